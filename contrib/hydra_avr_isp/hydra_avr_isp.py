@@ -0,0 +1,252 @@
+#!/usr/bin/env python3
+#
+# Program AVR microcontrollers with the Hydrabus BBIO SPI AVR commands
+# (command 0b00000110), pages are loaded and read by the firmware in
+# pipelined SPI bursts.
+#
+# Wiring: SCK to PB3, MOSI to PB5, MISO to PB4 (SPI1), RESET to PA15 (CS).
+#
+# License: Apache 2.0, same as hydrafw
+#
+import argparse
+import struct
+import sys
+import time
+import zlib
+
+BBIO_SPI_CS_LOW = 0x02
+BBIO_SPI_CS_HIGH = 0x03
+BBIO_SPI_AVR = 0x06
+BBIO_SPI_SET_SPEED = 0x60
+BBIO_SPI_CONFIG = 0x80
+
+AVR_VERSION = 0x01
+AVR_PROG_ENABLE = 0x03
+AVR_CHIP_ERASE = 0x04
+AVR_READ_INFO = 0x05
+AVR_WRITE_FUSE = 0x06
+AVR_READ_MEM = 0x07
+AVR_WRITE_MEM = 0x08
+AVR_CRC = 0x09
+
+MEM = {'flash': 0, 'eeprom': 1}
+FUSES = {'low': 0, 'high': 1, 'ext': 2, 'lock': 3}
+
+# Signature: name, flash size, flash page size, EEPROM size
+DEVICES = {
+    b'\x1e\x93\x0a': ('ATmega88', 8192, 64, 512),
+    b'\x1e\x94\x06': ('ATmega168', 16384, 128, 512),
+    b'\x1e\x95\x0f': ('ATmega328P', 32768, 128, 1024),
+    b'\x1e\x95\x14': ('ATmega328', 32768, 128, 1024),
+    b'\x1e\x95\x87': ('ATmega32U4', 32768, 128, 1024),
+    b'\x1e\x96\x08': ('ATmega640', 65536, 256, 4096),
+    b'\x1e\x97\x03': ('ATmega1280', 131072, 256, 4096),
+    b'\x1e\x98\x01': ('ATmega2560', 262144, 256, 4096),
+    b'\x1e\x91\x0a': ('ATtiny2313', 2048, 32, 128),
+    b'\x1e\x93\x0b': ('ATtiny85', 8192, 64, 512),
+}
+
+
+class AvrIsp(object):
+
+    def __init__(self, port):
+        self.port = port
+
+    def read_exact(self, n):
+        data = self.port.read(n)
+        if len(data) != n:
+            raise IOError('Timeout, %d bytes missing' % (n - len(data)))
+        return data
+
+    def command(self, data, answer=1):
+        self.port.write(bytes(data))
+        return self.read_exact(answer)
+
+    def enter(self, speed):
+        for _ in range(20):
+            self.port.write(b'\x00')
+        self.port.read(5)
+        time.sleep(0.1)
+        self.port.reset_input_buffer()
+        if self.command(b'\x00', 5) != b'BBIO1':
+            raise IOError('Could not get into binary mode, reset hydrabus')
+        if self.command(b'\x01', 4) != b'SPI1':
+            raise IOError('Cannot set SPI mode')
+        # SPI1, CPOL=0, CPHA=0, SCK shall be below the AVR clock / 4
+        self.command([BBIO_SPI_CONFIG | 0b011])
+        self.command([BBIO_SPI_SET_SPEED | speed])
+        if self.avr([AVR_VERSION], 3) != b'\x01\x00\x02':
+            raise IOError('AVR ISP commands not supported, update hydrafw')
+
+    def leave(self):
+        self.command([BBIO_SPI_CS_HIGH])
+        self.port.write(b'\x00')
+        self.port.read(5)
+        self.port.write(b'\x0F')
+
+    def avr(self, data, answer=1):
+        if self.command([BBIO_SPI_AVR, data[0]]) != b'\x01':
+            raise IOError('AVR command rejected')
+        if len(data) > 1:
+            self.port.write(bytes(data[1:]))
+        return self.read_exact(answer)
+
+    def program_enable(self):
+        # RESET pulse, then programming enable with RESET low
+        self.command([BBIO_SPI_CS_HIGH])
+        time.sleep(0.001)
+        self.command([BBIO_SPI_CS_LOW])
+        time.sleep(0.02)
+        if self.avr([AVR_PROG_ENABLE]) != b'\x01':
+            raise IOError('AVR not in sync, check wiring and --speed')
+
+    def info(self):
+        data = self.avr([AVR_READ_INFO], 7)
+        return data[:3], data[3:]
+
+    def chip_erase(self):
+        if self.avr([AVR_CHIP_ERASE]) != b'\x01':
+            raise IOError('Chip erase failed')
+
+    def write_fuse(self, fuse, value):
+        if self.avr([AVR_WRITE_FUSE, fuse, value]) != b'\x01':
+            raise IOError('Fuse write failed')
+
+    def read(self, mem, addr, length):
+        hdr = struct.pack('>BII', mem, addr, length)
+        if self.avr(bytes([AVR_READ_MEM]) + hdr) != b'\x01':
+            raise IOError('Read rejected')
+        return self.read_exact(length)
+
+    def crc(self, mem, addr, length):
+        hdr = struct.pack('>BII', mem, addr, length)
+        if self.avr(bytes([AVR_CRC]) + hdr) != b'\x01':
+            raise IOError('CRC rejected')
+        return struct.unpack('>I', self.read_exact(4))[0]
+
+    def write(self, mem, addr, data, page_size):
+        hdr = struct.pack('>BIIH', mem, addr, len(data), page_size)
+        if self.avr(bytes([AVR_WRITE_MEM]) + hdr) != b'\x01':
+            raise IOError('Write rejected, check address and page size')
+        self.port.write(data)
+        if self.read_exact(1) != b'\x01':
+            raise IOError('Write failed')
+
+
+def load(path):
+    """ Raw binary or Intel HEX file, returns the data from address 0 """
+    with open(path, 'rb') as f:
+        content = f.read()
+    if not path.lower().endswith('.hex'):
+        return content
+    data = bytearray()
+    base = 0
+    for line in content.decode('ascii').split():
+        rec = bytes.fromhex(line.lstrip(':'))
+        if sum(rec) & 0xFF:
+            raise ValueError('Bad checksum in %s' % path)
+        length, addr, rtype = rec[0], (rec[1] << 8) | rec[2], rec[3]
+        if rtype == 0:
+            addr += base
+            if len(data) < addr + length:
+                data.extend(b'\xff' * (addr + length - len(data)))
+            data[addr:addr + length] = rec[4:4 + length]
+        elif rtype == 2:
+            base = ((rec[4] << 8) | rec[5]) << 4
+        elif rtype == 4:
+            base = ((rec[4] << 8) | rec[5]) << 16
+    return bytes(data)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Hydrabus AVR ISP programmer')
+    parser.add_argument('--port', default='/dev/ttyACM0')
+    parser.add_argument('--speed', type=int, default=0, choices=range(8),
+                        help='BBIO SPI speed (0 slowest, default)')
+    sub = parser.add_subparsers(dest='cmd')
+    sub.add_parser('info', help='print signature and fuses')
+    sub.add_parser('erase', help='chip erase')
+    p = sub.add_parser('read', help='read memory to a raw binary file')
+    p.add_argument('mem', choices=MEM)
+    p.add_argument('file')
+    p.add_argument('--size', type=int, help='default whole memory')
+    p = sub.add_parser('write', help='erase, write and verify flash, or write EEPROM')
+    p.add_argument('mem', choices=MEM)
+    p.add_argument('file', help='raw binary or Intel HEX (.hex)')
+    p.add_argument('--no-erase', action='store_true')
+    p = sub.add_parser('verify', help='compare memory CRC32 with a file')
+    p.add_argument('mem', choices=MEM)
+    p.add_argument('file')
+    p = sub.add_parser('fuse', help='write a fuse or the lock bits')
+    p.add_argument('fuse', choices=FUSES)
+    p.add_argument('value', type=lambda v: int(v, 0))
+    args = parser.parse_args()
+
+    if args.cmd is None:
+        parser.print_help()
+        sys.exit(1)
+
+    import serial
+
+    port_name = args.port
+    try:
+        port = serial.Serial(port_name, 115200, timeout=5)
+    except serial.SerialException:
+        print("Couldn't open serial port %s" % port_name)
+        sys.exit(1)
+
+    isp = AvrIsp(port)
+    try:
+        isp.enter(args.speed)
+        isp.program_enable()
+        sig, fuses = isp.info()
+        if sig not in DEVICES:
+            raise IOError('Unknown signature %s' % sig.hex())
+        name, flash_size, page_size, eeprom_size = DEVICES[sig]
+        sizes = {'flash': flash_size, 'eeprom': eeprom_size}
+        t = time.time()
+
+        if args.cmd == 'info':
+            print('%s (signature %s)' % (name, sig.hex()))
+            print('Fuses: low 0x%02x high 0x%02x ext 0x%02x lock 0x%02x' %
+                  tuple(fuses))
+        elif args.cmd == 'erase':
+            isp.chip_erase()
+            print('Erased %s' % name)
+        elif args.cmd == 'read':
+            size = args.size or sizes[args.mem]
+            data = isp.read(MEM[args.mem], 0, size)
+            with open(args.file, 'wb') as f:
+                f.write(data)
+            print('Read %d bytes in %.2f s' % (size, time.time() - t))
+        elif args.cmd in ('write', 'verify'):
+            data = load(args.file)
+            if len(data) > sizes[args.mem]:
+                raise IOError('%d bytes do not fit in %s' % (len(data), name))
+            if args.cmd == 'write':
+                if args.mem == 'flash' and not args.no_erase:
+                    isp.chip_erase()
+                isp.write(MEM[args.mem], 0, data, page_size)
+                print('Wrote %d bytes in %.2f s' % (len(data), time.time() - t))
+            crc = isp.crc(MEM[args.mem], 0, len(data))
+            if crc != zlib.crc32(data) & 0xFFFFFFFF:
+                raise IOError('Verify failed (CRC32 0x%08x)' % crc)
+            print('Verified %d bytes, CRC32 0x%08x' % (len(data), crc))
+        elif args.cmd == 'fuse':
+            isp.write_fuse(FUSES[args.fuse], args.value)
+            _, fuses = isp.info()
+            if fuses[FUSES[args.fuse]] != args.value:
+                raise IOError('Fuse readback 0x%02x' % fuses[FUSES[args.fuse]])
+            print('%s fuse set to 0x%02x' % (args.fuse, args.value))
+        ok = True
+    except (IOError, ValueError) as e:
+        print(e)
+        ok = False
+
+    isp.leave()
+    port.close()
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,51 @@
+#!/usr/bin/env python3
+#
+# Hydrabus I2C slave emulation: register map images for the microSD card
+# (`slave file` in I2C mode)
+#
+# Wiring: SCL to PB6, SDA to PB7, GND, with pull-ups on the bus.
+#
+# License: Apache 2.0, same as hydrafw
+#
+import argparse
+import sys
+
+
+def make_image(filename, length, fill, sets):
+    """ Writes a register map image, REG=HEXBYTES sets bytes from REG """
+    image = bytearray([fill] * length)
+    for item in sets:
+        reg, data = item.split('=', 1)
+        reg = int(reg, 0)
+        data = bytes.fromhex(data)
+        if reg + len(data) > length:
+            print('%s: beyond the map length' % item)
+            return False
+        image[reg:reg + len(data)] = data
+    with open(filename, 'wb') as f:
+        f.write(image)
+    print('%s: %d bytes' % (filename, length))
+    return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Hydrabus I2C slave emulation')
+    parser.add_argument('--image', help='write a register map image for the microSD card')
+    parser.add_argument('--length', type=int, default=256,
+                        help='image length in bytes (default 256)')
+    parser.add_argument('--fill', type=lambda x: int(x, 0), default=0xFF,
+                        help='image fill byte (default 0xff)')
+    parser.add_argument('--set', action='append', default=[],
+                        metavar='REG=HEX', help='bytes at REG, e.g. 0x10=deadbeef')
+    args = parser.parse_args()
+
+    if args.image:
+        ok = make_image(args.image, args.length, args.fill, args.set)
+    else:
+        parser.print_help()
+        ok = False
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+#
+# Hydrabus I2C sniffer: live capture with the BBIO I2C sniffer
+# (command 0b00001111)
+#
+# Wiring: SCL to PB6, SDA to PB7, GND.
+#
+# License: Apache 2.0, same as hydrafw
+#
+import argparse
+import sys
+import time
+
+
+class StreamParser(object):
+    """ Parses the BBIO sniffer output: '[', ']', '\\' byte '+'/'-' """
+
+    def __init__(self):
+        self.buf = b''
+        self.line = ''
+
+    def feed(self, data):
+        self.buf += data
+        lines = []
+        while self.buf:
+            c = self.buf[:1]
+            if c == b'[':
+                if not self.line:
+                    self.line = '%.6f ' % time.time()
+                self.line += '['
+                self.buf = self.buf[1:]
+            elif c == b']':
+                lines.append(self.line + ']')
+                self.line = ''
+                self.buf = self.buf[1:]
+            elif c == b'\\':
+                if len(self.buf) < 3:
+                    break
+                self.line += '0x%02x%s' % (self.buf[1], chr(self.buf[2]))
+                self.buf = self.buf[3:]
+            elif c == b'\x01':
+                # End of the sniffer
+                self.buf = self.buf[1:]
+                lines.append(None)
+            else:
+                raise ValueError('Unknown byte 0x%02x' % self.buf[0])
+        return lines
+
+
+def capture(port_name, duration):
+    import serial
+
+    port = serial.Serial(port_name, 115200, timeout=0.1)
+    for _ in range(20):
+        port.write(b'\x00')
+    if b'BBIO1' not in port.read(5):
+        print('Could not get into binary mode, try again or reset hydrabus.')
+        return False
+    port.reset_input_buffer()
+    port.write(b'\x02')
+    if b'I2C1' not in port.read(4):
+        print('Cannot set I2C mode, try again or reset hydrabus.')
+        return False
+
+    port.write(b'\x0f')
+    parser = StreamParser()
+    stop = time.time() + duration if duration else None
+    stopping = False
+    try:
+        while True:
+            if not stopping and stop is not None and time.time() >= stop:
+                # Any byte stops the sniffer
+                port.write(b'\x00')
+                stopping = True
+            lines = parser.feed(port.read(port.in_waiting or 1))
+            for line in lines:
+                if line is None:
+                    break
+                print(line)
+            if None in lines:
+                break
+    except KeyboardInterrupt:
+        port.write(b'\x00')
+        while None not in parser.feed(port.read(port.in_waiting or 1)):
+            pass
+
+    # Back to console mode
+    port.write(b'\x00')
+    port.write(b'\x0F\n')
+    port.close()
+    return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Hydrabus I2C sniffer')
+    parser.add_argument('port', nargs='?', default='/dev/ttyACM0')
+    parser.add_argument('--duration', type=float, default=0,
+                        help='capture duration in seconds (default until CTRL+C)')
+    args = parser.parse_args()
+
+    ok = capture(args.port, args.duration)
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,285 @@
+#!/usr/bin/env python3
+#
+# Dump parallel NAND flash with the Hydrabus BBIO flash page read command
+# (0b00001100): pages (data and spare areas) are read by the firmware with
+# the data bus kept in input mode and streamed with a CRC32 per page, to
+# USB or to a preallocated microSD file.
+# The geometry comes from the probe command (0b00001101, ONFI parameter
+# page or ID), bad blocks and 1 bit Hamming ECC (Linux software ECC
+# layout) are checked by the firmware.
+#
+# Wiring: see 'show pins' in nandflash mode, data bus on PC0-PC7.
+#
+# License: Apache 2.0, same as hydrafw
+#
+import argparse
+import struct
+import sys
+import time
+import zlib
+
+BBIO_FLASH = 0x0A
+FLASH_EN_LOW = 0x02
+FLASH_EN_HIGH = 0x03
+FLASH_WRITE_READ = 0x04
+FLASH_WRITE_CMD = 0x06
+FLASH_READ_BYTE = 0x07
+FLASH_WAIT_READY = 0x08
+FLASH_READ_PAGES = 0x0C
+FLASH_PROBE = 0x0D
+FLASH_WRITE_ADDR = 0x10
+
+READ_PAGES_SD = 0x01
+READ_PAGES_ECC = 0x02
+READ_PAGES_STATUS = 0x04
+
+# Page status (NAND_PAGE_x)
+PAGE_BAD_BLOCK = 0x01
+PAGE_ECC_CORRECTED = 0x02
+PAGE_ECC_FAILED = 0x04
+
+ONFI_PARAM_SIZE = 256
+
+def onfi_crc16(data):
+    crc = 0x4F4E
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x8005 if crc & 0x8000 else crc << 1) & 0xFFFF
+    return crc
+
+
+def parse_onfi(param):
+    """ Same parsing as nand_parse_onfi(), returns a dict or None """
+    if param[:4] != b'ONFI' or \
+            onfi_crc16(param[:254]) != struct.unpack('<H', param[254:256])[0]:
+        return None
+    data_size, spare = struct.unpack('<IH', param[80:86])
+    pages_per_block, blocks_per_lun, luns = struct.unpack('<IIB', param[92:101])
+    return {
+        'model': param[44:64].decode('ascii', 'replace').rstrip(),
+        'data_size': data_size,
+        'page_size': data_size + spare,
+        'pages_per_block': pages_per_block,
+        'nb_blocks': blocks_per_lun * luns,
+        'row_cycles': param[101] & 0x0F,
+        'col_cycles': param[101] >> 4,
+        'ecc_bits': param[112],
+    }
+
+
+class NandDump(object):
+
+    def __init__(self, port):
+        self.port = port
+
+    def read_exact(self, n):
+        data = self.port.read(n)
+        if len(data) != n:
+            raise IOError('Timeout, %d bytes missing' % (n - len(data)))
+        return data
+
+    def command(self, data, answer=1):
+        self.port.write(bytes(data))
+        return self.read_exact(answer)
+
+    def enter(self):
+        for _ in range(20):
+            self.port.write(b'\x00')
+        self.port.read(5)
+        time.sleep(0.1)
+        self.port.reset_input_buffer()
+        if self.command(b'\x00', 5) != b'BBIO1':
+            raise IOError('Could not get into binary mode, reset hydrabus')
+        if self.command([BBIO_FLASH], 4) != b'FLA1':
+            raise IOError('Cannot set flash mode')
+
+    def leave(self):
+        self.port.write(b'\x00')
+        self.port.read(5)
+        self.port.write(b'\x0F')
+
+    def probe(self):
+        """ ID and geometry, from the ONFI parameter page or the ID """
+        if self.command([FLASH_PROBE]) != b'\x01':
+            raise IOError('No NAND flash found')
+        answer = self.read_exact(25)
+        onfi, col, row, data_size, page_size, ppb, blocks, ecc_bits = \
+            struct.unpack('>BBBIIIIB', answer[5:])
+        return {
+            'id': answer[:5], 'onfi': bool(onfi), 'col_cycles': col,
+            'row_cycles': row, 'data_size': data_size,
+            'page_size': page_size, 'pages_per_block': ppb,
+            'nb_blocks': blocks, 'ecc_bits': ecc_bits,
+        }
+
+    def read_param_page(self):
+        """ ONFI parameter page (3 copies) with the byte oriented commands """
+        self.command([FLASH_EN_LOW])
+        self.command([FLASH_WRITE_CMD, 0xEC])
+        self.command([FLASH_WRITE_ADDR, 0x00])
+        self.command([FLASH_WAIT_READY])
+        data = self.command([FLASH_WRITE_READ] +
+                            list(struct.pack('>HH', 0, 3 * ONFI_PARAM_SIZE)),
+                            1 + 3 * ONFI_PARAM_SIZE)[1:]
+        self.command([FLASH_EN_HIGH])
+        for i in range(3):
+            geo = parse_onfi(data[i * ONFI_PARAM_SIZE:(i + 1) * ONFI_PARAM_SIZE])
+            if geo:
+                return geo
+        return None
+
+    def read_pages(self, geo, first, count, to_sd, use_ecc, out):
+        """ Burst page read, returns (CRC errors, pages status) """
+        flags = READ_PAGES_STATUS
+        if to_sd:
+            flags |= READ_PAGES_SD
+        if use_ecc:
+            flags |= READ_PAGES_ECC
+        hdr = struct.pack('>BBHIIIB', geo['col_cycles'], geo['row_cycles'],
+                          geo['page_size'], geo['pages_per_block'], first,
+                          count, flags)
+        if self.command([FLASH_READ_PAGES] + list(hdr)) != b'\x01':
+            raise IOError('Page read rejected (geometry, ECC or microSD)')
+        errors = 0
+        status = bytearray()
+        for i in range(count):
+            data = b'' if to_sd else self.read_exact(geo['page_size'])
+            crc, page_status = struct.unpack('>IB', self.read_exact(5))
+            status.append(page_status)
+            if not to_sd:
+                if zlib.crc32(data) & 0xFFFFFFFF != crc:
+                    print('Page %d: CRC error' % (first + i))
+                    errors += 1
+                out.write(data)
+        if self.read_exact(1) != b'\x01':
+            raise IOError('Dump failed')
+        return errors, status
+
+    def read_pages_legacy(self, geo, first, count, out):
+        """ One page at a time with the byte oriented commands """
+        for row in range(first, first + count):
+            addr = [0] * geo['col_cycles'] + \
+                [(row >> (8 * i)) & 0xFF for i in range(geo['row_cycles'])]
+            self.command([FLASH_EN_LOW])
+            self.command([FLASH_WRITE_CMD, 0x00])
+            self.command([FLASH_WRITE_ADDR | (len(addr) - 1)] + addr)
+            if geo['col_cycles'] > 1:
+                self.command([FLASH_WRITE_CMD, 0x30])
+            self.command([FLASH_WAIT_READY])
+            data = b''
+            while len(data) < geo['page_size']:
+                n = min(4096, geo['page_size'] - len(data))
+                data += self.command([FLASH_WRITE_READ] +
+                                     list(struct.pack('>HH', 0, n)), 1 + n)[1:]
+            self.command([FLASH_EN_HIGH])
+            out.write(data)
+
+
+def report(geo, first, status):
+    """ Prints the bad blocks and ECC results """
+    ppb = geo['pages_per_block']
+    # The device only flags the marker pages, maybe both of them
+    bad = sorted(set((first + i) // ppb for i, s in enumerate(status)
+                     if s & PAGE_BAD_BLOCK))
+    failed = [first + i for i, s in enumerate(status) if s & PAGE_ECC_FAILED]
+    corrected = sum(1 for s in status if s & PAGE_ECC_CORRECTED)
+    print('Bad blocks: %d%s' % (len(bad), (' (' + ', '.join(map(str, bad)) + ')')
+                                if bad else ''))
+    if failed or corrected:
+        print('ECC corrected pages: %d, uncorrectable pages: %d' %
+              (corrected, len(failed)))
+        for page in failed[:20]:
+            print('Page %d: uncorrectable' % page)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Hydrabus NAND flash dump')
+    parser.add_argument('port', nargs='?', default='/dev/ttyACM0')
+    parser.add_argument('--output', default='nand_dump.bin')
+    parser.add_argument('--first', type=int, default=0, help='first page')
+    parser.add_argument('--pages', type=int, default=0,
+                        help='number of pages (default up to the end)')
+    parser.add_argument('--page-size', type=int,
+                        help='data and spare bytes (default from the probe)')
+    parser.add_argument('--col-cycles', type=int, choices=(1, 2))
+    parser.add_argument('--row-cycles', type=int, choices=(1, 2, 3))
+    parser.add_argument('--ecc', action='store_true',
+                        help='correct the data with the 1 bit Hamming ECC')
+    parser.add_argument('--sd', action='store_true',
+                        help='dump to nand_dump.bin on the hydrabus microSD')
+    parser.add_argument('--legacy', action='store_true',
+                        help='also dump with the byte oriented commands and compare')
+    args = parser.parse_args()
+
+    import serial
+
+    port_name = args.port
+    try:
+        port = serial.Serial(port_name, 115200, timeout=5)
+    except serial.SerialException:
+        print("Couldn't open serial port %s" % port_name)
+        sys.exit(1)
+
+    dump = NandDump(port)
+    ok = True
+    try:
+        dump.enter()
+        geo = dump.probe()
+        for key in ('page_size', 'col_cycles', 'row_cycles'):
+            if getattr(args, key) is not None:
+                geo[key] = getattr(args, key)
+        count = args.pages or geo['nb_blocks'] * geo['pages_per_block'] - args.first
+        if count <= 0:
+            raise IOError('Unknown device, give --pages')
+        print('ID: %s%s, %d+%d bytes pages, %d pages per block, %d blocks' %
+              (geo['id'].hex(), ' (ONFI)' if geo['onfi'] else '',
+               geo['data_size'], geo['page_size'] - geo['data_size'],
+               geo['pages_per_block'], geo['nb_blocks']))
+        if geo['onfi']:
+            onfi = dump.read_param_page()
+            if onfi:
+                print('ONFI model: %s, required ECC: %d bits' %
+                      (onfi['model'], onfi['ecc_bits']))
+        if args.ecc and geo['ecc_bits'] > 1:
+            print('Warning: the device requires %d ECC bits, the 1 bit '
+                  'Hamming ECC will not match its layout' % geo['ecc_bits'])
+
+        t = time.time()
+        with open(args.output, 'wb') as out:
+            errors, status = dump.read_pages(geo, args.first, count, args.sd,
+                                             args.ecc, out)
+        t = time.time() - t
+        size = count * geo['page_size']
+        print('Read %d pages in %.2f s (%d KB/s)%s' %
+              (count, t, size / t / 1024, ' to microSD' if args.sd else ''))
+        report(geo, args.first, status)
+        if errors:
+            ok = False
+
+        if args.legacy and not args.sd:
+            t = time.time()
+            with open(args.output + '.legacy', 'wb') as out:
+                dump.read_pages_legacy(geo, args.first, count, out)
+            t = time.time() - t
+            print('Legacy commands: %.2f s (%d KB/s)' % (t, size / t / 1024))
+            with open(args.output, 'rb') as a, open(args.output + '.legacy', 'rb') as b:
+                if args.ecc:
+                    print('Raw dump kept in %s.legacy' % args.output)
+                elif a.read() != b.read():
+                    print('Dumps differ')
+                    ok = False
+                else:
+                    print('Dumps match')
+    except IOError as e:
+        print(e)
+        ok = False
+
+    dump.leave()
+    port.close()
+    print('Errors: %d' % (0 if ok else 1))
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == '__main__':
+    main()
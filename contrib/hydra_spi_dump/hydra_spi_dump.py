@@ -11,9 +11,12 @@ import serial
 import struct
 import sys
 import signal
+import zlib
 
 sector_size = 0x1000      # also the max buffer supported by hydrabus ? (CONFIRM THIS)
 hydrabus = None
+port = '/dev/ttyACM0'
+max_retries = 3
 
 def error(msg):
     print(msg)
@@ -36,6 +39,13 @@ def print_usage():
     print("\t\tBy default, it dumps in slow (320kHz) mode, choose fast to increase to 10.5 mHz.")
     print("\n\thydra_spi_flash.py chip_id")
     print("\t\tPrints chip idenfification (RDID).")
+    print("\n\thydra_spi_dump.py flash_dump <dump_file> [hex_address] [hex_length]")
+    print("\t\tDumps the flash with the on-device engine (fast read at highest speed),")
+    print("\t\teach 4k block is checked with its CRC32 and read again on mismatch.")
+    print("\t\tBy default, dumps the whole flash (size from SFDP).")
+    print("\n\thydra_spi_dump.py flash_id")
+    print("\t\tPrints JEDEC ID and geometry detected by hydrabus.")
+    print("\nAdd --port <dev> to use another serial port than " + port + ".")
     print("\nThis script requires Python 3.2+, pip3 install serial hexdump")
     quit()
     
@@ -52,7 +62,7 @@ def hydrabus_setup():
     global hydrabus
     
     #Open serial port
-    hydrabus = serial.Serial('/dev/ttyACM0', 115200)
+    hydrabus = serial.Serial(port, 115200, timeout=5)
 
     #Open binary mode
     for i in range(20):
@@ -109,21 +119,27 @@ def dump_chip():
     sector = 0
     buf = bytearray()
     
-    while sector < sectors:
-        # write-then-read: write 4 bytes (1 read cmd + 3 read addr), read sector_size bytes
-        hydrabus.write(b'\x04\x00\x04' + hex_to_bin(sector_size, 2))
+    # streaming write-then-read: write 4 bytes (1 read cmd + 3 read addr),
+    # read all sectors at once with CS held low (32bits lengths)
+    hydrabus.write(b'\x07' + hex_to_bin(4, 4) + hex_to_bin(sectors * sector_size, 4))
 
-        # read command (\x03) and address
-        hydrabus.write(b'\x03' + calc_hex_addr(start_addr, sector * sector_size))
-        
-        # Hydrabus will send \x01 in case of success...
-        ok = hydrabus.read(1)
-        
-        #...followed by sector_size read bytes
+    # read command (\x03) and address
+    hydrabus.write(b'\x03' + calc_hex_addr(start_addr, 0))
+
+    # Hydrabus will send \x01 if the command is accepted...
+    if b'\x01' not in hydrabus.read(1):
+        error("Streaming write-then-read not supported, update hydrafw.")
+
+    #...followed by the read bytes
+    while sector < sectors:
         buf += hydrabus.read(sector_size)
         print('Read sector ' + str(sector))
         sector += 1
 
+    #...and \x01 if all SPI transfers succeeded
+    if b'\x01' not in hydrabus.read(1):
+        error("SPI transfer error.")
+
     with open(dump_file, 'wb+') as f:
         f.write(buf)
         
@@ -149,8 +165,92 @@ def chip_id():
     print("Finished chip_id function.")
     
 
+def flash_info():
+    global hydrabus
+
+    hydrabus.write(b'\x0a')
+    if hydrabus.read(1) != b'\x01':
+        error("No SPI flash found (or on-device engine not supported, update hydrafw).")
+    answer = hydrabus.read(12)
+    flags = answer[3]
+    size, erase = struct.unpack('>II', answer[4:12])
+    return answer[0:3], flags, size, erase
+
+def flash_id():
+    jedec, flags, size, erase = flash_info()
+    print('JEDEC ID: ' + jedec.hex())
+    print('Size: ' + (str(size) + ' bytes' if size else 'unknown'))
+    if erase:
+        print('Erase size: ' + str(erase) + ' bytes')
+    print('Address bytes: ' + ('4' if flags & 0x02 else '3'))
+    print('Geometry from: ' + ('SFDP' if flags & 0x01 else 'JEDEC ID'))
+
+def flash_read(addr, length):
+    """ On-device dump, returns the blocks and the ones with a bad CRC """
+    global hydrabus
+
+    hydrabus.write(b'\x08' + hex_to_bin(addr, 4) + hex_to_bin(length, 4) + b'\x00')
+    if hydrabus.read(1) != b'\x01':
+        error("Dump rejected (address or length out of the flash).")
+
+    blocks = []
+    bad = []
+    while length > 0:
+        size = min(length, sector_size)
+        data = hydrabus.read(size)
+        crc = struct.unpack('>I', hydrabus.read(4))[0]
+        if len(data) != size or zlib.crc32(data) != crc:
+            bad.append(len(blocks))
+        blocks.append(data)
+        length -= size
+
+    if hydrabus.read(1) != b'\x01':
+        error("SPI transfer error.")
+    return blocks, bad
+
+def flash_dump():
+    if len(sys.argv) < 3:
+        print_usage()
+    dump_file = sys.argv[2]
+    addr = int(sys.argv[3], 16) if len(sys.argv) > 3 else 0
+
+    hydrabus_setup()
+    jedec, flags, size, erase = flash_info()
+    if len(sys.argv) > 4:
+        length = int(sys.argv[4], 16)
+    elif size > addr:
+        length = size - addr
+    else:
+        error("Flash size unknown, give the length.")
+
+    print('Dumping ' + hex(length) + ' bytes from ' + hex(addr) + ', JEDEC ID ' + jedec.hex())
+    blocks, bad = flash_read(addr, length)
+
+    for block in bad:
+        block_addr = addr + block * sector_size
+        block_len = min(sector_size, addr + length - block_addr)
+        for retry in range(max_retries):
+            print('CRC error on block at ' + hex(block_addr) + ', reading it again')
+            data, data_bad = flash_read(block_addr, block_len)
+            if not data_bad:
+                blocks[block] = data[0]
+                break
+        else:
+            error("Block at " + hex(block_addr) + " still corrupted, giving up.")
+
+    with open(dump_file, 'wb+') as f:
+        f.write(b''.join(blocks))
+
+    print('Finished dumping to ' + dump_file + ', ' + str(len(bad)) + ' block(s) read again')
+
 if __name__ == '__main__':
     
+    if '--port' in sys.argv:
+        i = sys.argv.index('--port')
+        port = sys.argv[i + 1]
+        del sys.argv[i:i + 2]
+
+    
     # disable this for debugging
     #signal.signal(signal.SIGINT, signal_handler)
     
@@ -166,6 +266,15 @@ if __name__ == '__main__':
         hydrabus_setup()
         chip_id()
         hydrabus_cleanup()
+
+    elif sys.argv[1] == "flash_dump":
+        flash_dump()
+        hydrabus_cleanup()
+
+    elif sys.argv[1] == "flash_id":
+        hydrabus_setup()
+        flash_id()
+        hydrabus_cleanup()
         
     else:
         print_usage()
@@ -0,0 +1,178 @@
+#!/usr/bin/env python3
+#
+# Capture and decode SPI traffic with the Hydrabus BBIO SPI DMA sniffer
+# (command 0b00001011).
+#
+# Wiring: SCK to SPI1 and SPI2 SCK (PB3, PB10), CS to SPI1 CS (PA15),
+# MOSI to SPI1 MOSI (PB5), MISO to SPI2 MOSI (PC3).
+#
+# License: Apache 2.0, same as hydrafw
+#
+import argparse
+import struct
+import sys
+import time
+
+# Timestamps are DWT cycles of the STM32F405 core
+HCLK = 168000000
+
+REC_CS_LOW = 0x01
+REC_CS_HIGH = 0x02
+REC_DATA = 0x03
+REC_STATUS = 0x04
+REC_END = 0x05
+
+
+class Decoder(object):
+    """ Parses the record stream, data can be fed in any chunk size """
+
+    def __init__(self):
+        self.buf = b''
+
+    def feed(self, data):
+        self.buf += data
+        records = []
+        while self.buf:
+            rec = self.buf[0]
+            if rec in (REC_CS_LOW, REC_CS_HIGH):
+                if len(self.buf) < 5:
+                    break
+                records.append((rec, struct.unpack('<I', self.buf[1:5])[0]))
+                self.buf = self.buf[5:]
+            elif rec == REC_DATA:
+                if len(self.buf) < 3:
+                    break
+                nb = struct.unpack('<H', self.buf[1:3])[0]
+                if len(self.buf) < 3 + 2 * nb:
+                    break
+                pairs = self.buf[3:3 + 2 * nb]
+                records.append((rec, pairs[0::2], pairs[1::2]))
+                self.buf = self.buf[3 + 2 * nb:]
+            elif rec in (REC_STATUS, REC_END):
+                if len(self.buf) < 13:
+                    break
+                records.append((rec,) + struct.unpack('<III', self.buf[1:13]))
+                self.buf = self.buf[13:]
+            else:
+                raise ValueError('Unknown record 0x%02x' % rec)
+        return records
+
+
+class Transactions(object):
+    """ Groups records in CS framed transactions, timestamps in seconds """
+
+    def __init__(self, hclk=HCLK):
+        self.hclk = hclk
+        self.last_ts = None
+        self.high_ts = 0
+        self.current = None
+        self.lost = 0
+        self.events_lost = 0
+
+    def _unwrap(self, ts):
+        # 32 bits cycle counter, status records come often enough
+        if self.last_ts is not None and ts < self.last_ts:
+            self.high_ts += 1 << 32
+        self.last_ts = ts
+        return float(self.high_ts + ts) / self.hclk
+
+    def add(self, records):
+        done = []
+        for rec in records:
+            if rec[0] == REC_CS_LOW:
+                self.current = {'start': self._unwrap(rec[1]), 'end': None,
+                                'mosi': b'', 'miso': b''}
+            elif rec[0] == REC_CS_HIGH:
+                end = self._unwrap(rec[1])
+                if self.current is not None:
+                    self.current['end'] = end
+                    done.append(self.current)
+                self.current = None
+            elif rec[0] == REC_DATA:
+                if self.current is None:
+                    # Data outside of CS, or CS low edge missed
+                    self.current = {'start': None, 'end': None,
+                                    'mosi': b'', 'miso': b''}
+                self.current['mosi'] += rec[1]
+                self.current['miso'] += rec[2]
+            else:
+                self._unwrap(rec[1])
+                self.lost = rec[2]
+                self.events_lost = rec[3]
+        return done
+
+
+def print_transaction(t):
+    start = '%.6f' % t['start'] if t['start'] is not None else '?'
+    end = '%.6f' % t['end'] if t['end'] is not None else '?'
+    print('[%s - %s] %d bytes' % (start, end, len(t['mosi'])))
+    print('  MOSI: ' + t['mosi'].hex())
+    print('  MISO: ' + t['miso'].hex())
+
+
+def capture(port_name, duration):
+    import serial
+
+    port = serial.Serial(port_name, 115200, timeout=1)
+    for _ in range(20):
+        port.write(b'\x00')
+    if b'BBIO1' not in port.read(5):
+        print('Could not get into binary mode, try again or reset hydrabus.')
+        return False
+    port.reset_input_buffer()
+    port.write(b'\x01')
+    if b'SPI1' not in port.read(4):
+        print('Cannot set SPI mode, try again or reset hydrabus.')
+        return False
+
+    port.write(b'\x0b')
+    if port.read(1) != b'\x01':
+        print('Cannot start the sniffer (update hydrafw?).')
+        return False
+
+    decoder = Decoder()
+    trans = Transactions()
+    stop = time.time() + duration if duration else None
+
+    def read_records():
+        """ Prints the transactions read, returns True at the end record """
+        records = decoder.feed(port.read(port.in_waiting or 1))
+        for t in trans.add(records):
+            print_transaction(t)
+        return any(r[0] == REC_END for r in records)
+
+    try:
+        while stop is None or time.time() < stop:
+            if read_records():
+                break
+        else:
+            port.write(b'\x00')
+            while not read_records():
+                pass
+    except KeyboardInterrupt:
+        # Any byte stops the sniffer, it then sends the end record
+        port.write(b'\x00')
+        while not read_records():
+            pass
+
+    print('Lost bytes: %d, lost CS edges: %d' % (trans.lost, trans.events_lost))
+    # Back to console mode
+    port.write(b'\x00')
+    port.write(b'\x0F\n')
+    port.close()
+    return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Hydrabus SPI DMA sniffer')
+    parser.add_argument('port', nargs='?', default='/dev/ttyACM0')
+    parser.add_argument('--duration', type=float, default=0,
+                        help='capture duration in seconds (default until CTRL+C)')
+    args = parser.parse_args()
+
+    ok = capture(args.port, args.duration)
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == '__main__':
+    main()
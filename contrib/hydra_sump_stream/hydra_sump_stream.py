@@ -0,0 +1,356 @@
+#!/usr/bin/env python3
+#
+# Decode the streaming SUMP captures written to the microSD by the
+# Hydrabus 'sump filename <name>' command: the data file (raw or run
+# length encoded 16bits words) and its .idx index file (header, trigger
+# and overflow markers).
+# Files are read from a directory (mounted card) or from a FAT16/FAT32
+# card image.
+#
+# License: Apache 2.0, same as hydrafw
+#
+import argparse
+import random
+import struct
+import sys
+
+MAGIC = b'HYDRASMP'
+HEADER = struct.Struct('<8sIIIIIIQQIIII')
+MARKER = struct.Struct('<QII')
+FLAG_RLE = 0x01
+RLE_FLAG = 0x8000
+RLE_MASK = 0x7FFF
+
+
+class FatImage(object):
+    """ Read only FAT16/FAT32 image, 8.3 names """
+
+    def __init__(self, data):
+        self.data = data
+        offset = 0
+        # MBR with a single partition
+        if data[510:512] == b'\x55\xaa' and data[0x1C2] in (0x04, 0x06, 0x0B, 0x0C, 0x0E):
+            offset = struct.unpack_from('<I', data, 0x1C6)[0] * 512
+        (self.sector, self.cluster_sectors, reserved, nb_fats, root_entries,
+         total16, _, fat16_size) = struct.unpack_from('<HBHBHHBH', data, offset + 11)
+        fat32_size, = struct.unpack_from('<I', data, offset + 36)
+        self.fat32 = fat16_size == 0
+        fat_size = fat32_size if self.fat32 else fat16_size
+        self.fat = offset + reserved * self.sector
+        root_sectors = (root_entries * 32 + self.sector - 1) // self.sector
+        self.root16 = self.fat + nb_fats * fat_size * self.sector
+        self.data_start = self.root16 + root_sectors * self.sector
+        self.root_entries = root_entries
+        if self.fat32:
+            self.root_cluster, = struct.unpack_from('<I', data, offset + 44)
+
+    def next_cluster(self, cluster):
+        if self.fat32:
+            return struct.unpack_from('<I', self.data, self.fat + 4 * cluster)[0] & 0x0FFFFFFF
+        return struct.unpack_from('<H', self.data, self.fat + 2 * cluster)[0]
+
+    def chain(self, cluster):
+        end = 0x0FFFFFF8 if self.fat32 else 0xFFF8
+        size = self.cluster_sectors * self.sector
+        out = []
+        while 2 <= cluster < end:
+            pos = self.data_start + (cluster - 2) * size
+            out.append(self.data[pos:pos + size])
+            cluster = self.next_cluster(cluster)
+        return b''.join(out)
+
+    def entries(self, cluster):
+        if cluster is None:
+            raw = self.data[self.root16:self.root16 + 32 * self.root_entries]
+        else:
+            raw = self.chain(cluster)
+        for pos in range(0, len(raw), 32):
+            e = raw[pos:pos + 32]
+            if e[0] == 0:
+                break
+            if e[0] == 0xE5 or e[11] == 0x0F or e[11] & 0x08:
+                continue
+            name = e[0:8].decode('latin-1').rstrip()
+            ext = e[8:11].decode('latin-1').rstrip()
+            first = struct.unpack_from('<H', e, 26)[0] | (struct.unpack_from('<H', e, 20)[0] << 16)
+            size = struct.unpack_from('<I', e, 28)[0]
+            yield (name + '.' + ext if ext else name).upper(), e[11], first, size
+
+    def read(self, path):
+        cluster = self.root_cluster if self.fat32 else None
+        # Firmware paths start with the drive number
+        if path[1:2] == ':':
+            path = path[2:]
+        parts = [p for p in path.replace('\\', '/').split('/') if p]
+        for i, part in enumerate(parts):
+            for name, attr, first, size in self.entries(cluster):
+                if name != part.upper():
+                    continue
+                if i == len(parts) - 1:
+                    return self.chain(first)[:size]
+                cluster = first
+                break
+            else:
+                raise IOError('%s not found in the image' % path)
+        raise IOError('%s is a directory' % path)
+
+
+def parse_index(data):
+    """ Returns the header as a dict and the markers (sample, offset, lost) """
+    if len(data) < HEADER.size or data[:8] != MAGIC:
+        raise ValueError('Not a Hydrabus SUMP index file')
+    fields = HEADER.unpack_from(data, 0)
+    keys = ('magic', 'version', 'sample_rate', 'flags', 'trigger_mask',
+            'trigger_value', 'data_len', 'samples', 'lost', 'nb_overflows',
+            'nb_triggers', 'dropped', 'reserved')
+    header = dict(zip(keys, fields))
+    markers = [MARKER.unpack_from(data, pos)
+               for pos in range(HEADER.size, len(data) - MARKER.size + 1, MARKER.size)]
+    return header, markers
+
+
+def decode(data, header, markers):
+    """ Returns the transitions [(sample, value)] and the number of samples.
+        Overflow markers move the time forward before their word. """
+    rle = header['flags'] & FLAG_RLE
+    gaps = {}
+    for sample, offset, lost in markers:
+        if lost:
+            gaps[offset] = gaps.get(offset, 0) + lost
+    words = struct.unpack('<%dH' % (len(data) // 2), data[:len(data) & ~1])
+    transitions = []
+    t = 0
+    last = None
+    for i, w in enumerate(words):
+        if i * 2 in gaps:
+            t += gaps[i * 2]
+        if rle and w & RLE_FLAG:
+            t += w & RLE_MASK
+            continue
+        if w != last:
+            transitions.append((t, w))
+            last = w
+        t += 1
+    # Repeats still pending when the capture stopped on a full block
+    return transitions, max(t, header['samples'])
+
+
+def offsets_time(data, header, markers):
+    """ Sample number of each word offset, to check the markers """
+    rle = header['flags'] & FLAG_RLE
+    gaps = {}
+    for sample, offset, lost in markers:
+        if lost:
+            gaps[offset] = gaps.get(offset, 0) + lost
+    times = {}
+    t = 0
+    for i in range(len(data) // 2):
+        w = struct.unpack_from('<H', data, 2 * i)[0]
+        if 2 * i in gaps:
+            t += gaps[2 * i]
+        times[2 * i] = t
+        t += (w & RLE_MASK) if rle and w & RLE_FLAG else 1
+    return times
+
+
+def check_markers(data, header, markers):
+    """ Each marker shall point to a value word of its sample """
+    times = offsets_time(data, header, markers)
+    rle = header['flags'] & FLAG_RLE
+    errors = 0
+    for sample, offset, lost in markers:
+        if times.get(offset) != sample:
+            errors += 1
+        elif rle and struct.unpack_from('<H', data, offset)[0] & RLE_FLAG:
+            errors += 1
+    return errors
+
+
+def write_vcd(f, transitions, nb_samples, rate, channels):
+    period_ns = 1e9 / rate
+    f.write('$timescale 1 ns $end\n$scope module hydrabus $end\n')
+    for ch in channels:
+        f.write('$var wire 1 %s PC%d $end\n' % (chr(33 + ch), ch))
+    f.write('$upscope $end\n$enddefinitions $end\n')
+    last = None
+    for t, value in transitions:
+        changed = [ch for ch in channels
+                   if last is None or ((value ^ last) >> ch) & 1]
+        if changed:
+            f.write('#%d\n' % int(t * period_ns))
+            for ch in changed:
+                f.write('%d%s\n' % ((value >> ch) & 1, chr(33 + ch)))
+        last = value
+    f.write('#%d\n' % int(nb_samples * period_ns))
+
+
+def write_ols(f, transitions, first, last, rate):
+    """ OLS data file, a window of samples """
+    window = [(t, v) for t, v in transitions if first <= t < last]
+    before = [v for t, v in transitions if t < first]
+    if before and (not window or window[0][0] != first):
+        window.insert(0, (first, before[-1]))
+    f.write(';Size: %d\n;Rate: %d\n;Channels: 16\n;EnabledChannels: 65535\n'
+            % (last - first, rate))
+    f.write(';Compressed: true\n;AbsoluteLength: %d\n' % (last - first))
+    for t, v in window:
+        f.write('%08x@%d\n' % (v, t - first))
+
+
+def encode(samples, rle, mask, value, block_size, gaps=None):
+    """ Reference of the firmware encoder, gaps: {sample: lost before} """
+    data = bytearray()
+    markers = []
+    gaps = gaps or {}
+    last = RLE_FLAG
+    count = 0
+    matched = False
+    t = 0
+
+    def put(word):
+        data.extend(struct.pack('<H', word))
+
+    def full():
+        if rle and len(data) % block_size == block_size - 2:
+            put(RLE_FLAG)
+
+    for i, v in enumerate(samples):
+        lost = gaps.get(i, 0)
+        t += lost
+        trigger = False
+        if mask:
+            m = (v & mask) == (value & mask)
+            trigger = m and not matched
+            matched = m
+        if rle:
+            v &= RLE_MASK
+            if not (trigger or lost or v != last):
+                count += 1
+                if count == RLE_MASK:
+                    put(RLE_FLAG | count)
+                    count = 0
+                    last = RLE_FLAG
+                t += 1
+                full()
+                continue
+            if count:
+                put(RLE_FLAG | count)
+                count = 0
+            last = v
+        if lost:
+            markers.append((t, len(data), lost))
+        if trigger:
+            markers.append((t, len(data), 0))
+        put(v)
+        t += 1
+        full()
+    if count:
+        put(RLE_FLAG | count)
+    header = {'flags': FLAG_RLE if rle else 0, 'samples': t, 'sample_rate': 1000000}
+    return bytes(data), header, markers
+
+
+def selftest():
+    """ Round trip of random waveforms through the reference encoder """
+    rnd = random.Random(2)
+    errors = 0
+    for n in range(200):
+        nb = rnd.randrange(1, 20000)
+        samples, v = [], 0
+        for i in range(nb):
+            if rnd.random() < 0.02:
+                v ^= 1 << rnd.randrange(16)
+            samples.append(v)
+        gaps = {rnd.randrange(nb): rnd.randrange(1, 5000) for _ in range(rnd.randrange(3))}
+        rle = n % 2 == 0
+        data, header, markers = encode(samples, rle, 0x0003, 0x0003, 64, gaps)
+        transitions, total = decode(data, header, markers)
+        expected, t, last = [], 0, None
+        mask = RLE_MASK if rle else 0xFFFF
+        for i, s in enumerate(samples):
+            t += gaps.get(i, 0)
+            if s & mask != last:
+                expected.append((t, s & mask))
+                last = s & mask
+            t += 1
+        if transitions != expected or total != t:
+            errors += 1
+        errors += check_markers(data, header, markers)
+    print('Stream decoder self test: %d errors' % errors)
+    return errors == 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Hydrabus SUMP stream decoder')
+    parser.add_argument('data', nargs='?', help='data file written by sump filename <name>')
+    parser.add_argument('--index', help='index file (default: data file with .idx extension)')
+    parser.add_argument('--image', help='read the files from a FAT16/FAT32 card image')
+    parser.add_argument('--vcd', help='write the whole capture to a VCD file')
+    parser.add_argument('--ols', help='write a window to an OLS data file')
+    parser.add_argument('--trigger', type=int, default=0,
+                        help='window around this trigger marker (default 0)')
+    parser.add_argument('--window', type=int, default=100000,
+                        help='window size in samples (default 100000)')
+    parser.add_argument('--channels', default='0-15', help='VCD channels, e.g. 0-7')
+    parser.add_argument('--selftest', action='store_true',
+                        help='check the decoder with a reference encoder')
+    args = parser.parse_args()
+
+    if args.selftest:
+        sys.exit(0 if selftest() else 1)
+    if not args.data:
+        parser.error('data file required')
+
+    index_name = args.index
+    if index_name is None:
+        base = args.data.rsplit('.', 1)[0] if '.' in args.data.split('/')[-1] else args.data
+        index_name = base + '.idx'
+    if args.image:
+        with open(args.image, 'rb') as f:
+            image = FatImage(f.read())
+        data = image.read(args.data)
+        index = image.read(index_name)
+    else:
+        with open(args.data, 'rb') as f:
+            data = f.read()
+        with open(index_name, 'rb') as f:
+            index = f.read()
+
+    header, markers = parse_index(index)
+    data = data[:header['data_len']]
+    transitions, total = decode(data, header, markers)
+    rate = header['sample_rate']
+    print('%d samples at %d Hz (%.3f s), %s, %d bytes' %
+          (total, rate, total / float(rate), 'RLE' if header['flags'] & FLAG_RLE else 'raw',
+           len(data)))
+    if header['trigger_mask']:
+        print('Trigger: mask 0x%04x value 0x%04x, %d matches' %
+              (header['trigger_mask'], header['trigger_value'], header['nb_triggers']))
+    if header['nb_overflows']:
+        print('Overflows: %d, %d samples lost' % (header['nb_overflows'], header['lost']))
+    if header['dropped']:
+        print('Markers dropped: %d' % header['dropped'])
+    bad = check_markers(data, header, markers)
+    if bad:
+        print('Inconsistent markers: %d' % bad)
+    triggers = [m for m in markers if m[2] == 0]
+    for sample, offset, lost in markers[:20]:
+        if lost:
+            print('  %.6f s: %d samples lost' % (sample / float(rate), lost))
+        else:
+            print('  %.6f s: trigger (sample %d)' % (sample / float(rate), sample))
+
+    if args.vcd:
+        first, _, last = args.channels.partition('-')
+        channels = range(int(first), int(last or first) + 1)
+        with open(args.vcd, 'w') as f:
+            write_vcd(f, transitions, total, rate, channels)
+    if args.ols:
+        center = triggers[args.trigger][0] if triggers else 0
+        first = max(0, center - args.window // 2)
+        with open(args.ols, 'w') as f:
+            write_ols(f, transitions, first, min(total, first + args.window), rate)
+
+
+if __name__ == '__main__':
+    main()
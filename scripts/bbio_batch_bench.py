@@ -0,0 +1,128 @@
+#!/usr/bin/env python
+
+########################### bbio_batch_bench.py ###########################
+"""
+Compares BBIO SPI single commands against the BBIO batch command.
+Enters BBIO SPI mode, runs the same register accesses (CS low, write the
+register address, read one byte, CS high) once with one write-then-read
+command per access and once as a single batch, checks that both return
+the same data and prints the time taken by each method.
+
+Examples
+bbio_batch_bench.py /dev/ttyACM0 64
+bbio_batch_bench.py COM3 256
+bbio_batch_bench.py /tmp/hydrabus 256
+
+The last example runs against the host build of the firmware, without any
+HydraBus connected ('make host' in src, then
+'build-host/hydrafw --tty1 /tmp/hydrabus'), its SPI MISO being wired to
+MOSI.
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+import serial
+
+BBIO_SPI = b"\x01"
+BBIO_SPI_WRITE_READ = b"\x04"
+BBIO_SPI_BATCH = b"\x09"
+
+BATCH_SELECT = 0x01
+BATCH_UNSELECT = 0x02
+BATCH_WRITE = 0x03
+BATCH_READ = 0x04
+BATCH_WRITE_READ = 0x05
+BATCH_DELAY_US = 0x06
+
+
+def enter_spi(port):
+    for _ in range(20):
+        port.write(b"\x00")
+    port.read(5)
+    port.reset_input_buffer()
+    port.write(b"\x00")
+    if port.read(5) != b"BBIO1":
+        raise IOError("Could not enter BBIO mode")
+    port.write(BBIO_SPI)
+    if port.read(4) != b"SPI1":
+        raise IOError("Could not enter SPI mode")
+
+
+def single(port, regs):
+    values = b""
+    for reg in regs:
+        port.write(BBIO_SPI_WRITE_READ + struct.pack(">HHB", 1, 1, reg))
+        answer = port.read(2)
+        if len(answer) != 2 or answer[0:1] != b"\x01":
+            raise IOError("Error on register 0x%02x" % reg)
+        values += answer[1:]
+    return values
+
+
+def batch(port, regs):
+    frame = b""
+    for reg in regs:
+        frame += struct.pack(">BBHBBHB", BATCH_SELECT, BATCH_WRITE, 1, reg,
+                             BATCH_READ, 1, BATCH_UNSELECT)
+    port.write(BBIO_SPI_BATCH + struct.pack(">H", len(frame)) + frame)
+    answer = port.read(1 + 5 * len(regs))
+    if len(answer) != 1 + 5 * len(regs) or answer[0:1] != b"\x01":
+        raise IOError("Batch rejected")
+    values = b""
+    for i in range(len(regs)):
+        status = answer[1 + 5 * i:1 + 5 * i + 5]
+        if status[0:3] != b"\x01\x01\x01" or status[4:5] != b"\x01":
+            raise IOError("Error on register 0x%02x" % regs[i])
+        values += status[3:4]
+    return values
+
+
+def main():
+    parser = argparse.ArgumentParser(description="HydraBus BBIO batch benchmark")
+    parser.add_argument("port", nargs="?", default="/dev/ttyACM0")
+    parser.add_argument("count", type=int,
+                        help="number of register accesses (max 450)")
+    args = parser.parse_args()
+
+    # Request frame (9 bytes per access) must fit in half of the BBIO buffer
+    if args.count < 1 or args.count > 450:
+        print("Count must be between 1 and 450")
+        sys.exit(1)
+
+    try:
+        port = serial.Serial(args.port, 115200, timeout=5)
+    except serial.SerialException:
+        print("Couldn't open serial port %s" % args.port)
+        sys.exit(1)
+
+    enter_spi(port)
+    regs = [i & 0xFF for i in range(args.count)]
+
+    t1 = time.time()
+    single_values = single(port, regs)
+    t2 = time.time()
+    batch_values = batch(port, regs)
+    t3 = time.time()
+
+    port.write(b"\x00")
+    port.read(5)
+    port.write(b"\x0F")
+    port.close()
+
+    errors = 0 if single_values == batch_values else 1
+    print("Accesses: %d" % args.count)
+    print("Single: %.5f s (%.3f ms/access)" % (t2 - t1,
+                                              (t2 - t1) * 1e3 / args.count))
+    print("Batch: %.5f s (%.3f ms/access)" % (t3 - t2,
+                                             (t3 - t2) * 1e3 / args.count))
+    print("Errors: %d" % errors)
+    print()
+
+    sys.exit(1 if errors else 0)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,226 @@
+#!/usr/bin/env python
+
+############################ bbio_bulk_bench.py ############################
+"""
+Compares the BBIO nibble bulk commands (1 to 16 bytes per command, byte
+by byte reads) with the length prefixed bulk commands of the I2C, RAWWIRE
+(2-wire) and 1-Wire modes.
+For each mode, writes then reads back the given number of bytes both
+ways, checks that they return the same data and prints the time taken.
+In I2C mode the data is written at address 0 of a memory with 16 bits
+addresses (FRAM, or EEPROM when the size fits in a page) at --i2c-addr,
+then read back. On RAWWIRE and 1-Wire the bus shall loop back the data
+written (shift register...), else only the timings are meaningful.
+
+Length prefixed bulk commands: command, length (16bits big endian), data
+for writes. The device answers 0x01 then:
+- I2C write: one byte per byte written, 0x00 ACK or 0x01 NACK
+- I2C read: the data, all bytes are ACKed but the last one
+- RAWWIRE write: the bytes returned by the bus (3-wire reads while writing)
+- RAWWIRE read: the data
+- 1-Wire write: 0x01 once all bytes are written
+- 1-Wire read: the data
+
+Examples
+bbio_bulk_bench.py /dev/ttyACM0 1024
+bbio_bulk_bench.py /dev/ttyACM0 --i2c-addr 0x57 32
+
+The host build has an I2C FRAM model at 0x50 (see src/host/host.mk):
+./build-host/hydrafw --i2c-fram --tty1 /tmp/hydrabus
+bbio_bulk_bench.py /tmp/hydrabus 1024
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+import serial
+
+BBIO_I2C = 0x02
+BBIO_1WIRE = 0x04
+BBIO_RAWWIRE = 0x05
+
+I2C_START_BIT = 0x02
+I2C_STOP_BIT = 0x03
+I2C_READ_BYTE = 0x04
+I2C_ACK_BIT = 0x06
+I2C_NACK_BIT = 0x07
+I2C_WRITE_BULK = 0x0A
+I2C_READ_BULK = 0x0B
+I2C_BULK_WRITE = 0x10
+
+RAWWIRE_READ_BYTE = 0x06
+RAWWIRE_WRITE_BULK = 0x0E
+RAWWIRE_READ_BULK = 0x0F
+RAWWIRE_BULK_TRANSFER = 0x10
+
+ONEWIRE_READ = 0x04
+ONEWIRE_WRITE_BULK = 0x05
+ONEWIRE_READ_BULK = 0x06
+ONEWIRE_BULK_TRANSFER = 0x10
+
+MODES = {
+    "I2C": (BBIO_I2C, b"I2C1"),
+    "RAWWIRE": (BBIO_RAWWIRE, b"RAW1"),
+    "1-Wire": (BBIO_1WIRE, b"1W01"),
+}
+
+
+def read_exact(port, n):
+    data = port.read(n)
+    if len(data) != n:
+        raise IOError("Timeout, %d bytes missing" % (n - len(data)))
+    return data
+
+
+def enter_mode(port, name):
+    cmd, header = MODES[name]
+    port.write(b"\x00")
+    read_exact(port, 5)
+    port.write(bytes([cmd]))
+    if read_exact(port, 4) != header:
+        raise IOError("Could not enter %s mode" % name)
+
+
+def i2c_cond(port, cond):
+    port.write(bytes([cond]))
+    if read_exact(port, 1) != b"\x01":
+        raise IOError("I2C START/STOP failed")
+
+
+def legacy_write(port, name, data):
+    for i in range(0, len(data), 16):
+        chunk = data[i:i + 16]
+        if name == "I2C":
+            port.write(bytes([I2C_BULK_WRITE | (len(chunk) - 1)]))
+            read_exact(port, 1)
+            port.write(chunk)
+            read_exact(port, len(chunk))
+        elif name == "RAWWIRE":
+            port.write(bytes([RAWWIRE_BULK_TRANSFER | (len(chunk) - 1)]) + chunk)
+            read_exact(port, 1 + len(chunk))
+        else:
+            port.write(bytes([ONEWIRE_BULK_TRANSFER | (len(chunk) - 1)]) + chunk)
+            read_exact(port, 1)
+
+
+def legacy_read(port, name, length):
+    data = b""
+    for i in range(length):
+        if name == "I2C":
+            port.write(bytes([I2C_READ_BYTE]))
+            data += read_exact(port, 1)
+            port.write(bytes([I2C_ACK_BIT if i < length - 1 else I2C_NACK_BIT]))
+            read_exact(port, 1)
+        elif name == "RAWWIRE":
+            port.write(bytes([RAWWIRE_READ_BYTE]))
+            data += read_exact(port, 1)
+        else:
+            port.write(bytes([ONEWIRE_READ]))
+            data += read_exact(port, 1)
+    return data
+
+
+def bulk_write(port, name, data):
+    cmd = {"I2C": I2C_WRITE_BULK, "RAWWIRE": RAWWIRE_WRITE_BULK,
+           "1-Wire": ONEWIRE_WRITE_BULK}[name]
+    port.write(bytes([cmd]) + struct.pack(">H", len(data)) + data)
+    if read_exact(port, 1) != b"\x01":
+        raise IOError("Bulk write rejected")
+    answer = read_exact(port, 1 if name == "1-Wire" else len(data))
+    if name == "I2C" and answer.count(b"\x00") != len(data):
+        raise IOError("%d bytes not acknowledged" % (len(data) - answer.count(b"\x00")))
+
+
+def bulk_read(port, name, length):
+    cmd = {"I2C": I2C_READ_BULK, "RAWWIRE": RAWWIRE_READ_BULK,
+           "1-Wire": ONEWIRE_READ_BULK}[name]
+    port.write(bytes([cmd]) + struct.pack(">H", length))
+    if read_exact(port, 1) != b"\x01":
+        raise IOError("Bulk read rejected")
+    return read_exact(port, length)
+
+
+def write_read(port, name, bulk, data, i2c_addr):
+    """ Writes data then reads it back, returns the data read """
+    write = bulk_write if bulk else legacy_write
+    read = bulk_read if bulk else legacy_read
+    if name == "I2C":
+        header = bytes([i2c_addr << 1, 0, 0])
+        i2c_cond(port, I2C_START_BIT)
+        write(port, name, header + data)
+        i2c_cond(port, I2C_STOP_BIT)
+        # Memory write cycle of EEPROMs
+        time.sleep(0.01)
+        i2c_cond(port, I2C_START_BIT)
+        write(port, name, header)
+        i2c_cond(port, I2C_START_BIT)
+        write(port, name, bytes([(i2c_addr << 1) | 1]))
+    else:
+        write(port, name, data)
+    result = read(port, name, len(data))
+    if name == "I2C":
+        i2c_cond(port, I2C_STOP_BIT)
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description="HydraBus BBIO bulk benchmark")
+    parser.add_argument("port", nargs="?", default="/dev/ttyACM0")
+    parser.add_argument("size", type=int, help="bytes written and read (max 65532)")
+    parser.add_argument("--i2c-addr", type=lambda x: int(x, 0), default=0x50,
+                        help="7 bits address of the I2C memory (default 0x50)")
+    args = parser.parse_intermixed_args()
+
+    # The I2C write carries the device and memory addresses
+    if args.size < 1 or args.size > 65532:
+        print("Size must be between 1 and 65532")
+        sys.exit(1)
+
+    try:
+        port = serial.Serial(args.port, 115200, timeout=5)
+    except serial.SerialException:
+        print("Couldn't open serial port %s" % args.port)
+        sys.exit(1)
+
+    for _ in range(20):
+        port.write(b"\x00")
+    port.read(5)
+    time.sleep(0.1)
+    port.reset_input_buffer()
+
+    data = bytes((i * 7 + 3) & 0xFF for i in range(args.size))
+    errors = 0
+    for name in MODES:
+        enter_mode(port, name)
+
+        t1 = time.time()
+        legacy_data = write_read(port, name, False, data, args.i2c_addr)
+        t2 = time.time()
+        bulk_data = write_read(port, name, True, data, args.i2c_addr)
+        t3 = time.time()
+
+        if legacy_data != bulk_data:
+            print("%s: data mismatch" % name)
+            errors += 1
+        elif name == "I2C" and bulk_data != data:
+            print("%s: data read back differs" % name)
+            errors += 1
+        print("%s: nibble %.5f s, bulk %.5f s (x%.1f)" %
+              (name, t2 - t1, t3 - t2, (t2 - t1) / max(t3 - t2, 1e-6)))
+
+    port.write(b"\x00")
+    port.read(5)
+    port.write(b"\x0F")
+    port.close()
+
+    print("Bytes: %d" % args.size)
+    print("Errors: %d" % errors)
+    print()
+
+    sys.exit(1 if errors else 0)
+
+
+if __name__ == '__main__':
+    main()
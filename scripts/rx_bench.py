@@ -0,0 +1,104 @@
+#!/usr/bin/env python
+
+############################### rx_bench.py ###############################
+"""
+Host side of HydraFW 'debug test-tx' (device to host throughput).
+Sends the command on a HydraBus console, then reads the sequence numbered
+packets, checks their order and content and measures the throughput.
+
+Each packet starts with its sequence number (32bits little endian)
+followed by bytes (seq + i) & 0xFF, i being the offset in the packet.
+
+Examples
+rx_bench.py /dev/ttyACM0 64 1000 >> bench.txt
+rx_bench.py /dev/ttyACM0 512 1000 >> bench.txt
+rx_bench.py COM3 4096 500 >> bench.txt
+rx_bench.py /tmp/hydrabus 512 1000
+
+The last example runs against the host build of the firmware, without any
+HydraBus connected ('make host' in src, then
+'build-host/hydrafw --tty1 /tmp/hydrabus').
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+import serial
+
+BANNER = b"Test debug-tx started"
+TRAILER = b"Test debug-tx end"
+
+
+def expected_packet(seq, size):
+    payload = bytes((seq + i) & 0xFF for i in range(4, size))
+    return struct.pack("<I", seq & 0xFFFFFFFF) + payload
+
+
+def read_until(port, marker):
+    data = b""
+    while not data.endswith(marker):
+        c = port.read(1)
+        if not c:
+            raise IOError("Timeout waiting for %r" % marker)
+        data += c
+    return data
+
+
+def main():
+    parser = argparse.ArgumentParser(description="HydraBus USB TX benchmark")
+    parser.add_argument("port", nargs="?", default="/dev/ttyACM0")
+    parser.add_argument("size", type=int, help="packet size in bytes (min 4)")
+    parser.add_argument("count", type=int, help="number of packets")
+    args = parser.parse_args()
+
+    if args.size < 4:
+        print("Packet size must be at least 4 bytes")
+        sys.exit(1)
+
+    try:
+        port = serial.Serial(args.port, 115200, timeout=5)
+    except serial.SerialException:
+        print("Couldn't open serial port %s" % args.port)
+        sys.exit(1)
+
+    port.reset_input_buffer()
+    port.write(b"debug test-tx %d samples %d\r" % (args.size, args.count))
+    read_until(port, BANNER)
+    read_until(port, b"\r\n")
+
+    errors = 0
+    received = 0
+    t1 = time.time()
+    for seq in range(args.count):
+        packet = port.read(args.size)
+        received += len(packet)
+        if packet != expected_packet(seq, args.size):
+            if len(packet) < args.size:
+                print("Timeout on packet %d (%d bytes received)" % (seq, len(packet)))
+                errors += 1
+                break
+            got = struct.unpack("<I", packet[:4])[0]
+            print("Packet %d corrupted or out of order (seq %d)" % (seq, got))
+            errors += 1
+    t2 = time.time()
+
+    read_until(port, TRAILER)
+    stats = port.read_until(b"> ")
+    port.close()
+
+    time_s = t2 - t1
+    print("packet_Length: %d num_Packets: %d" % (args.size, args.count))
+    print("RX Time: %.5f s" % time_s)
+    print("RX Bytes/s: %d RX MBytes/s: %.3f" % (received / time_s,
+                                                received / time_s / 1e6))
+    print("Errors: %d" % errors)
+    print(stats.decode("ascii", "replace").strip().rstrip(">").strip())
+    print()
+
+    sys.exit(1 if errors else 0)
+
+
+if __name__ == '__main__':
+    main()
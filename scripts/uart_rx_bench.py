@@ -0,0 +1,142 @@
+#!/usr/bin/env python
+
+############################# uart_rx_bench.py #############################
+"""
+UART to host throughput and loss test of the BBIO UART echo mode.
+A UART peer (USB to serial adapter wired to HydraBus UART1 RX PA10) sends
+a known pattern at the selected baudrate, the data echoed by HydraBus on
+its USB port is checked against the pattern.
+
+The pattern is a 32bits big endian counter, sent in bursts of --burst
+bytes separated by idle line gaps (the firmware hands data to the host on
+idle line, half and full DMA buffer).
+
+Examples
+uart_rx_bench.py /dev/ttyACM0 --peer /dev/ttyUSB0 --baud 4000000 65536
+uart_rx_bench.py COM3 --peer COM4 --baud 921600 65536
+uart_rx_bench.py /tmp/hydrabus --peer /tmp/uart1 --baud 2000000 1000000
+
+The last example runs against the host build of the firmware, without any
+HydraBus connected ('make host' in src, then
+'build-host/hydrafw --tty1 /tmp/hydrabus --uart1 /tmp/uart1'), the peer
+is a pseudo terminal whose bytes are received at the UART baudrate. The
+host UART mock is slower than the DMA, it loses bytes above 2Mbit/s.
+"""
+
+import argparse
+import struct
+import sys
+import threading
+import time
+
+import serial
+
+BBIO_UART = b"\x03"
+BBIO_UART_START_ECHO = b"\x02"
+BBIO_UART_STOP_ECHO = b"\x03"
+BBIO_UART_BAUD_RATE = b"\x07"
+
+
+def pattern(size):
+    words = (size + 3) // 4
+    return b"".join(struct.pack(">I", i) for i in range(words))[:size]
+
+
+def enter_uart(port, baud):
+    for _ in range(20):
+        port.write(b"\x00")
+    port.read(5)
+    time.sleep(0.1)
+    port.reset_input_buffer()
+    port.write(b"\x00")
+    if port.read(5) != b"BBIO1":
+        raise IOError("Could not enter BBIO mode")
+    port.write(BBIO_UART)
+    if port.read(4) != b"ART1":
+        raise IOError("Could not enter UART mode")
+    port.write(BBIO_UART_BAUD_RATE + struct.pack(">I", baud))
+    if port.read(1) != b"\x01":
+        raise IOError("Could not set baudrate")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="HydraBus UART RX benchmark")
+    parser.add_argument("port", nargs="?", default="/dev/ttyACM0")
+    parser.add_argument("size", type=int, help="number of bytes sent by the peer")
+    parser.add_argument("--peer", help="serial port of the UART peer")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--burst", type=int, default=4096,
+                        help="bytes sent between idle line gaps")
+    args = parser.parse_intermixed_args()
+
+    if args.peer is None:
+        print("--peer is required")
+        sys.exit(1)
+
+    try:
+        port = serial.Serial(args.port, 115200, timeout=1)
+    except serial.SerialException:
+        print("Couldn't open serial port %s" % args.port)
+        sys.exit(1)
+
+    enter_uart(port, args.baud)
+
+    expected = pattern(args.size)
+    peer = serial.Serial(args.peer, args.baud, timeout=1)
+
+    port.write(BBIO_UART_START_ECHO)
+    if port.read(1) != b"\x01":
+        print("Could not start echo")
+        sys.exit(1)
+
+    def send():
+        for i in range(0, len(expected), args.burst):
+            peer.write(expected[i:i + args.burst])
+            peer.flush()
+            # Idle line gap of a few characters
+            time.sleep(0.001)
+    sender = threading.Thread(target=send)
+    sender.daemon = True
+    sender.start()
+
+    received = b""
+    t1 = time.time()
+    t2 = t1
+    while len(received) < len(expected):
+        data = port.read(min(4096, len(expected) - len(received)))
+        if not data:
+            # No data for one second, the remaining bytes are lost
+            break
+        received += data
+        t2 = time.time()
+
+    port.write(BBIO_UART_STOP_ECHO)
+    port.read_until(b"\x01")
+    port.write(b"\x00")
+    port.read(5)
+    port.write(b"\x0F")
+    port.close()
+    peer.close()
+
+    lost = len(expected) - len(received)
+    errors = 0
+    if received != expected[:len(received)]:
+        i = next(i for i, (a, b) in enumerate(zip(received, expected)) if a != b)
+        print("Data mismatch at offset %d" % i)
+        errors += 1
+
+    time_s = max(t2 - t1, 1e-6)
+    line_rate = args.baud / 10.0
+    print("Baudrate: %d (%d Bytes/s) Size: %d" % (args.baud, line_rate, args.size))
+    print("RX Time: %.5f s" % time_s)
+    print("RX Bytes/s: %d (%.1f%% of line rate)" % (len(received) / time_s,
+                                                   len(received) / time_s * 100 / line_rate))
+    print("Lost bytes: %d" % lost)
+    print("Errors: %d" % errors)
+    print()
+
+    sys.exit(1 if errors or lost else 0)
+
+
+if __name__ == '__main__':
+    main()
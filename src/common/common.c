@@ -28,36 +28,134 @@
 
 #include "bsp_gpio.h"
 #include "microsd.h"
+#include "logger.h"
+#include "hexdump.h"
+#include "sbuf.h"
 #include "hydrabus_sd.h"
 
 #define HYDRAFW_VERSION "HydraFW (HydraBus v1/HydraNFC Shield v2) " HYDRAFW_GIT_TAG " " HYDRAFW_CHECKIN_DATE
 #define TEST_WA_SIZE    THD_WORKING_AREA_SIZE(256)
 
-/* CCM = .ram4 */
-uint8_t buf[512] __attribute__ ((section(".ram4")));
-/* Generic large buffer.*/
-uint8_t fbuff[2048] __attribute__ ((section(".ram4")));
-
 uint32_t g_sbuf_idx;
 uint8_t g_sbuf[NB_SBUFFER+128] __attribute__ ((aligned (4)));
 
 extern uint32_t debug_flags;
 extern char log_dest[];
 
+void console_tx_init(t_hydra_console *con)
+{
+	chMtxObjectInit(&con->tx.mtx);
+	con->tx.len = 0;
+	con->tx.last = chVTGetSystemTimeX();
+}
+
+/* Push data to the USB channel and the SD logger, returns bytes written */
+static uint32_t console_tx_emit(t_hydra_console *con, const uint8_t *data,
+				const uint32_t size, sysinterval_t timeout)
+{
+	uint32_t written;
+
+	written = chnWriteTimeout(con->sdu, data, size, timeout);
+
+	logger_write(con, data, written);
+
+	return written;
+}
+
+/* Must be called with con->tx.mtx held */
+static void console_tx_flush(t_hydra_console *con, sysinterval_t timeout)
+{
+	t_console_tx *tx = &con->tx;
+	uint32_t written;
+
+	if (tx->len == 0)
+		return;
+
+	written = console_tx_emit(con, tx->data, tx->len, timeout);
+	if (written < tx->len) {
+		/* Channel timed out, keep the remaining data for later */
+		memmove(tx->data, &tx->data[written], tx->len - written);
+	}
+	tx->len -= written;
+}
+
 void stream_write(t_hydra_console *con, const char *data, const uint32_t size)
 {
-	BaseSequentialStream* chp;
-	if(con != NULL)
-	{
-		chp = con->bss;
-		if (!size)
-			return;
+	t_console_tx *tx;
+	uint32_t remaining, chunk;
+
+	if (con == NULL || !size)
+		return;
 
-		chnWrite(chp, (uint8_t *)data, size);
+	tx = &con->tx;
+	remaining = size;
 
-		if (con->log_file.obj.fs)
-			file_append(&(con->log_file), (uint8_t *)data, size);
+	chMtxLock(&tx->mtx);
+	while (remaining) {
+		if (tx->len == 0 && remaining >= CONSOLE_TX_BUF_SIZE) {
+			/* Large block, no need to copy it */
+			console_tx_emit(con, (const uint8_t *)data, remaining,
+					TIME_INFINITE);
+			break;
+		}
+		chunk = MIN(CONSOLE_TX_BUF_SIZE - tx->len, remaining);
+		memcpy(&tx->data[tx->len], data, chunk);
+		tx->len += chunk;
+		data += chunk;
+		remaining -= chunk;
+
+		if (tx->len == CONSOLE_TX_BUF_SIZE)
+			console_tx_flush(con, TIME_INFINITE);
 	}
+	tx->last = chVTGetSystemTimeX();
+	chMtxUnlock(&tx->mtx);
+}
+
+/* Send all pending console output now */
+void cflush(t_hydra_console *con)
+{
+	if (con == NULL)
+		return;
+
+	chMtxLock(&con->tx.mtx);
+	console_tx_flush(con, TIME_INFINITE);
+	chMtxUnlock(&con->tx.mtx);
+}
+
+/*
+ * Called periodically from the console TX thread, sends pending output
+ * which has not been touched for CONSOLE_TX_IDLE_MS.
+ * Never blocks on a busy console or a host not reading its data.
+ */
+void cflush_idle(t_hydra_console *con)
+{
+	t_console_tx *tx = &con->tx;
+
+	if (tx->len == 0)
+		return;
+
+	if (chVTTimeElapsedSinceX(tx->last) < TIME_MS2I(CONSOLE_TX_IDLE_MS))
+		return;
+
+	if (!chMtxTryLock(&tx->mtx))
+		return;
+
+	console_tx_flush(con, TIME_MS2I(CONSOLE_TX_IDLE_MS));
+	chMtxUnlock(&tx->mtx);
+}
+
+/* Console input, pending output is flushed first so replies are not delayed */
+size_t cread(t_hydra_console *con, uint8_t *data, size_t size)
+{
+	cflush(con);
+	return chnRead(con->sdu, data, size);
+}
+
+size_t cread_timeout(t_hydra_console *con, uint8_t *data, size_t size,
+		     sysinterval_t timeout)
+{
+	cflush(con);
+	return chnReadTimeout(con->sdu, data, size, timeout);
 }
 
 void print(void *user, const char *str)
@@ -81,36 +179,40 @@ void cprint(t_hydra_console *con, const char *data, const uint32_t size)
 	stream_write(con, data, size);
 }
 
-void print_hex(t_hydra_console *con, uint8_t* data, uint8_t size)
+/* Number of hexdump lines rendered before each write */
+#define HEXDUMP_LINES_PER_WRITE (4)
+
+static void hexdump_print(t_hydra_console *con, const uint8_t *data,
+			  uint32_t size, uint32_t offset)
 {
-	uint8_t ascii[17];
-	uint8_t i, j;
-	ascii[16] = '\0';
-	for (i = 0; i < size; ++i) {
-		cprintf(con, "%02X ", data[i]);
-		if (data[i] >= 0x20 && data[i] <= 0x7f) {
-			ascii[i % 16] = data[i];
-		} else {
-			ascii[i % 16] = '.';
-		}
-		if ((i+1) % 8 == 0 || i+1 == size) {
-			cprintf(con, " ");
-			if ((i+1) % 16 == 0) {
-				cprintf(con, "|  %s \r\n", ascii);
-			} else if (i+1 == size) {
-				ascii[(i+1) % 16] = '\0';
-				if ((i+1) % 16 <= 8) {
-					cprintf(con, " ");
-				}
-				for (j = (i+1) % 16; j < 16; ++j) {
-					cprintf(con, "   ");
-				}
-				cprintf(con, "|  %s \r\n", ascii);
-			}
+	char lines[HEXDUMP_LINES_PER_WRITE * HEXDUMP_LINE_MAX];
+	uint32_t len, nb_lines, chunk;
+
+	while (size) {
+		len = 0;
+		for (nb_lines = 0; nb_lines < HEXDUMP_LINES_PER_WRITE && size; nb_lines++) {
+			chunk = MIN(size, HEXDUMP_BYTES_PER_LINE);
+			len += hexdump_line(&lines[len], data, chunk, offset);
+			data += chunk;
+			size -= chunk;
+			if (offset != HEXDUMP_NO_OFFSET)
+				offset += chunk;
 		}
+		stream_write(con, lines, len);
 	}
 }
 
+void print_hex(t_hydra_console *con, uint8_t* data, uint32_t size)
+{
+	hexdump_print(con, data, size, HEXDUMP_NO_OFFSET);
+}
+
+/* Same as print_hex() with an offset column starting at offset */
+void print_hexdump(t_hydra_console *con, uint32_t offset, uint8_t* data, uint32_t size)
+{
+	hexdump_print(con, data, size, offset);
+}
+
 void cprintf(t_hydra_console *con, const char *fmt, ...)
 {
 	va_list va_args;
@@ -154,6 +256,7 @@ void cmd_show_memory(t_hydra_console *con)
 	cprintf(con, "heap fragments   : %u\r\n", n);
   cprintf(con, "heap free total  : %u bytes\r\n", total);
 	cprintf(con, "heap free largest: %u bytes\r\n", largest);
+	sbuf_show(con);
 }
 
 void cmd_show_threads(t_hydra_console *con)
@@ -295,6 +398,7 @@ int cmd_debug_timing(t_hydra_console *con, t_tokenline_parsed *p)
 	cprintf(con, "148ns=%.2ld ticks\r\n", (uint32_t)ticks3_39MHz);
 	cprintf(con, "500ns=%.2ld ticks\r\n", (uint32_t)tick1MHz);
 	cprintf(con, "Test dbg Out Freq Max 84Mhz(11.9ns),10MHz(100ns/2),3.39MHz(295ns/2),1MHz(1us/2)\r\nPress User Button to exit\r\n");
+	cflush(con);
 	chThdSleepMilliseconds(1);
 
 	/* Lock Kernel for sniffer */
@@ -424,10 +528,17 @@ int cmd_debug_test_rx(t_hydra_console *con, t_tokenline_parsed *p)
 {
 	(void)p;
 	BaseSequentialStream* chp = con->bss;
+	uint8_t *rx_data;
+
+	rx_data = sbuf_alloc(con, SBUF_RAM, NB_SBUFFER);
+	if (rx_data == NULL) {
+		cprintf(con, "Scratch buffer busy.\r\n");
+		return FALSE;
+	}
 
 	cprintf(con, "Test debug-rx started, stop it with UBTN + Key\r\n");
 	while(1) {
-		chnRead(chp, (uint8_t *)g_sbuf, sizeof(g_sbuf) - 1);
+		chnRead(chp, rx_data, NB_SBUFFER);
 
 		/* Exit if User Button is pressed */
 		if (hydrabus_ubtn()) {
@@ -435,6 +546,99 @@ int cmd_debug_test_rx(t_hydra_console *con, t_tokenline_parsed *p)
 		}
 		//get_char(con);
 	}
+	sbuf_free(con, rx_data);
+	return TRUE;
+}
+
+#define TEST_TX_DEFAULT_PACKETS (1000)
+#define TEST_TX_MIN_SIZE (4)
+
+/*
+ * Just debug tx speed, send nb_packets packets of packet_size bytes.
+ * Each packet starts with its sequence number (32bits little endian)
+ * followed by bytes (seq + i) & 0xFF, i being the offset in the packet.
+ */
+int cmd_debug_test_tx(t_hydra_console *con, t_tokenline_parsed *p)
+{
+	uint32_t packet_size, nb_packets, seq, i;
+	uint64_t cycles_start, cycles_pkt, cycles_total;
+	uint32_t cycles, cycles_min, cycles_max;
+	uint32_t kbytes_s;
+	uint8_t *tx_data;
+	int t;
+
+	packet_size = 0;
+	nb_packets = TEST_TX_DEFAULT_PACKETS;
+	for (t = 0; p->tokens[t]; t++) {
+		switch (p->tokens[t]) {
+		case T_DEBUG_TEST_TX:
+			t += 2;
+			memcpy(&packet_size, p->buf + p->tokens[t], sizeof(uint32_t));
+			break;
+		case T_SAMPLES:
+			t += 2;
+			memcpy(&nb_packets, p->buf + p->tokens[t], sizeof(uint32_t));
+			break;
+		}
+	}
+	if (packet_size < TEST_TX_MIN_SIZE || packet_size > NB_SBUFFER) {
+		cprintf(con, "Packet size must be between %d and %d bytes.\r\n",
+			TEST_TX_MIN_SIZE, NB_SBUFFER);
+		return FALSE;
+	}
+
+	tx_data = sbuf_alloc(con, SBUF_RAM, packet_size);
+	if (tx_data == NULL) {
+		cprintf(con, "Scratch buffer busy.\r\n");
+		return FALSE;
+	}
+
+	cprintf(con, "Test debug-tx started, %d packets of %d bytes\r\n",
+		nb_packets, packet_size);
+	cflush(con);
+
+	cycles_min = 0xFFFFFFFF;
+	cycles_max = 0;
+	cycles_start = bsp_get_cyclecounter64();
+	for (seq = 0; seq < nb_packets; seq++) {
+		tx_data[0] = seq & 0xFF;
+		tx_data[1] = (seq >> 8) & 0xFF;
+		tx_data[2] = (seq >> 16) & 0xFF;
+		tx_data[3] = (seq >> 24) & 0xFF;
+		for (i = TEST_TX_MIN_SIZE; i < packet_size; i++)
+			tx_data[i] = (seq + i) & 0xFF;
+
+		cycles_pkt = bsp_get_cyclecounter64();
+		chnWrite(con->sdu, tx_data, packet_size);
+		cycles = (uint32_t)(bsp_get_cyclecounter64() - cycles_pkt);
+
+		if (cycles < cycles_min)
+			cycles_min = cycles;
+		if (cycles > cycles_max)
+			cycles_max = cycles;
+
+		/* Exit if User Button is pressed */
+		if (hydrabus_ubtn()) {
+			seq++;
+			break;
+		}
+	}
+	cycles_total = bsp_get_cyclecounter64() - cycles_start;
+	if (cycles_total == 0)
+		cycles_total = 1;
+
+	kbytes_s = (uint32_t)(((uint64_t)seq * packet_size * (STM32_HCLK / 1000)) / cycles_total);
+	cprintf(con, "\r\nTest debug-tx end\r\n");
+	cprintf(con, "Packets: %d Bytes: %d\r\n", seq, seq * packet_size);
+	cprintf(con, "Total: %d us\r\n",
+		(uint32_t)(cycles_total / (STM32_HCLK / 1000000)));
+	if (seq) {
+		cprintf(con, "Cycles per packet min/avg/max: %d/%d/%d\r\n",
+			cycles_min, (uint32_t)(cycles_total / seq), cycles_max);
+	}
+	cprintf(con, "TX KBytes/s: %d\r\n", kbytes_s);
+
+	sbuf_free(con, tx_data);
 	return TRUE;
 }
 
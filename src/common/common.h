@@ -58,13 +58,10 @@
 void DelayUs(uint32_t delay_us);
 void DelayMs(uint32_t delay_ms);
 
-extern uint8_t buf[512] __attribute__ ((section(".cmm")));
-/* Generic large buffer.*/
-extern uint8_t fbuff[2048] __attribute__ ((section(".cmm")));
-
 #define NB_SBUFFER  (65536)
 #define G_SBUF_SDC_BURST_SIZE (NB_SBUFFER/MMCSD_BLOCK_SIZE) /* how many sectors reads at once */
 extern uint32_t g_sbuf_idx;
+/* Shared by all consoles, lease it with sbuf_alloc() (see sbuf.h) */
 extern uint8_t g_sbuf[NB_SBUFFER+128] __attribute__ ((aligned (4)));
 
 /* USB1: Virtual serial port over USB.*/
@@ -86,6 +83,37 @@ extern SerialUSBDriver SDU2;
 
 #define PROMPT "> "
 
+/* Console output is staged in a per-console TX buffer and pushed to the
+ USB channel in large chunks, either when the buffer is full, on cflush(),
+ before any console read, or once it has been idle for CONSOLE_TX_IDLE_MS */
+#define CONSOLE_TX_BUF_SIZE 512
+#define CONSOLE_TX_IDLE_MS 2
+#define CONSOLE_TX_WA_SIZE 512
+
+typedef struct {
+	mutex_t mtx;
+	systime_t last;
+	uint32_t len;
+	uint8_t data[CONSOLE_TX_BUF_SIZE];
+} t_console_tx;
+
+/* SD card logging ring, filled by the console and emptied by the logger
+ thread, see logger.c */
+#define CONSOLE_LOG_RING_SIZE 8192 /* Shall be a power of 2 */
+
+typedef struct {
+	volatile uint32_t head; /* Only written by the console */
+	volatile uint32_t tail; /* Only written by the logger thread */
+	volatile uint32_t dropped_write; /* Ring full, only written by the console */
+	volatile uint32_t dropped_sd; /* SD error, only written by the logger thread */
+	uint32_t block_size; /* SD write size, bytes */
+	volatile bool enabled;
+	systime_t last_write;
+	systime_t last_sync;
+	bool dirty;
+	uint8_t data[CONSOLE_LOG_RING_SIZE] __attribute__ ((aligned (4)));
+} t_console_log;
+
 struct t_mode_config;
 typedef struct hydra_console {
 	char *thread_name;
@@ -98,6 +126,8 @@ typedef struct hydra_console {
 	t_mode_config *mode;
 	int console_mode;
 	FIL log_file;
+	t_console_tx tx;
+	t_console_log log;
 } t_hydra_console;
 
 enum console_modes {
@@ -121,6 +151,7 @@ int mode_exit(t_hydra_console *con, t_tokenline_parsed *p);
 int cmd_show(t_hydra_console *con, t_tokenline_parsed *p);
 int cmd_debug_timing(t_hydra_console *con, t_tokenline_parsed *p);
 int cmd_debug_test_rx(t_hydra_console *con, t_tokenline_parsed *p);
+int cmd_debug_test_tx(t_hydra_console *con, t_tokenline_parsed *p);
 int cmd_adc(t_hydra_console *con, t_tokenline_parsed *p);
 int cmd_dac(t_hydra_console *con, t_tokenline_parsed *p);
 int cmd_pwm(t_hydra_console *con, t_tokenline_parsed *p);
@@ -132,7 +163,14 @@ int cmd_rng(t_hydra_console *con, t_tokenline_parsed *p);
 void token_dump(t_hydra_console *con, t_tokenline_parsed *p);
 void cprint(t_hydra_console *con, const char *data, const uint32_t size);
 void cprintf(t_hydra_console *con, const char *fmt, ...);
-void print_hex(t_hydra_console *con, uint8_t* data, uint8_t size);
+void cflush(t_hydra_console *con);
+void cflush_idle(t_hydra_console *con);
+void console_tx_init(t_hydra_console *con);
+size_t cread(t_hydra_console *con, uint8_t *data, size_t size);
+size_t cread_timeout(t_hydra_console *con, uint8_t *data, size_t size,
+		     sysinterval_t timeout);
+void print_hex(t_hydra_console *con, uint8_t* data, uint32_t size);
+void print_hexdump(t_hydra_console *con, uint32_t offset, uint8_t* data, uint32_t size);
 uint8_t parse_escaped_string(char * input, uint8_t * output);
 
 uint8_t reverse_u8(uint8_t value);
@@ -2,6 +2,9 @@
 COMMONSRC = common/common.c \
             common/exec.c \
             common/microsd.c \
+            common/logger.c \
+            common/hexdump.c \
+            common/sbuf.c \
             common/usb1cfg.c \
             common/usb2cfg.c \
             common/script.c
@@ -25,6 +25,8 @@
 #include "chprintf.h"
 #include "ff.h"
 #include "microsd.h"
+#include "logger.h"
+#include "sbuf.h"
 #include "hydrabus_sd.h"
 
 #include "common.h"
@@ -39,7 +41,7 @@ char get_char(t_hydra_console *con)
 {
 	uint8_t c;
 
-	if (chnRead(con->sdu, &c, 1) == 0)
+	if (cread(con, &c, 1) == 0)
 		c = 0;
 
 	return c;
@@ -118,6 +120,9 @@ static int cmd_debug(t_hydra_console *con, t_tokenline_parsed *p)
 		case T_DEBUG_TEST_RX:
 			cmd_debug_test_rx(con, p);
 			break;
+		case T_DEBUG_TEST_TX:
+			/* test-tx consumes the rest of the command line */
+			return cmd_debug_test_tx(con, p);
 		case T_ON:
 		case T_OFF:
 			action = p->tokens[t];
@@ -142,6 +147,7 @@ static int cmd_logging(t_hydra_console *con, t_tokenline_parsed *p)
 	char *filename;
 	char log_dest[FILENAME_SIZE];
 	bool enable;
+	uint32_t dropped;
 
 	filename = NULL;
 	enable = TRUE;
@@ -169,14 +175,18 @@ static int cmd_logging(t_hydra_console *con, t_tokenline_parsed *p)
 		} else {
 			strncpy(log_dest, filename, sizeof(log_dest) - 1);/* -1 to include terminating null-character */
 		}
-		if(!file_open(&(con->log_file), log_dest, 'w')) {
+		if(!logger_start(con, log_dest)) {
 			cprintf(con, "Error. Unable to create file.\r\n");
 			enable = FALSE;
 			return FALSE;
 		}
 	} else {
 		log_dest[0] = '\0';
-		file_close(&(con->log_file));
+		/* Flush pending console output to the log first */
+		cflush(con);
+		dropped = logger_stop(con);
+		if (dropped)
+			cprintf(con, "Logging: %u bytes dropped.\r\n", dropped);
 	}
 
 	return TRUE;
@@ -241,9 +251,7 @@ void execute(void *user, t_tokenline_parsed *p)
 		}
 	}
 
-	if (con->log_file.obj.fs) {
-		/* Flush cached logging output. */
-		file_sync(&(con->log_file));
-	}
+	/* Scratch buffers do not outlive the command */
+	sbuf_free_all(con);
 }
 
@@ -0,0 +1,75 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hexdump.h"
+
+static const char hex_digits[16] = "0123456789ABCDEF";
+
+/* Printable ASCII or '.' */
+#define HEXDUMP_ASCII(c) (((c) >= 0x20 && (c) < 0x7f) ? (char)(c) : '.')
+
+/**
+ * @brief   Renders one hexdump line without any printf
+ *
+ * @param[out] out	buffer of at least HEXDUMP_LINE_MAX bytes
+ * @param[in]  data	data to dump
+ * @param[in]  size	number of bytes, at most HEXDUMP_BYTES_PER_LINE
+ * @param[in]  offset	value of the offset column or HEXDUMP_NO_OFFSET
+ *
+ * @return		Length of the line (not null terminated).
+ */
+uint32_t hexdump_line(char *out, const uint8_t *data, uint32_t size,
+		      uint32_t offset)
+{
+	char *hex, *ascii;
+	uint32_t i;
+	int shift;
+
+	if (size > HEXDUMP_BYTES_PER_LINE)
+		size = HEXDUMP_BYTES_PER_LINE;
+
+	hex = out;
+	if (offset != HEXDUMP_NO_OFFSET) {
+		for (shift = 28; shift >= 0; shift -= 4)
+			*hex++ = hex_digits[(offset >> shift) & 0x0F];
+		*hex++ = ' ';
+		*hex++ = ' ';
+	}
+
+	/* Blank the hex columns, then fill used ones */
+	for (i = 0; i < HEXDUMP_HEX_LEN; i++)
+		hex[i] = ' ';
+	ascii = hex + HEXDUMP_HEX_LEN;
+	*ascii++ = '|';
+	*ascii++ = ' ';
+	*ascii++ = ' ';
+
+	for (i = 0; i < size; i++) {
+		/* One more separator after the 8th byte */
+		char *h = &hex[i * 3 + (i >= 8)];
+
+		h[0] = hex_digits[data[i] >> 4];
+		h[1] = hex_digits[data[i] & 0x0F];
+		*ascii++ = HEXDUMP_ASCII(data[i]);
+	}
+	*ascii++ = ' ';
+	*ascii++ = '\r';
+	*ascii++ = '\n';
+
+	return ascii - out;
+}
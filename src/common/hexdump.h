@@ -0,0 +1,37 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HEXDUMP_H_
+#define _HEXDUMP_H_
+
+#include <stdint.h>
+
+#define HEXDUMP_BYTES_PER_LINE (16)
+/* "XXXXXXXX  " offset, 16 * "XX " + 2 separators, "|  ", ASCII, " \r\n" */
+#define HEXDUMP_OFFSET_LEN (10)
+#define HEXDUMP_HEX_LEN (HEXDUMP_BYTES_PER_LINE * 3 + 2)
+#define HEXDUMP_LINE_MAX (HEXDUMP_OFFSET_LEN + HEXDUMP_HEX_LEN + 3 + \
+			  HEXDUMP_BYTES_PER_LINE + 3)
+
+/* Don't print the offset column */
+#define HEXDUMP_NO_OFFSET (0xFFFFFFFF)
+
+uint32_t hexdump_line(char *out, const uint8_t *data, uint32_t size,
+		      uint32_t offset);
+
+#endif /* _HEXDUMP_H_ */
@@ -0,0 +1,233 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "ch.h"
+#include "hal.h"
+
+#include "ff.h"
+
+#include "common.h"
+#include "microsd.h"
+#include "logger.h"
+
+/*
+ * Console logging to SD card.
+ * The console copies its output to a per-console ring buffer
+ * (single producer/single consumer, no lock) and the logger thread writes it
+ * to the already opened log file in cluster sized blocks, so the console
+ * never waits for the SD card.
+ */
+
+#define LOGGER_MAX_CONSOLES (2)
+#define LOGGER_RING_MASK (CONSOLE_LOG_RING_SIZE - 1)
+
+static THD_WORKING_AREA(wa_logger, LOGGER_WA_SIZE);
+static BSEMAPHORE_DECL(logger_sem, TRUE);
+/* Protects log files against concurrent open/write/close */
+static MUTEX_DECL(logger_mtx);
+static t_hydra_console *logger_consoles[LOGGER_MAX_CONSOLES];
+
+/* Must be called with logger_mtx held */
+static void logger_service(t_hydra_console *con)
+{
+	t_console_log *log = &con->log;
+	FIL *fp = &con->log_file;
+	uint32_t used, to_write, offset, chunk, block;
+	UINT written;
+
+	if (fp->obj.fs == NULL)
+		return;
+
+	used = log->head - log->tail;
+	if (used) {
+		/* First reach the next block boundary, then whole blocks */
+		block = log->block_size;
+		to_write = block - (f_tell(fp) % block);
+		if (used >= to_write) {
+			to_write += ((used - to_write) / block) * block;
+		} else if (log->enabled &&
+			   chVTTimeElapsedSinceX(log->last_write) < TIME_MS2I(LOGGER_IDLE_MS)) {
+			to_write = 0;
+		} else {
+			/* Idle or stopping, write what is left */
+			to_write = used;
+		}
+
+		while (to_write) {
+			offset = log->tail & LOGGER_RING_MASK;
+			chunk = MIN(to_write, CONSOLE_LOG_RING_SIZE - offset);
+			if (f_write(fp, &log->data[offset], chunk, &written) != FR_OK ||
+			    written != chunk) {
+				/* SD card error or full, give up logging */
+				log->enabled = FALSE;
+				log->dropped_sd += log->head - log->tail;
+				log->tail = log->head;
+				break;
+			}
+			log->tail += chunk;
+			to_write -= chunk;
+			log->dirty = TRUE;
+		}
+		log->last_write = chVTGetSystemTimeX();
+	}
+
+	if (log->dirty && (!log->enabled ||
+	    chVTTimeElapsedSinceX(log->last_sync) >= TIME_MS2I(LOGGER_SYNC_MS))) {
+		f_sync(fp);
+		log->dirty = FALSE;
+		log->last_sync = chVTGetSystemTimeX();
+	}
+}
+
+static THD_FUNCTION(logger_thread, arg)
+{
+	int i;
+
+	(void)arg;
+	chRegSetThreadName("SD logger");
+
+	while (TRUE) {
+		chBSemWaitTimeout(&logger_sem, TIME_MS2I(LOGGER_IDLE_MS));
+
+		chMtxLock(&logger_mtx);
+		for (i = 0; i < LOGGER_MAX_CONSOLES; i++) {
+			if (logger_consoles[i] != NULL)
+				logger_service(logger_consoles[i]);
+		}
+		chMtxUnlock(&logger_mtx);
+	}
+}
+
+void logger_init(void)
+{
+	chThdCreateStatic(wa_logger, sizeof(wa_logger), NORMALPRIO - 1,
+			  logger_thread, NULL);
+}
+
+/**
+ * @brief   Starts logging console output to a file
+ *
+ * @param[in] con		console to log
+ * @param[in] filename		full path to the file on the SD, data is
+ *				appended if it already exists
+ *
+ * @return			The operation status.
+ */
+bool logger_start(t_hydra_console *con, const char *filename)
+{
+	t_console_log *log = &con->log;
+	int i;
+
+	if (con->log_file.obj.fs)
+		logger_stop(con);
+
+	chMtxLock(&logger_mtx);
+	if (!file_open(&con->log_file, filename, 'w')) {
+		chMtxUnlock(&logger_mtx);
+		return FALSE;
+	}
+	f_lseek(&con->log_file, f_size(&con->log_file));
+
+	/* One cluster, both are powers of 2 so a part divides the cluster */
+	log->block_size = MIN((uint32_t)con->log_file.obj.fs->csize * MMCSD_BLOCK_SIZE,
+			      LOGGER_BLOCK_MAX);
+	log->head = 0;
+	log->tail = 0;
+	log->dropped_write = 0;
+	log->dropped_sd = 0;
+	log->dirty = FALSE;
+	log->last_write = chVTGetSystemTimeX();
+	log->last_sync = log->last_write;
+
+	for (i = 0; i < LOGGER_MAX_CONSOLES; i++) {
+		if (logger_consoles[i] == NULL || logger_consoles[i] == con) {
+			logger_consoles[i] = con;
+			break;
+		}
+	}
+	log->enabled = TRUE;
+	chMtxUnlock(&logger_mtx);
+
+	return TRUE;
+}
+
+/**
+ * @brief   Writes pending data, then closes the log file
+ *
+ * @param[in] con		console to stop logging
+ *
+ * @return			Number of bytes which could not be logged.
+ */
+uint32_t logger_stop(t_hydra_console *con)
+{
+	con->log.enabled = FALSE;
+
+	chMtxLock(&logger_mtx);
+	logger_service(con);
+	if (con->log_file.obj.fs)
+		file_close(&con->log_file);
+	chMtxUnlock(&logger_mtx);
+
+	return logger_dropped(con);
+}
+
+/**
+ * @brief   Number of bytes which could not be logged
+ *
+ * @param[in] con		logged console
+ *
+ * @return			Bytes dropped on a full ring or a SD error.
+ */
+uint32_t logger_dropped(t_hydra_console *con)
+{
+	return con->log.dropped_write + con->log.dropped_sd;
+}
+
+/* Called from the console output path, never blocks */
+void logger_write(t_hydra_console *con, const uint8_t *data, uint32_t size)
+{
+	t_console_log *log = &con->log;
+	uint32_t head, free, offset, chunk;
+
+	if (!log->enabled || !size)
+		return;
+
+	head = log->head;
+	free = CONSOLE_LOG_RING_SIZE - (head - log->tail);
+	if (size > free) {
+		log->dropped_write += size - free;
+		size = free;
+	}
+
+	while (size) {
+		offset = head & LOGGER_RING_MASK;
+		chunk = MIN(size, CONSOLE_LOG_RING_SIZE - offset);
+		memcpy(&log->data[offset], data, chunk);
+		data += chunk;
+		size -= chunk;
+		head += chunk;
+	}
+
+	/* Publish the data only once copied */
+	__asm__ volatile("" ::: "memory");
+	log->head = head;
+
+	if (head - log->tail >= log->block_size)
+		chBSemSignal(&logger_sem);
+}
@@ -0,0 +1,39 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOGGER_H_
+#define _LOGGER_H_
+
+#include "common.h"
+
+/* Data is written to the SD card in blocks of one FAT cluster aligned on
+ the file position, clusters larger than this are written in parts */
+#define LOGGER_BLOCK_MAX (CONSOLE_LOG_RING_SIZE / 2)
+/* Pending data older than this is written even if not a full block */
+#define LOGGER_IDLE_MS (250)
+/* Maximum time between two f_sync() while data is written */
+#define LOGGER_SYNC_MS (1000)
+#define LOGGER_WA_SIZE (1024)
+
+void logger_init(void);
+bool logger_start(t_hydra_console *con, const char *filename);
+uint32_t logger_stop(t_hydra_console *con);
+uint32_t logger_dropped(t_hydra_console *con);
+void logger_write(t_hydra_console *con, const uint8_t *data, uint32_t size);
+
+#endif /* _LOGGER_H_ */
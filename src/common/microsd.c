@@ -29,6 +29,7 @@
 
 #include "microsd.h"
 #include "common.h"
+#include "sbuf.h"
 
 #include "script.h"
 
@@ -175,6 +176,31 @@ bool file_append(FIL *file_handle, uint8_t *data, int len)
 	return TRUE;
 }
 
+/**
+ * @brief   Sets the size of an opened file and rewinds it
+ * @note    Clusters are allocated once, so that the following sequential
+ *          writes do not extend the FAT chain. Data beyond the new size
+ *          is truncated.
+ *
+ * @param[in]  file_handle	pointer to a FIL object opened for writing
+ * @param[in]  size		file size in bytes
+ *
+ * @return			The operation status, FALSE if the card is full.
+ */
+bool file_preallocate(FIL *file_handle, uint32_t size)
+{
+	if (f_lseek(file_handle, size) != FR_OK || f_tell(file_handle) != size)
+		return FALSE;
+
+	if (f_truncate(file_handle) != FR_OK)
+		return FALSE;
+
+	if (f_lseek(file_handle, 0) != FR_OK)
+		return FALSE;
+
+	return TRUE;
+}
+
 bool file_close(FIL *file_handle)
 {
 	if(f_close(file_handle) == FR_OK) {
@@ -331,7 +357,8 @@ static void print_mbs(t_hydra_console *con, uint32_t val_perf_kibs)
 	cprintf(con, "%2d.%03d", val_int_part, val_dec_part);
 }
 
-static int sd_perf_run(t_hydra_console *con, int seconds, int sectors, int offset)
+static int sd_perf_run(t_hydra_console *con, uint8_t *buffer, int seconds,
+		       int sectors, int offset)
 {
 	uint32_t n, startblk;
 	systime_t start, end;
@@ -343,7 +370,7 @@ static int sd_perf_run(t_hydra_console *con, int seconds, int sectors, int offse
 	end = start + TIME_MS2I(seconds * 1000);
 	n = 0;
 	do {
-		if (blkRead(&SDCD1, startblk, g_sbuf + offset, sectors)) {
+		if (blkRead(&SDCD1, startblk, buffer + offset, sectors)) {
 			cprintf(con, "SD read failed.\r\n");
 			return FALSE;
 		}
@@ -361,22 +388,36 @@ static int sd_perf_run(t_hydra_console *con, int seconds, int sectors, int offse
 int sd_perf(t_hydra_console *con, int offset)
 {
 	uint32_t nb_sectors;
+	uint8_t *buffer;
 	int ret;
 
+	/*
+	 * Whole g_sbuf lease, the unaligned reads use the slack at the
+	 * end of g_sbuf.
+	 */
+	buffer = sbuf_alloc(con, SBUF_RAM, NB_SBUFFER);
+	if (buffer == NULL) {
+		cprintf(con, "Scratch buffer busy.\r\n");
+		return FALSE;
+	}
+
 	cprintf(con, "%sligned sequential reads:\r\n", offset ? "Una" : "A");
 
 	/* Single block read performance. */
 	cprintf(con, "0.5KiB blocks: ");
-	if (!(ret = sd_perf_run(con, PERFRUN_SECONDS, 1, offset)))
+	if (!(ret = sd_perf_run(con, buffer, PERFRUN_SECONDS, 1, offset))) {
+		sbuf_free(con, buffer);
 		return ret;
+	}
 
 	for(nb_sectors = 2; nb_sectors <= G_SBUF_SDC_BURST_SIZE; nb_sectors=nb_sectors*2) {
 		/* Multiple sequential blocks read performance, aligned.*/
 		cprintf(con, "%3dKiB blocks: ", nb_sectors/2 );
-		ret = sd_perf_run(con, PERFRUN_SECONDS, nb_sectors, offset);
+		ret = sd_perf_run(con, buffer, PERFRUN_SECONDS, nb_sectors, offset);
 		if(ret == FALSE)
-			return ret;
+			break;
 	}
+	sbuf_free(con, buffer);
 
 	return ret;
 }
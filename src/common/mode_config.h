@@ -154,11 +154,13 @@ typedef struct {
 typedef struct {
 	uint32_t trigger_masks[4];
 	uint32_t trigger_values[4];
+	uint32_t trigger_configs[4];
 	uint32_t read_count;
 	uint32_t delay_count;
-	uint32_t divider;
+	uint32_t sample_rate;
 	uint8_t state;
 	uint8_t channels;
+	uint8_t rle;
 } sump_config_t;
 
 typedef struct {
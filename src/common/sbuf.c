@@ -0,0 +1,189 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common.h"
+#include "sbuf.h"
+
+/*
+ * Each arena is split in fixed size blocks, a lease is a run of
+ * contiguous blocks owned by one console.
+ * Leases are released explicitly with sbuf_free() or all at once with
+ * sbuf_free_all() once the console command is over.
+ */
+
+#define SBUF_MAX_BLOCKS (16)
+
+typedef struct {
+	const char *name;
+	uint8_t *base;
+	uint32_t block_size;
+	uint32_t nb_blocks;
+	/* Owner of each block, NULL if free */
+	t_hydra_console *owner[SBUF_MAX_BLOCKS];
+	/* Number of blocks of the lease starting at this block */
+	uint8_t lease_len[SBUF_MAX_BLOCKS];
+	uint32_t used;
+	uint32_t high_water;
+	uint32_t failures;
+} t_sbuf_arena;
+
+/* CCM = .ram4 */
+static uint8_t ccm_sbuf[SBUF_CCM_SIZE] __attribute__ ((section(".ram4"), aligned (4)));
+
+static t_sbuf_arena arenas[SBUF_NB_ARENAS] = {
+	[SBUF_RAM] = {
+		.name = "RAM",
+		.base = g_sbuf,
+		.block_size = SBUF_RAM_BLOCK_SIZE,
+		.nb_blocks = SBUF_RAM_NB_BLOCKS,
+	},
+	[SBUF_CCM] = {
+		.name = "CCM",
+		.base = ccm_sbuf,
+		.block_size = SBUF_CCM_BLOCK_SIZE,
+		.nb_blocks = SBUF_CCM_NB_BLOCKS,
+	},
+};
+
+/**
+ * @brief   Leases a scratch buffer
+ *
+ * @param[in] con		owner console
+ * @param[in] arena		SBUF_RAM or SBUF_CCM
+ * @param[in] size		size in bytes
+ *
+ * @return			Buffer (4 bytes aligned) or NULL if no room.
+ */
+void *sbuf_alloc(t_hydra_console *con, sbuf_arena_t arena, uint32_t size)
+{
+	t_sbuf_arena *a = &arenas[arena];
+	uint32_t nb, first, i, run;
+	void *ptr = NULL;
+
+	nb = (size + a->block_size - 1) / a->block_size;
+	if (nb == 0)
+		nb = 1;
+
+	chSysLock();
+	run = 0;
+	for (i = 0; i < a->nb_blocks && nb <= a->nb_blocks; i++) {
+		if (a->owner[i] != NULL) {
+			run = 0;
+			continue;
+		}
+		if (++run == nb) {
+			first = i + 1 - nb;
+			for (i = first; i < first + nb; i++)
+				a->owner[i] = con;
+			a->lease_len[first] = nb;
+			a->used += nb;
+			if (a->used > a->high_water)
+				a->high_water = a->used;
+			ptr = &a->base[first * a->block_size];
+			break;
+		}
+	}
+	if (ptr == NULL)
+		a->failures++;
+	chSysUnlock();
+
+	return ptr;
+}
+
+/* Must be called from a locked state */
+static void sbuf_release(t_sbuf_arena *a, uint32_t first)
+{
+	uint32_t i;
+
+	for (i = first; i < first + a->lease_len[first]; i++)
+		a->owner[i] = NULL;
+	a->used -= a->lease_len[first];
+	a->lease_len[first] = 0;
+}
+
+/**
+ * @brief   Releases a scratch buffer
+ *
+ * @param[in] con		owner console
+ * @param[in] ptr		buffer returned by sbuf_alloc()
+ *
+ * @return			FALSE if ptr is not a lease owned by con.
+ */
+bool sbuf_free(t_hydra_console *con, void *ptr)
+{
+	t_sbuf_arena *a;
+	uint32_t offset;
+	int i;
+
+	if (ptr == NULL)
+		return TRUE;
+
+	for (i = 0; i < SBUF_NB_ARENAS; i++) {
+		a = &arenas[i];
+		if ((uint8_t *)ptr < a->base ||
+		    (uint8_t *)ptr >= a->base + a->nb_blocks * a->block_size)
+			continue;
+
+		offset = (uint8_t *)ptr - a->base;
+		if (offset % a->block_size)
+			return FALSE;
+
+		chSysLock();
+		if (a->owner[offset / a->block_size] != con ||
+		    a->lease_len[offset / a->block_size] == 0) {
+			chSysUnlock();
+			return FALSE;
+		}
+		sbuf_release(a, offset / a->block_size);
+		chSysUnlock();
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Releases all leases owned by a console */
+void sbuf_free_all(t_hydra_console *con)
+{
+	t_sbuf_arena *a;
+	uint32_t i;
+	int j;
+
+	chSysLock();
+	for (j = 0; j < SBUF_NB_ARENAS; j++) {
+		a = &arenas[j];
+		for (i = 0; i < a->nb_blocks; i++) {
+			if (a->owner[i] == con && a->lease_len[i])
+				sbuf_release(a, i);
+		}
+	}
+	chSysUnlock();
+}
+
+void sbuf_show(t_hydra_console *con)
+{
+	t_sbuf_arena *a;
+	int i;
+
+	for (i = 0; i < SBUF_NB_ARENAS; i++) {
+		a = &arenas[i];
+		cprintf(con, "sbuf %s         : %u/%u blocks of %u bytes used, high water %u, %u failed\r\n",
+			a->name, a->used, a->nb_blocks, a->block_size,
+			a->high_water, a->failures);
+	}
+}
@@ -0,0 +1,46 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _SBUF_H_
+#define _SBUF_H_
+
+#include "common.h"
+
+/*
+ * Scratch buffers leased by consoles.
+ * SBUF_RAM is carved from g_sbuf (DMA capable), SBUF_CCM from the CCM
+ * (CPU access only, no DMA).
+ */
+#define SBUF_RAM_BLOCK_SIZE (4096)
+#define SBUF_RAM_NB_BLOCKS (NB_SBUFFER / SBUF_RAM_BLOCK_SIZE)
+#define SBUF_CCM_BLOCK_SIZE (512)
+#define SBUF_CCM_NB_BLOCKS (16)
+#define SBUF_CCM_SIZE (SBUF_CCM_BLOCK_SIZE * SBUF_CCM_NB_BLOCKS)
+
+typedef enum {
+	SBUF_RAM = 0,
+	SBUF_CCM,
+	SBUF_NB_ARENAS
+} sbuf_arena_t;
+
+void *sbuf_alloc(t_hydra_console *con, sbuf_arena_t arena, uint32_t size);
+bool sbuf_free(t_hydra_console *con, void *ptr);
+void sbuf_free_all(t_hydra_console *con);
+void sbuf_show(t_hydra_console *con);
+
+#endif /* _SBUF_H_ */
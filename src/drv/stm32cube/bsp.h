@@ -48,8 +48,15 @@ typedef struct {
 
 /* Macro for fast read, set & clear GPIO pin */
 #define gpio_get_pin(GPIOx, GPIO_Pin) (GPIOx->IDR & GPIO_Pin)
+#ifdef HYDRAFW_HOST
+/* Host build: BSRR is plain memory, each write is applied at once, see host/hal.c */
+void host_gpio_bsrr(void *gpiop, uint32_t bsrr);
+#define gpio_set_pin(GPIOx, GPIO_Pin) (host_gpio_bsrr(GPIOx, GPIO_Pin<<16))
+#define gpio_clr_pin(GPIOx, GPIO_Pin) (host_gpio_bsrr(GPIOx, GPIO_Pin))
+#else
 #define gpio_set_pin(GPIOx, GPIO_Pin) (GPIOx->BSRR = GPIO_Pin<<16)
 #define gpio_clr_pin(GPIOx, GPIO_Pin) (GPIOx->BSRR = GPIO_Pin)
+#endif
 
 #if !defined(bool) || defined(__DOXYGEN__)
 typedef enum {
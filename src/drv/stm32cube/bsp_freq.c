@@ -16,6 +16,7 @@ limitations under the License.
 #include "common.h"
 #include "bsp_freq.h"
 #include "bsp_freq_conf.h"
+#include "bsp_tim.h"
 
 #define NB_FREQ (BSP_DEV_freq_END)
 
@@ -57,7 +58,7 @@ static void freq_gpio_hw_init(bsp_dev_freq_t dev_num)
 /** \brief Init FREQ device.
  *
  * \param dev_num bsp_dev_freq_t: FREQ dev num.
- * \return bsp_status_t: status of the init.
+ * \return bsp_status_t: status of the init, BSP_ERROR if TIM8 is used by the TIM DMA sampling.
  *
  */
 bsp_status_t bsp_freq_init(bsp_dev_freq_t dev_num, uint16_t scale)
@@ -69,6 +70,10 @@ bsp_status_t bsp_freq_init(bsp_dev_freq_t dev_num, uint16_t scale)
 
 	bsp_freq_deinit(dev_num);
 
+	if(bsp_tim8_acquire(BSP_TIM8_FREQ) != BSP_OK) {
+		return BSP_ERROR;
+	}
+
 	/* Configure the FREQ (TIM8) peripheral */
 	__TIM8_CLK_ENABLE();
 
@@ -129,13 +134,18 @@ bsp_status_t bsp_freq_init(bsp_dev_freq_t dev_num, uint16_t scale)
 /** \brief De-initialize the FREQ device.
  *
  * \param dev_num bsp_dev_freq_t: FREQ dev num.
- * \return bsp_status_t: Status of the deinit.
+ * \return bsp_status_t: Status of the deinit, BSP_ERROR if TIM8 is used by the TIM DMA sampling.
  *
  */
 bsp_status_t bsp_freq_deinit(bsp_dev_freq_t dev_num)
 {
 	TIM_HandleTypeDef  htim;
 
+	/* Leave TIM8 alone while it samples */
+	if(bsp_tim8_acquire(BSP_TIM8_FREQ) != BSP_OK) {
+		return BSP_ERROR;
+	}
+
 	htim.Instance = BSP_FREQ1_TIMER;
 	HAL_TIM_IC_Stop(&htim, TIM_CHANNEL_1);
 	HAL_TIM_IC_Stop(&htim, TIM_CHANNEL_2);
@@ -143,6 +153,8 @@ bsp_status_t bsp_freq_deinit(bsp_dev_freq_t dev_num)
 	/* DeInit the low level hardware: GPIO, CLOCK, NVIC... */
 	freq_gpio_hw_deinit(dev_num);
 
+	bsp_tim8_release(BSP_TIM8_FREQ);
+
 	return BSP_OK;
 }
 
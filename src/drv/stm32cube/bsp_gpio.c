@@ -88,7 +88,11 @@ void bsp_gpio_set(bsp_gpio_port_t gpio_port, uint16_t gpio_pin)
 	GPIO_TypeDef *hal_gpio_port;
 
 	hal_gpio_port = (GPIO_TypeDef *)gpio_port;
+#ifdef HYDRAFW_HOST
+	host_gpio_bsrr(hal_gpio_port, 1 << gpio_pin);
+#else
 	hal_gpio_port->BSRR = 1 << gpio_pin;
+#endif
 }
 
 
@@ -103,7 +107,11 @@ void bsp_gpio_clr(bsp_gpio_port_t gpio_port, uint16_t gpio_pin)
 	GPIO_TypeDef *hal_gpio_port;
 
 	hal_gpio_port = (GPIO_TypeDef *)gpio_port;
+#ifdef HYDRAFW_HOST
+	host_gpio_bsrr(hal_gpio_port, 1 << (gpio_pin+16));
+#else
 	hal_gpio_port->BSRR = 1 << (gpio_pin+16);
+#endif
 }
 
 /** \brief Set gpio_pin(s) as input for the corresponding gpio_port
@@ -21,4 +21,10 @@ limitations under the License.
 #define BSP_I2C1_SCL_PIN            GPIO_PIN_6
 #define BSP_I2C1_SDA_PIN            GPIO_PIN_7
 
+/* I2C1 peripheral, slave emulation */
+#define BSP_I2C1                    I2C1
+#define BSP_I2C1_AF                 GPIO_AF4_I2C1
+/* Above the other IRQs (see common/mcuconf.h), to limit clock stretching */
+#define BSP_I2C_IRQ_PRIORITY        (5)
+
 #endif /* _BSP_I2C_CONF_H_ */
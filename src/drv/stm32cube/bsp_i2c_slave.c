@@ -13,13 +13,33 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 */
+#include "hal.h"
 #include "bsp_i2c_slave.h"
 #include "bsp_i2c_conf.h"
 
-#define I2C_SLAVE_TIMEOUT_MAX (100000) // About 10sec (see common/chconf.h/CH_CFG_ST_FREQUENCY)
+/* Sniffer edge events, see bsp_i2c_slave_sniff_start() */
+#define BSP_I2C_SNIFF_LINES (0x3)
+#define BSP_I2C_SNIFF_CLOCK (0x4)
+#define BSP_I2C_SNIFF_TIME  (~0x7U)
 
-#define BSP_I2C_EVENT_START 0b10000000000
-#define BSP_I2C_EVENT_STOP  0b01000000000
+typedef struct {
+	volatile uint32_t *ring;
+	uint32_t len;
+	volatile uint32_t head;
+	volatile uint32_t tail;
+	volatile uint32_t lost;
+} t_i2c_sniff_ring;
+
+static t_i2c_sniff_ring sniff_ring;
+
+typedef struct {
+	const bsp_i2c_slave_cb_t *cb;
+	uint16_t addr;
+	volatile bool transmit;
+	volatile uint32_t errors;
+} t_i2c_listen;
+
+static t_i2c_listen slave_listen;
 
 /** \brief I2C SW Bit Banging GPIO HW DeInit.
  *
@@ -103,158 +123,323 @@ bsp_status_t bsp_i2c_slave_deinit(bsp_dev_i2c_t dev_num)
 	return BSP_OK;
 }
 
-/** \brief Sends a Byte in blocking mode and set the status.
+/** \brief Get current lines status
  *
  * \param dev_num bsp_dev_i2c_t: I2C dev num.
- * \param tx_data uint8_t: data to send.
- * \param tx_ack_flag bool*: TRUE means ACK, FALSE means NACK.
- * \return bsp_status_t: status of the transfer.
+ * \return uint8_t: status of the lines on two bits (SDA-SCL).
+ *
+ * 7 6 5 4 3 2 1 0
+ * X X X X X X D C
+ *
+ * D : SDA
+ * C : SCL
  *
  */
-bsp_status_t bsp_i2c_slave_write_u8(bsp_dev_i2c_t dev_num, uint8_t tx_data, uint8_t* tx_ack_flag)
+static inline uint8_t bsp_i2c_slave_get_lines(bsp_dev_i2c_t dev_num)
 {
 	(void) dev_num;
-	(void) tx_data;
-	(void) tx_ack_flag;
-	// TODO
+	uint8_t value = 0;
 
-	return BSP_OK;
+	value = HAL_GPIO_ReadPin(BSP_I2C1_SCL_SDA_GPIO_PORT, BSP_I2C1_SDA_PIN)<<1;
+	value |= HAL_GPIO_ReadPin(BSP_I2C1_SCL_SDA_GPIO_PORT, BSP_I2C1_SCL_PIN);
+	return value;
+}
+
+/* Called from ISR context, SCL and SDA share the EXTI9_5 vector.
+   arg is NULL for the SDA edges. */
+static void bsp_i2c_slave_sniff_cb(void *arg)
+{
+	uint32_t event, idr;
+
+	event = bsp_get_cyclecounter() & BSP_I2C_SNIFF_TIME;
+	idr = BSP_I2C1_SCL_SDA_GPIO_PORT->IDR;
+	if (arg != NULL) {
+		event |= BSP_I2C_SNIFF_CLOCK;
+	} else if (EXTI->PR & BSP_I2C1_SCL_PIN) {
+		/* SCL rose after SDA changed, SCL was low at the SDA edge */
+		idr &= ~BSP_I2C1_SCL_PIN;
+	}
+	/* PB6/PB7: bit 0 SCL, bit 1 SDA */
+	event |= (idr >> 6) & BSP_I2C_SNIFF_LINES;
+
+	/* Single producer, no lock needed */
+	if (sniff_ring.head - sniff_ring.tail < sniff_ring.len) {
+		sniff_ring.ring[sniff_ring.head & (sniff_ring.len - 1)] = event;
+		sniff_ring.head++;
+	} else {
+		sniff_ring.lost++;
+	}
 }
 
-/** \brief Read a Byte in blocking mode and set the status.
+/** \brief Start the interrupt driven sniffer
  *
  * \param dev_num bsp_dev_i2c_t: I2C dev num.
- * \param rx_data uint8_t*: The received byte.
- * \return bsp_status_t: status of the transfer.
+ * \param ring uint32_t*: Edge events ring.
+ * \param len uint32_t: Ring size in events, power of two.
+ * \param lines uint8_t*: Lines levels before the first event (SDA-SCL).
+ * \return bsp_status_t: status of the start.
+ *
+ * The device shall be initialized with bsp_i2c_slave_init().
+ * EXTI events are recorded on SCL rising edges and on SDA edges:
+ *
+ * 31 ... 3   2 1 0
+ * T .... T   K D C
+ *
+ * T : Cycle counter (bits 31-3)
+ * K : SCL rising edge, else SDA edge
+ * D : SDA level after the edge
+ * C : SCL level after the edge
+ *
+ * Events are read from the ring up to bsp_i2c_slave_sniff_count() and
+ * released with bsp_i2c_slave_sniff_release(). Events are dropped while
+ * the ring is full.
  *
  */
-bsp_status_t bsp_i2c_slave_read_u8(bsp_dev_i2c_t dev_num, uint8_t* rx_data)
+bsp_status_t bsp_i2c_slave_sniff_start(bsp_dev_i2c_t dev_num, uint32_t *ring,
+				       uint32_t len, uint8_t *lines)
 {
-	(void) dev_num;
-	(void) rx_data;
-	// TODO
+	if (len == 0 || (len & (len - 1)) != 0)
+		return BSP_ERROR;
+
+	sniff_ring.ring = ring;
+	sniff_ring.len = len;
+	sniff_ring.head = 0;
+	sniff_ring.tail = 0;
+	sniff_ring.lost = 0;
+
+	*lines = bsp_i2c_slave_get_lines(dev_num);
+	palEnablePadEvent(GPIOB, 6, PAL_EVENT_MODE_RISING_EDGE);
+	palSetPadCallback(GPIOB, 6, bsp_i2c_slave_sniff_cb, &sniff_ring);
+	palEnablePadEvent(GPIOB, 7, PAL_EVENT_MODE_BOTH_EDGES);
+	palSetPadCallback(GPIOB, 7, bsp_i2c_slave_sniff_cb, NULL);
 
 	return BSP_OK;
 }
 
-
-/** \brief Get current lines status
+/** \brief Stop the interrupt driven sniffer
  *
  * \param dev_num bsp_dev_i2c_t: I2C dev num.
- * \return uint8_t: status of the lines on two bits (SDA-SCL).
+ * \return void
  *
- * 7 6 5 4 3 2 1 0
- * X X X X X X D C
+ */
+void bsp_i2c_slave_sniff_stop(bsp_dev_i2c_t dev_num)
+{
+	(void)dev_num;
+
+	palDisablePadEvent(GPIOB, 6);
+	palDisablePadEvent(GPIOB, 7);
+}
+
+/** \brief Number of events recorded since the start
  *
- * D : SDA
- * C : SCL
+ * \param dev_num bsp_dev_i2c_t: I2C dev num.
+ * \return uint32_t: events written to the ring (wraps around).
  *
  */
-static inline uint8_t bsp_i2c_slave_get_lines(bsp_dev_i2c_t dev_num)
+uint32_t bsp_i2c_slave_sniff_count(bsp_dev_i2c_t dev_num)
 {
-	(void) dev_num;
-	uint8_t value = 0;
+	(void)dev_num;
 
-	value = HAL_GPIO_ReadPin(BSP_I2C1_SCL_SDA_GPIO_PORT, BSP_I2C1_SDA_PIN)<<1;
-	value |= HAL_GPIO_ReadPin(BSP_I2C1_SCL_SDA_GPIO_PORT, BSP_I2C1_SCL_PIN);
-	return value;
+	return sniff_ring.head;
 }
 
-/** \brief Wait for line change
+/** \brief Release the events read from the ring
  *
  * \param dev_num bsp_dev_i2c_t: I2C dev num.
- * \param status uint8_t: Line change status.
- * \return bsp_status_t: operation status.
+ * \param count uint32_t: events read since the start (wraps around).
+ * \return void
  *
- * 7 6 5 4 3 2 1 0
- * X X d c X X D C
+ */
+void bsp_i2c_slave_sniff_release(bsp_dev_i2c_t dev_num, uint32_t count)
+{
+	(void)dev_num;
+
+	sniff_ring.tail = count;
+}
+
+/** \brief Number of events dropped while the ring was full
  *
- * d : old SDA
- * c : old SCL
- * D : SDA
- * C : SCL
+ * \param dev_num bsp_dev_i2c_t: I2C dev num.
+ * \return uint32_t: events dropped.
  *
  */
-static bsp_status_t bsp_i2c_slave_wait_change(bsp_dev_i2c_t dev_num, uint8_t *status)
+uint32_t bsp_i2c_slave_sniff_lost(bsp_dev_i2c_t dev_num)
+{
+	(void)dev_num;
+
+	return sniff_ring.lost;
+}
+
+/* I2C1 peripheral setup, own address and interrupts */
+static void i2c_listen_hw_config(void)
+{
+	I2C_TypeDef *i2c = BSP_I2C1;
+
+	i2c->CR1 = I2C_CR1_SWRST;
+	i2c->CR1 = 0;
+	i2c->CR2 = (bsp_get_apb1_freq() / 1000000) & I2C_CR2_FREQ;
+	/* Bit 14 shall be kept at 1 */
+	i2c->OAR1 = (1 << 14) | (slave_listen.addr << 1);
+	i2c->OAR2 = 0;
+	i2c->CR1 = I2C_CR1_PE;
+	i2c->CR1 = I2C_CR1_PE | I2C_CR1_ACK;
+	i2c->CR2 |= I2C_CR2_ITEVTEN | I2C_CR2_ITERREN;
+}
+
+static void i2c_listen_ev_irq(void)
 {
-	uint32_t tickstart;
-	uint8_t initial, current;
+	I2C_TypeDef *i2c = BSP_I2C1;
+	const bsp_i2c_slave_cb_t *cb = slave_listen.cb;
+	uint32_t sr1, sr2;
+
+	sr1 = i2c->SR1;
+	if (sr1 & I2C_SR1_ADDR) {
+		/* SR1 then SR2 read clears ADDR */
+		sr2 = i2c->SR2;
+		slave_listen.transmit = (sr2 & I2C_SR2_TRA) != 0;
+		cb->start(cb->arg, slave_listen.transmit);
+		i2c->CR2 |= I2C_CR2_ITBUFEN;
+		sr1 = i2c->SR1;
+	}
+	if (sr1 & I2C_SR1_RXNE)
+		cb->rx(cb->arg, i2c->DR);
+	/* Next byte loaded while the current one is sent, no stretching */
+	if ((sr1 & I2C_SR1_TXE) && slave_listen.transmit)
+		i2c->DR = cb->tx(cb->arg);
+	if (sr1 & I2C_SR1_STOPF) {
+		/* SR1 read then CR1 write clears STOPF */
+		i2c->CR1 |= I2C_CR1_PE;
+		i2c->CR2 &= ~I2C_CR2_ITBUFEN;
+		slave_listen.transmit = FALSE;
+		cb->stop(cb->arg, 0);
+	}
+}
 
-	tickstart = HAL_GetTick();
-	initial = bsp_i2c_slave_get_lines(dev_num);
-	do {
-		current = bsp_i2c_slave_get_lines(dev_num);
+static void i2c_listen_er_irq(void)
+{
+	I2C_TypeDef *i2c = BSP_I2C1;
+	const bsp_i2c_slave_cb_t *cb = slave_listen.cb;
+	uint32_t sr1;
 
-		if ((HAL_GetTick() - tickstart) > I2C_SLAVE_TIMEOUT_MAX) {
-			return BSP_TIMEOUT;
+	sr1 = i2c->SR1;
+	if (sr1 & I2C_SR1_AF) {
+		/* Master NACK, end of a read */
+		i2c->SR1 = ~I2C_SR1_AF & 0xFFFF;
+		slave_listen.transmit = FALSE;
+		if (sr1 & I2C_SR1_TXE) {
+			i2c->CR2 &= ~I2C_CR2_ITBUFEN;
+			cb->stop(cb->arg, 0);
+		} else {
+			/* DR holds the next byte, it would be sent first on the
+			   next read: reset the peripheral */
+			i2c_listen_hw_config();
+			cb->stop(cb->arg, 1);
 		}
-	} while(current == initial);
-	*status = initial<<4 | current;
-	return BSP_OK;
+	}
+	if (sr1 & (I2C_SR1_BERR | I2C_SR1_ARLO | I2C_SR1_OVR)) {
+		i2c->SR1 = ~(I2C_SR1_BERR | I2C_SR1_ARLO | I2C_SR1_OVR) & 0xFFFF;
+		slave_listen.errors++;
+	}
+}
+
+OSAL_IRQ_HANDLER(STM32_I2C1_EVENT_HANDLER)
+{
+	OSAL_IRQ_PROLOGUE();
+	i2c_listen_ev_irq();
+	OSAL_IRQ_EPILOGUE();
 }
 
-/** \brief Sniff one I2C event
+OSAL_IRQ_HANDLER(STM32_I2C1_ERROR_HANDLER)
+{
+	OSAL_IRQ_PROLOGUE();
+	i2c_listen_er_irq();
+	OSAL_IRQ_EPILOGUE();
+}
+
+/** \brief Start the interrupt driven slave
  *
  * \param dev_num bsp_dev_i2c_t: I2C dev num.
- * \param rx_value uint16_t: Encoded I2C event.
- * \return bsp_status_t: Operation status.
+ * \param mode_conf mode_config_proto_t*: Mode config proto (pull).
+ * \param addr uint8_t: 7 bits slave address.
+ * \param cb bsp_i2c_slave_cb_t*: Callbacks, called from ISR context.
+ * \return bsp_status_t: status of the start.
  *
- * I2C event is encoded in 16 bits like so:
+ * The I2C1 peripheral answers on SCL/SDA. For a read, each byte is given
+ * by the tx callback while the previous one is sent, the stop callback
+ * gets the number of bytes given but not sent.
  *
- * f e d c b a 9 8 7 6 5 4 3 2 1 0
- * X X X X X S P D D D D D D D D A
+ */
+bsp_status_t bsp_i2c_slave_listen_start(bsp_dev_i2c_t dev_num,
+					mode_config_proto_t* mode_conf,
+					uint8_t addr,
+					const bsp_i2c_slave_cb_t *cb)
+{
+	GPIO_InitTypeDef gpio_init;
+
+	(void)dev_num;
+	if (addr > 0x7F)
+		return BSP_ERROR;
+
+	slave_listen.cb = cb;
+	slave_listen.addr = addr;
+	slave_listen.transmit = FALSE;
+	slave_listen.errors = 0;
+
+	__HAL_RCC_I2C1_CLK_ENABLE();
+	__HAL_RCC_I2C1_FORCE_RESET();
+	__HAL_RCC_I2C1_RELEASE_RESET();
+
+	gpio_init.Pin = BSP_I2C1_SCL_PIN | BSP_I2C1_SDA_PIN;
+	gpio_init.Mode = GPIO_MODE_AF_OD;
+	gpio_init.Speed = GPIO_SPEED_FAST;
+	switch(mode_conf->config.i2c.dev_gpio_pull) {
+	case MODE_CONFIG_DEV_GPIO_PULLUP:
+		gpio_init.Pull = GPIO_PULLUP;
+		break;
+	case MODE_CONFIG_DEV_GPIO_PULLDOWN:
+		gpio_init.Pull = GPIO_PULLDOWN;
+		break;
+	default:
+		gpio_init.Pull = GPIO_NOPULL;
+		break;
+	}
+	gpio_init.Alternate = BSP_I2C1_AF;
+	HAL_GPIO_Init(BSP_I2C1_SCL_SDA_GPIO_PORT, &gpio_init);
+
+	i2c_listen_hw_config();
+	nvicEnableVector(STM32_I2C1_EVENT_NUMBER, BSP_I2C_IRQ_PRIORITY);
+	nvicEnableVector(STM32_I2C1_ERROR_NUMBER, BSP_I2C_IRQ_PRIORITY);
+
+	return BSP_OK;
+}
+
+/** \brief Stop the interrupt driven slave
  *
- * X : Unused
- * S : START
- * P : STOP
- * D : Data
- * A : ACK
+ * \param dev_num bsp_dev_i2c_t: I2C dev num.
+ * \return void
  *
  */
-bsp_status_t bsp_i2c_slave_sniff(bsp_dev_i2c_t dev_num, uint16_t * rx_value)
+void bsp_i2c_slave_listen_stop(bsp_dev_i2c_t dev_num)
 {
-	bsp_status_t status;
-	uint16_t value = 0;
-	uint8_t pin_status, i = 0;
+	nvicDisableVector(STM32_I2C1_EVENT_NUMBER);
+	nvicDisableVector(STM32_I2C1_ERROR_NUMBER);
 
-	while(1) {
-		status = bsp_i2c_slave_wait_change(dev_num, &pin_status);
+	BSP_I2C1->CR2 = 0;
+	BSP_I2C1->CR1 = 0;
+	__HAL_RCC_I2C1_CLK_DISABLE();
 
-		if (status == BSP_TIMEOUT) {
-			return BSP_TIMEOUT;
-		}
+	bsp_i2c_slave_deinit(dev_num);
+}
 
-		switch(pin_status) {
-		case 0b00110001:
-			// START condition
-			*rx_value = BSP_I2C_EVENT_START;
-			return BSP_OK;
-		case 0b00010011:
-			//STOP condition
-			*rx_value = BSP_I2C_EVENT_STOP;
-			return BSP_OK;
-		case 0b00000001:
-		case 0b00100001:
-			//SCL goes high, SDA low
-			value <<= 1;
-			if (++i == 9) {
-				*rx_value = value;
-				return BSP_OK;
-			}
-			break;
-		case 0b00000011:
-		case 0b00100011:
-			//SCL goes high, SDA high
-			value <<= 1;
-			value |= 1;
-			if (++i == 9) {
-				*rx_value = value;
-				return BSP_OK;
-			}
-			break;
-		default:
-			continue;
-		}
-	}
-	return BSP_ERROR;
+/** \brief Number of bus errors, arbitration losts and overruns
+ *
+ * \param dev_num bsp_dev_i2c_t: I2C dev num.
+ * \return uint32_t: errors since the start.
+ *
+ */
+uint32_t bsp_i2c_slave_listen_errors(bsp_dev_i2c_t dev_num)
+{
+	(void)dev_num;
+
+	return slave_listen.errors;
 }
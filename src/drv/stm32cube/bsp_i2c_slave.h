@@ -28,11 +28,30 @@ typedef enum {
 
 #include "bsp.h"
 #include "mode_config.h"
+
+/* Slave callbacks, called from ISR context */
+typedef struct {
+	void (*start)(void *arg, bool read);
+	void (*rx)(void *arg, uint8_t data);
+	uint8_t (*tx)(void *arg);
+	void (*stop)(void *arg, uint32_t unsent);
+	void *arg;
+} bsp_i2c_slave_cb_t;
+
 bsp_status_t bsp_i2c_slave_init(bsp_dev_i2c_t dev_num, mode_config_proto_t* mode_conf);
 bsp_status_t bsp_i2c_slave_deinit(bsp_dev_i2c_t dev_num);
 
-bsp_status_t bsp_i2c_slave_write_u8(bsp_dev_i2c_t dev_num, uint8_t tx_data, uint8_t* tx_ack_flag);
-bsp_status_t bsp_i2c_slave_read_u8(bsp_dev_i2c_t dev_num, uint8_t* rx_data);
-
-bsp_status_t bsp_i2c_slave_sniff(bsp_dev_i2c_t dev_num, uint16_t * rx_value);
+bsp_status_t bsp_i2c_slave_sniff_start(bsp_dev_i2c_t dev_num, uint32_t *ring,
+				       uint32_t len, uint8_t *lines);
+void bsp_i2c_slave_sniff_stop(bsp_dev_i2c_t dev_num);
+uint32_t bsp_i2c_slave_sniff_count(bsp_dev_i2c_t dev_num);
+void bsp_i2c_slave_sniff_release(bsp_dev_i2c_t dev_num, uint32_t count);
+uint32_t bsp_i2c_slave_sniff_lost(bsp_dev_i2c_t dev_num);
+
+bsp_status_t bsp_i2c_slave_listen_start(bsp_dev_i2c_t dev_num,
+					mode_config_proto_t* mode_conf,
+					uint8_t addr,
+					const bsp_i2c_slave_cb_t *cb);
+void bsp_i2c_slave_listen_stop(bsp_dev_i2c_t dev_num);
+uint32_t bsp_i2c_slave_listen_errors(bsp_dev_i2c_t dev_num);
 #endif /* _BSP_I2C_SLAVE_H_ */
@@ -12,6 +12,7 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 */
+#include "hal.h"
 #include "bsp_spi.h"
 #include "bsp_spi_conf.h"
 
@@ -23,6 +24,38 @@ Warning in order to use this driver all GPIOs peripherals shall be enabled.
 static SPI_HandleTypeDef spi_handle[NB_SPI];
 static mode_config_proto_t* spi_mode_conf[NB_SPI];
 
+/*
+ * DMA transfers are used in master mode for transfers of at least
+ * SPIx_DMA_MIN_SIZE bytes, smaller ones are faster in polling mode.
+ * The DMA cannot access the CCM, such buffers also use polling mode.
+ */
+#define SPIx_DMA_MIN_SIZE (16)
+#define SPIx_DMA_TIMEOUT_MS (10000)
+#define SPIx_DMA_CAPABLE(p) ((p) == NULL || ((uint32_t)(p) & 0xFFFF0000) != 0x10000000)
+
+typedef struct {
+	bsp_dev_spi_t dev_num;
+	const stm32_dma_stream_t *dma_rx;
+	const stm32_dma_stream_t *dma_tx;
+	uint32_t mode_rx;
+	uint32_t mode_tx;
+	volatile bool busy;
+	bsp_status_t status;
+	bsp_spi_cb_t cb;
+	void *cb_arg;
+	thread_reference_t thread;
+	/* Circular reception */
+	bool circular;
+	uint16_t ring_size;
+	volatile uint32_t laps;
+	uint32_t last_count;
+} t_spi_dma;
+
+static t_spi_dma spi_dma[NB_SPI];
+/* Sent by reads, and sink for the data received by writes */
+static const uint8_t spi_dma_tx_dummy = 0xFF;
+static uint8_t spi_dma_rx_dummy;
+
 /**
   * @brief  Init low level hardware: GPIO, CLOCK, NVIC...
   * @param  dev_num: SPI dev num
@@ -129,6 +162,125 @@ static void spi_gpio_hw_deinit(bsp_dev_spi_t dev_num)
 	}
 }
 
+/* Called from ISR context */
+static void spi_dma_end(t_spi_dma *dma, bsp_status_t status)
+{
+	SPI_TypeDef *spi = spi_handle[dma->dev_num].Instance;
+
+	dmaStreamDisable(dma->dma_tx);
+	dmaStreamDisable(dma->dma_rx);
+	spi->CR2 &= ~(SPI_CR2_TXDMAEN | SPI_CR2_RXDMAEN);
+
+	osalSysLockFromISR();
+	dma->status = status;
+	dma->busy = FALSE;
+	osalThreadResumeI(&dma->thread, MSG_OK);
+	osalSysUnlockFromISR();
+
+	if(dma->cb != NULL)
+		dma->cb(dma->dev_num, status, dma->cb_arg);
+}
+
+static void spi_dma_rx_isr(void *p, uint32_t flags)
+{
+	t_spi_dma *dma = (t_spi_dma *)p;
+
+	if(dma->circular) {
+		if((flags & STM32_DMA_ISR_TCIF) != 0)
+			dma->laps++;
+		return;
+	}
+	if((flags & (STM32_DMA_ISR_TEIF | STM32_DMA_ISR_DMEIF)) != 0)
+		spi_dma_end((t_spi_dma *)p, BSP_ERROR);
+	else if((flags & STM32_DMA_ISR_TCIF) != 0)
+		spi_dma_end((t_spi_dma *)p, BSP_OK);
+}
+
+static void spi_dma_tx_isr(void *p, uint32_t flags)
+{
+	/* End of transfer is signaled by the RX stream */
+	if((flags & (STM32_DMA_ISR_TEIF | STM32_DMA_ISR_DMEIF)) != 0)
+		spi_dma_end((t_spi_dma *)p, BSP_ERROR);
+}
+
+/*
+ * Allocate the DMA streams, if they are already used (ChibiOS SPI
+ * driver...) transfers fall back to polling mode.
+ */
+static void spi_dma_init(bsp_dev_spi_t dev_num)
+{
+	t_spi_dma *dma = &spi_dma[dev_num];
+	SPI_TypeDef *spi = spi_handle[dev_num].Instance;
+	const stm32_dma_stream_t *dma_rx;
+	const stm32_dma_stream_t *dma_tx;
+	uint32_t mode;
+
+	if(dma->dma_rx != NULL)
+		return;
+
+	if(dev_num == BSP_DEV_SPI1) {
+		dma_rx = STM32_DMA_STREAM(BSP_SPI1_RX_DMA_STREAM);
+		dma_tx = STM32_DMA_STREAM(BSP_SPI1_TX_DMA_STREAM);
+		dma->mode_rx = STM32_DMA_CR_CHSEL(BSP_SPI1_RX_DMA_CHN);
+		dma->mode_tx = STM32_DMA_CR_CHSEL(BSP_SPI1_TX_DMA_CHN);
+	} else { /* SPI2 */
+		dma_rx = STM32_DMA_STREAM(BSP_SPI2_RX_DMA_STREAM);
+		dma_tx = STM32_DMA_STREAM(BSP_SPI2_TX_DMA_STREAM);
+		dma->mode_rx = STM32_DMA_CR_CHSEL(BSP_SPI2_RX_DMA_CHN);
+		dma->mode_tx = STM32_DMA_CR_CHSEL(BSP_SPI2_TX_DMA_CHN);
+	}
+
+	if(dmaStreamAllocate(dma_rx, BSP_SPI_DMA_IRQ_PRIORITY,
+			     spi_dma_rx_isr, dma))
+		return;
+	if(dmaStreamAllocate(dma_tx, BSP_SPI_DMA_IRQ_PRIORITY,
+			     spi_dma_tx_isr, dma)) {
+		dmaStreamRelease(dma_rx);
+		return;
+	}
+
+	mode = STM32_DMA_CR_PL(BSP_SPI_DMA_PRIORITY) |
+	       STM32_DMA_CR_PSIZE_BYTE | STM32_DMA_CR_MSIZE_BYTE |
+	       STM32_DMA_CR_TEIE | STM32_DMA_CR_DMEIE;
+	dma->mode_rx |= mode | STM32_DMA_CR_DIR_P2M | STM32_DMA_CR_TCIE;
+	dma->mode_tx |= mode | STM32_DMA_CR_DIR_M2P;
+
+	dmaStreamSetPeripheral(dma_rx, &spi->DR);
+	dmaStreamSetPeripheral(dma_tx, &spi->DR);
+
+	dma->dev_num = dev_num;
+	dma->busy = FALSE;
+	dma->circular = FALSE;
+	dma->dma_tx = dma_tx;
+	dma->dma_rx = dma_rx;
+}
+
+static void spi_dma_deinit(bsp_dev_spi_t dev_num)
+{
+	t_spi_dma *dma = &spi_dma[dev_num];
+
+	if(dma->dma_rx == NULL)
+		return;
+
+	dmaStreamDisable(dma->dma_tx);
+	dmaStreamDisable(dma->dma_rx);
+	dmaStreamRelease(dma->dma_tx);
+	dmaStreamRelease(dma->dma_rx);
+	dma->dma_tx = NULL;
+	dma->dma_rx = NULL;
+	dma->busy = FALSE;
+	dma->circular = FALSE;
+}
+
+static bool spi_dma_usable(bsp_dev_spi_t dev_num, const uint8_t* tx_data,
+			   uint8_t* rx_data, uint16_t nb_data)
+{
+	return (spi_dma[dev_num].dma_rx != NULL &&
+		spi_handle[dev_num].Init.Mode == SPI_MODE_MASTER &&
+		nb_data >= SPIx_DMA_MIN_SIZE &&
+		SPIx_DMA_CAPABLE(tx_data) && SPIx_DMA_CAPABLE(rx_data));
+}
+
 /**
   * @brief  SPIx error treatment function.
   * @param  dev_num: SPI dev num
@@ -221,6 +373,8 @@ bsp_status_t bsp_spi_init(bsp_dev_spi_t dev_num, mode_config_proto_t* mode_conf)
 	/* Enable SPI peripheral */
 	__HAL_SPI_ENABLE(hspi);
 
+	spi_dma_init(dev_num);
+
 	return status;
 }
 
@@ -236,6 +390,8 @@ bsp_status_t bsp_spi_deinit(bsp_dev_spi_t dev_num)
 
 	hspi = &spi_handle[dev_num];
 
+	spi_dma_deinit(dev_num);
+
 	/* De-initialize the SPI comunication bus */
 	status = (bsp_status_t) HAL_SPI_DeInit(hspi);
 
@@ -305,12 +461,15 @@ uint8_t bsp_spi_rxne(bsp_dev_spi_t dev_num)
   * @param  nb_data: Number of data to send.
   * @retval status of the transfer.
   */
-bsp_status_t bsp_spi_write_u8(bsp_dev_spi_t dev_num, uint8_t* tx_data, uint8_t nb_data)
+bsp_status_t bsp_spi_write_u8(bsp_dev_spi_t dev_num, uint8_t* tx_data, uint16_t nb_data)
 {
 	SPI_HandleTypeDef* hspi;
 	hspi = &spi_handle[dev_num];
 
 	bsp_status_t status;
+	if(spi_dma_usable(dev_num, tx_data, NULL, nb_data))
+		return bsp_spi_dma_xfer(dev_num, tx_data, NULL, nb_data);
+
 	status = (bsp_status_t) HAL_SPI_Transmit(hspi, tx_data, nb_data, SPIx_TIMEOUT_MAX);
 	if(status != BSP_OK) {
 		spi_error(dev_num);
@@ -325,12 +484,15 @@ bsp_status_t bsp_spi_write_u8(bsp_dev_spi_t dev_num, uint8_t* tx_data, uint8_t n
   * @param  nb_data: Number of data to receive.
   * @retval status of the transfer.
   */
-bsp_status_t bsp_spi_read_u8(bsp_dev_spi_t dev_num, uint8_t* rx_data, uint8_t nb_data)
+bsp_status_t bsp_spi_read_u8(bsp_dev_spi_t dev_num, uint8_t* rx_data, uint16_t nb_data)
 {
 	SPI_HandleTypeDef* hspi;
 	hspi = &spi_handle[dev_num];
 
 	bsp_status_t status;
+	if(spi_dma_usable(dev_num, NULL, rx_data, nb_data))
+		return bsp_spi_dma_xfer(dev_num, NULL, rx_data, nb_data);
+
 	status = (bsp_status_t) HAL_SPI_Receive(hspi, rx_data, nb_data, SPIx_TIMEOUT_MAX);
 	if(status != BSP_OK) {
 		spi_error(dev_num);
@@ -345,12 +507,15 @@ bsp_status_t bsp_spi_read_u8(bsp_dev_spi_t dev_num, uint8_t* rx_data, uint8_t nb
   * @param  nb_data: Number of data to send & receive.
   * @retval status of the transfer.
   */
-bsp_status_t bsp_spi_write_read_u8(bsp_dev_spi_t dev_num, uint8_t* tx_data, uint8_t* rx_data, uint8_t nb_data)
+bsp_status_t bsp_spi_write_read_u8(bsp_dev_spi_t dev_num, uint8_t* tx_data, uint8_t* rx_data, uint16_t nb_data)
 {
 	SPI_HandleTypeDef* hspi;
 	hspi = &spi_handle[dev_num];
 
 	bsp_status_t status;
+	if(spi_dma_usable(dev_num, tx_data, rx_data, nb_data))
+		return bsp_spi_dma_xfer(dev_num, tx_data, rx_data, nb_data);
+
 	status = (bsp_status_t) HAL_SPI_TransmitReceive(hspi, tx_data, rx_data, nb_data, SPIx_TIMEOUT_MAX);
 	if(status != BSP_OK) {
 		spi_error(dev_num);
@@ -358,6 +523,206 @@ bsp_status_t bsp_spi_write_read_u8(bsp_dev_spi_t dev_num, uint8_t* tx_data, uint
 	return status;
 }
 
+/**
+  * @brief  Start a DMA transfer and return immediately.
+  * @param  dev_num: SPI dev num.
+  * @param  tx_data: Data to send, NULL to send 0xFF.
+  * @param  rx_data: Data to receive, NULL to drop received data.
+  * @param  nb_data: Number of data to send & receive.
+  * @param  cb: Called from ISR context at the end of the transfer, can be NULL.
+  * @param  arg: cb argument.
+  * @retval BSP_OK if started, BSP_BUSY if a transfer is in progress,
+  *         BSP_ERROR if DMA is not available.
+  */
+bsp_status_t bsp_spi_dma_start(bsp_dev_spi_t dev_num, const uint8_t* tx_data, uint8_t* rx_data,
+			       uint16_t nb_data, bsp_spi_cb_t cb, void *arg)
+{
+	t_spi_dma *dma = &spi_dma[dev_num];
+	SPI_TypeDef *spi = spi_handle[dev_num].Instance;
+
+	if(dma->dma_rx == NULL || nb_data == 0 ||
+	   !SPIx_DMA_CAPABLE(tx_data) || !SPIx_DMA_CAPABLE(rx_data))
+		return BSP_ERROR;
+	if(dma->busy)
+		return BSP_BUSY;
+
+	dma->busy = TRUE;
+	dma->status = BSP_BUSY;
+	dma->cb = cb;
+	dma->cb_arg = arg;
+
+	/* Drop data and overrun flag left by polled transfers */
+	(void)spi->DR;
+	(void)spi->SR;
+
+	if(rx_data != NULL) {
+		dmaStreamSetMemory0(dma->dma_rx, rx_data);
+		dmaStreamSetMode(dma->dma_rx, dma->mode_rx | STM32_DMA_CR_MINC);
+	} else {
+		dmaStreamSetMemory0(dma->dma_rx, &spi_dma_rx_dummy);
+		dmaStreamSetMode(dma->dma_rx, dma->mode_rx);
+	}
+	dmaStreamSetTransactionSize(dma->dma_rx, nb_data);
+
+	if(tx_data != NULL) {
+		dmaStreamSetMemory0(dma->dma_tx, tx_data);
+		dmaStreamSetMode(dma->dma_tx, dma->mode_tx | STM32_DMA_CR_MINC);
+	} else {
+		dmaStreamSetMemory0(dma->dma_tx, &spi_dma_tx_dummy);
+		dmaStreamSetMode(dma->dma_tx, dma->mode_tx);
+	}
+	dmaStreamSetTransactionSize(dma->dma_tx, nb_data);
+
+	dmaStreamEnable(dma->dma_rx);
+	dmaStreamEnable(dma->dma_tx);
+	spi->CR2 |= SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN;
+
+	return BSP_OK;
+}
+
+/**
+  * @brief  Wait for the end of the DMA transfer, the calling thread sleeps.
+  * @param  dev_num: SPI dev num.
+  * @retval status of the transfer.
+  */
+bsp_status_t bsp_spi_dma_wait(bsp_dev_spi_t dev_num)
+{
+	t_spi_dma *dma = &spi_dma[dev_num];
+	msg_t msg;
+
+	msg = MSG_OK;
+	osalSysLock();
+	if(dma->busy)
+		msg = osalThreadSuspendTimeoutS(&dma->thread, TIME_MS2I(SPIx_DMA_TIMEOUT_MS));
+	osalSysUnlock();
+
+	if(msg == MSG_TIMEOUT) {
+		dmaStreamDisable(dma->dma_tx);
+		dmaStreamDisable(dma->dma_rx);
+		dma->busy = FALSE;
+		spi_error(dev_num);
+		return BSP_TIMEOUT;
+	}
+	if(dma->status != BSP_OK)
+		spi_error(dev_num);
+
+	return dma->status;
+}
+
+/**
+  * @brief  Blocking DMA transfer.
+  * @param  dev_num: SPI dev num.
+  * @param  tx_data: Data to send, NULL to send 0xFF.
+  * @param  rx_data: Data to receive, NULL to drop received data.
+  * @param  nb_data: Number of data to send & receive.
+  * @retval status of the transfer.
+  */
+bsp_status_t bsp_spi_dma_xfer(bsp_dev_spi_t dev_num, const uint8_t* tx_data, uint8_t* rx_data, uint16_t nb_data)
+{
+	bsp_status_t status;
+
+	status = bsp_spi_dma_start(dev_num, tx_data, rx_data, nb_data, NULL, NULL);
+	if(status != BSP_OK)
+		return status;
+
+	return bsp_spi_dma_wait(dev_num);
+}
+
+/**
+  * @brief  Start a circular DMA reception, the received data is written in
+  *         a ring buffer until bsp_spi_dma_rx_circular_stop().
+  *         Used in slave mode, nothing is sent by the DMA.
+  * @param  dev_num: SPI dev num.
+  * @param  rx_data: Ring buffer.
+  * @param  nb_data: Ring buffer size.
+  * @retval BSP_OK if started, BSP_BUSY if a transfer is in progress,
+  *         BSP_ERROR if DMA is not available.
+  */
+bsp_status_t bsp_spi_dma_rx_circular_start(bsp_dev_spi_t dev_num, uint8_t* rx_data, uint16_t nb_data)
+{
+	t_spi_dma *dma = &spi_dma[dev_num];
+	SPI_TypeDef *spi = spi_handle[dev_num].Instance;
+
+	if(dma->dma_rx == NULL || nb_data == 0 || !SPIx_DMA_CAPABLE(rx_data))
+		return BSP_ERROR;
+	if(dma->busy)
+		return BSP_BUSY;
+
+	dma->busy = TRUE;
+	dma->circular = TRUE;
+	dma->ring_size = nb_data;
+	dma->laps = 0;
+	dma->last_count = 0;
+
+	/* Drop data and overrun flag left by previous transfers */
+	(void)spi->DR;
+	(void)spi->SR;
+
+	dmaStreamSetMemory0(dma->dma_rx, rx_data);
+	dmaStreamSetMode(dma->dma_rx, dma->mode_rx | STM32_DMA_CR_MINC | STM32_DMA_CR_CIRC);
+	dmaStreamSetTransactionSize(dma->dma_rx, nb_data);
+	dmaStreamEnable(dma->dma_rx);
+	spi->CR2 |= SPI_CR2_RXDMAEN;
+
+	return BSP_OK;
+}
+
+/**
+  * @brief  Number of bytes received since bsp_spi_dma_rx_circular_start().
+  *         Shall be called from a single thread, at least once per ring
+  *         buffer lap.
+  * @param  dev_num: SPI dev num.
+  * @retval Number of bytes, wraps at 2^32.
+  */
+uint32_t bsp_spi_dma_rx_circular_count(bsp_dev_spi_t dev_num)
+{
+	t_spi_dma *dma = &spi_dma[dev_num];
+	uint32_t laps, ndtr, count;
+
+	do {
+		laps = dma->laps;
+		ndtr = dmaStreamGetTransactionSize(dma->dma_rx);
+	} while(laps != dma->laps);
+
+	count = laps * dma->ring_size + (dma->ring_size - ndtr);
+	/* End of lap not yet counted by the ISR */
+	if((int32_t)(count - dma->last_count) < 0)
+		count += dma->ring_size;
+	dma->last_count = count;
+
+	return count;
+}
+
+/**
+  * @brief  Current write position in the ring buffer, can be called from ISR.
+  * @param  dev_num: SPI dev num.
+  * @retval Position, from 0 to ring size - 1.
+  */
+uint16_t bsp_spi_dma_rx_circular_pos(bsp_dev_spi_t dev_num)
+{
+	t_spi_dma *dma = &spi_dma[dev_num];
+
+	return (dma->ring_size - dmaStreamGetTransactionSize(dma->dma_rx)) % dma->ring_size;
+}
+
+/**
+  * @brief  Stop a circular DMA reception.
+  * @param  dev_num: SPI dev num.
+  */
+void bsp_spi_dma_rx_circular_stop(bsp_dev_spi_t dev_num)
+{
+	t_spi_dma *dma = &spi_dma[dev_num];
+	SPI_TypeDef *spi = spi_handle[dev_num].Instance;
+
+	if(!dma->circular)
+		return;
+
+	spi->CR2 &= ~SPI_CR2_RXDMAEN;
+	dmaStreamDisable(dma->dma_rx);
+	dma->circular = FALSE;
+	dma->busy = FALSE;
+}
+
 SPI_HandleTypeDef* bsp_spi_get_handle(bsp_dev_spi_t dev_num)
 {
 	SPI_HandleTypeDef* hspi;
@@ -32,9 +32,22 @@ void bsp_spi_unselect(bsp_dev_spi_t dev_num);
 uint8_t bsp_spi_get_cs(bsp_dev_spi_t dev_num);
 uint8_t bsp_spi_rxne(bsp_dev_spi_t dev_num);
 
-bsp_status_t bsp_spi_write_u8(bsp_dev_spi_t dev_num, uint8_t* tx_data, uint8_t nb_data);
-bsp_status_t bsp_spi_read_u8(bsp_dev_spi_t dev_num, uint8_t* rx_data, uint8_t nb_data);
-bsp_status_t bsp_spi_write_read_u8(bsp_dev_spi_t dev_num, uint8_t* tx_data, uint8_t* rx_data, uint8_t nb_data);
+bsp_status_t bsp_spi_write_u8(bsp_dev_spi_t dev_num, uint8_t* tx_data, uint16_t nb_data);
+bsp_status_t bsp_spi_read_u8(bsp_dev_spi_t dev_num, uint8_t* rx_data, uint16_t nb_data);
+bsp_status_t bsp_spi_write_read_u8(bsp_dev_spi_t dev_num, uint8_t* tx_data, uint8_t* rx_data, uint16_t nb_data);
+
+/* Called from the DMA ISR at the end of a bsp_spi_dma_start() transfer */
+typedef void (*bsp_spi_cb_t)(bsp_dev_spi_t dev_num, bsp_status_t status, void *arg);
+
+bsp_status_t bsp_spi_dma_start(bsp_dev_spi_t dev_num, const uint8_t* tx_data, uint8_t* rx_data,
+			       uint16_t nb_data, bsp_spi_cb_t cb, void *arg);
+bsp_status_t bsp_spi_dma_wait(bsp_dev_spi_t dev_num);
+bsp_status_t bsp_spi_dma_xfer(bsp_dev_spi_t dev_num, const uint8_t* tx_data, uint8_t* rx_data, uint16_t nb_data);
+
+bsp_status_t bsp_spi_dma_rx_circular_start(bsp_dev_spi_t dev_num, uint8_t* rx_data, uint16_t nb_data);
+uint32_t bsp_spi_dma_rx_circular_count(bsp_dev_spi_t dev_num);
+uint16_t bsp_spi_dma_rx_circular_pos(bsp_dev_spi_t dev_num);
+void bsp_spi_dma_rx_circular_stop(bsp_dev_spi_t dev_num);
 
 SPI_HandleTypeDef* bsp_spi_get_handle(bsp_dev_spi_t dev_num);
 
@@ -50,5 +50,17 @@ limitations under the License.
 #define BSP_SPI2_MOSI_PORT    GPIOC
 #define BSP_SPI2_MOSI_PIN     GPIO_PIN_3 /* PC.03 */
 
+/* DMA streams, same as the ChibiOS SPI driver (see common/mcuconf.h) */
+#define BSP_SPI1_RX_DMA_STREAM  STM32_SPI_SPI1_RX_DMA_STREAM
+#define BSP_SPI1_TX_DMA_STREAM  STM32_SPI_SPI1_TX_DMA_STREAM
+#define BSP_SPI1_RX_DMA_CHN     STM32_DMA_GETCHANNEL(STM32_SPI_SPI1_RX_DMA_STREAM, STM32_SPI1_RX_DMA_CHN)
+#define BSP_SPI1_TX_DMA_CHN     STM32_DMA_GETCHANNEL(STM32_SPI_SPI1_TX_DMA_STREAM, STM32_SPI1_TX_DMA_CHN)
+#define BSP_SPI2_RX_DMA_STREAM  STM32_SPI_SPI2_RX_DMA_STREAM
+#define BSP_SPI2_TX_DMA_STREAM  STM32_SPI_SPI2_TX_DMA_STREAM
+#define BSP_SPI2_RX_DMA_CHN     STM32_DMA_GETCHANNEL(STM32_SPI_SPI2_RX_DMA_STREAM, STM32_SPI2_RX_DMA_CHN)
+#define BSP_SPI2_TX_DMA_CHN     STM32_DMA_GETCHANNEL(STM32_SPI_SPI2_TX_DMA_STREAM, STM32_SPI2_TX_DMA_CHN)
+#define BSP_SPI_DMA_PRIORITY    (1)
+#define BSP_SPI_DMA_IRQ_PRIORITY (10)
+
 #endif /* _BSP_SPI_CONF_H_ */
 
@@ -13,12 +13,21 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 */
+#include "hal.h"
 #include "bsp_tim.h"
 #include "bsp_tim_conf.h"
 
 /* BSP_TIM */
 static TIM_HandleTypeDef bsp_htim;
 
+/* BSP_TIM_DMA */
+static const stm32_dma_stream_t *bsp_tim_dma;
+static uint32_t bsp_tim_dma_nb_samples;
+static uint32_t bsp_tim_dma_half; /* Double buffer mode half size, 0 if not used */
+
+/* TIM8 shared with FREQ1 */
+static bsp_tim8_owner_t bsp_tim8_owner;
+
 /** \brief Init & Start TIMER device.
  *
  * \param tim_period uint32_t: Specifies the period value to be loaded into the active, Auto-Reload Register at the next update event. This parameter can be a number between Min_Data = 0x0000 and Max_Data = 0xFFFF.
@@ -93,4 +102,164 @@ void bsp_tim_stop(void)
   HAL_TIM_Base_Stop(&bsp_htim);
 }
 
+/** \brief Sample a register to a circular buffer with DMA at each
+ * TIMER update, the CPU is not involved.
+ * Buffers longer than 65535 samples are split in two halves filled in
+ * double buffer mode.
+ *
+ * \param src volatile void*: register to sample, on AHB1/AHB2/APB2 (GPIOx->IDR)
+ * \param buf void*: circular buffer, not in CCM
+ * \param nb_samples uint32_t: buffer size in samples, 1 to 65535 or an even number up to 131070
+ * \param sample_size uint8_t: 1 (lower byte of src) or 2 bytes
+ * \param rate uint32_t: sample rate in Hz, rounded to a divider of the TIMER clock
+ * \return bsp_status_t: BSP_OK, or BSP_ERROR if TIM8 or the DMA stream is used by another driver
+ *
+ */
+bsp_status_t bsp_tim_dma_start(volatile void *src, void *buf, uint32_t nb_samples, uint8_t sample_size, uint32_t rate)
+{
+	const stm32_dma_stream_t *dma = STM32_DMA_STREAM(BSP_TIM_DMA_STREAM);
+	uint32_t ticks, prescaler, mode, half;
+
+	if(rate == 0 || nb_samples == 0)
+		return BSP_ERROR;
+	if(sample_size != 1 && sample_size != 2)
+		return BSP_ERROR;
+	half = 0;
+	if(nb_samples > 0xFFFF) {
+		if((nb_samples & 1) || nb_samples / 2 > 0xFFFF)
+			return BSP_ERROR;
+		half = nb_samples / 2;
+	}
+	if(bsp_tim8_acquire(BSP_TIM8_DMA) != BSP_OK)
+		return BSP_ERROR;
+	if(dmaStreamAllocate(dma, BSP_TIM_DMA_IRQ_PRIORITY, NULL, NULL)) {
+		bsp_tim8_release(BSP_TIM8_DMA);
+		return BSP_ERROR;
+	}
+
+	bsp_tim_dma = dma;
+	bsp_tim_dma_nb_samples = nb_samples;
+	bsp_tim_dma_half = half;
+
+	ticks = BSP_TIM_DMA_CLK / rate;
+	if(ticks < 2)
+		ticks = 2;
+	prescaler = ticks / 65536 + 1;
+
+	BSP_TIM_DMA_CLK_ENABLE();
+	BSP_TIM_DMA->CR1 = 0;
+	BSP_TIM_DMA->DIER = 0;
+	BSP_TIM_DMA->PSC = prescaler - 1;
+	BSP_TIM_DMA->ARR = ticks / prescaler - 1;
+	BSP_TIM_DMA->CNT = 0;
+	BSP_TIM_DMA->EGR = TIM_EGR_UG; /* load PSC */
+	BSP_TIM_DMA->SR = 0;
+
+	mode = STM32_DMA_CR_CHSEL(BSP_TIM_DMA_CHN) |
+	       STM32_DMA_CR_PL(BSP_TIM_DMA_PRIORITY) |
+	       STM32_DMA_CR_DIR_P2M | STM32_DMA_CR_MINC |
+	       STM32_DMA_CR_CIRC;
+	if(sample_size == 1)
+		mode |= STM32_DMA_CR_PSIZE_BYTE | STM32_DMA_CR_MSIZE_BYTE;
+	else
+		mode |= STM32_DMA_CR_PSIZE_HWORD | STM32_DMA_CR_MSIZE_HWORD;
+
+	dmaStreamSetPeripheral(dma, src);
+	dmaStreamSetMemory0(dma, buf);
+	if(half) {
+		dmaStreamSetMemory1(dma, (uint8_t *)buf + half * sample_size);
+		dmaStreamSetTransactionSize(dma, half);
+		mode |= STM32_DMA_CR_DBM;
+	} else {
+		dmaStreamSetTransactionSize(dma, nb_samples);
+	}
+	dmaStreamSetMode(dma, mode);
+	dmaStreamClearInterrupt(dma);
+	dmaStreamEnable(dma);
+
+	BSP_TIM_DMA->DIER = TIM_DIER_UDE;
+	BSP_TIM_DMA->CR1 = TIM_CR1_CEN;
+
+	return BSP_OK;
+}
+
+/** \brief Index of the next sample written by the DMA.
+ *
+ * \return uint32_t: 0 to nb_samples-1
+ *
+ */
+uint32_t bsp_tim_dma_pos(void)
+{
+	uint32_t pos, ct;
+
+	if(bsp_tim_dma_half) {
+		/* NDTR reloads when the current target switches */
+		do {
+			ct = bsp_tim_dma->stream->CR & STM32_DMA_CR_CT;
+			pos = bsp_tim_dma_half - dmaStreamGetTransactionSize(bsp_tim_dma);
+		} while(ct != (bsp_tim_dma->stream->CR & STM32_DMA_CR_CT));
+		if(ct)
+			pos += bsp_tim_dma_half;
+	} else {
+		pos = bsp_tim_dma_nb_samples - dmaStreamGetTransactionSize(bsp_tim_dma);
+	}
+	if(pos == bsp_tim_dma_nb_samples)
+		pos = 0;
+	return pos;
+}
+
+/** \brief Stop sampling and release the DMA stream.
+ *
+ * \return void
+ *
+ */
+void bsp_tim_dma_stop(void)
+{
+	if(bsp_tim_dma == NULL)
+		return;
+
+	BSP_TIM_DMA->CR1 = 0;
+	BSP_TIM_DMA->DIER = 0;
+	dmaStreamDisable(bsp_tim_dma);
+	dmaStreamRelease(bsp_tim_dma);
+	BSP_TIM_DMA_CLK_DISABLE();
+	bsp_tim_dma = NULL;
+	bsp_tim8_release(BSP_TIM8_DMA);
+}
+
+/** \brief Take TIM8 for the TIM DMA sampling or the FREQ1 input capture.
+ * The owner can take it again while it holds it.
+ *
+ * \param owner bsp_tim8_owner_t: BSP_TIM8_DMA or BSP_TIM8_FREQ
+ * \return bsp_status_t: BSP_OK, or BSP_ERROR if TIM8 is used by the other driver
+ *
+ */
+bsp_status_t bsp_tim8_acquire(bsp_tim8_owner_t owner)
+{
+	bsp_status_t status = BSP_ERROR;
+
+	chSysLock();
+	if(bsp_tim8_owner == BSP_TIM8_FREE || bsp_tim8_owner == owner) {
+		bsp_tim8_owner = owner;
+		status = BSP_OK;
+	}
+	chSysUnlock();
+
+	return status;
+}
+
+/** \brief Give TIM8 back, nothing is done if owner does not hold it.
+ *
+ * \param owner bsp_tim8_owner_t: BSP_TIM8_DMA or BSP_TIM8_FREQ
+ * \return void
+ *
+ */
+void bsp_tim8_release(bsp_tim8_owner_t owner)
+{
+	chSysLock();
+	if(bsp_tim8_owner == owner)
+		bsp_tim8_owner = BSP_TIM8_FREE;
+	chSysUnlock();
+}
+
 /* See bsp.h for other bsp_tim_xxx funtions defined as macro */
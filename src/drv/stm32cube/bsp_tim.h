@@ -59,3 +59,25 @@ void bsp_tim_start(void);
 
 /* Stop the TIM Base generation. */
 void bsp_tim_stop(void);
+
+/* Sample a 16bits register to a circular buffer with DMA at each update. */
+bsp_status_t bsp_tim_dma_start(volatile void *src, void *buf, uint32_t nb_samples, uint8_t sample_size, uint32_t rate);
+
+/* Index of the next sample written by the DMA. */
+uint32_t bsp_tim_dma_pos(void);
+
+/* Stop sampling and release the DMA stream. */
+void bsp_tim_dma_stop(void);
+
+/* TIM8 is shared by the TIM DMA sampling and the FREQ1 input capture */
+typedef enum {
+	BSP_TIM8_FREE = 0,
+	BSP_TIM8_DMA,
+	BSP_TIM8_FREQ
+} bsp_tim8_owner_t;
+
+/* Take TIM8 for owner, BSP_ERROR if it is used by the other driver. */
+bsp_status_t bsp_tim8_acquire(bsp_tim8_owner_t owner);
+
+/* Give TIM8 back if owner holds it. */
+void bsp_tim8_release(bsp_tim8_owner_t owner);
@@ -22,4 +22,17 @@ limitations under the License.
 #define BSP_TIM1_CLK_ENABLE  __TIM4_CLK_ENABLE
 #define BSP_TIM1_CLK_DISABLE  __TIM4_CLK_DISABLE
 
+/* TIM DMA, GPIO sampling: TIM8 update request on DMA2 stream 1 channel 7
+ * (only DMA2 can read the AHB1 GPIO registers, the TIM1 update request on
+ * DMA2 stream 5 is taken by SPI1 TX).
+ * TIM8 is also the FREQ1 timer (bsp_freq_conf.h), see bsp_tim8_acquire() */
+#define BSP_TIM_DMA             TIM8
+#define BSP_TIM_DMA_CLK         STM32_TIMCLK2
+#define BSP_TIM_DMA_CLK_ENABLE  __TIM8_CLK_ENABLE
+#define BSP_TIM_DMA_CLK_DISABLE __TIM8_CLK_DISABLE
+#define BSP_TIM_DMA_STREAM      STM32_DMA_STREAM_ID(2, 1)
+#define BSP_TIM_DMA_CHN         (7)
+#define BSP_TIM_DMA_PRIORITY    (3)
+#define BSP_TIM_DMA_IRQ_PRIORITY (6)
+
 #endif /* _BSP_TIM_CONF_H_ */
@@ -12,6 +12,7 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 */
+#include "hal.h"
 #include "bsp_uart.h"
 #include "bsp_uart_conf.h"
 
@@ -29,6 +30,28 @@ static UART_HandleTypeDef uart_handle[NB_UART];
 static mode_config_proto_t* uart_mode_conf[NB_UART];
 static volatile uint16_t dummy_read;
 
+/*
+ * DMA reception: the DMA writes to a circular buffer, new data is pushed
+ * to an input queue on half transfer, transfer complete and USART IDLE
+ * interrupts, so a chunk is handed to the reader as soon as the line is
+ * idle for one character.
+ */
+#define UARTx_RX_DMA_SIZE (512)
+#define UARTx_RX_QUEUE_SIZE (2048)
+
+typedef struct {
+	const stm32_dma_stream_t *dma;
+	uint32_t mode;
+	bool active;
+	uint16_t last;
+	volatile uint32_t lost;
+	input_queue_t iq;
+	uint8_t ring[UARTx_RX_DMA_SIZE];
+	uint8_t queue[UARTx_RX_QUEUE_SIZE];
+} t_uart_rx_dma;
+
+static t_uart_rx_dma uart_rx_dma[NB_UART];
+
 /**
   * @brief  Init low level hardware: GPIO, CLOCK, NVIC...
   * @param  dev_num: UART dev num
@@ -109,6 +132,98 @@ static void uart_gpio_hw_deinit(bsp_dev_uart_t dev_num)
 	}
 }
 
+/* Called from ISR context, pushes the new DMA data to the input queue */
+static void uart_rx_dma_process(t_uart_rx_dma *rx)
+{
+	uint16_t pos;
+
+	pos = UARTx_RX_DMA_SIZE - dmaStreamGetTransactionSize(rx->dma);
+	if(pos == UARTx_RX_DMA_SIZE)
+		pos = 0;
+
+	osalSysLockFromISR();
+	while(rx->last != pos) {
+		if(iqPutI(&rx->iq, rx->ring[rx->last]) != MSG_OK)
+			rx->lost++;
+		rx->last = (rx->last + 1) % UARTx_RX_DMA_SIZE;
+	}
+	osalSysUnlockFromISR();
+}
+
+static void uart_rx_dma_isr(void *p, uint32_t flags)
+{
+	(void)flags;
+	uart_rx_dma_process((t_uart_rx_dma *)p);
+}
+
+static void uart_rx_irq(bsp_dev_uart_t dev_num)
+{
+	USART_TypeDef *usart = uart_handle[dev_num].Instance;
+	uint32_t sr;
+
+	sr = usart->SR;
+	if((sr & (USART_SR_IDLE | USART_SR_ORE)) != 0) {
+		/* SR then DR read clears IDLE and ORE */
+		dummy_read = usart->DR;
+		if((sr & USART_SR_ORE) != 0)
+			uart_rx_dma[dev_num].lost++;
+		uart_rx_dma_process(&uart_rx_dma[dev_num]);
+	}
+}
+
+OSAL_IRQ_HANDLER(STM32_USART1_HANDLER)
+{
+	OSAL_IRQ_PROLOGUE();
+	uart_rx_irq(BSP_DEV_UART1);
+	OSAL_IRQ_EPILOGUE();
+}
+
+OSAL_IRQ_HANDLER(STM32_USART2_HANDLER)
+{
+	OSAL_IRQ_PROLOGUE();
+	uart_rx_irq(BSP_DEV_UART2);
+	OSAL_IRQ_EPILOGUE();
+}
+
+static void uart_rx_dma_hw_start(bsp_dev_uart_t dev_num)
+{
+	t_uart_rx_dma *rx = &uart_rx_dma[dev_num];
+	USART_TypeDef *usart = uart_handle[dev_num].Instance;
+
+	rx->last = 0;
+	dmaStreamSetPeripheral(rx->dma, &usart->DR);
+	dmaStreamSetMemory0(rx->dma, rx->ring);
+	dmaStreamSetTransactionSize(rx->dma, UARTx_RX_DMA_SIZE);
+	dmaStreamSetMode(rx->dma, rx->mode);
+	dmaStreamClearInterrupt(rx->dma);
+	dmaStreamEnable(rx->dma);
+
+	dummy_read = usart->SR;
+	dummy_read = usart->DR;
+	usart->CR3 |= USART_CR3_DMAR;
+	usart->CR1 |= USART_CR1_IDLEIE;
+
+	if(dev_num == BSP_DEV_UART1)
+		nvicEnableVector(STM32_USART1_NUMBER, BSP_UART_IRQ_PRIORITY);
+	else
+		nvicEnableVector(STM32_USART2_NUMBER, BSP_UART_IRQ_PRIORITY);
+}
+
+static void uart_rx_dma_hw_stop(bsp_dev_uart_t dev_num)
+{
+	t_uart_rx_dma *rx = &uart_rx_dma[dev_num];
+	USART_TypeDef *usart = uart_handle[dev_num].Instance;
+
+	if(dev_num == BSP_DEV_UART1)
+		nvicDisableVector(STM32_USART1_NUMBER);
+	else
+		nvicDisableVector(STM32_USART2_NUMBER);
+
+	usart->CR1 &= ~USART_CR1_IDLEIE;
+	usart->CR3 &= ~USART_CR3_DMAR;
+	dmaStreamDisable(rx->dma);
+}
+
 /**
   * @brief  UARTx error treatment function.
   * @param  dev_num: UART dev num
@@ -116,9 +231,13 @@ static void uart_gpio_hw_deinit(bsp_dev_uart_t dev_num)
   */
 static void uart_error(bsp_dev_uart_t dev_num)
 {
+	bool rx_dma = uart_rx_dma[dev_num].active;
+
 	if(bsp_uart_deinit(dev_num) == BSP_OK) {
 		/* Re-Initialize the UART comunication bus */
 		bsp_uart_init(dev_num, uart_mode_conf[dev_num]);
+		if(rx_dma)
+			bsp_uart_rx_dma_start(dev_num);
 	}
 }
 
@@ -136,6 +255,10 @@ bsp_status_t bsp_uart_init(bsp_dev_uart_t dev_num, mode_config_proto_t* mode_con
 	uart_mode_conf[dev_num] = mode_conf;
 	huart = &uart_handle[dev_num];
 
+	/* Speed change while receiving, restarted below */
+	if(uart_rx_dma[dev_num].active)
+		uart_rx_dma_hw_stop(dev_num);
+
 	uart_gpio_hw_init(dev_num);
 
 	__HAL_UART_RESET_HANDLE_STATE(huart);
@@ -191,6 +314,9 @@ bsp_status_t bsp_uart_init(bsp_dev_uart_t dev_num, mode_config_proto_t* mode_con
 	/* Dummy read to flush old character */
 	dummy_read = huart->Instance->DR;
 
+	if(uart_rx_dma[dev_num].active)
+		uart_rx_dma_hw_start(dev_num);
+
 	return status;
 }
 
@@ -224,6 +350,8 @@ bsp_status_t bsp_uart_deinit(bsp_dev_uart_t dev_num)
 
 	huart = &uart_handle[dev_num];
 
+	bsp_uart_rx_dma_stop(dev_num);
+
 	/* De-initialize the UART comunication bus */
 	status = (bsp_status_t) HAL_UART_DeInit(huart);
 
@@ -240,7 +368,7 @@ bsp_status_t bsp_uart_deinit(bsp_dev_uart_t dev_num)
   * @param  nb_data: Number of data to send.
   * @retval status of the transfer.
   */
-bsp_status_t bsp_uart_write_u8(bsp_dev_uart_t dev_num, uint8_t* tx_data, uint8_t nb_data)
+bsp_status_t bsp_uart_write_u8(bsp_dev_uart_t dev_num, uint8_t* tx_data, uint16_t nb_data)
 {
 	UART_HandleTypeDef* huart;
 	huart = &uart_handle[dev_num];
@@ -260,7 +388,7 @@ bsp_status_t bsp_uart_write_u8(bsp_dev_uart_t dev_num, uint8_t* tx_data, uint8_t
   * @param  nb_data: Number of data to receive.
   * @retval status of the transfer.
   */
-bsp_status_t bsp_uart_read_u8(bsp_dev_uart_t dev_num, uint8_t* rx_data, uint8_t nb_data)
+bsp_status_t bsp_uart_read_u8(bsp_dev_uart_t dev_num, uint8_t* rx_data, uint16_t nb_data)
 {
 	UART_HandleTypeDef* huart;
 	huart = &uart_handle[dev_num];
@@ -307,7 +435,7 @@ bsp_status_t bsp_uart_read_u8_timeout(bsp_dev_uart_t dev_num, uint8_t* rx_data,
   * @param  nb_data: Number of data to send & receive.
   * @retval status of the transfer.
   */
-bsp_status_t bsp_uart_write_read_u8(bsp_dev_uart_t dev_num, uint8_t* tx_data, uint8_t* rx_data, uint8_t nb_data)
+bsp_status_t bsp_uart_write_read_u8(bsp_dev_uart_t dev_num, uint8_t* tx_data, uint8_t* rx_data, uint16_t nb_data)
 {
 	UART_HandleTypeDef* huart;
 	huart = &uart_handle[dev_num];
@@ -334,6 +462,110 @@ bsp_status_t bsp_uart_rxne(bsp_dev_uart_t dev_num)
 	return __HAL_UART_GET_FLAG(huart, UART_FLAG_RXNE);
 }
 
+/**
+  * @brief  Start DMA reception, received data is read with bsp_uart_rx_dma_read().
+  *         The other read functions shall not be used until bsp_uart_rx_dma_stop().
+  * @param  dev_num: UART dev num.
+  * @retval BSP_OK, or BSP_ERROR if the DMA stream is used by another driver.
+  */
+bsp_status_t bsp_uart_rx_dma_start(bsp_dev_uart_t dev_num)
+{
+	t_uart_rx_dma *rx = &uart_rx_dma[dev_num];
+	const stm32_dma_stream_t *dma;
+	uint32_t chn;
+
+	if(rx->active)
+		return BSP_OK;
+
+	if(dev_num == BSP_DEV_UART1) {
+		dma = STM32_DMA_STREAM(BSP_UART1_RX_DMA_STREAM);
+		chn = BSP_UART1_RX_DMA_CHN;
+	} else { /* UART2 */
+		dma = STM32_DMA_STREAM(BSP_UART2_RX_DMA_STREAM);
+		chn = BSP_UART2_RX_DMA_CHN;
+	}
+
+	if(dmaStreamAllocate(dma, BSP_UART_IRQ_PRIORITY, uart_rx_dma_isr, rx))
+		return BSP_ERROR;
+
+	rx->dma = dma;
+	rx->mode = STM32_DMA_CR_CHSEL(chn) |
+		   STM32_DMA_CR_PL(BSP_UART_DMA_PRIORITY) |
+		   STM32_DMA_CR_PSIZE_BYTE | STM32_DMA_CR_MSIZE_BYTE |
+		   STM32_DMA_CR_DIR_P2M | STM32_DMA_CR_MINC | STM32_DMA_CR_CIRC |
+		   STM32_DMA_CR_HTIE | STM32_DMA_CR_TCIE;
+	rx->lost = 0;
+	iqObjectInit(&rx->iq, rx->queue, UARTx_RX_QUEUE_SIZE, NULL, NULL);
+	rx->active = TRUE;
+
+	uart_rx_dma_hw_start(dev_num);
+
+	return BSP_OK;
+}
+
+/**
+  * @brief  Stop DMA reception, data not read is dropped.
+  * @param  dev_num: UART dev num.
+  * @retval None
+  */
+void bsp_uart_rx_dma_stop(bsp_dev_uart_t dev_num)
+{
+	t_uart_rx_dma *rx = &uart_rx_dma[dev_num];
+
+	if(!rx->active)
+		return;
+
+	uart_rx_dma_hw_stop(dev_num);
+	dmaStreamRelease(rx->dma);
+	rx->active = FALSE;
+
+	osalSysLock();
+	iqResetI(&rx->iq);
+	osalOsRescheduleS();
+	osalSysUnlock();
+}
+
+/**
+  * @brief  Read the data received by DMA, waits for the first byte only.
+  * @param  dev_num: UART dev num.
+  * @param  rx_data: Data to receive.
+  * @param  nb_data: Maximum number of data to receive.
+  * @param  timeout: Number of ticks to wait for the first byte.
+  * @retval Number of bytes read.
+  */
+uint32_t bsp_uart_rx_dma_read(bsp_dev_uart_t dev_num, uint8_t* rx_data,
+			      uint32_t nb_data, uint32_t timeout)
+{
+	input_queue_t *iq = &uart_rx_dma[dev_num].iq;
+	uint32_t nb_read, avail;
+
+	if(!uart_rx_dma[dev_num].active || nb_data == 0)
+		return 0;
+
+	nb_read = iqReadTimeout(iq, rx_data, 1, timeout);
+	if(nb_read == 0)
+		return 0;
+
+	osalSysLock();
+	avail = iqGetFullI(iq);
+	osalSysUnlock();
+	if(avail > nb_data - 1)
+		avail = nb_data - 1;
+
+	return nb_read + iqReadTimeout(iq, rx_data + 1, avail, TIME_IMMEDIATE);
+}
+
+/**
+  * @brief  Number of bytes lost (input queue full or USART overrun) since
+  *         bsp_uart_rx_dma_start().
+  * @param  dev_num: UART dev num.
+  * @retval Number of bytes lost.
+  */
+uint32_t bsp_uart_rx_dma_lost(bsp_dev_uart_t dev_num)
+{
+	return uart_rx_dma[dev_num].lost;
+}
+
 /** \brief Return final baud rate configured for over8=0 or over8=1.
  *
  * \param dev_num bsp_dev_uart_t
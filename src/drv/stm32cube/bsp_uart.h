@@ -32,12 +32,17 @@ typedef enum {
 bsp_status_t bsp_uart_init(bsp_dev_uart_t dev_num, mode_config_proto_t* mode_conf);
 bsp_status_t bsp_uart_deinit(bsp_dev_uart_t dev_num);
 
-bsp_status_t bsp_uart_write_u8(bsp_dev_uart_t dev_num, uint8_t* tx_data, uint8_t nb_data);
-bsp_status_t bsp_uart_read_u8(bsp_dev_uart_t dev_num, uint8_t* rx_data, uint8_t nb_data);
+bsp_status_t bsp_uart_write_u8(bsp_dev_uart_t dev_num, uint8_t* tx_data, uint16_t nb_data);
+bsp_status_t bsp_uart_read_u8(bsp_dev_uart_t dev_num, uint8_t* rx_data, uint16_t nb_data);
 bsp_status_t bsp_uart_read_u8_timeout(bsp_dev_uart_t dev_num, uint8_t* rx_data, uint8_t nb_data, uint32_t timeout);
-bsp_status_t bsp_uart_write_read_u8(bsp_dev_uart_t dev_num, uint8_t* tx_data, uint8_t* rx_data, uint8_t nb_data);
+bsp_status_t bsp_uart_write_read_u8(bsp_dev_uart_t dev_num, uint8_t* tx_data, uint8_t* rx_data, uint16_t nb_data);
 bsp_status_t bsp_uart_rxne(bsp_dev_uart_t dev_num);
 
+bsp_status_t bsp_uart_rx_dma_start(bsp_dev_uart_t dev_num);
+void bsp_uart_rx_dma_stop(bsp_dev_uart_t dev_num);
+uint32_t bsp_uart_rx_dma_read(bsp_dev_uart_t dev_num, uint8_t* rx_data, uint32_t nb_data, uint32_t timeout);
+uint32_t bsp_uart_rx_dma_lost(bsp_dev_uart_t dev_num);
+
 uint32_t bsp_uart_get_final_baudrate(bsp_dev_uart_t dev_num);
 
 bsp_status_t bsp_lin_break(bsp_dev_uart_t dev_num);
@@ -38,4 +38,13 @@ limitations under the License.
 #define BSP_UART2_RX_PORT     GPIOA
 #define BSP_UART2_RX_PIN      GPIO_PIN_3 /* PA.03 */
 
+/* RX DMA streams, same as the ChibiOS UART driver (see common/mcuconf.h) */
+#define BSP_UART1_RX_DMA_STREAM  STM32_UART_USART1_RX_DMA_STREAM
+#define BSP_UART1_RX_DMA_CHN     STM32_DMA_GETCHANNEL(STM32_UART_USART1_RX_DMA_STREAM, STM32_USART1_RX_DMA_CHN)
+#define BSP_UART2_RX_DMA_STREAM  STM32_UART_USART2_RX_DMA_STREAM
+#define BSP_UART2_RX_DMA_CHN     STM32_DMA_GETCHANNEL(STM32_UART_USART2_RX_DMA_STREAM, STM32_USART2_RX_DMA_CHN)
+#define BSP_UART_DMA_PRIORITY    (1)
+/* USART and DMA IRQs shall have the same priority */
+#define BSP_UART_IRQ_PRIORITY    (10)
+
 #endif /* _BSP_UART_CONF_H_ */
@@ -0,0 +1,236 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host build: ATmega2560 serial programming interface, RESET is the SPI
+ * chip select. 256KB flash in 256 bytes pages (the upper 128KB through the
+ * extended address byte), 4KB EEPROM, fuses and lock bits.
+ * Each 4 bytes instruction answers in its last byte, the second and third
+ * bytes echo the previous ones. Writes keep RDY/BSY busy for a few polls,
+ * flash pages are programmed over the previous content (bits only cleared).
+ */
+
+#include <string.h>
+
+#include "ch.h"
+#include "bsp_host.h"
+
+#define FLASH_PAGE_SIZE		256
+#define EEPROM_SIZE		0x1000
+#define BUSY_POLLS		3
+
+#define NB_FUSES		4
+
+typedef struct {
+	bool reset; /* RESET low */
+	bool enabled;
+	uint32_t count; /* Bytes received since RESET low */
+	uint8_t frame[4];
+	uint8_t ext;
+	uint8_t busy;
+} t_avr;
+
+static const uint8_t signature[3] = { 0x1E, 0x98, 0x01 };
+static const uint8_t default_fuses[NB_FUSES] = { 0x62, 0x99, 0xFF, 0xFF };
+
+static uint8_t flash[HOST_AVR_FLASH_SIZE];
+static uint8_t page[FLASH_PAGE_SIZE];
+static uint8_t eeprom[EEPROM_SIZE];
+static uint8_t fuses[NB_FUSES];
+static t_avr avr;
+
+/* Byte address of the flash word in bytes 1 and 2 */
+static uint32_t flash_addr(void)
+{
+	uint32_t word;
+
+	word = (avr.ext << 16) | (avr.frame[1] << 8) | avr.frame[2];
+	return (word * 2) % HOST_AVR_FLASH_SIZE;
+}
+
+static uint16_t eeprom_addr(void)
+{
+	return ((avr.frame[1] << 8) | avr.frame[2]) % EEPROM_SIZE;
+}
+
+/* Fuse index of a read or write instruction, NB_FUSES if none */
+static uint8_t fuse_index(void)
+{
+	if (avr.frame[0] == 0x50 || avr.frame[0] == 0x58) {
+		switch ((avr.frame[0] << 8) | avr.frame[1]) {
+		case 0x5000: return 0;
+		case 0x5808: return 1;
+		case 0x5008: return 2;
+		case 0x5800: return 3;
+		}
+	} else if (avr.frame[0] == 0xAC) {
+		switch (avr.frame[1]) {
+		case 0xA0: return 0;
+		case 0xA8: return 1;
+		case 0xA4: return 2;
+		case 0xE0: return 3;
+		}
+	}
+	return NB_FUSES;
+}
+
+/* Last byte of the answer, from the first 3 bytes of the instruction */
+static uint8_t avr_out(void)
+{
+	uint8_t fuse;
+
+	if (avr.frame[0] == 0xAC && avr.frame[1] == 0x53)
+		return avr.frame[2];
+	if (!avr.enabled)
+		return 0xFF;
+
+	switch (avr.frame[0]) {
+	case 0xF0:
+		if (avr.busy == 0)
+			return 0x00;
+		avr.busy--;
+		return 0x01;
+	case 0x20:
+		return flash[flash_addr()];
+	case 0x28:
+		return flash[flash_addr() + 1];
+	case 0xA0:
+		return eeprom[eeprom_addr()];
+	case 0x30:
+		return (avr.frame[2] < 3) ? signature[avr.frame[2]] : 0xFF;
+	}
+	fuse = fuse_index();
+	if (avr.frame[0] != 0xAC && fuse < NB_FUSES)
+		return fuses[fuse];
+	return 0xFF;
+}
+
+/* Executes the complete instruction */
+static void avr_exec(void)
+{
+	uint32_t addr, i;
+	uint8_t fuse;
+
+	if (avr.frame[0] == 0xAC && avr.frame[1] == 0x53) {
+		avr.enabled = TRUE;
+		return;
+	}
+	if (!avr.enabled)
+		return;
+
+	switch (avr.frame[0]) {
+	case 0x40:
+	case 0x48:
+		addr = ((avr.frame[2] * 2) % FLASH_PAGE_SIZE) + (avr.frame[0] == 0x48);
+		page[addr] = avr.frame[3];
+		return;
+	case 0x4C:
+		addr = flash_addr() & ~(FLASH_PAGE_SIZE - 1);
+		for (i = 0; i < FLASH_PAGE_SIZE; i++)
+			flash[addr + i] &= page[i];
+		memset(page, 0xFF, sizeof(page));
+		avr.busy = BUSY_POLLS;
+		return;
+	case 0x4D:
+		avr.ext = avr.frame[2];
+		return;
+	case 0xC0:
+		eeprom[eeprom_addr()] = avr.frame[3];
+		avr.busy = BUSY_POLLS;
+		return;
+	case 0xAC:
+		if (avr.frame[1] == 0x80) {
+			memset(flash, 0xFF, sizeof(flash));
+			memset(eeprom, 0xFF, sizeof(eeprom));
+			avr.busy = BUSY_POLLS;
+			return;
+		}
+		fuse = fuse_index();
+		if (fuse < NB_FUSES) {
+			fuses[fuse] = avr.frame[3];
+			avr.busy = BUSY_POLLS;
+		}
+		return;
+	}
+}
+
+static uint8_t avr_in(uint8_t val)
+{
+	uint8_t pos, out;
+
+	if (!avr.reset)
+		return 0xFF;
+
+	pos = avr.count++ % 4;
+	avr.frame[pos] = val;
+	switch (pos) {
+	case 0:
+		return 0xFF;
+	case 1:
+	case 2:
+		return avr.frame[pos - 1];
+	default:
+		out = avr_out();
+		avr_exec();
+		return out;
+	}
+}
+
+/* RESET high leaves the programming mode */
+static void avr_select(bool selected)
+{
+	avr.reset = selected;
+	avr.count = 0;
+	if (!selected) {
+		avr.enabled = FALSE;
+		avr.ext = 0;
+	}
+}
+
+static void avr_xfer(const uint8_t *tx_data, uint8_t *rx_data, uint16_t nb_data)
+{
+	uint8_t val;
+	uint16_t i;
+
+	for (i = 0; i < nb_data; i++) {
+		val = avr_in(tx_data != NULL ? tx_data[i] : 0xFF);
+		if (rx_data != NULL)
+			rx_data[i] = val;
+	}
+}
+
+static const t_bsp_host_spi_dev avr_dev = {
+	.select = avr_select,
+	.xfer = avr_xfer,
+};
+
+/* Erased device with its factory fuses */
+void host_avr_attach(bsp_dev_spi_t dev_num)
+{
+	memset(flash, 0xFF, sizeof(flash));
+	memset(page, 0xFF, sizeof(page));
+	memset(eeprom, 0xFF, sizeof(eeprom));
+	memcpy(fuses, default_fuses, sizeof(fuses));
+	memset(&avr, 0, sizeof(avr));
+	bsp_host_spi_attach(dev_num, &avr_dev);
+}
+
+uint8_t host_avr_flash_data(uint32_t addr)
+{
+	return flash[addr % HOST_AVR_FLASH_SIZE];
+}
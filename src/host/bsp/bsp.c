@@ -0,0 +1,127 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host build: bsp.c without the interrupt masking, the cycle counter is
+ * run by the host tick (see host/hal.c). There is no USB DFU.
+ */
+
+#include <sched.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "bsp.h"
+#include "bsp_host.h"
+
+static volatile uint64_t cyclecounter64 = 0;
+static t_bsp_host_stats stats;
+
+void bsp_scs_dwt_cycle_counter_enabled(void)
+{
+	SCS_DEMCR |= SCS_DEMCR_TRCENA;
+	DWT_CTRL  |= DWT_CTRL_CYCCNTENA;
+}
+
+uint64_t bsp_get_cyclecounter64(void)
+{
+	uint64_t r;
+
+	chSysLock();
+	r = bsp_get_cyclecounter64I();
+	chSysUnlock();
+
+	return r;
+}
+
+uint64_t bsp_get_cyclecounter64I(void)
+{
+	cyclecounter64 += DWTBase->CYCCNT - (uint32_t)(cyclecounter64);
+	return cyclecounter64;
+}
+
+/*
+ * Polled in busy loops until a timeout, which interrupts preempt on the
+ * target: the threads standing for the hardware get the CPU meanwhile.
+ */
+uint32_t HAL_GetTick(void)
+{
+	sched_yield();
+	return osalOsGetSystemTimeX();
+}
+
+uint32_t HAL_RCC_GetPCLK1Freq(void)
+{
+	return 42000000;
+}
+
+uint32_t HAL_RCC_GetPCLK2Freq(void)
+{
+	return 84000000;
+}
+
+bool delay_is_expired(bool start, uint32_t wait_nb_cycles)
+{
+	if(start == TRUE) {
+		bsp_clear_cyclecounter();
+	} else {
+		if(bsp_get_cyclecounter() >= (wait_nb_cycles-10))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+void wait_delay(uint32_t wait_nb_cycles)
+{
+	osalSysPolledDelayX(wait_nb_cycles);
+}
+
+uint32_t bsp_get_apb1_freq(void)
+{
+	return 42000000;
+}
+
+void bsp_enter_usb_dfu(void)
+{
+}
+
+void bsp_host_count(bsp_host_driver_t drv, uint32_t nb_data)
+{
+	__atomic_add_fetch(&stats.calls[drv], 1, __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&stats.bytes[drv], nb_data, __ATOMIC_SEQ_CST);
+}
+
+void bsp_host_get_stats(t_bsp_host_stats *st)
+{
+	int i;
+
+	for(i = 0; i < BSP_HOST_NB_DRIVERS; i++) {
+		st->calls[i] = __atomic_load_n(&stats.calls[i], __ATOMIC_SEQ_CST);
+		st->bytes[i] = __atomic_load_n(&stats.bytes[i], __ATOMIC_SEQ_CST);
+	}
+}
+
+void bsp_host_reset_stats(void)
+{
+	int i;
+
+	for(i = 0; i < BSP_HOST_NB_DRIVERS; i++) {
+		__atomic_store_n(&stats.calls[i], 0, __ATOMIC_SEQ_CST);
+		__atomic_store_n(&stats.bytes[i], 0, __ATOMIC_SEQ_CST);
+	}
+}
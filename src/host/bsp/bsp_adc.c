@@ -0,0 +1,97 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Host build: ADC mock.
+ * ADC1 (PA1) reads a ramp over the full 12bits range, the internal
+ * channels read fixed values (25 degC, 1.21V VREFINT, 3V VBAT).
+ */
+
+#include "ch.h"
+#include "hal.h"
+#include "common.h"
+#include "bsp_adc.h"
+#include "bsp_trigger.h"
+
+#define ADC_RAMP_STEP (16)
+
+static uint16_t adc_ramp;
+
+static uint16_t adc_convert(bsp_dev_adc_t dev_num)
+{
+	switch(dev_num) {
+	case BSP_DEV_ADC_TEMPSENSOR:
+		return 943;
+	case BSP_DEV_ADC_VREFINT:
+		return 1502;
+	case BSP_DEV_ADC_VBAT:
+		return 1861;
+	case BSP_DEV_ADC1:
+	default:
+		adc_ramp = (adc_ramp + ADC_RAMP_STEP) & 0xFFF;
+		return adc_ramp;
+	}
+}
+
+bsp_status_t bsp_adc_init(bsp_dev_adc_t dev_num)
+{
+	(void)dev_num;
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_adc_deinit(bsp_dev_adc_t dev_num)
+{
+	(void)dev_num;
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_adc_read_u16(bsp_dev_adc_t dev_num, uint16_t* rx_data, uint8_t nb_data)
+{
+	int i;
+
+	if(nb_data == 0)
+		return BSP_ERROR;
+
+	for(i=0; i<nb_data; i++)
+		rx_data[i] = adc_convert(dev_num);
+
+	return BSP_OK;
+}
+
+/* The analog watchdog fires when a conversion is outside [low, high] */
+bsp_status_t bsp_adc_trigger(uint32_t low, uint32_t high, uint32_t delay)
+{
+	uint16_t value;
+	uint32_t i;
+
+	bsp_trigger_init();
+	bsp_trigger_off();
+	for(i = 0; i < 0x1000 / ADC_RAMP_STEP; i++) {
+		value = adc_convert(BSP_DEV_ADC1);
+		if(value < low || value > high) {
+			DelayUs(delay);
+			bsp_trigger_on();
+			return BSP_OK;
+		}
+	}
+
+	return BSP_TIMEOUT;
+}
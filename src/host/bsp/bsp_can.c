@@ -0,0 +1,206 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host build: CAN mock in loopback mode.
+ * Every frame written is received back by the same controller, the
+ * filters accept everything. The bit timing register is only recorded.
+ */
+
+#include <string.h>
+#include "ch.h"
+#include "hal.h"
+#include "bsp_can.h"
+
+#define CANx_TIMEOUT_MAX (100000)
+#define CANx_RX_FIFO_SIZE (3)
+
+#define CAN_BTR_TIMING_MASK (0x37f0000)
+
+typedef struct {
+	semaphore_t full;
+	uint32_t wr;
+	uint32_t rd;
+	uint32_t btr;
+	can_rx_frame fifo[CANx_RX_FIFO_SIZE];
+} t_can_loop;
+
+static t_can_loop can_loop[BSP_DEV_CAN_END];
+
+bsp_status_t bsp_can_set_speed(bsp_dev_can_t dev_num, uint32_t speed)
+{
+	t_can_loop *loop = &can_loop[dev_num];
+
+	if(speed == 0 || speed > 2000000)
+		return BSP_ERROR;
+
+	loop->btr = (loop->btr & CAN_BTR_TIMING_MASK) | (2000000/speed - 1);
+
+	return BSP_OK;
+}
+
+uint32_t bsp_can_get_speed(bsp_dev_can_t dev_num)
+{
+	return 2000000/((can_loop[dev_num].btr & 0x3ff) + 1);
+}
+
+bsp_status_t bsp_can_set_timings(bsp_dev_can_t dev_num, mode_config_proto_t* mode_conf)
+{
+	t_can_loop *loop = &can_loop[dev_num];
+
+	loop->btr = (loop->btr & ~CAN_BTR_TIMING_MASK) |
+		    (mode_conf->config.can.dev_timing & CAN_BTR_TIMING_MASK);
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_can_set_ts1(bsp_dev_can_t dev_num, mode_config_proto_t* mode_conf, uint8_t ts1)
+{
+	t_can_loop *loop = &can_loop[dev_num];
+
+	loop->btr = (loop->btr & ~0xf0000) | (((uint32_t)(ts1-1)<<16) & 0xf0000);
+	mode_conf->config.can.dev_timing = bsp_can_get_timings(dev_num);
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_can_set_ts2(bsp_dev_can_t dev_num, mode_config_proto_t* mode_conf, uint8_t ts2)
+{
+	t_can_loop *loop = &can_loop[dev_num];
+
+	loop->btr = (loop->btr & ~0x700000) | (((uint32_t)(ts2-1)<<20) & 0x700000);
+	mode_conf->config.can.dev_timing = bsp_can_get_timings(dev_num);
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_can_set_sjw(bsp_dev_can_t dev_num, mode_config_proto_t* mode_conf, uint8_t sjw)
+{
+	t_can_loop *loop = &can_loop[dev_num];
+
+	loop->btr = (loop->btr & ~0x3000000) | (((uint32_t)(sjw-1)<<24) & 0x3000000);
+	mode_conf->config.can.dev_timing = bsp_can_get_timings(dev_num);
+
+	return BSP_OK;
+}
+
+uint32_t bsp_can_get_timings(bsp_dev_can_t dev_num)
+{
+	return can_loop[dev_num].btr;
+}
+
+bsp_status_t bsp_can_mode_rw(bsp_dev_can_t dev_num, mode_config_proto_t* mode_conf)
+{
+	(void)dev_num;
+
+	mode_conf->config.can.dev_mode = BSP_CAN_MODE_RW;
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_can_init(bsp_dev_can_t dev_num, mode_config_proto_t* mode_conf)
+{
+	t_can_loop *loop = &can_loop[dev_num];
+
+	memset(loop, 0, sizeof(t_can_loop));
+	chSemObjectInit(&loop->full, 0);
+	loop->btr = mode_conf->config.can.dev_timing & CAN_BTR_TIMING_MASK;
+
+	return bsp_can_set_speed(dev_num, mode_conf->config.can.dev_speed);
+}
+
+bsp_status_t bsp_can_init_filter(bsp_dev_can_t dev_num, mode_config_proto_t* mode_conf)
+{
+	(void)dev_num;
+	(void)mode_conf;
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_can_set_filter(bsp_dev_can_t dev_num,
+				mode_config_proto_t* mode_conf,
+				uint32_t id_low, uint32_t id_high)
+{
+	(void)dev_num;
+	(void)mode_conf;
+	(void)id_low;
+	(void)id_high;
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_can_deinit(bsp_dev_can_t dev_num)
+{
+	(void)dev_num;
+
+	return BSP_OK;
+}
+
+/* The frame is lost when the receive FIFO is full, as with a real FIFO0 */
+bsp_status_t bsp_can_write(bsp_dev_can_t dev_num, can_tx_frame* tx_msg)
+{
+	t_can_loop *loop = &can_loop[dev_num];
+	can_rx_frame *rx_msg;
+
+	if(tx_msg->header.DLC > 8)
+		return BSP_ERROR;
+
+	chSysLock();
+	if(loop->wr - loop->rd >= CANx_RX_FIFO_SIZE) {
+		chSysUnlock();
+		return BSP_OK;
+	}
+	rx_msg = &loop->fifo[loop->wr++ % CANx_RX_FIFO_SIZE];
+	memset(rx_msg, 0, sizeof(can_rx_frame));
+	rx_msg->header.StdId = tx_msg->header.StdId;
+	rx_msg->header.ExtId = tx_msg->header.ExtId;
+	rx_msg->header.IDE = tx_msg->header.IDE;
+	rx_msg->header.RTR = tx_msg->header.RTR;
+	rx_msg->header.DLC = tx_msg->header.DLC;
+	memcpy(rx_msg->data, tx_msg->data, tx_msg->header.DLC);
+	chSysUnlock();
+	chSemSignal(&loop->full);
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_can_read(bsp_dev_can_t dev_num, can_rx_frame* rx_msg)
+{
+	t_can_loop *loop = &can_loop[dev_num];
+
+	if(chSemWaitTimeout(&loop->full, CANx_TIMEOUT_MAX) != MSG_OK)
+		return BSP_TIMEOUT;
+
+	chSysLock();
+	*rx_msg = loop->fifo[loop->rd++ % CANx_RX_FIFO_SIZE];
+	chSysUnlock();
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_can_rxne(bsp_dev_can_t dev_num)
+{
+	t_can_loop *loop = &can_loop[dev_num];
+	uint32_t level;
+
+	chSysLock();
+	level = loop->wr - loop->rd;
+	chSysUnlock();
+
+	return level;
+}
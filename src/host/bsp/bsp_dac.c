@@ -0,0 +1,66 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Host build: DAC mock, the output is not generated.
+ */
+
+#include "bsp_dac.h"
+
+bsp_status_t bsp_dac_init(bsp_dev_dac_t dev_num)
+{
+	(void)dev_num;
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_dac_deinit(bsp_dev_dac_t dev_num)
+{
+	(void)dev_num;
+
+	return BSP_OK;
+}
+
+void bsp_dac_disable(void)
+{
+}
+
+bsp_status_t bsp_dac_write_u12(bsp_dev_dac_t dev_num, uint16_t data)
+{
+	(void)dev_num;
+
+	if(data > 0xFFF)
+		return BSP_ERROR;
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_dac_triangle(bsp_dev_dac_t dev_num)
+{
+	(void)dev_num;
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_dac_noise(bsp_dev_dac_t dev_num)
+{
+	(void)dev_num;
+
+	return BSP_OK;
+}
@@ -0,0 +1,71 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Host build: frequency counter mock, no signal is present on the input
+ * so sampling times out. TIM8 is taken as on the target.
+ */
+
+#include "bsp_freq.h"
+#include "bsp_tim.h"
+
+bsp_status_t bsp_freq_init(bsp_dev_freq_t dev_num, uint16_t scale)
+{
+	(void)scale;
+
+	bsp_freq_deinit(dev_num);
+
+	return bsp_tim8_acquire(BSP_TIM8_FREQ);
+}
+
+bsp_status_t bsp_freq_deinit(bsp_dev_freq_t dev_num)
+{
+	(void)dev_num;
+
+	if(bsp_tim8_acquire(BSP_TIM8_FREQ) != BSP_OK)
+		return BSP_ERROR;
+	bsp_tim8_release(BSP_TIM8_FREQ);
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_freq_sample(bsp_dev_freq_t dev_num)
+{
+	(void)dev_num;
+
+	return BSP_TIMEOUT;
+}
+
+uint32_t bsp_freq_getchannel(bsp_dev_freq_t dev_num, uint8_t channel)
+{
+	(void)dev_num;
+	(void)channel;
+
+	return 0;
+}
+
+uint8_t bsp_freq_get_values(bsp_dev_freq_t dev_num, uint32_t *freq, uint32_t *duty)
+{
+	*freq = 0;
+	*duty = 0;
+
+	if(bsp_freq_init(dev_num, 1) != BSP_OK)
+		return FALSE;
+	return (bsp_freq_sample(dev_num) == BSP_OK);
+}
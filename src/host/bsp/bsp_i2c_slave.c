@@ -0,0 +1,117 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Host build: I2C slave mock, the bus stays idle.
+ * The sniffer records no event and no master ever addresses the slave.
+ */
+
+#include "bsp_i2c_slave.h"
+
+typedef struct {
+	uint32_t head;
+	uint32_t tail;
+} t_i2c_sniff_ring;
+
+static t_i2c_sniff_ring sniff_ring;
+
+bsp_status_t bsp_i2c_slave_init(bsp_dev_i2c_t dev_num, mode_config_proto_t* mode_conf)
+{
+	(void)dev_num;
+	(void)mode_conf;
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_i2c_slave_deinit(bsp_dev_i2c_t dev_num)
+{
+	(void)dev_num;
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_i2c_slave_sniff_start(bsp_dev_i2c_t dev_num, uint32_t *ring,
+				       uint32_t len, uint8_t *lines)
+{
+	(void)dev_num;
+	(void)ring;
+
+	if(len == 0 || (len & (len - 1)) != 0)
+		return BSP_ERROR;
+
+	sniff_ring.head = 0;
+	sniff_ring.tail = 0;
+	/* SDA (bit 1) and SCL (bit 0) are pulled up */
+	*lines = 0x3;
+
+	return BSP_OK;
+}
+
+void bsp_i2c_slave_sniff_stop(bsp_dev_i2c_t dev_num)
+{
+	(void)dev_num;
+}
+
+uint32_t bsp_i2c_slave_sniff_count(bsp_dev_i2c_t dev_num)
+{
+	(void)dev_num;
+
+	return sniff_ring.head;
+}
+
+void bsp_i2c_slave_sniff_release(bsp_dev_i2c_t dev_num, uint32_t count)
+{
+	(void)dev_num;
+
+	sniff_ring.tail = count;
+}
+
+uint32_t bsp_i2c_slave_sniff_lost(bsp_dev_i2c_t dev_num)
+{
+	(void)dev_num;
+
+	return 0;
+}
+
+bsp_status_t bsp_i2c_slave_listen_start(bsp_dev_i2c_t dev_num,
+					mode_config_proto_t* mode_conf,
+					uint8_t addr,
+					const bsp_i2c_slave_cb_t *cb)
+{
+	(void)dev_num;
+	(void)mode_conf;
+	(void)cb;
+
+	if(addr > 0x7F)
+		return BSP_ERROR;
+
+	return BSP_OK;
+}
+
+void bsp_i2c_slave_listen_stop(bsp_dev_i2c_t dev_num)
+{
+	(void)dev_num;
+}
+
+uint32_t bsp_i2c_slave_listen_errors(bsp_dev_i2c_t dev_num)
+{
+	(void)dev_num;
+
+	return 0;
+}
@@ -0,0 +1,69 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Host build: PWM mock, the frequency and duty cycle are only recorded.
+ */
+
+#include "bsp_pwm.h"
+
+typedef struct {
+	uint32_t frequency;
+	uint32_t duty_cycle_percent;
+} t_pwm_state;
+
+static t_pwm_state pwm_state[BSP_DEV_PWM_END];
+
+bsp_status_t bsp_pwm_init(bsp_dev_pwm_t dev_num)
+{
+	pwm_state[dev_num].frequency = 0;
+	pwm_state[dev_num].duty_cycle_percent = 0;
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_pwm_deinit(bsp_dev_pwm_t dev_num)
+{
+	(void)dev_num;
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_pwm_update(bsp_dev_pwm_t dev_num, uint32_t frequency, uint32_t duty_cycle_percent)
+{
+	if(frequency < 1)
+		return BSP_ERROR;
+
+	if(frequency > bsp_get_apb1_freq())
+		return BSP_ERROR;
+
+	if(duty_cycle_percent > 100)
+		return BSP_ERROR;
+
+	pwm_state[dev_num].frequency = frequency;
+	pwm_state[dev_num].duty_cycle_percent = duty_cycle_percent;
+
+	return BSP_OK;
+}
+
+void bsp_pwm_get(bsp_dev_pwm_t dev_num, uint32_t* frequency, uint32_t* duty_cycle_percent)
+{
+	*frequency = pwm_state[dev_num].frequency;
+	*duty_cycle_percent = pwm_state[dev_num].duty_cycle_percent;
+}
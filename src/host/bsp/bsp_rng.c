@@ -0,0 +1,40 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Host build: RNG mock, the numbers come from the host random generator.
+ */
+
+#include <stdlib.h>
+#include "bsp_rng.h"
+
+bsp_status_t bsp_rng_init(void)
+{
+	return BSP_OK;
+}
+
+bsp_status_t bsp_rng_deinit(void)
+{
+	return BSP_OK;
+}
+
+uint32_t bsp_rng_read(void)
+{
+	return ((uint32_t)random() << 16) ^ (uint32_t)random();
+}
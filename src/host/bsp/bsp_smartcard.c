@@ -0,0 +1,135 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Host build: smartcard mock, no card is inserted.
+ * Writes succeed, reads time out, RST and VCC are only recorded.
+ */
+
+#include "ch.h"
+#include "hal.h"
+#include "bsp_smartcard.h"
+
+typedef struct {
+	uint32_t speed;
+	uint32_t prescaler;
+	uint8_t rst;
+	uint8_t vcc;
+} t_smartcard_state;
+
+static t_smartcard_state smartcard_state[BSP_DEV_SMARTCARD_END];
+
+bsp_status_t bsp_smartcard_init(bsp_dev_smartcard_t dev_num, mode_config_proto_t* mode_conf)
+{
+	smartcard_state[dev_num].speed = mode_conf->config.smartcard.dev_speed;
+	smartcard_state[dev_num].prescaler = mode_conf->config.smartcard.dev_prescaler;
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_smartcard_deinit(bsp_dev_smartcard_t dev_num)
+{
+	smartcard_state[dev_num].rst = 0;
+	smartcard_state[dev_num].vcc = 0;
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_smartcard_write_u8(bsp_dev_smartcard_t dev_num, uint8_t* tx_data, uint8_t nb_data)
+{
+	(void)dev_num;
+	(void)tx_data;
+	(void)nb_data;
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_smartcard_read_u8(bsp_dev_smartcard_t dev_num, uint8_t* rx_data, uint8_t nb_data)
+{
+	(void)dev_num;
+	(void)rx_data;
+	(void)nb_data;
+
+	return BSP_TIMEOUT;
+}
+
+bsp_status_t bsp_smartcard_read_u8_timeout(bsp_dev_smartcard_t dev_num, uint8_t* rx_data, uint8_t nb_data, uint32_t timeout)
+{
+	(void)dev_num;
+	(void)rx_data;
+
+	if(nb_data > 0)
+		chThdSleep(timeout);
+
+	return BSP_TIMEOUT;
+}
+
+bsp_status_t bsp_smartcard_write_read_u8(bsp_dev_smartcard_t dev_num, uint8_t* tx_data, uint8_t* rx_data, uint8_t nb_data)
+{
+	(void)tx_data;
+
+	return bsp_smartcard_read_u8(dev_num, rx_data, nb_data);
+}
+
+bsp_status_t bsp_smartcard_rxne(bsp_dev_smartcard_t dev_num)
+{
+	(void)dev_num;
+
+	return 0;
+}
+
+uint32_t bsp_smartcard_get_final_baudrate(bsp_dev_smartcard_t dev_num)
+{
+	return smartcard_state[dev_num].speed;
+}
+
+uint8_t bsp_smartcard_get_cd(bsp_dev_smartcard_t dev_num)
+{
+	(void)dev_num;
+
+	return 0;
+}
+
+uint8_t bsp_smartcard_get_rst(bsp_dev_smartcard_t dev_num)
+{
+	return smartcard_state[dev_num].rst;
+}
+
+void bsp_smartcard_set_rst(bsp_dev_smartcard_t dev_num, uint8_t state)
+{
+	smartcard_state[dev_num].rst = state;
+}
+
+uint8_t bsp_smartcard_get_vcc(bsp_dev_smartcard_t dev_num)
+{
+	return smartcard_state[dev_num].vcc;
+}
+
+void bsp_smartcard_set_vcc(bsp_dev_smartcard_t dev_num, uint8_t state)
+{
+	smartcard_state[dev_num].vcc = state;
+}
+
+float bsp_smartcard_get_clk_frequency(bsp_dev_smartcard_t dev_num)
+{
+	if(smartcard_state[dev_num].prescaler == 0)
+		return 0;
+
+	return HAL_RCC_GetPCLK2Freq() / (smartcard_state[dev_num].prescaler * 2);
+}
@@ -0,0 +1,363 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host build: SPI mock, MISO is wired to MOSI unless a device model is
+ * attached (see bsp_host_spi_attach()).
+ * Chip select is a real GPIO, data is received in slave (circular) mode
+ * when a test sends it with bsp_host_spi_circular_rx(). As on the target, master transfers of SPIx_DMA_MIN_SIZE bytes or
+ * more go through the DMA, which is run by a thread taking the time of
+ * the transfer at SPIx_HOST_BITRATE before it copies the data and calls
+ * the end of transfer callback. Transfers are counted, see bsp_host.h.
+ */
+
+#include <string.h>
+#include "ch.h"
+#include "hal.h"
+#include "bsp_spi.h"
+#include "bsp_spi_conf.h"
+#include "bsp_host.h"
+
+#define SPIx_DMA_MIN_SIZE (16)
+#define SPIx_DMA_TIMEOUT_MS (10000)
+#define SPIx_HOST_BITRATE (42000000)
+
+typedef struct {
+	bsp_dev_spi_t dev_num;
+	thread_t *thread;
+	semaphore_t start;
+	binary_semaphore_t done;
+	volatile bool busy;
+	bool circular;
+	bool fail;
+	bsp_status_t status;
+	const uint8_t *tx_data;
+	uint8_t *rx_data;
+	uint16_t nb_data;
+	bsp_spi_cb_t cb;
+	void *cb_arg;
+	/* Circular reception */
+	uint8_t *ring;
+	uint16_t ring_size;
+	volatile uint32_t count;
+} t_spi_dma;
+
+static SPI_HandleTypeDef spi_handle[BSP_DEV_SPI_END];
+static t_spi_dma spi_dma[BSP_DEV_SPI_END];
+static const t_bsp_host_spi_dev *spi_dev[BSP_DEV_SPI_END];
+
+static GPIO_TypeDef *spi_nss_port(bsp_dev_spi_t dev_num)
+{
+	if(dev_num == BSP_DEV_SPI1)
+		return (GPIO_TypeDef *)BSP_SPI1_NSS_PORT;
+	return (GPIO_TypeDef *)BSP_SPI2_NSS_PORT;
+}
+
+static uint16_t spi_nss_pin(bsp_dev_spi_t dev_num)
+{
+	if(dev_num == BSP_DEV_SPI1)
+		return BSP_SPI1_NSS_PIN;
+	return BSP_SPI2_NSS_PIN;
+}
+
+/* Data on the wire, 0xFF is sent when there is no TX data */
+static void spi_loop(bsp_dev_spi_t dev_num, const uint8_t* tx_data,
+		     uint8_t* rx_data, uint16_t nb_data)
+{
+	if(spi_dev[dev_num] != NULL) {
+		spi_dev[dev_num]->xfer(tx_data, rx_data, nb_data);
+		return;
+	}
+	if(rx_data == NULL)
+		return;
+	if(tx_data != NULL)
+		memmove(rx_data, tx_data, nb_data);
+	else
+		memset(rx_data, 0xFF, nb_data);
+}
+
+/* Stands for the DMA streams and their ISR */
+static THD_FUNCTION(spi_dma_thread, arg)
+{
+	t_spi_dma *dma = (t_spi_dma *)arg;
+	bsp_status_t status;
+
+	chRegSetThreadName("spi_dma");
+	while(TRUE) {
+		chSemWait(&dma->start);
+		chThdSleepMicroseconds(((uint64_t)dma->nb_data * 8 * 1000000 +
+					SPIx_HOST_BITRATE - 1) / SPIx_HOST_BITRATE);
+
+		status = BSP_OK;
+		if(dma->fail) {
+			dma->fail = FALSE;
+			status = BSP_ERROR;
+		} else {
+			spi_loop(dma->dev_num, dma->tx_data, dma->rx_data, dma->nb_data);
+		}
+
+		chSysLock();
+		dma->status = status;
+		dma->busy = FALSE;
+		chSysUnlock();
+		chBSemSignal(&dma->done);
+
+		if(dma->cb != NULL)
+			dma->cb(dma->dev_num, status, dma->cb_arg);
+	}
+}
+
+static void spi_dma_init(bsp_dev_spi_t dev_num)
+{
+	t_spi_dma *dma = &spi_dma[dev_num];
+
+	if(dma->thread == NULL) {
+		dma->dev_num = dev_num;
+		chSemObjectInit(&dma->start, 0);
+		dma->thread = chThdCreateFromHeap(NULL, THD_WORKING_AREA_SIZE(256),
+						  "spi_dma", NORMALPRIO + 1,
+						  spi_dma_thread, dma);
+	}
+	bsp_spi_dma_rx_circular_stop(dev_num);
+}
+
+static bool spi_dma_usable(bsp_dev_spi_t dev_num, uint16_t nb_data)
+{
+	return (spi_handle[dev_num].Init.Mode == SPI_MODE_MASTER &&
+		nb_data >= SPIx_DMA_MIN_SIZE);
+}
+
+bsp_status_t bsp_spi_init(bsp_dev_spi_t dev_num, mode_config_proto_t* mode_conf)
+{
+	GPIO_InitTypeDef gpio_init;
+
+	spi_handle[dev_num].Instance = (dev_num == BSP_DEV_SPI1) ? SPI1 : SPI2;
+	spi_handle[dev_num].Init.Mode =
+		(mode_conf->config.spi.dev_mode == DEV_MASTER) ?
+		SPI_MODE_MASTER : SPI_MODE_SLAVE;
+	spi_dma_init(dev_num);
+
+	gpio_init.Mode = GPIO_MODE_OUTPUT_PP;
+	gpio_init.Pull = GPIO_PULLUP;
+	gpio_init.Speed = GPIO_SPEED_HIGH;
+	gpio_init.Pin = spi_nss_pin(dev_num);
+	gpio_init.Alternate = 0;
+	HAL_GPIO_Init(spi_nss_port(dev_num), &gpio_init);
+	bsp_spi_unselect(dev_num);
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_spi_deinit(bsp_dev_spi_t dev_num)
+{
+	HAL_GPIO_DeInit(spi_nss_port(dev_num), spi_nss_pin(dev_num));
+	/* A DMA transfer in progress ends on its own */
+	bsp_spi_dma_rx_circular_stop(dev_num);
+
+	return BSP_OK;
+}
+
+void bsp_spi_select(bsp_dev_spi_t dev_num)
+{
+	HAL_GPIO_WritePin(spi_nss_port(dev_num), spi_nss_pin(dev_num), GPIO_PIN_RESET);
+	if(spi_dev[dev_num] != NULL)
+		spi_dev[dev_num]->select(TRUE);
+}
+
+void bsp_spi_unselect(bsp_dev_spi_t dev_num)
+{
+	HAL_GPIO_WritePin(spi_nss_port(dev_num), spi_nss_pin(dev_num), GPIO_PIN_SET);
+	if(spi_dev[dev_num] != NULL)
+		spi_dev[dev_num]->select(FALSE);
+}
+
+/* Device model answering on MISO, NULL to loop MOSI back */
+void bsp_host_spi_attach(bsp_dev_spi_t dev_num, const t_bsp_host_spi_dev *dev)
+{
+	spi_dev[dev_num] = dev;
+}
+
+uint8_t bsp_spi_get_cs(bsp_dev_spi_t dev_num)
+{
+	return HAL_GPIO_ReadPin(spi_nss_port(dev_num), spi_nss_pin(dev_num));
+}
+
+uint8_t bsp_spi_rxne(bsp_dev_spi_t dev_num)
+{
+	(void)dev_num;
+
+	return 0;
+}
+
+bsp_status_t bsp_spi_write_u8(bsp_dev_spi_t dev_num, uint8_t* tx_data, uint16_t nb_data)
+{
+	if(spi_dma_usable(dev_num, nb_data))
+		return bsp_spi_dma_xfer(dev_num, tx_data, NULL, nb_data);
+
+	bsp_host_count(BSP_HOST_SPI, nb_data);
+	spi_loop(dev_num, tx_data, NULL, nb_data);
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_spi_read_u8(bsp_dev_spi_t dev_num, uint8_t* rx_data, uint16_t nb_data)
+{
+	if(spi_dma_usable(dev_num, nb_data))
+		return bsp_spi_dma_xfer(dev_num, NULL, rx_data, nb_data);
+
+	bsp_host_count(BSP_HOST_SPI, nb_data);
+	spi_loop(dev_num, NULL, rx_data, nb_data);
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_spi_write_read_u8(bsp_dev_spi_t dev_num, uint8_t* tx_data, uint8_t* rx_data, uint16_t nb_data)
+{
+	if(spi_dma_usable(dev_num, nb_data))
+		return bsp_spi_dma_xfer(dev_num, tx_data, rx_data, nb_data);
+
+	bsp_host_count(BSP_HOST_SPI, nb_data);
+	spi_loop(dev_num, tx_data, rx_data, nb_data);
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_spi_dma_start(bsp_dev_spi_t dev_num, const uint8_t* tx_data, uint8_t* rx_data,
+			       uint16_t nb_data, bsp_spi_cb_t cb, void *arg)
+{
+	t_spi_dma *dma = &spi_dma[dev_num];
+
+	if(dma->thread == NULL || nb_data == 0)
+		return BSP_ERROR;
+
+	chSysLock();
+	if(dma->busy) {
+		chSysUnlock();
+		return BSP_BUSY;
+	}
+	dma->busy = TRUE;
+	chSysUnlock();
+
+	bsp_host_count(BSP_HOST_SPI, nb_data);
+	bsp_host_count(BSP_HOST_SPI_DMA, nb_data);
+	dma->status = BSP_BUSY;
+	dma->tx_data = tx_data;
+	dma->rx_data = rx_data;
+	dma->nb_data = nb_data;
+	dma->cb = cb;
+	dma->cb_arg = arg;
+	chBSemObjectInit(&dma->done, TRUE);
+	chSemSignal(&dma->start);
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_spi_dma_wait(bsp_dev_spi_t dev_num)
+{
+	t_spi_dma *dma = &spi_dma[dev_num];
+
+	if(dma->busy && !dma->circular &&
+	   chBSemWaitTimeout(&dma->done, TIME_MS2I(SPIx_DMA_TIMEOUT_MS)) != MSG_OK)
+		return BSP_TIMEOUT;
+
+	return dma->status;
+}
+
+bsp_status_t bsp_spi_dma_xfer(bsp_dev_spi_t dev_num, const uint8_t* tx_data, uint8_t* rx_data, uint16_t nb_data)
+{
+	bsp_status_t status;
+
+	status = bsp_spi_dma_start(dev_num, tx_data, rx_data, nb_data, NULL, NULL);
+	if(status != BSP_OK)
+		return status;
+
+	return bsp_spi_dma_wait(dev_num);
+}
+
+/* The next DMA transfer ends with a transfer error */
+void bsp_host_spi_dma_fail(bsp_dev_spi_t dev_num)
+{
+	spi_dma[dev_num].fail = TRUE;
+}
+
+bsp_status_t bsp_spi_dma_rx_circular_start(bsp_dev_spi_t dev_num, uint8_t* rx_data, uint16_t nb_data)
+{
+	t_spi_dma *dma = &spi_dma[dev_num];
+
+	if(rx_data == NULL || nb_data == 0)
+		return BSP_ERROR;
+
+	chSysLock();
+	if(dma->busy) {
+		chSysUnlock();
+		return BSP_BUSY;
+	}
+	dma->busy = TRUE;
+	dma->circular = TRUE;
+	dma->ring = rx_data;
+	dma->ring_size = nb_data;
+	dma->count = 0;
+	chSysUnlock();
+
+	return BSP_OK;
+}
+
+uint32_t bsp_spi_dma_rx_circular_count(bsp_dev_spi_t dev_num)
+{
+	return __atomic_load_n(&spi_dma[dev_num].count, __ATOMIC_ACQUIRE);
+}
+
+uint16_t bsp_spi_dma_rx_circular_pos(bsp_dev_spi_t dev_num)
+{
+	t_spi_dma *dma = &spi_dma[dev_num];
+
+	if(dma->ring_size == 0)
+		return 0;
+	return bsp_spi_dma_rx_circular_count(dev_num) % dma->ring_size;
+}
+
+/* Bytes clocked in by the master while a circular reception runs */
+void bsp_host_spi_circular_rx(bsp_dev_spi_t dev_num, const uint8_t *data, uint32_t nb_data)
+{
+	t_spi_dma *dma = &spi_dma[dev_num];
+	uint32_t count, i;
+
+	if(!dma->circular)
+		return;
+	count = dma->count;
+	for(i = 0; i < nb_data; i++)
+		dma->ring[(count + i) % dma->ring_size] = data[i];
+	__atomic_store_n(&dma->count, count + nb_data, __ATOMIC_RELEASE);
+}
+
+void bsp_spi_dma_rx_circular_stop(bsp_dev_spi_t dev_num)
+{
+	t_spi_dma *dma = &spi_dma[dev_num];
+
+	chSysLock();
+	if(dma->circular) {
+		dma->circular = FALSE;
+		dma->busy = FALSE;
+	}
+	chSysUnlock();
+}
+
+SPI_HandleTypeDef* bsp_spi_get_handle(bsp_dev_spi_t dev_num)
+{
+	return &spi_handle[dev_num];
+}
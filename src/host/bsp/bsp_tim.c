@@ -0,0 +1,182 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Host build: TIM4 and TIM8 DMA mock.
+ * TIM4 only keeps its counter enable, prescaler and period registers, the
+ * update flag is set by the host tick (see host/hal.c).
+ * The TIM8 DMA sampling is run by a thread which catches up the number of
+ * samples due at the requested rate every millisecond.
+ * TIM8 is shared with the FREQ1 mock (host/bsp/bsp_freq.c).
+ */
+
+#include <string.h>
+#include "ch.h"
+#include "hal.h"
+#include "bsp_tim.h"
+#include "bsp_tim_conf.h"
+
+typedef struct {
+	volatile void *src;
+	uint8_t *buf;
+	uint32_t nb_samples;
+	uint8_t sample_size;
+	uint32_t rate;
+	volatile uint32_t pos;
+	thread_t *thread;
+} t_tim_dma;
+
+static t_tim_dma tim_dma;
+static bsp_tim8_owner_t tim8_owner;
+
+void bsp_tim_init(uint32_t tim_period, uint32_t prescaler, uint32_t clock_division, uint32_t counter_mode)
+{
+	(void)clock_division;
+	(void)counter_mode;
+
+	BSP_TIM1->CR1 = 0;
+	BSP_TIM1->PSC = prescaler - 1;
+	BSP_TIM1->ARR = tim_period - 1;
+	BSP_TIM1->CNT = 0;
+	BSP_TIM1->SR &= ~TIM_SR_UIF;
+	BSP_TIM1->CR1 = TIM_CR1_CEN;
+}
+
+void bsp_tim_deinit(void)
+{
+	BSP_TIM1->CR1 = 0;
+	BSP_TIM1->SR = 0;
+}
+
+void bsp_tim_set_prescaler(uint32_t prescaler)
+{
+	BSP_TIM1->CR1 = 0;
+	BSP_TIM1->PSC = prescaler - 1;
+	BSP_TIM1->SR &= ~TIM_SR_UIF;
+	BSP_TIM1->CR1 = TIM_CR1_CEN;
+}
+
+void bsp_tim_start(void)
+{
+	BSP_TIM1->CR1 |= TIM_CR1_CEN;
+}
+
+void bsp_tim_stop(void)
+{
+	BSP_TIM1->CR1 &= ~TIM_CR1_CEN;
+}
+
+static void tim_dma_sample(t_tim_dma *dma)
+{
+	uint32_t pos = dma->pos;
+
+	if(dma->sample_size == 1)
+		dma->buf[pos] = *(volatile uint8_t *)dma->src;
+	else
+		((uint16_t *)dma->buf)[pos] = *(volatile uint16_t *)dma->src;
+	if(++pos == dma->nb_samples)
+		pos = 0;
+	dma->pos = pos;
+}
+
+static THD_FUNCTION(tim_dma_thread, arg)
+{
+	t_tim_dma *dma = (t_tim_dma *)arg;
+	systime_t start;
+	uint64_t done, due;
+
+	chRegSetThreadName("tim_dma");
+	start = chVTGetSystemTimeX();
+	done = 0;
+	while(!chThdShouldTerminateX()) {
+		due = (uint64_t)TIME_I2US(chVTTimeElapsedSinceX(start)) *
+		      dma->rate / 1000000;
+		while(done < due) {
+			tim_dma_sample(dma);
+			done++;
+		}
+		chThdSleepMilliseconds(1);
+	}
+}
+
+bsp_status_t bsp_tim_dma_start(volatile void *src, void *buf, uint32_t nb_samples, uint8_t sample_size, uint32_t rate)
+{
+	if(rate == 0 || nb_samples == 0)
+		return BSP_ERROR;
+	if(sample_size != 1 && sample_size != 2)
+		return BSP_ERROR;
+	if(nb_samples > 0xFFFF) {
+		if((nb_samples & 1) || nb_samples / 2 > 0xFFFF)
+			return BSP_ERROR;
+	}
+	if(tim_dma.thread != NULL)
+		return BSP_ERROR;
+	if(bsp_tim8_acquire(BSP_TIM8_DMA) != BSP_OK)
+		return BSP_ERROR;
+
+	tim_dma.src = src;
+	tim_dma.buf = buf;
+	tim_dma.nb_samples = nb_samples;
+	tim_dma.sample_size = sample_size;
+	tim_dma.rate = rate;
+	tim_dma.pos = 0;
+	tim_dma.thread = chThdCreateFromHeap(NULL, THD_WORKING_AREA_SIZE(256),
+					     "tim_dma", NORMALPRIO + 1,
+					     tim_dma_thread, &tim_dma);
+
+	return BSP_OK;
+}
+
+uint32_t bsp_tim_dma_pos(void)
+{
+	return tim_dma.pos;
+}
+
+void bsp_tim_dma_stop(void)
+{
+	if(tim_dma.thread == NULL)
+		return;
+
+	chThdTerminate(tim_dma.thread);
+	chThdWait(tim_dma.thread);
+	tim_dma.thread = NULL;
+	bsp_tim8_release(BSP_TIM8_DMA);
+}
+
+bsp_status_t bsp_tim8_acquire(bsp_tim8_owner_t owner)
+{
+	bsp_status_t status = BSP_ERROR;
+
+	chSysLock();
+	if(tim8_owner == BSP_TIM8_FREE || tim8_owner == owner) {
+		tim8_owner = owner;
+		status = BSP_OK;
+	}
+	chSysUnlock();
+
+	return status;
+}
+
+void bsp_tim8_release(bsp_tim8_owner_t owner)
+{
+	chSysLock();
+	if(tim8_owner == owner)
+		tim8_owner = BSP_TIM8_FREE;
+	chSysUnlock();
+}
@@ -0,0 +1,290 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host build: UART mock, RX is wired to TX.
+ * Every byte written is received back by the same UART, bytes are lost
+ * when the receive queue is full. Transfers are counted, see bsp_host.h.
+ * With bsp_host_uart_peer(), a pseudo terminal stands for the UART peer
+ * instead: TX is written to it and the bytes read from it are received at
+ * the UART baudrate.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/* The termios output delay flags clash with the STM32 register names */
+#undef CR1
+#undef CR2
+#undef CR3
+
+#include "ch.h"
+#include "hal.h"
+#include "bsp_uart.h"
+#include "bsp_host.h"
+
+#define UARTx_TIMEOUT_MAX (100000)
+#define UARTx_RX_QUEUE_SIZE (2048)
+
+typedef struct {
+	semaphore_t full;
+	uint32_t wr;
+	uint32_t rd;
+	uint32_t lost;
+	uint32_t speed;
+	bool dma;
+	uint8_t queue[UARTx_RX_QUEUE_SIZE];
+} t_uart_loop;
+
+static t_uart_loop uart_loop[BSP_DEV_UART_END];
+/* Pseudo terminal master of the UART peer, 0 if RX is wired to TX */
+static int uart_peer_fd[BSP_DEV_UART_END];
+
+static void uart_loop_put(t_uart_loop *loop, uint8_t data)
+{
+	chSysLock();
+	if(loop->wr - loop->rd >= UARTx_RX_QUEUE_SIZE) {
+		loop->lost++;
+		chSysUnlock();
+		return;
+	}
+	loop->queue[loop->wr++ % UARTx_RX_QUEUE_SIZE] = data;
+	chSysUnlock();
+	chSemSignal(&loop->full);
+}
+
+static bool uart_loop_get(t_uart_loop *loop, uint8_t *data, sysinterval_t timeout)
+{
+	if(chSemWaitTimeout(&loop->full, timeout) != MSG_OK)
+		return FALSE;
+
+	chSysLock();
+	*data = loop->queue[loop->rd++ % UARTx_RX_QUEUE_SIZE];
+	chSysUnlock();
+
+	return TRUE;
+}
+
+static uint64_t uart_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Receives the bytes sent by the peer, 10 bits per byte at the UART speed */
+static void *uart_peer_thread(void *arg)
+{
+	bsp_dev_uart_t dev_num = (bsp_dev_uart_t)(uintptr_t)arg;
+	t_uart_loop *loop = &uart_loop[dev_num];
+	struct timespec ts;
+	uint8_t data[256];
+	uint64_t next, now;
+	ssize_t nb, i;
+
+	next = 0;
+	while((nb = read(uart_peer_fd[dev_num], data, sizeof(data))) > 0) {
+		now = uart_ns();
+		/* Line was idle */
+		if(next < now)
+			next = now;
+		for(i = 0; i < nb; i++)
+			uart_loop_put(loop, data[i]);
+		if(loop->speed > 0)
+			next += (uint64_t)nb * 10 * 1000000000ULL / loop->speed;
+		if(next > now) {
+			ts.tv_sec = next / 1000000000ULL;
+			ts.tv_nsec = next % 1000000000ULL;
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+		}
+	}
+
+	return NULL;
+}
+
+/* Creates the pseudo terminal of the UART peer, link is symlinked to it */
+void bsp_host_uart_peer(bsp_dev_uart_t dev_num, const char *link)
+{
+	struct termios tio;
+	pthread_t thread;
+	const char *name;
+	int fd, slave_fd;
+
+	fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if(fd < 0 || grantpt(fd) || unlockpt(fd))
+		chSysHalt("posix_openpt");
+	name = ptsname(fd);
+	/* Kept open, so that the master does not see a hangup */
+	slave_fd = open(name, O_RDWR | O_NOCTTY);
+	if(slave_fd < 0)
+		chSysHalt("ptsname");
+	tcgetattr(slave_fd, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(slave_fd, TCSANOW, &tio);
+
+	unlink(link);
+	if(symlink(name, link) != 0)
+		perror(link);
+	fprintf(stderr, "UART%d peer: %s -> %s\n", dev_num + 1, name, link);
+
+	uart_peer_fd[dev_num] = fd;
+	if(pthread_create(&thread, NULL, uart_peer_thread,
+			  (void *)(uintptr_t)dev_num) != 0)
+		chSysHalt("uart peer");
+	pthread_detach(thread);
+}
+
+bsp_status_t bsp_uart_init(bsp_dev_uart_t dev_num, mode_config_proto_t* mode_conf)
+{
+	t_uart_loop *loop = &uart_loop[dev_num];
+
+	memset(loop, 0, sizeof(t_uart_loop));
+	chSemObjectInit(&loop->full, 0);
+	loop->speed = mode_conf->config.uart.dev_speed;
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_uart_deinit(bsp_dev_uart_t dev_num)
+{
+	bsp_uart_rx_dma_stop(dev_num);
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_uart_write_u8(bsp_dev_uart_t dev_num, uint8_t* tx_data, uint16_t nb_data)
+{
+	uint16_t i;
+
+	bsp_host_count(BSP_HOST_UART_TX, nb_data);
+	if(uart_peer_fd[dev_num] > 0) {
+		if(write(uart_peer_fd[dev_num], tx_data, nb_data) != nb_data)
+			return BSP_ERROR;
+		return BSP_OK;
+	}
+	for(i = 0; i < nb_data; i++)
+		uart_loop_put(&uart_loop[dev_num], tx_data[i]);
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_uart_read_u8(bsp_dev_uart_t dev_num, uint8_t* rx_data, uint16_t nb_data)
+{
+	uint16_t i;
+
+	bsp_host_count(BSP_HOST_UART_RX, nb_data);
+	for(i = 0; i < nb_data; i++) {
+		if(!uart_loop_get(&uart_loop[dev_num], &rx_data[i], UARTx_TIMEOUT_MAX))
+			return BSP_TIMEOUT;
+	}
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_uart_read_u8_timeout(bsp_dev_uart_t dev_num, uint8_t* rx_data, uint8_t nb_data, uint32_t timeout)
+{
+	uint8_t i;
+
+	bsp_host_count(BSP_HOST_UART_RX, nb_data);
+	for(i = 0; i < nb_data; i++) {
+		if(!uart_loop_get(&uart_loop[dev_num], &rx_data[i], timeout))
+			return BSP_TIMEOUT;
+	}
+
+	return BSP_OK;
+}
+
+bsp_status_t bsp_uart_write_read_u8(bsp_dev_uart_t dev_num, uint8_t* tx_data, uint8_t* rx_data, uint16_t nb_data)
+{
+	bsp_status_t status;
+
+	status = bsp_uart_write_u8(dev_num, tx_data, nb_data);
+	if(status == BSP_OK)
+		status = bsp_uart_read_u8(dev_num, rx_data, nb_data);
+
+	return status;
+}
+
+bsp_status_t bsp_uart_rxne(bsp_dev_uart_t dev_num)
+{
+	t_uart_loop *loop = &uart_loop[dev_num];
+	bool rxne;
+
+	chSysLock();
+	rxne = (loop->wr != loop->rd);
+	chSysUnlock();
+
+	return rxne;
+}
+
+bsp_status_t bsp_uart_rx_dma_start(bsp_dev_uart_t dev_num)
+{
+	uart_loop[dev_num].dma = TRUE;
+	uart_loop[dev_num].lost = 0;
+
+	return BSP_OK;
+}
+
+void bsp_uart_rx_dma_stop(bsp_dev_uart_t dev_num)
+{
+	uart_loop[dev_num].dma = FALSE;
+}
+
+uint32_t bsp_uart_rx_dma_read(bsp_dev_uart_t dev_num, uint8_t* rx_data,
+			      uint32_t nb_data, uint32_t timeout)
+{
+	t_uart_loop *loop = &uart_loop[dev_num];
+	uint32_t nb_read;
+
+	if(!loop->dma || nb_data == 0)
+		return 0;
+
+	if(!uart_loop_get(loop, rx_data, timeout))
+		return 0;
+	for(nb_read = 1; nb_read < nb_data; nb_read++) {
+		if(!uart_loop_get(loop, &rx_data[nb_read], TIME_IMMEDIATE))
+			break;
+	}
+
+	return nb_read;
+}
+
+uint32_t bsp_uart_rx_dma_lost(bsp_dev_uart_t dev_num)
+{
+	return uart_loop[dev_num].lost;
+}
+
+uint32_t bsp_uart_get_final_baudrate(bsp_dev_uart_t dev_num)
+{
+	return uart_loop[dev_num].speed;
+}
+
+bsp_status_t bsp_lin_break(bsp_dev_uart_t dev_num)
+{
+	(void)dev_num;
+
+	return BSP_OK;
+}
@@ -0,0 +1,427 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host build: ChibiOS/RT kernel services on top of POSIX threads.
+ * The system lock is a global mutex, it only protects the data shared
+ * with the mocked interrupt handlers, there is no preemption control.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "ch.h"
+
+static pthread_mutex_t sys_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/* Registry, threads stay listed until chThdWait() */
+static pthread_mutex_t reg_mtx = PTHREAD_MUTEX_INITIALIZER;
+static thread_t *reg_first;
+static thread_t main_thread;
+
+static __thread thread_t *self;
+
+/* Shown by "show threads", threads not created by the shim have none */
+static void set_state(uint8_t state)
+{
+	if (self != NULL)
+		self->state = state;
+}
+
+static struct timespec boot_time;
+
+__attribute__((constructor)) static void chibios_boot(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &boot_time);
+}
+
+void chSysInit(void)
+{
+	main_thread.name = "main";
+	main_thread.prio = NORMALPRIO;
+	main_thread.state = CH_STATE_CURRENT;
+	main_thread.refs = 1;
+	main_thread.pthread = pthread_self();
+	main_thread.ctx.sp = &main_thread;
+
+	pthread_mutex_lock(&reg_mtx);
+	main_thread.next = reg_first;
+	reg_first = &main_thread;
+	pthread_mutex_unlock(&reg_mtx);
+
+	self = &main_thread;
+}
+
+void chSysLock(void)
+{
+	pthread_mutex_lock(&sys_mtx);
+}
+
+void chSysUnlock(void)
+{
+	pthread_mutex_unlock(&sys_mtx);
+}
+
+void chSysHalt(const char *reason)
+{
+	fprintf(stderr, "chSysHalt: %s\n", reason);
+	abort();
+}
+
+systime_t chVTGetSystemTimeX(void)
+{
+	struct timespec now;
+	uint64_t ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ns = (uint64_t)(now.tv_sec - boot_time.tv_sec) * 1000000000ULL +
+	     now.tv_nsec - boot_time.tv_nsec;
+
+	return (systime_t)(ns / (1000000000ULL / CH_CFG_ST_FREQUENCY));
+}
+
+/* Absolute CLOCK_REALTIME deadline, as used by pthread_cond_timedwait() */
+static void deadline(struct timespec *ts, sysinterval_t timeout)
+{
+	uint64_t us;
+
+	us = TIME_I2US(timeout);
+	clock_gettime(CLOCK_REALTIME, ts);
+	ts->tv_sec += us / 1000000;
+	ts->tv_nsec += (us % 1000000) * 1000;
+	if (ts->tv_nsec >= 1000000000) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000;
+	}
+}
+
+/* Must be called with reg_mtx held */
+static void thread_release(thread_t *tp)
+{
+	thread_t **pp;
+
+	if (--tp->refs > 0)
+		return;
+
+	for (pp = &reg_first; *pp != NULL; pp = &(*pp)->next) {
+		if (*pp == tp) {
+			*pp = tp->next;
+			break;
+		}
+	}
+	if (tp != &main_thread)
+		free(tp);
+}
+
+static void *thread_start(void *arg)
+{
+	thread_t *tp = arg;
+
+	self = tp;
+	tp->state = CH_STATE_CURRENT;
+	tp->ctx.sp = &tp;
+	tp->func(tp->arg);
+	chThdExit(MSG_OK);
+
+	return NULL;
+}
+
+static thread_t *thread_create(void *wsp, const char *name, tprio_t prio,
+			       tfunc_t pf, void *arg)
+{
+	thread_t *tp;
+
+	tp = calloc(1, sizeof(thread_t));
+	if (tp == NULL)
+		return NULL;
+
+	tp->name = name;
+	tp->prio = prio;
+	tp->state = CH_STATE_READY;
+	/* Owner reference, released by chThdWait() */
+	tp->refs = 1;
+	tp->wabase = wsp;
+	tp->func = pf;
+	tp->arg = arg;
+
+	pthread_mutex_lock(&reg_mtx);
+	tp->next = reg_first;
+	reg_first = tp;
+	pthread_mutex_unlock(&reg_mtx);
+
+	if (pthread_create(&tp->pthread, NULL, thread_start, tp) != 0)
+		chSysHalt("pthread_create");
+
+	return tp;
+}
+
+thread_t *chThdCreateStatic(void *wsp, size_t size, tprio_t prio,
+			    tfunc_t pf, void *arg)
+{
+	(void)size;
+
+	return thread_create(wsp, NULL, prio, pf, arg);
+}
+
+thread_t *chThdCreateFromHeap(memory_heap_t *heapp, size_t size,
+			      const char *name, tprio_t prio,
+			      tfunc_t pf, void *arg)
+{
+	(void)heapp;
+	(void)size;
+
+	return thread_create(NULL, name, prio, pf, arg);
+}
+
+thread_t *chThdGetSelfX(void)
+{
+	return self;
+}
+
+tprio_t chThdGetPriorityX(void)
+{
+	return (self != NULL) ? self->prio : NORMALPRIO;
+}
+
+void chThdTerminate(thread_t *tp)
+{
+	tp->terminate = true;
+}
+
+bool chThdShouldTerminateX(void)
+{
+	return (self != NULL) && self->terminate;
+}
+
+bool chThdTerminatedX(thread_t *tp)
+{
+	return tp->state == CH_STATE_FINAL;
+}
+
+msg_t chThdWait(thread_t *tp)
+{
+	msg_t msg;
+
+	pthread_join(tp->pthread, NULL);
+	msg = tp->exit_msg;
+
+	pthread_mutex_lock(&reg_mtx);
+	thread_release(tp);
+	pthread_mutex_unlock(&reg_mtx);
+
+	return msg;
+}
+
+void chThdExit(msg_t msg)
+{
+	if (self == &main_thread)
+		exit(0);
+
+	self->exit_msg = msg;
+	self->state = CH_STATE_FINAL;
+	pthread_exit(NULL);
+}
+
+void chThdSleep(sysinterval_t time)
+{
+	struct timespec ts;
+	uint64_t us;
+
+	if (time == TIME_IMMEDIATE) {
+		sched_yield();
+		return;
+	}
+	if (time == TIME_INFINITE) {
+		set_state(CH_STATE_SLEEPING);
+		for (;;)
+			pause();
+	}
+
+	us = TIME_I2US(time);
+	ts.tv_sec = us / 1000000;
+	ts.tv_nsec = (us % 1000000) * 1000;
+	set_state(CH_STATE_SLEEPING);
+	while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+		;
+	set_state(CH_STATE_CURRENT);
+}
+
+void chThdYield(void)
+{
+	sched_yield();
+}
+
+void chRegSetThreadName(const char *name)
+{
+	char comm[16];
+
+	if (self == NULL)
+		return;
+
+	self->name = name;
+	/* The main thread name is the process name */
+	if (self == &main_thread)
+		return;
+	strncpy(comm, name, sizeof(comm) - 1);
+	comm[sizeof(comm) - 1] = 0;
+	pthread_setname_np(pthread_self(), comm);
+}
+
+thread_t *chRegFirstThread(void)
+{
+	thread_t *tp;
+
+	pthread_mutex_lock(&reg_mtx);
+	tp = reg_first;
+	if (tp != NULL)
+		tp->refs++;
+	pthread_mutex_unlock(&reg_mtx);
+
+	return tp;
+}
+
+thread_t *chRegNextThread(thread_t *tp)
+{
+	thread_t *ntp;
+
+	pthread_mutex_lock(&reg_mtx);
+	ntp = tp->next;
+	if (ntp != NULL)
+		ntp->refs++;
+	thread_release(tp);
+	pthread_mutex_unlock(&reg_mtx);
+
+	return ntp;
+}
+
+void chMtxObjectInit(mutex_t *mp)
+{
+	pthread_mutex_init(&mp->mtx, NULL);
+}
+
+void chMtxLock(mutex_t *mp)
+{
+	set_state(CH_STATE_WTMTX);
+	pthread_mutex_lock(&mp->mtx);
+	set_state(CH_STATE_CURRENT);
+}
+
+bool chMtxTryLock(mutex_t *mp)
+{
+	return pthread_mutex_trylock(&mp->mtx) == 0;
+}
+
+void chMtxUnlock(mutex_t *mp)
+{
+	pthread_mutex_unlock(&mp->mtx);
+}
+
+void chSemObjectInit(semaphore_t *sp, cnt_t n)
+{
+	pthread_mutex_init(&sp->mtx, NULL);
+	pthread_cond_init(&sp->cond, NULL);
+	sp->cnt = n;
+}
+
+msg_t chSemWait(semaphore_t *sp)
+{
+	return chSemWaitTimeout(sp, TIME_INFINITE);
+}
+
+msg_t chSemWaitTimeout(semaphore_t *sp, sysinterval_t timeout)
+{
+	struct timespec ts;
+	msg_t msg = MSG_OK;
+
+	if (timeout != TIME_INFINITE && timeout != TIME_IMMEDIATE)
+		deadline(&ts, timeout);
+
+	set_state(CH_STATE_WTSEM);
+	pthread_mutex_lock(&sp->mtx);
+	while (sp->cnt <= 0) {
+		if (timeout == TIME_IMMEDIATE) {
+			msg = MSG_TIMEOUT;
+			break;
+		}
+		if (timeout == TIME_INFINITE) {
+			pthread_cond_wait(&sp->cond, &sp->mtx);
+		} else if (pthread_cond_timedwait(&sp->cond, &sp->mtx, &ts) ==
+			   ETIMEDOUT) {
+			if (sp->cnt <= 0)
+				msg = MSG_TIMEOUT;
+			break;
+		}
+	}
+	if (msg == MSG_OK)
+		sp->cnt--;
+	pthread_mutex_unlock(&sp->mtx);
+	set_state(CH_STATE_CURRENT);
+
+	return msg;
+}
+
+void chSemSignal(semaphore_t *sp)
+{
+	pthread_mutex_lock(&sp->mtx);
+	sp->cnt++;
+	pthread_cond_signal(&sp->cond);
+	pthread_mutex_unlock(&sp->mtx);
+}
+
+void chBSemObjectInit(binary_semaphore_t *bsp, bool taken)
+{
+	chSemObjectInit(&bsp->sem, taken ? 0 : 1);
+}
+
+msg_t chBSemWaitTimeout(binary_semaphore_t *bsp, sysinterval_t timeout)
+{
+	return chSemWaitTimeout(&bsp->sem, timeout);
+}
+
+void chBSemSignal(binary_semaphore_t *bsp)
+{
+	pthread_mutex_lock(&bsp->sem.mtx);
+	if (bsp->sem.cnt < 1) {
+		bsp->sem.cnt = 1;
+		pthread_cond_signal(&bsp->sem.cond);
+	}
+	pthread_mutex_unlock(&bsp->sem.mtx);
+}
+
+size_t chHeapStatus(memory_heap_t *heapp, size_t *totalp, size_t *largestp)
+{
+	(void)heapp;
+
+	if (totalp != NULL)
+		*totalp = 0;
+	if (largestp != NULL)
+		*largestp = 0;
+
+	return 0;
+}
+
+size_t chCoreGetStatusX(void)
+{
+	return 0;
+}
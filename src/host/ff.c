@@ -0,0 +1,633 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host build: FatFs API on a host directory, see ff.h */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+
+/* ff.h has its own DIR */
+#define DIR FF_DIR
+#include "ff.h"
+#undef DIR
+
+#define FS_FAT32	3
+/* 32KB clusters, as formatted by the SD card vendors */
+#define HOST_CLUSTER_SECTORS	64
+#define HOST_SECTOR_SIZE	512
+#define HOST_CLUSTER_SIZE	(HOST_CLUSTER_SECTORS * HOST_SECTOR_SIZE)
+
+/* FIL flags, as FatFs R0.12 */
+#define FA_MODIFIED	0x40
+#define FA_DIRTY	0x80
+
+static const char *root;
+static FATFS *mounted;
+static t_ff_host_stats stats;
+
+void ff_host_set_root(const char *path)
+{
+	root = path;
+}
+
+const char *ff_host_get_root(void)
+{
+	return root;
+}
+
+void ff_host_get_stats(t_ff_host_stats *st)
+{
+	st->sector_reads = __atomic_load_n(&stats.sector_reads, __ATOMIC_SEQ_CST);
+	st->sector_writes = __atomic_load_n(&stats.sector_writes, __ATOMIC_SEQ_CST);
+	st->syncs = __atomic_load_n(&stats.syncs, __ATOMIC_SEQ_CST);
+}
+
+void ff_host_reset_stats(void)
+{
+	__atomic_store_n(&stats.sector_reads, 0, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&stats.sector_writes, 0, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&stats.syncs, 0, __ATOMIC_SEQ_CST);
+}
+
+static void count(uint32_t *counter, uint32_t n)
+{
+	__atomic_add_fetch(counter, n, __ATOMIC_SEQ_CST);
+}
+
+static DWORD file_clusters(FSIZE_t size)
+{
+	return (size + HOST_CLUSTER_SIZE - 1) / HOST_CLUSTER_SIZE;
+}
+
+/*
+ * Sector accounting: each FIL has a one sector buffer (_FS_TINY 0),
+ * written back when another sector is accessed or on sync.
+ */
+static void sect_flush(FIL *fp)
+{
+	if (!(fp->flag & FA_DIRTY))
+		return;
+
+	count(&stats.sector_writes, 1);
+	fp->flag &= ~FA_DIRTY;
+}
+
+static void sect_load(FIL *fp, DWORD sect, bool read)
+{
+	if (fp->sect == sect + 1)
+		return;
+
+	sect_flush(fp);
+	if (read)
+		count(&stats.sector_reads, 1);
+	fp->sect = sect + 1;
+}
+
+/* Partial sectors go through the buffer, whole sectors to the card */
+static void sect_access(FIL *fp, UINT len, bool write)
+{
+	FSIZE_t pos;
+	DWORD sect, nb;
+	UINT chunk;
+
+	pos = fp->fptr;
+	while (len) {
+		sect = pos / HOST_SECTOR_SIZE;
+		if (pos % HOST_SECTOR_SIZE == 0)
+			sect_flush(fp);
+
+		if (pos % HOST_SECTOR_SIZE == 0 && len >= HOST_SECTOR_SIZE) {
+			nb = len / HOST_SECTOR_SIZE;
+			count(write ? &stats.sector_writes : &stats.sector_reads, nb);
+			chunk = nb * HOST_SECTOR_SIZE;
+		} else {
+			/* A written sector is read first if it holds file data */
+			sect_load(fp, sect, !write || pos < fp->obj.objsize);
+			chunk = HOST_SECTOR_SIZE - pos % HOST_SECTOR_SIZE;
+			if (chunk > len)
+				chunk = len;
+			if (write)
+				fp->flag |= FA_DIRTY;
+		}
+		pos += chunk;
+		len -= chunk;
+	}
+}
+
+static FRESULT errno_to_fresult(int err)
+{
+	switch (err) {
+	case ENOENT:
+		return FR_NO_FILE;
+	case ENOTDIR:
+		return FR_NO_PATH;
+	case EEXIST:
+		return FR_EXIST;
+	case EACCES:
+	case EPERM:
+	case EISDIR:
+	case ENOTEMPTY:
+	case ENOSPC:
+		return FR_DENIED;
+	case EROFS:
+		return FR_WRITE_PROTECTED;
+	case ENAMETOOLONG:
+		return FR_INVALID_NAME;
+	case EMFILE:
+	case ENFILE:
+		return FR_TOO_MANY_OPEN_FILES;
+	default:
+		return FR_DISK_ERR;
+	}
+}
+
+/*
+ * Resolves a FatFs path against the current directory, rel gets the
+ * normalized path relative to the root (without leading '/') and host
+ * the path on the host. ".." never goes above the root.
+ */
+static FRESULT resolve(const TCHAR *path, char *rel, char *host)
+{
+	char tmp[PATH_MAX];
+	char *name, *save;
+	size_t len;
+
+	if (mounted == NULL || root == NULL)
+		return FR_NOT_ENABLED;
+
+	if (path[0] == '0' && path[1] == ':')
+		path += 2;
+
+	if (path[0] == '/' || path[0] == '\\')
+		len = snprintf(tmp, sizeof(tmp), "%s", path);
+	else
+		len = snprintf(tmp, sizeof(tmp), "%s/%s", mounted->cwd, path);
+	if (len >= sizeof(tmp))
+		return FR_INVALID_NAME;
+
+	rel[0] = 0;
+	len = 0;
+	for (name = strtok_r(tmp, "/\\", &save); name != NULL;
+	     name = strtok_r(NULL, "/\\", &save)) {
+		if (strcmp(name, ".") == 0)
+			continue;
+		if (strcmp(name, "..") == 0) {
+			while (len > 0 && rel[len - 1] != '/')
+				len--;
+			if (len > 0)
+				len--;
+			rel[len] = 0;
+			continue;
+		}
+		if (len + strlen(name) + 2 > _MAX_LFN)
+			return FR_INVALID_NAME;
+		if (len > 0)
+			rel[len++] = '/';
+		strcpy(&rel[len], name);
+		len += strlen(name);
+	}
+
+	if (snprintf(host, PATH_MAX, "%s/%s", root, rel) >= PATH_MAX)
+		return FR_INVALID_NAME;
+
+	return FR_OK;
+}
+
+FRESULT f_mount(FATFS *fs, const TCHAR *path, BYTE opt)
+{
+	(void)path;
+	(void)opt;
+
+	if (fs == NULL) {
+		mounted = NULL;
+		return FR_OK;
+	}
+	if (root == NULL)
+		return FR_NOT_READY;
+
+	fs->fs_type = FS_FAT32;
+	fs->csize = HOST_CLUSTER_SECTORS;
+	fs->cwd[0] = 0;
+	mounted = fs;
+
+	return FR_OK;
+}
+
+FRESULT f_mkfs(const TCHAR *path, BYTE opt, DWORD au, void *work, UINT len)
+{
+	(void)path;
+	(void)opt;
+	(void)au;
+	(void)work;
+	(void)len;
+
+	return FR_MKFS_ABORTED;
+}
+
+FRESULT f_open(FIL *fp, const TCHAR *path, BYTE mode)
+{
+	char rel[_MAX_LFN + 1], host[PATH_MAX];
+	struct stat st;
+	FRESULT res;
+	int flags;
+
+	fp->fd = -1;
+	fp->obj.fs = NULL;
+	if ((res = resolve(path, rel, host)) != FR_OK)
+		return res;
+
+	switch (mode & (FA_READ | FA_WRITE)) {
+	case FA_WRITE:
+		flags = O_WRONLY;
+		break;
+	case FA_READ | FA_WRITE:
+		flags = O_RDWR;
+		break;
+	default:
+		flags = O_RDONLY;
+		break;
+	}
+	if ((mode & FA_OPEN_APPEND) == FA_OPEN_APPEND ||
+	    (mode & FA_OPEN_ALWAYS))
+		flags |= O_CREAT;
+	else if (mode & FA_CREATE_ALWAYS)
+		flags |= O_CREAT | O_TRUNC;
+	else if (mode & FA_CREATE_NEW)
+		flags |= O_CREAT | O_EXCL;
+
+	fp->fd = open(host, flags, 0666);
+	if (fp->fd < 0)
+		return errno_to_fresult(errno);
+	if (fstat(fp->fd, &st) != 0 || S_ISDIR(st.st_mode)) {
+		close(fp->fd);
+		fp->fd = -1;
+		return FR_NO_FILE;
+	}
+
+	/* Directory entry lookup */
+	count(&stats.sector_reads, 1);
+
+	fp->obj.fs = mounted;
+	fp->obj.objsize = st.st_size;
+	fp->flag = mode & ~(FA_MODIFIED | FA_DIRTY);
+	if (mode & FA_CREATE_ALWAYS)
+		fp->flag |= FA_MODIFIED;
+	fp->fptr = 0;
+	fp->sect = 0;
+	fp->nclst = file_clusters(fp->obj.objsize);
+	if ((mode & FA_OPEN_APPEND) == FA_OPEN_APPEND)
+		return f_lseek(fp, fp->obj.objsize);
+
+	return FR_OK;
+}
+
+FRESULT f_close(FIL *fp)
+{
+	if (fp->fd < 0)
+		return FR_INVALID_OBJECT;
+
+	f_sync(fp);
+	close(fp->fd);
+	fp->fd = -1;
+	fp->obj.fs = NULL;
+
+	return FR_OK;
+}
+
+FRESULT f_read(FIL *fp, void *buff, UINT btr, UINT *br)
+{
+	ssize_t len;
+
+	*br = 0;
+	if (fp->fd < 0)
+		return FR_INVALID_OBJECT;
+	if (!(fp->flag & FA_READ))
+		return FR_DENIED;
+
+	while (*br < btr) {
+		len = read(fp->fd, (BYTE *)buff + *br, btr - *br);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len < 0)
+			return FR_DISK_ERR;
+		if (len == 0)
+			break;
+		*br += len;
+	}
+	sect_access(fp, *br, false);
+	fp->fptr += *br;
+
+	return FR_OK;
+}
+
+FRESULT f_write(FIL *fp, const void *buff, UINT btw, UINT *bw)
+{
+	ssize_t len;
+
+	*bw = 0;
+	if (fp->fd < 0)
+		return FR_INVALID_OBJECT;
+	if (!(fp->flag & FA_WRITE))
+		return FR_DENIED;
+
+	while (*bw < btw) {
+		len = write(fp->fd, (const BYTE *)buff + *bw, btw - *bw);
+		if (len < 0 && errno == EINTR)
+			continue;
+		/* Disk full is not an error, like FatFs */
+		if (len <= 0)
+			break;
+		*bw += len;
+	}
+	if (*bw) {
+		sect_access(fp, *bw, true);
+		fp->flag |= FA_MODIFIED;
+	}
+	fp->fptr += *bw;
+	if (fp->fptr > fp->obj.objsize)
+		fp->obj.objsize = fp->fptr;
+
+	return FR_OK;
+}
+
+/* Like FatFs, the file is expanded when seeking past its end in write mode */
+FRESULT f_lseek(FIL *fp, FSIZE_t ofs)
+{
+	if (fp->fd < 0)
+		return FR_INVALID_OBJECT;
+
+	if (ofs > fp->obj.objsize) {
+		if (!(fp->flag & FA_WRITE))
+			ofs = fp->obj.objsize;
+		else if (ftruncate(fp->fd, ofs) == 0) {
+			fp->obj.objsize = ofs;
+			fp->flag |= FA_MODIFIED;
+		} else {
+			ofs = fp->obj.objsize;
+		}
+	}
+	if (lseek(fp->fd, ofs, SEEK_SET) < 0)
+		return FR_DISK_ERR;
+	fp->fptr = ofs;
+	/* FatFs loads the sector of an unaligned position */
+	if (ofs % HOST_SECTOR_SIZE)
+		sect_load(fp, ofs / HOST_SECTOR_SIZE, true);
+
+	return FR_OK;
+}
+
+FRESULT f_truncate(FIL *fp)
+{
+	if (fp->fd < 0)
+		return FR_INVALID_OBJECT;
+	if (!(fp->flag & FA_WRITE))
+		return FR_DENIED;
+
+	if (ftruncate(fp->fd, fp->fptr) != 0)
+		return FR_DISK_ERR;
+	fp->obj.objsize = fp->fptr;
+	fp->flag |= FA_MODIFIED;
+
+	return FR_OK;
+}
+
+/* Writes the file buffer, the directory entry, then the FAT and FSInfo */
+FRESULT f_sync(FIL *fp)
+{
+	DWORD nclst;
+
+	if (fp->fd < 0)
+		return FR_INVALID_OBJECT;
+	if (!(fp->flag & FA_MODIFIED))
+		return FR_OK;
+
+	sect_flush(fp);
+	count(&stats.sector_reads, 1);
+	count(&stats.sector_writes, 1);
+	nclst = file_clusters(fp->obj.objsize);
+	if (nclst != fp->nclst) {
+		count(&stats.sector_writes, 2);
+		fp->nclst = nclst;
+	}
+	count(&stats.syncs, 1);
+	fp->flag &= ~FA_MODIFIED;
+
+	return (fsync(fp->fd) == 0) ? FR_OK : FR_DISK_ERR;
+}
+
+FRESULT f_opendir(FF_DIR *dp, const TCHAR *path)
+{
+	char rel[_MAX_LFN + 1], host[PATH_MAX];
+	FRESULT res;
+
+	dp->dir = NULL;
+	if ((res = resolve(path, rel, host)) != FR_OK)
+		return res;
+
+	dp->dir = opendir(host);
+	if (dp->dir == NULL)
+		return (errno == ENOENT) ? FR_NO_PATH : errno_to_fresult(errno);
+	dp->obj.fs = mounted;
+
+	return FR_OK;
+}
+
+FRESULT f_closedir(FF_DIR *dp)
+{
+	if (dp->dir == NULL)
+		return FR_INVALID_OBJECT;
+
+	closedir((DIR *)dp->dir);
+	dp->dir = NULL;
+
+	return FR_OK;
+}
+
+static void fill_info(FILINFO *fno, const char *name, const struct stat *st)
+{
+	struct tm tm;
+
+	fno->fsize = st->st_size;
+	fno->fattrib = S_ISDIR(st->st_mode) ? AM_DIR : AM_ARC;
+	if (!(st->st_mode & S_IWUSR))
+		fno->fattrib |= AM_RDO;
+	localtime_r(&st->st_mtime, &tm);
+	fno->fdate = ((tm.tm_year - 80) << 9) | ((tm.tm_mon + 1) << 5) |
+		     tm.tm_mday;
+	fno->ftime = (tm.tm_hour << 11) | (tm.tm_min << 5) | (tm.tm_sec / 2);
+	snprintf(fno->fname, sizeof(fno->fname), "%s", name);
+}
+
+/* fname is empty at the end of the directory, a NULL fno rewinds it */
+FRESULT f_readdir(FF_DIR *dp, FILINFO *fno)
+{
+	struct dirent *de;
+	struct stat st;
+
+	if (dp->dir == NULL)
+		return FR_INVALID_OBJECT;
+
+	if (fno == NULL) {
+		rewinddir((DIR *)dp->dir);
+		return FR_OK;
+	}
+
+	while ((de = readdir((DIR *)dp->dir)) != NULL) {
+		if (strcmp(de->d_name, ".") == 0 ||
+		    strcmp(de->d_name, "..") == 0)
+			continue;
+		if (fstatat(dirfd((DIR *)dp->dir), de->d_name,
+			    &st, 0) != 0)
+			continue;
+		fill_info(fno, de->d_name, &st);
+		return FR_OK;
+	}
+	fno->fname[0] = 0;
+
+	return FR_OK;
+}
+
+FRESULT f_mkdir(const TCHAR *path)
+{
+	char rel[_MAX_LFN + 1], host[PATH_MAX];
+	FRESULT res;
+
+	if ((res = resolve(path, rel, host)) != FR_OK)
+		return res;
+
+	if (mkdir(host, 0777) != 0)
+		return (errno == ENOENT) ? FR_NO_PATH : errno_to_fresult(errno);
+
+	return FR_OK;
+}
+
+FRESULT f_unlink(const TCHAR *path)
+{
+	char rel[_MAX_LFN + 1], host[PATH_MAX];
+	struct stat st;
+	FRESULT res;
+
+	if ((res = resolve(path, rel, host)) != FR_OK)
+		return res;
+	if (rel[0] == 0)
+		return FR_INVALID_NAME;
+
+	if (stat(host, &st) != 0)
+		return errno_to_fresult(errno);
+	if (S_ISDIR(st.st_mode) ? rmdir(host) : unlink(host))
+		return errno_to_fresult(errno);
+
+	return FR_OK;
+}
+
+FRESULT f_stat(const TCHAR *path, FILINFO *fno)
+{
+	char rel[_MAX_LFN + 1], host[PATH_MAX];
+	struct stat st;
+	FRESULT res;
+	const char *name;
+
+	if ((res = resolve(path, rel, host)) != FR_OK)
+		return res;
+	if (rel[0] == 0)
+		return FR_INVALID_NAME;
+
+	if (stat(host, &st) != 0)
+		return errno_to_fresult(errno);
+	if (fno != NULL) {
+		name = strrchr(rel, '/');
+		fill_info(fno, name ? name + 1 : rel, &st);
+	}
+
+	return FR_OK;
+}
+
+FRESULT f_chdir(const TCHAR *path)
+{
+	char rel[_MAX_LFN + 1], host[PATH_MAX];
+	struct stat st;
+	FRESULT res;
+
+	if ((res = resolve(path, rel, host)) != FR_OK)
+		return res;
+
+	if (stat(host, &st) != 0 || !S_ISDIR(st.st_mode))
+		return FR_NO_PATH;
+	strcpy(mounted->cwd, rel);
+
+	return FR_OK;
+}
+
+FRESULT f_getcwd(TCHAR *buff, UINT len)
+{
+	if (mounted == NULL)
+		return FR_NOT_ENABLED;
+
+	if ((UINT)snprintf(buff, len, "/%s", mounted->cwd) >= len)
+		return FR_NOT_ENOUGH_CORE;
+
+	return FR_OK;
+}
+
+FRESULT f_getfree(const TCHAR *path, DWORD *nclst, FATFS **fatfs)
+{
+	struct statvfs st;
+	uint64_t clusters;
+
+	(void)path;
+	if (mounted == NULL)
+		return FR_NOT_ENABLED;
+
+	if (statvfs(root, &st) != 0)
+		return FR_DISK_ERR;
+	clusters = (uint64_t)st.f_bavail * st.f_frsize /
+		   (HOST_CLUSTER_SECTORS * HOST_SECTOR_SIZE);
+	*nclst = (clusters > UINT32_MAX) ? UINT32_MAX : clusters;
+	*fatfs = mounted;
+
+	return FR_OK;
+}
+
+TCHAR *f_gets(TCHAR *buff, int len, FIL *fp)
+{
+	UINT br;
+	int n;
+
+	for (n = 0; n < len - 1; n++) {
+		if (f_read(fp, &buff[n], 1, &br) != FR_OK || br == 0)
+			break;
+		if (buff[n] == '\n') {
+			n++;
+			break;
+		}
+	}
+	buff[n] = 0;
+
+	return n ? buff : NULL;
+}
@@ -0,0 +1,708 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host build: ChibiOS HAL drivers, see hal.h.
+ * The peripheral registers are plain memory mapped at their addresses, the
+ * tick thread stands for the hardware which updates them: DWT cycle
+ * counter, TIM4 update flag and GPIO output to input loopback.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/statvfs.h>
+
+/* The termios output delay flags clash with the STM32 register names */
+#undef CR1
+#undef CR2
+#undef CR3
+
+#include "hal.h"
+#include "stm32f4xx_hal.h"
+#include "ff.h"
+#include "usb1cfg.h"
+#include "usb2cfg.h"
+
+#define HOST_TICK_NS	50000
+
+/* DWT registers, see bsp.h */
+#define DWT_CTRL_REG		(*(volatile uint32_t *)0xE0001000U)
+#define DWT_CYCCNT_REG		(*(volatile uint32_t *)0xE0001004U)
+#define DWT_CTRL_CYCCNTENA	(0x1U << 0)
+
+/* TIM4 runs from the 84MHz APB1 timer clock */
+#define TIM4_CLK	(STM32_PCLK1 * 2)
+
+#define PAL_NB_PORTS	9
+#define PAL_NB_PADS	16
+
+typedef struct {
+	uint32_t mode;
+	palcallback_t cb;
+	void *arg;
+} pal_event_t;
+
+static pthread_mutex_t gpio_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pal_event_t pal_events[PAL_NB_PORTS][PAL_NB_PADS];
+static uint16_t pal_last_idr[PAL_NB_PORTS];
+/* Input pads driven by a mocked device, see host_gpio_set_input() */
+static uint16_t pal_ext_mask[PAL_NB_PORTS];
+static uint16_t pal_ext_in[PAL_NB_PORTS];
+/* Open drain device of each port and the pads it pulls low */
+static host_gpio_dev_t pal_dev[PAL_NB_PORTS];
+static uint16_t pal_dev_low[PAL_NB_PORTS];
+
+static stm32_gpio_t * const tick_ports[] = {
+	GPIOA, GPIOB, GPIOC, GPIOD, GPIOE, GPIOH
+};
+
+static volatile sig_atomic_t ubtn_pressed;
+
+USBDriver USBD1 = { USB_STOP, NULL, (stm32_otg_t *)USB_OTG_FS_PERIPH_BASE };
+USBDriver USBD2 = { USB_STOP, NULL, (stm32_otg_t *)USB_OTG_HS_PERIPH_BASE };
+
+const USBConfig usb1cfg = { 0 };
+const USBConfig usb2cfg = { 0 };
+SerialUSBConfig serusb1cfg = { &USBD1, 1, 1, 2 };
+SerialUSBConfig serusb2cfg = { &USBD2, 1, 1, 2 };
+
+static const char *tty_links[2];
+
+SDCDriver SDCD1;
+
+typedef struct {
+	uintptr_t base;
+	size_t size;
+} t_host_region;
+
+static const t_host_region regions[] = {
+	/* System memory: unique ID, flash size */
+	{ 0x1FFF0000, 0x00010000 },
+	/* APB1, APB2, AHB1 and AHB2 peripherals */
+	{ PERIPH_BASE, 0x10061000 },
+	/* Cortex-M4 private peripherals: DWT, SCB, DBGMCU */
+	{ 0xE0000000, 0x00100000 },
+};
+
+#define REG32(addr)	(*(volatile uint32_t *)(addr))
+#define REG16(addr)	(*(volatile uint16_t *)(addr))
+
+/*
+ * Maps the STM32 peripheral, system memory and Cortex-M4 core registers
+ * as plain memory at their addresses, so that the firmware and the ST HAL
+ * access them unchanged. Must be called before anything else.
+ */
+void host_map_registers(void)
+{
+	uint32_t i;
+	void *p;
+
+	for (i = 0; i < sizeof(regions) / sizeof(regions[0]); i++) {
+		p = mmap((void *)regions[i].base, regions[i].size,
+			 PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE |
+			 MAP_FIXED_NOREPLACE, -1, 0);
+		if (p != (void *)regions[i].base) {
+			fprintf(stderr, "Cannot map registers at 0x%08lx\n",
+				(unsigned long)regions[i].base);
+			exit(1);
+		}
+	}
+
+	/* Unique ID, flash size in KB */
+	REG32(0x1FFF7A10) = 0x484F5354;
+	REG32(0x1FFF7A14) = 0x48594452;
+	REG32(0x1FFF7A18) = 0x41465721;
+	REG16(0x1FFF7A22) = 1024;
+	/* STM32F405 rev Z DBGMCU_IDCODE, Cortex-M4 r0p1 CPUID */
+	REG32(0xE0042000) = 0x10076413;
+	REG32(0xE000ED00) = 0x410FC241;
+}
+
+static uint64_t host_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t pal_port_index(stm32_gpio_t *gpiop)
+{
+	return ((uintptr_t)gpiop - GPIOA_BASE) / (GPIOB_BASE - GPIOA_BASE);
+}
+
+void host_ubtn_toggle(void)
+{
+	ubtn_pressed = !ubtn_pressed;
+}
+
+/* Pending BSRR writes to ODR, set has priority over reset */
+static void gpio_apply_bsrr(stm32_gpio_t *gpiop)
+{
+	uint32_t bsrr;
+
+	bsrr = __atomic_exchange_n(&gpiop->BSRR.W, 0, __ATOMIC_SEQ_CST);
+	if (bsrr)
+		gpiop->ODR = (gpiop->ODR & ~(bsrr >> 16)) | (bsrr & 0xFFFF);
+}
+
+/*
+ * Applies the pending BSRR writes to ODR, then drives IDR: outputs read
+ * back their ODR level, inputs read their pull-up or pull-down (UBTN on
+ * PA0, or the level set by host_gpio_set_input()), floating inputs keep
+ * their level.
+ * The device of the port (see host_gpio_set_device()) sees the new levels
+ * and pulls inputs and open drain outputs low (wired AND).
+ * PAL callbacks of the changed pads are called like from the EXTI ISR.
+ */
+void host_gpio_update(stm32_gpio_t *gpiop)
+{
+	uint32_t idx, moder, pupdr, out, od, in, idr, low, changed, pad, edge,
+		 i;
+	pal_event_t events[PAL_NB_PADS];
+
+	idx = pal_port_index(gpiop);
+	/* Under the lock, a write is applied once its writer reads IDR back */
+	pthread_mutex_lock(&gpio_mtx);
+	gpio_apply_bsrr(gpiop);
+
+	moder = gpiop->MODER;
+	pupdr = gpiop->PUPDR;
+	out = 0;
+	in = 0;
+	for (pad = 0; pad < PAL_NB_PADS; pad++) {
+		if (((moder >> (pad * 2)) & 3) == PAL_STM32_MODE_OUTPUT)
+			out |= 1U << pad;
+		switch ((pupdr >> (pad * 2)) & 3) {
+		case 0:
+			/* Floating, keeps the level last seen */
+			in |= pal_last_idr[idx] & (1U << pad);
+			break;
+		case 1:
+			in |= 1U << pad;
+			break;
+		}
+	}
+	if (gpiop == GPIOA) {
+		in &= ~1U;
+		if (ubtn_pressed)
+			in |= 1U;
+	}
+	in = (in & ~pal_ext_mask[idx]) | pal_ext_in[idx];
+	od = out & gpiop->OTYPER;
+	/* The device reacts to its own pads once at most */
+	for (i = 0; i < 2; i++) {
+		idr = (gpiop->ODR & out) | (in & ~out);
+		idr &= ~(pal_dev_low[idx] & (od | ~out));
+		if (pal_dev[idx] == NULL)
+			break;
+		low = pal_dev[idx](idr);
+		if (low == pal_dev_low[idx])
+			break;
+		pal_dev_low[idx] = low;
+	}
+	gpiop->IDR = idr;
+
+	changed = idr ^ pal_last_idr[idx];
+	pal_last_idr[idx] = idr;
+	if (changed)
+		memcpy(events, pal_events[idx], sizeof(events));
+	pthread_mutex_unlock(&gpio_mtx);
+
+	for (pad = 0; changed; pad++, changed >>= 1) {
+		if (!(changed & 1) || events[pad].cb == NULL)
+			continue;
+		edge = (idr & (1U << pad)) ? PAL_EVENT_MODE_RISING_EDGE :
+		       PAL_EVENT_MODE_FALLING_EDGE;
+		if (events[pad].mode & edge)
+			events[pad].cb(events[pad].arg);
+	}
+}
+
+/* Drives an input pad from a mocked device, instead of its pull-up */
+void host_gpio_set_input(stm32_gpio_t *gpiop, uint32_t pad, uint32_t level)
+{
+	uint32_t idx;
+
+	idx = pal_port_index(gpiop);
+	pthread_mutex_lock(&gpio_mtx);
+	pal_ext_mask[idx] |= 1U << pad;
+	if (level)
+		pal_ext_in[idx] |= 1U << pad;
+	else
+		pal_ext_in[idx] &= ~(1U << pad);
+	pthread_mutex_unlock(&gpio_mtx);
+
+	host_gpio_update(gpiop);
+}
+
+/*
+ * Attaches an open drain device to a port, NULL to detach it. dev() is
+ * called with the gpio lock held on each update, with the IDR levels, and
+ * returns the pads it pulls low.
+ */
+void host_gpio_set_device(stm32_gpio_t *gpiop, host_gpio_dev_t dev)
+{
+	uint32_t idx;
+
+	idx = pal_port_index(gpiop);
+	pthread_mutex_lock(&gpio_mtx);
+	pal_dev[idx] = dev;
+	pal_dev_low[idx] = 0;
+	pthread_mutex_unlock(&gpio_mtx);
+
+	host_gpio_update(gpiop);
+}
+
+/*
+ * For a device callback sampling the outputs of another port, with the
+ * gpio lock held: applies its pending BSRR writes and returns ODR.
+ */
+uint32_t host_gpio_odr(stm32_gpio_t *gpiop)
+{
+	gpio_apply_bsrr(gpiop);
+	return gpiop->ODR;
+}
+
+/*
+ * For a device callback driving input pads of another port, with the gpio
+ * lock held: same as host_gpio_set_input(), IDR of the input pads is
+ * updated at once.
+ */
+void host_gpio_drive(stm32_gpio_t *gpiop, uint32_t mask, uint32_t levels)
+{
+	uint32_t idx, in, pad;
+
+	idx = pal_port_index(gpiop);
+	pal_ext_mask[idx] |= mask;
+	pal_ext_in[idx] = (pal_ext_in[idx] & ~mask) | (levels & mask);
+
+	in = 0;
+	for (pad = 0; pad < PAL_NB_PADS; pad++) {
+		if (((gpiop->MODER >> (pad * 2)) & 3) != PAL_STM32_MODE_OUTPUT)
+			in |= 1U << pad;
+	}
+	in &= mask;
+	gpiop->IDR = (gpiop->IDR & ~in) | (levels & in);
+}
+
+/*
+ * gpio_set_pin()/gpio_clr_pin(): the pad is updated before the next write,
+ * gpiop is a GPIO_TypeDef or a stm32_gpio_t.
+ */
+void host_gpio_bsrr(void *gpiop, uint32_t bsrr)
+{
+	__atomic_or_fetch(&((stm32_gpio_t *)gpiop)->BSRR.W, bsrr, __ATOMIC_SEQ_CST);
+	host_gpio_update(gpiop);
+}
+
+static void gpio_update_all(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < sizeof(tick_ports) / sizeof(tick_ports[0]); i++)
+		host_gpio_update(tick_ports[i]);
+}
+
+static void *hal_tick(void *arg)
+{
+	struct timespec next;
+	uint64_t now, last, delta, tim4_ns, period_ns;
+
+	(void)arg;
+	tim4_ns = 0;
+	last = host_ns();
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (1) {
+		next.tv_nsec += HOST_TICK_NS;
+		if (next.tv_nsec >= 1000000000) {
+			next.tv_sec++;
+			next.tv_nsec -= 1000000000;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+		now = host_ns();
+		delta = now - last;
+		last = now;
+
+		if (DWT_CTRL_REG & DWT_CTRL_CYCCNTENA)
+			DWT_CYCCNT_REG += (uint32_t)(delta * (STM32_HCLK / 1000000) / 1000);
+
+		if (TIM4->CR1 & TIM_CR1_CEN) {
+			period_ns = (uint64_t)(TIM4->PSC + 1) * (TIM4->ARR + 1) *
+				    1000000000ULL / TIM4_CLK;
+			tim4_ns += delta;
+			if (tim4_ns >= period_ns) {
+				tim4_ns = 0;
+				TIM4->SR |= TIM_SR_UIF;
+			}
+		} else {
+			tim4_ns = 0;
+		}
+
+		gpio_update_all();
+	}
+
+	return NULL;
+}
+
+void halInit(void)
+{
+	pthread_t tick;
+
+	if (pthread_create(&tick, NULL, hal_tick, NULL) != 0)
+		chSysHalt("hal tick");
+	pthread_detach(tick);
+}
+
+void osalSysPolledDelayX(rtcnt_t cycles)
+{
+	uint64_t end;
+
+	end = host_ns() + (uint64_t)cycles * 1000 / (STM32_HCLK / 1000000);
+	/* Bit banged drivers read back their outputs after a delay */
+	gpio_update_all();
+	while (host_ns() < end)
+		;
+}
+
+/* Same encoding as the ChibiOS STM32 GPIOv2 PAL driver */
+void palSetPadMode(ioportid_t port, uint32_t pad, iomode_t mode)
+{
+	uint32_t shift2, shift4;
+	volatile uint32_t *afr;
+
+	shift2 = pad * 2;
+	pthread_mutex_lock(&gpio_mtx);
+	port->OTYPER = (port->OTYPER & ~(1U << pad)) |
+		       (((mode >> 2) & 1) << pad);
+	port->OSPEEDR = (port->OSPEEDR & ~(3U << shift2)) |
+			(((mode >> 3) & 3) << shift2);
+	port->PUPDR = (port->PUPDR & ~(3U << shift2)) |
+		      (((mode >> 5) & 3) << shift2);
+	afr = (pad < 8) ? &port->AFRL : &port->AFRH;
+	shift4 = (pad & 7) * 4;
+	*afr = (*afr & ~(15U << shift4)) | (((mode >> 7) & 15) << shift4);
+	port->MODER = (port->MODER & ~(3U << shift2)) |
+		      ((mode & PAL_STM32_MODE_MASK) << shift2);
+	pthread_mutex_unlock(&gpio_mtx);
+
+	host_gpio_update(port);
+}
+
+void palSetPad(ioportid_t port, uint32_t pad)
+{
+	port->BSRR.H.set = 1U << pad;
+	host_gpio_update(port);
+}
+
+void palClearPad(ioportid_t port, uint32_t pad)
+{
+	port->BSRR.H.clear = 1U << pad;
+	host_gpio_update(port);
+}
+
+void palTogglePad(ioportid_t port, uint32_t pad)
+{
+	if (port->ODR & (1U << pad))
+		palClearPad(port, pad);
+	else
+		palSetPad(port, pad);
+}
+
+uint32_t palReadPad(ioportid_t port, uint32_t pad)
+{
+	return (port->IDR >> pad) & 1;
+}
+
+void palWritePad(ioportid_t port, uint32_t pad, uint32_t bit)
+{
+	if (bit)
+		palSetPad(port, pad);
+	else
+		palClearPad(port, pad);
+}
+
+void palEnablePadEvent(ioportid_t port, uint32_t pad, uint32_t mode)
+{
+	pthread_mutex_lock(&gpio_mtx);
+	pal_events[pal_port_index(port)][pad].mode = mode;
+	pthread_mutex_unlock(&gpio_mtx);
+}
+
+void palDisablePadEvent(ioportid_t port, uint32_t pad)
+{
+	pthread_mutex_lock(&gpio_mtx);
+	memset(&pal_events[pal_port_index(port)][pad], 0, sizeof(pal_event_t));
+	pthread_mutex_unlock(&gpio_mtx);
+}
+
+void palSetPadCallback(ioportid_t port, uint32_t pad, palcallback_t cb,
+		       void *arg)
+{
+	pthread_mutex_lock(&gpio_mtx);
+	pal_events[pal_port_index(port)][pad].cb = cb;
+	pal_events[pal_port_index(port)][pad].arg = arg;
+	pthread_mutex_unlock(&gpio_mtx);
+}
+
+/*
+ * The ST HAL GPIO driver is linked with --wrap (see host.mk) so that the
+ * input register is up to date as soon as a pin is configured.
+ */
+void __real_HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init);
+void __real_HAL_GPIO_DeInit(GPIO_TypeDef *GPIOx, uint32_t GPIO_Pin);
+
+void __wrap_HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init)
+{
+	__real_HAL_GPIO_Init(GPIOx, GPIO_Init);
+	host_gpio_update((stm32_gpio_t *)GPIOx);
+}
+
+void __wrap_HAL_GPIO_DeInit(GPIO_TypeDef *GPIOx, uint32_t GPIO_Pin)
+{
+	__real_HAL_GPIO_DeInit(GPIOx, GPIO_Pin);
+	host_gpio_update((stm32_gpio_t *)GPIOx);
+}
+
+void usbStart(USBDriver *usbp, const USBConfig *config)
+{
+	usbp->config = config;
+	usbp->state = USB_ACTIVE;
+}
+
+void usbStop(USBDriver *usbp)
+{
+	usbp->state = USB_STOP;
+}
+
+void host_set_tty_link(USBDriver *usbp, const char *link)
+{
+	tty_links[usbp == &USBD2] = link;
+}
+
+void sduObjectInit(SerialUSBDriver *sdup)
+{
+	sdup->config = NULL;
+	sdup->fd = -1;
+	sdup->slave_fd = -1;
+	sdup->link = NULL;
+	sdup->nb_writes = 0;
+	sdup->nb_written = 0;
+}
+
+void sduStart(SerialUSBDriver *sdup, const SerialUSBConfig *config)
+{
+	struct termios tio;
+	const char *name;
+
+	sdup->config = config;
+	sdup->fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (sdup->fd < 0 || grantpt(sdup->fd) || unlockpt(sdup->fd))
+		chSysHalt("posix_openpt");
+
+	name = ptsname(sdup->fd);
+	sdup->slave_fd = open(name, O_RDWR | O_NOCTTY);
+	if (sdup->slave_fd < 0)
+		chSysHalt("ptsname");
+	tcgetattr(sdup->slave_fd, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(sdup->slave_fd, TCSANOW, &tio);
+
+	sdup->link = tty_links[config->usbp == &USBD2];
+	if (sdup->link != NULL) {
+		unlink(sdup->link);
+		if (symlink(name, sdup->link) != 0)
+			perror(sdup->link);
+	}
+	fprintf(stderr, "USB%d console: %s%s%s\n",
+		(config->usbp == &USBD2) ? 2 : 1, name,
+		sdup->link ? " -> " : "", sdup->link ? sdup->link : "");
+}
+
+void sduStop(SerialUSBDriver *sdup)
+{
+	if (sdup->fd < 0)
+		return;
+
+	if (sdup->link != NULL)
+		unlink(sdup->link);
+	close(sdup->slave_fd);
+	close(sdup->fd);
+	sdup->fd = -1;
+	sdup->slave_fd = -1;
+}
+
+/* Waits for the pseudo terminal until the end of the ChibiOS timeout */
+static bool sdu_poll(SerialUSBDriver *sdup, short events, systime_t start,
+		     sysinterval_t timeout)
+{
+	struct pollfd pfd;
+	sysinterval_t elapsed;
+	int ms;
+
+	if (timeout == TIME_INFINITE) {
+		ms = -1;
+	} else {
+		elapsed = chVTTimeElapsedSinceX(start);
+		ms = (elapsed < timeout) ? (int)TIME_I2MS(timeout - elapsed) : 0;
+	}
+
+	pfd.fd = sdup->fd;
+	pfd.events = events;
+	while (poll(&pfd, 1, ms) < 0) {
+		if (errno != EINTR)
+			return false;
+	}
+
+	return (pfd.revents & events) != 0;
+}
+
+size_t chnWriteTimeout(void *ip, const uint8_t *bp, size_t n,
+		       sysinterval_t timeout)
+{
+	SerialUSBDriver *sdup = ip;
+	systime_t start;
+	size_t done;
+	ssize_t len;
+
+	if (sdup->fd < 0)
+		return 0;
+
+	sdup->nb_writes++;
+	start = chVTGetSystemTimeX();
+	done = 0;
+	while (done < n) {
+		if (!sdu_poll(sdup, POLLOUT, start, timeout))
+			break;
+		len = write(sdup->fd, bp + done, n - done);
+		if (len < 0 && (errno == EAGAIN || errno == EINTR))
+			continue;
+		if (len <= 0)
+			break;
+		done += len;
+	}
+	sdup->nb_written += done;
+
+	return done;
+}
+
+size_t chnReadTimeout(void *ip, uint8_t *bp, size_t n, sysinterval_t timeout)
+{
+	SerialUSBDriver *sdup = ip;
+	systime_t start;
+	size_t done;
+	ssize_t len;
+
+	if (sdup->fd < 0)
+		return 0;
+
+	start = chVTGetSystemTimeX();
+	done = 0;
+	while (done < n) {
+		if (!sdu_poll(sdup, POLLIN, start, timeout))
+			break;
+		len = read(sdup->fd, bp + done, n - done);
+		if (len < 0 && (errno == EAGAIN || errno == EINTR))
+			continue;
+		if (len <= 0)
+			break;
+		done += len;
+	}
+
+	return done;
+}
+
+void sdcStart(SDCDriver *sdcp, const SDCConfig *config)
+{
+	(void)sdcp;
+	(void)config;
+}
+
+void sdcStop(SDCDriver *sdcp)
+{
+	sdcp->inserted = false;
+}
+
+bool sdcIsCardInserted(SDCDriver *sdcp)
+{
+	(void)sdcp;
+
+	return ff_host_get_root() != NULL;
+}
+
+bool sdcConnect(SDCDriver *sdcp)
+{
+	struct statvfs st;
+	uint64_t blocks;
+
+	if (!sdcIsCardInserted(sdcp))
+		return HAL_FAILED;
+
+	blocks = 0;
+	if (statvfs(ff_host_get_root(), &st) == 0)
+		blocks = (uint64_t)st.f_blocks * st.f_frsize / MMCSD_BLOCK_SIZE;
+	if (blocks > UINT32_MAX)
+		blocks = UINT32_MAX;
+
+	sdcp->inserted = true;
+	sdcp->cardmode = SDC_MODE_CARDTYPE_SDV20 | SDC_MODE_HIGH_CAPACITY;
+	sdcp->capacity = blocks;
+
+	return HAL_SUCCESS;
+}
+
+bool sdcDisconnect(SDCDriver *sdcp)
+{
+	sdcp->inserted = false;
+
+	return HAL_SUCCESS;
+}
+
+/* There is no block device behind the SD directory */
+bool sdcRead(SDCDriver *sdcp, uint32_t startblk, uint8_t *buf, uint32_t n)
+{
+	(void)sdcp;
+	(void)startblk;
+	(void)buf;
+	(void)n;
+
+	return HAL_FAILED;
+}
+
+bool sdcWrite(SDCDriver *sdcp, uint32_t startblk, const uint8_t *buf,
+	      uint32_t n)
+{
+	(void)sdcp;
+	(void)startblk;
+	(void)buf;
+	(void)n;
+
+	return HAL_FAILED;
+}
@@ -0,0 +1,170 @@
+##############################################################################
+# Host build of HydraFW (make host)
+#
+# Builds common/ and hydrabus/ for Linux against a minimal ChibiOS/HAL/FatFs
+# shim (host/) and mocked bsp_* drivers (host/bsp/).
+# The GPIO, trigger and bit banged I2C master drivers are the real ones,
+# the peripheral registers are memory mapped at their STM32 addresses.
+# Each USB console is a pseudo terminal, the HydraNFC v2 RFAL runs against
+# a ST25R3916 mock, a SPI NOR flash or an AVR ISP model can be attached to
+# SPI1, an I2C FRAM model to the I2C1 pins and a NAND model to the
+# nandflash mode pins.
+#
+#   make host
+#   ./build-host/hydrafw --sd <dir> --tty1 /tmp/hydrabus1 --tty2 /tmp/hydrabus2
+#   ./build-host/hydrafw --spi-flash --i2c-fram --tty1 /tmp/hydrabus
+#   ./build-host/hydrafw --avr --nand --tty1 /tmp/hydrabus
+#
+# The tests in host/test/ are linked with the same objects, without
+# host_main.c, and run by:
+#
+#   make host-test
+#
+
+HOST_BUILDDIR = build-host
+HOST_OBJDIR = $(HOST_BUILDDIR)/obj
+HOST_PROJECT = $(HOST_BUILDDIR)/hydrafw
+
+HOST_CC ?= gcc
+
+include common/common.mk
+include hydrabus/hydrabus.mk
+include drv/stm32cube/stm32f4xx_hal.mk
+include hydranfc_v2/hal.mk
+include hydranfc_v2/rfal.mk
+include hydranfc_v2/lib.mk
+
+# USB descriptors are replaced by the pseudo terminals
+HOST_COMMONSRC = $(filter-out common/usb1cfg.c common/usb2cfg.c,$(COMMONSRC))
+
+HOST_SHIMSRC = host/chibios.c \
+               host/hal.c \
+               host/ff.c \
+               host/host_main.c
+
+HOST_BSPSRC = host/bsp/bsp.c \
+              host/bsp/bsp_adc.c \
+              host/bsp/bsp_can.c \
+              host/bsp/bsp_dac.c \
+              host/bsp/bsp_freq.c \
+              host/bsp/bsp_i2c_slave.c \
+              host/bsp/bsp_pwm.c \
+              host/bsp/bsp_rng.c \
+              host/bsp/bsp_smartcard.c \
+              host/bsp/bsp_spi.c \
+              host/bsp/bsp_tim.c \
+              host/bsp/bsp_uart.c \
+              host/spi_flash.c \
+              host/i2c_fram.c \
+              host/avr_isp.c \
+              host/nand.c
+
+# HydraNFC v2: the RFAL drives a ST25R3916 mock (host/st25r3916.c).
+# hydranfc_v2.c and rfal_poller.c (the console mode), the NDEF wrappers,
+# the USB HID stream dispatcher and the UART logger are not built, their
+# headers and libraries (lib_NDEF, TruST25, USB device) are not in the tree.
+HOST_NFCSRC = $(HYDRANFC_V2_RFAL_SRC) \
+              hydranfc_v2/hal/src/led.c \
+              hydranfc_v2/hal/src/spi.c \
+              hydranfc_v2/hal/src/timer.c \
+              hydranfc_v2/hal/src/rfal_analogConfigCustomTbl.c \
+              hydranfc_v2/lib/st25r/src/st25r.c \
+              host/st25r3916.c
+
+HOST_CSRC = $(HOST_COMMONSRC) \
+            $(HYDRABUSSRC) \
+            $(HOST_SHIMSRC) \
+            $(HOST_BSPSRC) \
+            $(HOST_NFCSRC) \
+            drv/stm32cube/bsp_gpio.c \
+            drv/stm32cube/bsp_i2c_master.c \
+            drv/stm32cube/bsp_trigger.c \
+            drv/stm32cube/stm32f4xx_hal/src/stm32f4xx_hal_gpio.c \
+            tokenline/tokenline.c \
+            main.c
+
+# The shim headers shadow the ChibiOS ones
+HOST_INCDIR = ./host/include \
+              $(COMMONINC) \
+              $(HYDRABUSINC) \
+              ./board \
+              $(STM32F4XX_HAL_INC) \
+              $(HYDRANFC_V2_HAL_INC) \
+              $(HYDRANFC_V2_RFAL_INC) \
+              $(HYDRANFC_V2_LIB_INC) \
+              tokenline \
+              ./host/test \
+              $(HOST_BUILDDIR)
+
+HOST_CFLAGS = -O1 -ggdb -std=gnu89 -pthread -Wall -Wextra -Wundef \
+              -Wstrict-prototypes -Wno-pointer-to-int-cast \
+              -Wno-int-to-pointer-cast -DHYDRAFW_HOST \
+              $(addprefix -I,$(HOST_INCDIR))
+HOST_LDFLAGS = -pthread \
+               -Wl,--wrap=HAL_GPIO_Init -Wl,--wrap=HAL_GPIO_DeInit
+HOST_LIBS = -lm
+
+HOST_OBJS = $(addprefix $(HOST_OBJDIR)/,$(HOST_CSRC:.c=.o))
+
+HOST_TESTSRC = host/test/test_shim.c \
+               host/test/test_console_tx.c \
+               host/test/test_sd_log.c \
+               host/test/test_st25r3916.c \
+               host/test/test_hexdump.c \
+               host/test/test_sbuf.c \
+               host/test/test_mode_bulk.c \
+               host/test/test_spi_dma.c \
+               host/test/test_spi_flash.c \
+               host/test/test_spi_sniff.c \
+               host/test/test_bbio_bulk.c \
+               host/test/test_avr_isp.c \
+               host/test/test_nand_dump.c \
+               host/test/test_sump_trigger.c \
+               host/test/test_i2c_sniff.c \
+               host/test/test_i2c_regmap.c
+
+HOST_TESTS = $(addprefix $(HOST_BUILDDIR)/,$(basename $(HOST_TESTSRC)))
+HOST_TESTOBJS = $(filter-out $(HOST_OBJDIR)/host/host_main.o,$(HOST_OBJS)) \
+                $(HOST_OBJDIR)/host/test/host_test.o
+
+.PHONY: host host-test host-clean FORCE
+
+host: $(HOST_PROJECT) $(HOST_TESTS)
+
+$(HOST_PROJECT): $(HOST_OBJS)
+	@echo Linking $@
+	@$(HOST_CC) $(HOST_LDFLAGS) -o $@ $(HOST_OBJS) $(HOST_LIBS)
+
+$(HOST_BUILDDIR)/host/test/%: $(HOST_OBJDIR)/host/test/%.o $(HOST_TESTOBJS)
+	@mkdir -p $(dir $@)
+	@echo Linking $@
+	@$(HOST_CC) $(HOST_LDFLAGS) -o $@ $< $(HOST_TESTOBJS) $(HOST_LIBS)
+
+host-test: $(HOST_TESTS)
+	@for t in $(HOST_TESTS); do ./$$t || exit 1; done
+
+# The ST code is kept as delivered, its warnings are not reported
+$(addprefix $(HOST_OBJDIR)/,$(filter hydranfc_v2/%,$(HOST_NFCSRC:.c=.o))): \
+	HOST_CFLAGS += -Wno-unused-parameter -Wno-sign-compare -Wno-type-limits \
+		       -Wno-switch -Wno-implicit-function-declaration
+
+# The firmware main() is started from host/host_main.c
+$(HOST_OBJDIR)/main.o: HOST_CFLAGS += -Dmain=hydrafw_main
+
+$(HOST_OBJDIR)/common/common.o: $(HOST_BUILDDIR)/hydrafw_version.hdr
+
+$(HOST_OBJDIR)/%.o: %.c
+	@mkdir -p $(dir $@)
+	@echo Compiling $<
+	@$(HOST_CC) $(HOST_CFLAGS) -MMD -MP -c $< -o $@
+
+$(HOST_BUILDDIR)/hydrafw_version.hdr: FORCE
+	@mkdir -p $(dir $@)
+	@echo Creating $@
+	@python build-scripts/hydrafw-version.py $@
+
+host-clean:
+	rm -rf $(HOST_BUILDDIR)
+
+-include $(HOST_OBJS:.o=.d) $(HOST_TESTOBJS:.o=.d) \
+         $(addprefix $(HOST_OBJDIR)/,$(HOST_TESTSRC:.c=.d))
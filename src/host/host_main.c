@@ -0,0 +1,141 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host build entry point.
+ * The STM32 registers are mapped as plain memory (see host_map_registers()),
+ * then the firmware main() is started.
+ *
+ *   --sd <dir>     directory used as the microSD card, no card if not given
+ *   --tty1 <link>  symlink created to the USB1 console pseudo terminal
+ *   --tty2 <link>  symlink created to the USB2 console pseudo terminal
+ *   --spi-flash    1MB SPI NOR flash on SPI1 (see host/spi_flash.c), MISO
+ *                  is wired to MOSI otherwise
+ *   --avr          ATmega2560 serial programming interface on SPI1 (see
+ *                  host/avr_isp.c), instead of --spi-flash
+ *   --i2c-fram     64KB I2C FRAM at address 0x50 on the I2C1 pins (see
+ *                  host/i2c_fram.c)
+ *   --nand         2Gbit ONFI NAND on the nandflash mode pins (see
+ *                  host/nand.c), instead of --i2c-fram (both on GPIOB)
+ *   --uart1 <link> symlink created to a pseudo terminal standing for the
+ *                  UART1 peer, RX is wired to TX otherwise
+ *
+ * SIGUSR1 toggles the UBTN state.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/stat.h>
+
+#include "hal.h"
+#include "ff.h"
+#include "bsp_host.h"
+
+int hydrafw_main(void);
+
+static void ubtn_handler(int sig)
+{
+	(void)sig;
+	host_ubtn_toggle();
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [--sd <dir>] [--tty1 <link>] [--tty2 <link>] [--spi-flash]\n"
+		"       [--avr] [--i2c-fram] [--nand] [--uart1 <link>]\n",
+		name);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option options[] = {
+		{ "sd", required_argument, NULL, 's' },
+		{ "tty1", required_argument, NULL, '1' },
+		{ "tty2", required_argument, NULL, '2' },
+		{ "spi-flash", no_argument, NULL, 'f' },
+		{ "avr", no_argument, NULL, 'a' },
+		{ "i2c-fram", no_argument, NULL, 'i' },
+		{ "nand", no_argument, NULL, 'n' },
+		{ "uart1", required_argument, NULL, 'u' },
+		{ "help", no_argument, NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+	static char sd_root[PATH_MAX];
+	struct stat st;
+	bool i2c_fram, nand;
+	int c;
+
+	i2c_fram = FALSE;
+	nand = FALSE;
+
+	while ((c = getopt_long(argc, argv, "h", options, NULL)) != -1) {
+		switch (c) {
+		case 's':
+			if (realpath(optarg, sd_root) == NULL ||
+			    stat(sd_root, &st) != 0 || !S_ISDIR(st.st_mode)) {
+				fprintf(stderr, "%s: not a directory\n", optarg);
+				return 1;
+			}
+			ff_host_set_root(sd_root);
+			break;
+		case '1':
+			host_set_tty_link(&USBD1, optarg);
+			break;
+		case '2':
+			host_set_tty_link(&USBD2, optarg);
+			break;
+		case 'f':
+			host_spi_flash_attach(BSP_DEV_SPI1, HOST_SPI_FLASH_DENSITY);
+			break;
+		case 'a':
+			host_avr_attach(BSP_DEV_SPI1);
+			break;
+		case 'i':
+			i2c_fram = TRUE;
+			break;
+		case 'n':
+			nand = TRUE;
+			break;
+		case 'u':
+			bsp_host_uart_peer(BSP_DEV_UART1, optarg);
+			break;
+		case 'h':
+			usage(argv[0]);
+			return 0;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	host_map_registers();
+	/* The models drive the GPIO registers */
+	if (i2c_fram)
+		host_i2c_fram_attach();
+	if (nand)
+		host_nand_attach();
+	signal(SIGUSR1, ubtn_handler);
+
+	return hydrafw_main();
+}
@@ -0,0 +1,177 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host build: 64KB I2C FRAM (MB85RC512T like) at HOST_I2C_FRAM_ADDR on the
+ * bit banged I2C1 pins, PB6 SCL and PB7 SDA.
+ * Writes set the 16 bits address (big endian) then store the data, reads
+ * start at the current address, which wraps around at the end.
+ * The model follows the bus levels from host_gpio_update(), SDA is pulled
+ * low on the falling edges of SCL.
+ */
+
+#include <string.h>
+
+#include "hal.h"
+#include "bsp_host.h"
+
+#define SCL_PAD		6
+#define SDA_PAD		7
+
+typedef enum {
+	FRAM_IDLE = 0,
+	FRAM_ADDR,
+	FRAM_WRITE,
+	FRAM_READ,
+} t_fram_state;
+
+typedef struct {
+	t_fram_state state;
+	bool start; /* SCL still high after a START */
+	uint8_t nb_bits; /* Clocks since the start of the byte */
+	uint8_t shift;
+	uint8_t nb_addr; /* Address bytes received */
+	bool read;
+	bool master_ack;
+	uint8_t out;
+	uint16_t addr;
+	uint32_t last;
+	uint32_t low;
+} t_fram;
+
+static uint8_t fram_mem[HOST_I2C_FRAM_SIZE];
+static t_fram fram;
+
+static void drive_bit(bool bit)
+{
+	fram.low = bit ? 0 : 1U << SDA_PAD;
+}
+
+static void load_byte(void)
+{
+	fram.out = fram_mem[fram.addr++];
+	drive_bit(fram.out & 0x80);
+}
+
+/* Returns FALSE to NACK the byte */
+static bool byte_in(void)
+{
+	if (fram.state == FRAM_ADDR) {
+		if ((fram.shift >> 1) != HOST_I2C_FRAM_ADDR)
+			return FALSE;
+		fram.read = fram.shift & 1;
+	} else if (fram.nb_addr < 2) {
+		fram.addr = (fram.addr << 8) | fram.shift;
+		fram.nb_addr++;
+	} else {
+		fram_mem[fram.addr++] = fram.shift;
+	}
+	return TRUE;
+}
+
+static void scl_rising(bool sda)
+{
+	if ((fram.state == FRAM_ADDR || fram.state == FRAM_WRITE) &&
+	    fram.nb_bits < 8)
+		fram.shift = (fram.shift << 1) | sda;
+	else if (fram.state == FRAM_READ && fram.nb_bits == 8)
+		fram.master_ack = !sda;
+}
+
+static void scl_falling(void)
+{
+	if (fram.state == FRAM_IDLE)
+		return;
+	if (fram.start) {
+		fram.start = FALSE;
+		return;
+	}
+
+	fram.nb_bits++;
+	if (fram.state == FRAM_READ) {
+		if (fram.nb_bits < 8) {
+			drive_bit(fram.out & (0x80 >> fram.nb_bits));
+		} else if (fram.nb_bits == 8) {
+			drive_bit(TRUE);
+		} else if (fram.master_ack) {
+			fram.nb_bits = 0;
+			load_byte();
+		} else {
+			fram.state = FRAM_IDLE;
+		}
+		return;
+	}
+
+	if (fram.nb_bits == 8) {
+		if (byte_in()) {
+			drive_bit(FALSE);
+		} else {
+			fram.state = FRAM_IDLE;
+			drive_bit(TRUE);
+		}
+	} else if (fram.nb_bits == 9) {
+		drive_bit(TRUE);
+		fram.nb_bits = 0;
+		if (fram.state == FRAM_ADDR) {
+			if (fram.read) {
+				fram.state = FRAM_READ;
+				load_byte();
+			} else {
+				fram.state = FRAM_WRITE;
+				fram.nb_addr = 0;
+			}
+		}
+	}
+}
+
+static uint32_t fram_gpio(uint32_t idr)
+{
+	uint32_t scl, sda, last_scl, last_sda;
+
+	scl = (idr >> SCL_PAD) & 1;
+	sda = (idr >> SDA_PAD) & 1;
+	last_scl = (fram.last >> SCL_PAD) & 1;
+	last_sda = (fram.last >> SDA_PAD) & 1;
+	fram.last = idr;
+
+	if (scl && last_scl && sda != last_sda) {
+		/* START or STOP */
+		fram.state = sda ? FRAM_IDLE : FRAM_ADDR;
+		fram.start = !sda;
+		fram.nb_bits = 0;
+		drive_bit(TRUE);
+	} else if (scl && !last_scl) {
+		scl_rising(sda);
+	} else if (!scl && last_scl) {
+		scl_falling();
+	}
+	return fram.low;
+}
+
+void host_i2c_fram_attach(void)
+{
+	memset(fram_mem, 0xFF, sizeof(fram_mem));
+	memset(&fram, 0, sizeof(fram));
+	fram.last = (1U << SCL_PAD) | (1U << SDA_PAD);
+	host_gpio_set_device(GPIOB, fram_gpio);
+}
+
+uint8_t host_i2c_fram_data(uint16_t addr)
+{
+	return fram_mem[addr];
+}
@@ -0,0 +1,91 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _BSP_HOST_H_
+#define _BSP_HOST_H_
+
+#include <stdint.h>
+#include "bsp_spi.h"
+#include "bsp_uart.h"
+
+/*
+ * Transfer calls made to the host BSP mocks, each one stands for one
+ * HAL transfer (and its setup) on the target.
+ * SPI DMA transfers are also counted in BSP_HOST_SPI.
+ */
+typedef enum {
+	BSP_HOST_SPI = 0,
+	BSP_HOST_SPI_DMA,
+	BSP_HOST_UART_TX,
+	BSP_HOST_UART_RX,
+	BSP_HOST_NB_DRIVERS
+} bsp_host_driver_t;
+
+typedef struct {
+	uint32_t calls[BSP_HOST_NB_DRIVERS];
+	uint32_t bytes[BSP_HOST_NB_DRIVERS];
+} t_bsp_host_stats;
+
+void bsp_host_count(bsp_host_driver_t drv, uint32_t nb_data);
+void bsp_host_get_stats(t_bsp_host_stats *stats);
+void bsp_host_reset_stats(void);
+
+void bsp_host_spi_dma_fail(bsp_dev_spi_t dev_num);
+
+/*
+ * Device model on a SPI bus. xfer() is called for the bytes exchanged
+ * while CS is low, tx_data is NULL when 0xFF is sent and rx_data is NULL
+ * when the received data is dropped.
+ */
+typedef struct {
+	void (*select)(bool selected);
+	void (*xfer)(const uint8_t *tx_data, uint8_t *rx_data, uint16_t nb_data);
+} t_bsp_host_spi_dev;
+
+void bsp_host_spi_attach(bsp_dev_spi_t dev_num, const t_bsp_host_spi_dev *dev);
+void bsp_host_spi_circular_rx(bsp_dev_spi_t dev_num, const uint8_t *data, uint32_t nb_data);
+
+void bsp_host_uart_peer(bsp_dev_uart_t dev_num, const char *link);
+
+/* 1MB SPI NOR flash with SFDP, see host/spi_flash.c */
+#define HOST_SPI_FLASH_DENSITY (8 * 1024 * 1024 - 1)
+void host_spi_flash_attach(bsp_dev_spi_t dev_num, uint32_t density);
+uint8_t host_spi_flash_data(uint32_t addr);
+
+/* 64KB I2C FRAM on the bit banged I2C1 pins, see host/i2c_fram.c */
+#define HOST_I2C_FRAM_ADDR	0x50
+#define HOST_I2C_FRAM_SIZE	0x10000
+void host_i2c_fram_attach(void);
+uint8_t host_i2c_fram_data(uint16_t addr);
+
+/* ATmega2560 serial programming, RESET on the SPI CS, see host/avr_isp.c */
+#define HOST_AVR_FLASH_SIZE	0x40000
+void host_avr_attach(bsp_dev_spi_t dev_num);
+uint8_t host_avr_flash_data(uint32_t addr);
+
+/* 2Gbit ONFI NAND on the nandflash mode pins, see host/nand.c */
+#define HOST_NAND_PAGE_SIZE		(2048 + 64)
+#define HOST_NAND_PAGES_PER_BLOCK	64
+#define HOST_NAND_NB_BLOCKS		2048
+/* Bad block marker cleared in their first page */
+#define HOST_NAND_BAD_BLOCKS		{ 3, 40 }
+void host_nand_attach(void);
+void host_nand_page(uint32_t row, uint8_t *data, bool errors);
+const uint8_t *host_nand_onfi_param(void);
+
+#endif /* _BSP_HOST_H_ */
@@ -0,0 +1,232 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host build: minimal ChibiOS/RT API on top of POSIX threads.
+ * Only the subset used by common/ and hydrabus/ is provided, each ChibiOS
+ * thread is a pthread and priorities are only recorded.
+ */
+
+#ifndef _CH_H_
+#define _CH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#if !defined(FALSE)
+#define FALSE 0
+#endif
+#if !defined(TRUE)
+#define TRUE 1
+#endif
+
+#include "chconf.h"
+
+#define CH_KERNEL_VERSION	"5.1.0 (host shim)"
+#define PORT_ARCHITECTURE_NAME	"Host (POSIX threads)"
+
+typedef uint32_t systime_t;
+typedef uint32_t sysinterval_t;
+typedef uint64_t time_conv_t;
+typedef uint32_t time_msecs_t;
+typedef uint32_t time_usecs_t;
+typedef int32_t msg_t;
+typedef uint32_t tprio_t;
+typedef int32_t cnt_t;
+typedef uint32_t rtcnt_t;
+typedef uint64_t stkalign_t;
+typedef uint32_t syssts_t;
+
+#define MSG_OK		(msg_t)0
+#define MSG_TIMEOUT	(msg_t)-1
+#define MSG_RESET	(msg_t)-2
+
+#define IDLEPRIO	(tprio_t)1
+#define LOWPRIO		(tprio_t)2
+#define NORMALPRIO	(tprio_t)128
+#define HIGHPRIO	(tprio_t)255
+
+#define TIME_IMMEDIATE	((sysinterval_t)0)
+#define TIME_INFINITE	((sysinterval_t)-1)
+
+#define TIME_S2I(secs)							\
+	((sysinterval_t)((time_conv_t)(secs) * (time_conv_t)CH_CFG_ST_FREQUENCY))
+#define TIME_MS2I(msecs)						\
+	((sysinterval_t)((((time_conv_t)(msecs) *			\
+			   (time_conv_t)CH_CFG_ST_FREQUENCY) +		\
+			  (time_conv_t)999) / (time_conv_t)1000))
+#define TIME_US2I(usecs)						\
+	((sysinterval_t)((((time_conv_t)(usecs) *			\
+			   (time_conv_t)CH_CFG_ST_FREQUENCY) +		\
+			  (time_conv_t)999999) / (time_conv_t)1000000))
+#define TIME_I2MS(interval)						\
+	(time_msecs_t)((((time_conv_t)(interval) * (time_conv_t)1000) +	\
+			(time_conv_t)CH_CFG_ST_FREQUENCY - (time_conv_t)1) /	\
+		       (time_conv_t)CH_CFG_ST_FREQUENCY)
+#define TIME_I2US(interval)						\
+	(time_usecs_t)((((time_conv_t)(interval) * (time_conv_t)1000000) + \
+			(time_conv_t)CH_CFG_ST_FREQUENCY - (time_conv_t)1) /	\
+		       (time_conv_t)CH_CFG_ST_FREQUENCY)
+
+/* Pre 18.x names */
+#define S2ST(sec)	TIME_S2I(sec)
+#define MS2ST(msec)	TIME_MS2I(msec)
+#define US2ST(usec)	TIME_US2I(usec)
+#define ST2MS(n)	TIME_I2MS(n)
+#define ST2US(n)	TIME_I2US(n)
+
+/* Working areas are kept for the API, threads run on their pthread stack */
+#define THD_WORKING_AREA_SIZE(n)	((size_t)(n))
+#define THD_WORKING_AREA(s, n)						\
+	stkalign_t s[(THD_WORKING_AREA_SIZE(n) + sizeof(stkalign_t) - 1) / \
+		     sizeof(stkalign_t)]
+#define THD_FUNCTION(tname, arg) void tname(void *arg)
+typedef void (*tfunc_t)(void *p);
+
+#define CH_STATE_READY		(uint8_t)0
+#define CH_STATE_CURRENT	(uint8_t)1
+#define CH_STATE_WTSEM		(uint8_t)5
+#define CH_STATE_WTMTX		(uint8_t)6
+#define CH_STATE_SLEEPING	(uint8_t)8
+#define CH_STATE_FINAL		(uint8_t)15
+#define CH_STATE_NAMES							\
+	"READY", "CURRENT", "WTSTART", "SUSPENDED", "QUEUED", "WTSEM",	\
+	"WTMTX", "WTCOND", "SLEEPING", "WTEXIT", "WTOREVT", "WTANDEVT",	\
+	"SNDMSGQ", "SNDMSG", "WTMSG", "FINAL"
+
+struct port_context {
+	void *sp;
+};
+
+typedef struct ch_thread {
+	const char *name;
+	tprio_t prio;
+	volatile uint8_t state;
+	/* Thread and registry references */
+	cnt_t refs;
+	stkalign_t *wabase;
+	struct port_context ctx;
+	volatile bool terminate;
+	msg_t exit_msg;
+	tfunc_t func;
+	void *arg;
+	pthread_t pthread;
+	struct ch_thread *next;
+} thread_t;
+
+typedef struct {
+	pthread_mutex_t mtx;
+} mutex_t;
+
+#define _MUTEX_DATA(name) { PTHREAD_MUTEX_INITIALIZER }
+#define MUTEX_DECL(name) mutex_t name = _MUTEX_DATA(name)
+
+typedef struct {
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	cnt_t cnt;
+} semaphore_t;
+
+#define _SEMAPHORE_DATA(name, n)					\
+	{ PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, n }
+#define SEMAPHORE_DECL(name, n) semaphore_t name = _SEMAPHORE_DATA(name, n)
+
+typedef struct {
+	semaphore_t sem;
+} binary_semaphore_t;
+
+#define _BSEMAPHORE_DATA(name, taken)					\
+	{ _SEMAPHORE_DATA(name.sem, ((taken) ? 0 : 1)) }
+#define BSEMAPHORE_DECL(name, taken)					\
+	binary_semaphore_t name = _BSEMAPHORE_DATA(name, taken)
+
+typedef struct memory_heap memory_heap_t;
+
+/* System */
+void chSysInit(void);
+void chSysLock(void);
+void chSysUnlock(void);
+#define chSysLockFromISR()	chSysLock()
+#define chSysUnlockFromISR()	chSysUnlock()
+void chSysHalt(const char *reason);
+#define chDbgCheck(c) do {						\
+		if (!(c))						\
+			chSysHalt(__func__);				\
+	} while (0)
+#define chDbgAssert(c, r) do {						\
+		if (!(c))						\
+			chSysHalt(r);					\
+	} while (0)
+
+/* Time */
+systime_t chVTGetSystemTimeX(void);
+#define chVTGetSystemTime()	chVTGetSystemTimeX()
+#define chVTTimeElapsedSinceX(start)					\
+	((sysinterval_t)(chVTGetSystemTimeX() - (systime_t)(start)))
+#define chVTIsSystemTimeWithinX(start, end)				\
+	((systime_t)(chVTGetSystemTimeX() - (systime_t)(start)) <	\
+	 (systime_t)((systime_t)(end) - (systime_t)(start)))
+#define chVTIsSystemTimeWithin(start, end)	chVTIsSystemTimeWithinX(start, end)
+
+/* Threads */
+thread_t *chThdCreateStatic(void *wsp, size_t size, tprio_t prio,
+			    tfunc_t pf, void *arg);
+thread_t *chThdCreateFromHeap(memory_heap_t *heapp, size_t size,
+			      const char *name, tprio_t prio,
+			      tfunc_t pf, void *arg);
+thread_t *chThdGetSelfX(void);
+tprio_t chThdGetPriorityX(void);
+void chThdTerminate(thread_t *tp);
+bool chThdShouldTerminateX(void);
+bool chThdTerminatedX(thread_t *tp);
+msg_t chThdWait(thread_t *tp);
+void chThdExit(msg_t msg);
+void chThdSleep(sysinterval_t time);
+#define chThdSleepSeconds(sec)		chThdSleep(TIME_S2I(sec))
+#define chThdSleepMilliseconds(msec)	chThdSleep(TIME_MS2I(msec))
+#define chThdSleepMicroseconds(usec)	chThdSleep(TIME_US2I(usec))
+void chThdYield(void);
+void chRegSetThreadName(const char *name);
+thread_t *chRegFirstThread(void);
+thread_t *chRegNextThread(thread_t *tp);
+
+/* Mutexes */
+void chMtxObjectInit(mutex_t *mp);
+void chMtxLock(mutex_t *mp);
+bool chMtxTryLock(mutex_t *mp);
+void chMtxUnlock(mutex_t *mp);
+
+/* Semaphores */
+void chSemObjectInit(semaphore_t *sp, cnt_t n);
+msg_t chSemWait(semaphore_t *sp);
+msg_t chSemWaitTimeout(semaphore_t *sp, sysinterval_t timeout);
+void chSemSignal(semaphore_t *sp);
+#define chSemSignalI(sp)	chSemSignal(sp)
+void chBSemObjectInit(binary_semaphore_t *bsp, bool taken);
+msg_t chBSemWaitTimeout(binary_semaphore_t *bsp, sysinterval_t timeout);
+#define chBSemWait(bsp)		chBSemWaitTimeout(bsp, TIME_INFINITE)
+void chBSemSignal(binary_semaphore_t *bsp);
+#define chBSemSignalI(bsp)	chBSemSignal(bsp)
+
+/* Memory, the host heap is not accounted */
+size_t chHeapStatus(memory_heap_t *heapp, size_t *totalp, size_t *largestp);
+size_t chCoreGetStatusX(void);
+
+#endif /* _CH_H_ */
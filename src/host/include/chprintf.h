@@ -0,0 +1,30 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host build: ChibiOS formatted output is the C library one */
+
+#ifndef _CHPRINTF_H_
+#define _CHPRINTF_H_
+
+#include <stdio.h>
+#include "hal.h"
+
+#define chsnprintf	snprintf
+#define chvsnprintf	vsnprintf
+
+#endif /* _CHPRINTF_H_ */
@@ -0,0 +1,132 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host build: the parts of the CMSIS Cortex-M4 core header needed by the
+ * STM32F4 device and HAL headers.
+ * The core peripherals live at their usual addresses, which are mapped to
+ * plain memory by host_map_registers() (see hal.c).
+ */
+
+#ifndef _CORE_CM4_H_
+#define _CORE_CM4_H_
+
+#include <stdint.h>
+
+#define __I	volatile const
+#define __O	volatile
+#define __IO	volatile
+#define __IM	volatile const
+#define __OM	volatile
+#define __IOM	volatile
+
+#ifndef __STATIC_INLINE
+#define __STATIC_INLINE static inline
+#endif
+#ifndef __ASM
+#define __ASM __asm__
+#endif
+#ifndef __ALIGNED
+#define __ALIGNED(x) __attribute__((aligned(x)))
+#endif
+
+#define __NOP()			__asm__ volatile("nop")
+#define __DSB()			__sync_synchronize()
+#define __ISB()			__sync_synchronize()
+#define __DMB()			__sync_synchronize()
+#define __enable_irq()		do { } while (0)
+#define __disable_irq()		do { } while (0)
+
+typedef struct {
+	__IOM uint32_t ISER[8U];
+	uint32_t RESERVED0[24U];
+	__IOM uint32_t ICER[8U];
+	uint32_t RESERVED1[24U];
+	__IOM uint32_t ISPR[8U];
+	uint32_t RESERVED2[24U];
+	__IOM uint32_t ICPR[8U];
+	uint32_t RESERVED3[24U];
+	__IOM uint32_t IABR[8U];
+	uint32_t RESERVED4[56U];
+	__IOM uint8_t IP[240U];
+	uint32_t RESERVED5[644U];
+	__OM uint32_t STIR;
+} NVIC_Type;
+
+typedef struct {
+	__IM uint32_t CPUID;
+	__IOM uint32_t ICSR;
+	__IOM uint32_t VTOR;
+	__IOM uint32_t AIRCR;
+	__IOM uint32_t SCR;
+	__IOM uint32_t CCR;
+	__IOM uint8_t SHP[12U];
+	__IOM uint32_t SHCSR;
+	__IOM uint32_t CFSR;
+	__IOM uint32_t HFSR;
+	__IOM uint32_t DFSR;
+	__IOM uint32_t MMFAR;
+	__IOM uint32_t BFAR;
+	__IOM uint32_t AFSR;
+	__IM uint32_t PFR[2U];
+	__IM uint32_t DFR;
+	__IM uint32_t ADR;
+	__IM uint32_t MMFR[4U];
+	__IM uint32_t ISAR[5U];
+	uint32_t RESERVED0[5U];
+	__IOM uint32_t CPACR;
+} SCB_Type;
+
+typedef struct {
+	__IOM uint32_t CTRL;
+	__IOM uint32_t LOAD;
+	__IOM uint32_t VAL;
+	__IM uint32_t CALIB;
+} SysTick_Type;
+
+typedef struct {
+	__IOM uint32_t DHCSR;
+	__OM uint32_t DCRSR;
+	__IOM uint32_t DCRDR;
+	__IOM uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define SCS_BASE		(0xE000E000UL)
+#define SysTick_BASE		(SCS_BASE + 0x0010UL)
+#define NVIC_BASE		(SCS_BASE + 0x0100UL)
+#define SCB_BASE		(SCS_BASE + 0x0D00UL)
+#define CoreDebug_BASE		(0xE000EDF0UL)
+
+#define SCB			((SCB_Type *)SCB_BASE)
+#define SysTick			((SysTick_Type *)SysTick_BASE)
+#define NVIC			((NVIC_Type *)NVIC_BASE)
+#define CoreDebug		((CoreDebug_Type *)CoreDebug_BASE)
+
+#define CoreDebug_DEMCR_TRCENA_Msk	(1UL << 24U)
+
+/* No interrupts on the host, the IRQ numbers are only recorded */
+static inline void NVIC_EnableIRQ(int IRQn) { (void)IRQn; }
+static inline void NVIC_DisableIRQ(int IRQn) { (void)IRQn; }
+static inline void NVIC_ClearPendingIRQ(int IRQn) { (void)IRQn; }
+static inline void NVIC_SetPriority(int IRQn, uint32_t priority)
+{
+	(void)IRQn;
+	(void)priority;
+}
+
+#endif /* _CORE_CM4_H_ */
@@ -0,0 +1,164 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host build: FatFs R0.12 API on top of a host directory used as the SD
+ * card root, given with --sd on the command line.
+ * Only one volume, "0:" prefixes are ignored and the volume is never
+ * formatted.
+ */
+
+#ifndef _FF_H_
+#define _FF_H_
+
+#include <stdint.h>
+
+typedef unsigned int UINT;
+typedef unsigned char BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef uint64_t QWORD;
+typedef char TCHAR;
+typedef DWORD FSIZE_t;
+
+#define _MAX_LFN	255
+
+typedef struct {
+	BYTE fs_type;
+	/* Sectors per cluster */
+	WORD csize;
+	/* Current directory, relative to the root, "" for the root */
+	char cwd[_MAX_LFN + 1];
+} FATFS;
+
+typedef struct {
+	FATFS *fs;
+	FSIZE_t objsize;
+} _FDID;
+
+typedef struct {
+	_FDID obj;
+	BYTE flag;
+	FSIZE_t fptr;
+	/* Sector held in the file buffer + 1, 0 when none */
+	DWORD sect;
+	/* Clusters allocated at the last sync */
+	DWORD nclst;
+	int fd;
+} FIL;
+
+typedef struct {
+	_FDID obj;
+	void *dir;
+} DIR;
+
+typedef struct {
+	FSIZE_t fsize;
+	WORD fdate;
+	WORD ftime;
+	BYTE fattrib;
+	TCHAR fname[_MAX_LFN + 1];
+} FILINFO;
+
+typedef enum {
+	FR_OK = 0,
+	FR_DISK_ERR,
+	FR_INT_ERR,
+	FR_NOT_READY,
+	FR_NO_FILE,
+	FR_NO_PATH,
+	FR_INVALID_NAME,
+	FR_DENIED,
+	FR_EXIST,
+	FR_INVALID_OBJECT,
+	FR_WRITE_PROTECTED,
+	FR_INVALID_DRIVE,
+	FR_NOT_ENABLED,
+	FR_NO_FILESYSTEM,
+	FR_MKFS_ABORTED,
+	FR_TIMEOUT,
+	FR_LOCKED,
+	FR_NOT_ENOUGH_CORE,
+	FR_TOO_MANY_OPEN_FILES,
+	FR_INVALID_PARAMETER
+} FRESULT;
+
+#define FA_READ			0x01
+#define FA_WRITE		0x02
+#define FA_OPEN_EXISTING	0x00
+#define FA_CREATE_NEW		0x04
+#define FA_CREATE_ALWAYS	0x08
+#define FA_OPEN_ALWAYS		0x10
+#define FA_OPEN_APPEND		0x30
+
+#define FM_FAT		0x01
+#define FM_FAT32	0x02
+#define FM_EXFAT	0x04
+#define FM_ANY		0x07
+#define FM_SFD		0x08
+
+#define AM_RDO	0x01
+#define AM_HID	0x02
+#define AM_SYS	0x04
+#define AM_DIR	0x10
+#define AM_ARC	0x20
+
+/* Host directory used as the SD card, NULL when there is no card */
+void ff_host_set_root(const char *path);
+const char *ff_host_get_root(void);
+
+/*
+ * Sectors a FatFs R0.12 volume would read and write for the file
+ * operations (file buffer, directory entry, FAT and FSInfo updates).
+ */
+typedef struct {
+	uint32_t sector_reads;
+	uint32_t sector_writes;
+	uint32_t syncs;
+} t_ff_host_stats;
+
+void ff_host_get_stats(t_ff_host_stats *stats);
+void ff_host_reset_stats(void);
+
+FRESULT f_open(FIL *fp, const TCHAR *path, BYTE mode);
+FRESULT f_close(FIL *fp);
+FRESULT f_read(FIL *fp, void *buff, UINT btr, UINT *br);
+FRESULT f_write(FIL *fp, const void *buff, UINT btw, UINT *bw);
+FRESULT f_lseek(FIL *fp, FSIZE_t ofs);
+FRESULT f_truncate(FIL *fp);
+FRESULT f_sync(FIL *fp);
+FRESULT f_opendir(DIR *dp, const TCHAR *path);
+FRESULT f_closedir(DIR *dp);
+FRESULT f_readdir(DIR *dp, FILINFO *fno);
+FRESULT f_mkdir(const TCHAR *path);
+FRESULT f_unlink(const TCHAR *path);
+FRESULT f_stat(const TCHAR *path, FILINFO *fno);
+FRESULT f_chdir(const TCHAR *path);
+FRESULT f_getcwd(TCHAR *buff, UINT len);
+FRESULT f_getfree(const TCHAR *path, DWORD *nclst, FATFS **fatfs);
+FRESULT f_mount(FATFS *fs, const TCHAR *path, BYTE opt);
+FRESULT f_mkfs(const TCHAR *path, BYTE opt, DWORD au, void *work, UINT len);
+TCHAR *f_gets(TCHAR *buff, int len, FIL *fp);
+
+#define f_eof(fp)	((int)((fp)->fptr == (fp)->obj.objsize))
+#define f_error(fp)	(0)
+#define f_tell(fp)	((fp)->fptr)
+#define f_size(fp)	((fp)->obj.objsize)
+#define f_rewind(fp)	f_lseek((fp), 0)
+
+#endif /* _FF_H_ */
@@ -0,0 +1,285 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host build: minimal ChibiOS HAL API.
+ * - PAL works on the GPIO registers, outputs are looped back to the inputs.
+ * - Each serial over USB driver is a pseudo terminal, the USB driver is
+ *   active as soon as it is started.
+ * - The SDC driver only reports a card when a SD directory is given, see
+ *   ff.h, raw block accesses always fail.
+ */
+
+#ifndef _HAL_H_
+#define _HAL_H_
+
+#include "ch.h"
+#include "halconf.h"
+#include "board.h"
+#include "stm32f405xx.h"
+
+#define HAL_SUCCESS	false
+#define HAL_FAILED	true
+
+#define STM32_SYSCLK	168000000U
+#define STM32_HCLK	168000000U
+#define STM32_PCLK1	(STM32_HCLK / 4)
+#define STM32_PCLK2	(STM32_HCLK / 2)
+
+#define S2RTC(freq, sec)	((rtcnt_t)((freq) * (sec)))
+#define MS2RTC(freq, msec)						\
+	((rtcnt_t)((((freq) + 999UL) / 1000UL) * (msec)))
+#define US2RTC(freq, usec)						\
+	((rtcnt_t)((((freq) + 999999UL) / 1000000UL) * (usec)))
+
+void halInit(void);
+void osalSysPolledDelayX(rtcnt_t cycles);
+#define osalSysLock()		chSysLock()
+#define osalSysUnlock()		chSysUnlock()
+#define osalSysLockFromISR()	chSysLockFromISR()
+#define osalSysUnlockFromISR()	chSysUnlockFromISR()
+#define osalOsGetSystemTimeX()	chVTGetSystemTimeX()
+
+/*
+ * PAL, same GPIO layout as the ChibiOS STM32 port, the ST definitions
+ * of the ports are replaced like hal_pal_lld.h does.
+ */
+typedef struct {
+	volatile uint32_t MODER;
+	volatile uint32_t OTYPER;
+	volatile uint32_t OSPEEDR;
+	volatile uint32_t PUPDR;
+	volatile uint32_t IDR;
+	volatile uint32_t ODR;
+	volatile union {
+		uint32_t W;
+		struct {
+			uint16_t set;
+			uint16_t clear;
+		} H;
+	} BSRR;
+	volatile uint32_t LCKR;
+	volatile uint32_t AFRL;
+	volatile uint32_t AFRH;
+} stm32_gpio_t;
+
+#undef GPIOA
+#undef GPIOB
+#undef GPIOC
+#undef GPIOD
+#undef GPIOE
+#undef GPIOH
+#define GPIOA	((stm32_gpio_t *)GPIOA_BASE)
+#define GPIOB	((stm32_gpio_t *)GPIOB_BASE)
+#define GPIOC	((stm32_gpio_t *)GPIOC_BASE)
+#define GPIOD	((stm32_gpio_t *)GPIOD_BASE)
+#define GPIOE	((stm32_gpio_t *)GPIOE_BASE)
+#define GPIOH	((stm32_gpio_t *)GPIOH_BASE)
+
+typedef stm32_gpio_t *ioportid_t;
+typedef uint32_t iomode_t;
+typedef void (*palcallback_t)(void *arg);
+
+#define PAL_USE_CALLBACKS	TRUE
+#define PAL_USE_WAIT		FALSE
+
+#define PAL_STM32_MODE_INPUT		(0U << 0U)
+#define PAL_STM32_MODE_OUTPUT		(1U << 0U)
+#define PAL_STM32_MODE_ALTERNATE	(2U << 0U)
+#define PAL_STM32_MODE_ANALOG		(3U << 0U)
+#define PAL_STM32_MODE_MASK		(3U << 0U)
+#define PAL_STM32_OTYPE_OPENDRAIN	(1U << 2U)
+#define PAL_STM32_OSPEED_HIGHEST	(3U << 3U)
+#define PAL_STM32_PUPDR_PULLUP		(1U << 5U)
+#define PAL_STM32_PUPDR_PULLDOWN	(2U << 5U)
+#define PAL_STM32_ALTERNATE(n)		((n) << 7U)
+
+#define PAL_MODE_RESET			PAL_STM32_MODE_INPUT
+#define PAL_MODE_UNCONNECTED		PAL_STM32_MODE_INPUT
+#define PAL_MODE_INPUT			PAL_STM32_MODE_INPUT
+#define PAL_MODE_INPUT_PULLUP		(PAL_STM32_MODE_INPUT | PAL_STM32_PUPDR_PULLUP)
+#define PAL_MODE_INPUT_PULLDOWN		(PAL_STM32_MODE_INPUT | PAL_STM32_PUPDR_PULLDOWN)
+#define PAL_MODE_INPUT_ANALOG		PAL_STM32_MODE_ANALOG
+#define PAL_MODE_OUTPUT_PUSHPULL	PAL_STM32_MODE_OUTPUT
+#define PAL_MODE_OUTPUT_OPENDRAIN	(PAL_STM32_MODE_OUTPUT | PAL_STM32_OTYPE_OPENDRAIN)
+#define PAL_MODE_ALTERNATE(n)		(PAL_STM32_MODE_ALTERNATE | PAL_STM32_ALTERNATE(n))
+
+#define PAL_EVENT_MODE_DISABLED		0U
+#define PAL_EVENT_MODE_RISING_EDGE	1U
+#define PAL_EVENT_MODE_FALLING_EDGE	2U
+#define PAL_EVENT_MODE_BOTH_EDGES	3U
+
+#define PAL_LOW		0U
+#define PAL_HIGH	1U
+
+void palSetPadMode(ioportid_t port, uint32_t pad, iomode_t mode);
+void palSetPad(ioportid_t port, uint32_t pad);
+void palClearPad(ioportid_t port, uint32_t pad);
+void palTogglePad(ioportid_t port, uint32_t pad);
+uint32_t palReadPad(ioportid_t port, uint32_t pad);
+void palWritePad(ioportid_t port, uint32_t pad, uint32_t bit);
+void palEnablePadEvent(ioportid_t port, uint32_t pad, uint32_t mode);
+void palDisablePadEvent(ioportid_t port, uint32_t pad);
+void palSetPadCallback(ioportid_t port, uint32_t pad, palcallback_t cb,
+		       void *arg);
+#define palSetPadCallbackI(port, pad, cb, arg)				\
+	palSetPadCallback(port, pad, cb, arg)
+#define palEnablePadEventI(port, pad, mode) palEnablePadEvent(port, pad, mode)
+#define palDisablePadEventI(port, pad)	palDisablePadEvent(port, pad)
+
+/* Streams */
+typedef struct base_sequential_stream BaseSequentialStream;
+
+/* USB */
+typedef enum {
+	USB_UNINIT = 0,
+	USB_STOP = 1,
+	USB_READY = 2,
+	USB_SELECTED = 3,
+	USB_ACTIVE = 4,
+	USB_SUSPENDED = 5
+} usbstate_t;
+
+typedef struct {
+	volatile uint32_t GOTGCTL;
+	volatile uint32_t GOTGINT;
+	volatile uint32_t GAHBCFG;
+	volatile uint32_t GUSBCFG;
+	volatile uint32_t GRSTCTL;
+	volatile uint32_t GINTSTS;
+	volatile uint32_t GINTMSK;
+	volatile uint32_t GRXSTSR;
+	volatile uint32_t GRXSTSP;
+	volatile uint32_t GRXFSIZ;
+	volatile uint32_t DIEPTXF0;
+	volatile uint32_t HNPTXSTS;
+	volatile uint32_t resvd30;
+	volatile uint32_t resvd34;
+	volatile uint32_t GCCFG;
+	volatile uint32_t CID;
+} stm32_otg_t;
+
+typedef struct {
+	int unused;
+} USBConfig;
+
+typedef struct USBDriver {
+	volatile usbstate_t state;
+	const USBConfig *config;
+	stm32_otg_t *otg;
+} USBDriver;
+
+extern USBDriver USBD1;
+extern USBDriver USBD2;
+
+void usbStart(USBDriver *usbp, const USBConfig *config);
+void usbStop(USBDriver *usbp);
+#define usbConnectBus(usbp)	do { (void)(usbp); } while (0)
+#define usbDisconnectBus(usbp)	do { (void)(usbp); } while (0)
+
+#define SERIAL_USB_BUFFERS_SIZE		256
+#define SERIAL_USB_BUFFERS_NUMBER	2
+
+typedef struct {
+	USBDriver *usbp;
+	uint32_t bulk_in;
+	uint32_t bulk_out;
+	uint32_t int_in;
+} SerialUSBConfig;
+
+typedef struct {
+	const SerialUSBConfig *config;
+	/* Pseudo terminal master side, -1 until started */
+	int fd;
+	/* Slave side kept open so the master never sees a hang up */
+	int slave_fd;
+	/* Optional symlink to the slave device */
+	const char *link;
+	/* chnWrite() calls and bytes written, for the host tests */
+	uint32_t nb_writes;
+	uint32_t nb_written;
+} SerialUSBDriver;
+
+void sduObjectInit(SerialUSBDriver *sdup);
+void sduStart(SerialUSBDriver *sdup, const SerialUSBConfig *config);
+void sduStop(SerialUSBDriver *sdup);
+
+size_t chnWriteTimeout(void *ip, const uint8_t *bp, size_t n,
+		       sysinterval_t timeout);
+size_t chnReadTimeout(void *ip, uint8_t *bp, size_t n, sysinterval_t timeout);
+#define chnWrite(ip, bp, n)	chnWriteTimeout(ip, bp, n, TIME_INFINITE)
+#define chnRead(ip, bp, n)	chnReadTimeout(ip, bp, n, TIME_INFINITE)
+
+/* SDC */
+#define MMCSD_BLOCK_SIZE	512U
+
+#define SDC_MODE_CARDTYPE_MASK	0xFU
+#define SDC_MODE_CARDTYPE_SDV11	0U
+#define SDC_MODE_CARDTYPE_SDV20	1U
+#define SDC_MODE_CARDTYPE_MMC	2U
+#define SDC_MODE_HIGH_CAPACITY	0x10U
+
+typedef struct {
+	bool inserted;
+	uint32_t cardmode;
+	uint32_t rca;
+	uint32_t csd[4];
+	uint32_t cid[4];
+	/* Capacity in blocks */
+	uint32_t capacity;
+} SDCDriver;
+
+#define SDC_MODE_1BIT	0U
+#define SDC_MODE_4BIT	1U
+#define SDC_MODE_8BIT	2U
+
+typedef struct {
+	uint8_t *scratchpad;
+	uint32_t bus_width;
+} SDCConfig;
+
+extern SDCDriver SDCD1;
+
+#define SDC_SUCCESS	HAL_SUCCESS
+#define SDC_FAILED	HAL_FAILED
+
+void sdcStart(SDCDriver *sdcp, const SDCConfig *config);
+void sdcStop(SDCDriver *sdcp);
+bool sdcConnect(SDCDriver *sdcp);
+bool sdcDisconnect(SDCDriver *sdcp);
+bool sdcRead(SDCDriver *sdcp, uint32_t startblk, uint8_t *buf, uint32_t n);
+bool sdcWrite(SDCDriver *sdcp, uint32_t startblk, const uint8_t *buf,
+	      uint32_t n);
+bool sdcIsCardInserted(SDCDriver *sdcp);
+#define blkIsInserted(sdcp)		sdcIsCardInserted(sdcp)
+#define blkRead(sdcp, blk, buf, n)	sdcRead(sdcp, blk, buf, n)
+#define blkWrite(sdcp, blk, buf, n)	sdcWrite(sdcp, blk, buf, n)
+
+/* Host only */
+void host_map_registers(void);
+void host_set_tty_link(USBDriver *usbp, const char *link);
+void host_ubtn_toggle(void);
+void host_gpio_update(stm32_gpio_t *gpiop);
+void host_gpio_set_input(stm32_gpio_t *gpiop, uint32_t pad, uint32_t level);
+typedef uint32_t (*host_gpio_dev_t)(uint32_t idr);
+void host_gpio_set_device(stm32_gpio_t *gpiop, host_gpio_dev_t dev);
+void host_gpio_bsrr(void *gpiop, uint32_t bsrr);
+uint32_t host_gpio_odr(stm32_gpio_t *gpiop);
+void host_gpio_drive(stm32_gpio_t *gpiop, uint32_t mask, uint32_t levels);
+
+#endif /* _HAL_H_ */
@@ -0,0 +1,59 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host build: the STM32F4xx CMSIS device header, normally provided by
+ * ChibiOS (os/common/ext/ST/STM32F4xx).
+ */
+
+#ifndef _STM32F4XX_H_
+#define _STM32F4XX_H_
+
+#if !defined(STM32F4)
+#define STM32F4
+#endif
+
+#include "stm32f405xx.h"
+
+typedef enum {
+	RESET = 0U,
+	SET = !RESET
+} FlagStatus, ITStatus;
+
+typedef enum {
+	DISABLE = 0U,
+	ENABLE = !DISABLE
+} FunctionalState;
+#define IS_FUNCTIONAL_STATE(STATE) (((STATE) == DISABLE) || ((STATE) == ENABLE))
+
+typedef enum {
+	SUCCESS = 0U,
+	ERROR = !SUCCESS
+} ErrorStatus;
+
+#define SET_BIT(REG, BIT)	((REG) |= (BIT))
+#define CLEAR_BIT(REG, BIT)	((REG) &= ~(BIT))
+#define READ_BIT(REG, BIT)	((REG) & (BIT))
+#define CLEAR_REG(REG)		((REG) = (0x0))
+#define WRITE_REG(REG, VAL)	((REG) = (VAL))
+#define READ_REG(REG)		((REG))
+#define MODIFY_REG(REG, CLEARMASK, SETMASK)				\
+	WRITE_REG((REG), (((READ_REG(REG)) & (~(CLEARMASK))) | (SETMASK)))
+#define POSITION_VAL(VAL)	(__builtin_ctz(VAL))
+
+#endif /* _STM32F4XX_H_ */
@@ -0,0 +1,246 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host build: 2Gbit ONFI NAND (MT29F2G08 like) on the nandflash mode pins,
+ * PC0-PC7 data bus, PB1 WE#, PB2 ALE, PB3 CLE, PB4 CE#, PB5 RE#, R/B# is
+ * always ready.
+ * Commands and addresses are latched on the rising edges of WE#, each
+ * falling edge of RE# drives the next byte on the data bus (input mode).
+ * Answers read ID (0x90), read parameter page (0xEC, the first of the 3
+ * copies has a bad CRC), read page (0x00 then 0x30), status and reset.
+ * The page content is generated, see host_nand_page().
+ */
+
+#include <string.h>
+
+#include "hal.h"
+#include "bsp_host.h"
+#include "hydrabus_nand.h"
+
+#define WE_PAD		1
+#define ALE_PAD		2
+#define CLE_PAD		3
+#define CE_PAD		4
+#define RE_PAD		5
+
+#define DATA_SIZE	2048
+#define SPARE_SIZE	64
+#define NB_PAGES	(HOST_NAND_PAGES_PER_BLOCK * HOST_NAND_NB_BLOCKS)
+
+#define MAX_ADDR	5
+
+typedef struct {
+	uint8_t cmd;
+	uint8_t addr[MAX_ADDR];
+	uint8_t nb_addr;
+	const uint8_t *out; /* Bytes read out, 0x00 past the end */
+	uint32_t out_len;
+	uint32_t pos;
+	uint32_t last;
+} t_nand_dev;
+
+static const uint8_t nand_id[5] = { 0x2C, 0xDA, 0x90, 0x95, 0x06 };
+static const uint8_t status_ready = 0xE0;
+static uint8_t param[NAND_ONFI_PARAM_COPIES * NAND_ONFI_PARAM_SIZE];
+static uint8_t page[HOST_NAND_PAGE_SIZE];
+static t_nand_dev nand;
+
+static const uint8_t bad_blocks[] = HOST_NAND_BAD_BLOCKS;
+
+static void put_le16(uint8_t *p, uint16_t val)
+{
+	p[0] = val;
+	p[1] = val >> 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t val)
+{
+	put_le16(p, val);
+	put_le16(&p[2], val >> 16);
+}
+
+static uint16_t onfi_crc16(const uint8_t *data, uint32_t nb_data)
+{
+	uint16_t crc = 0x4F4E;
+	int bit;
+
+	while (nb_data--) {
+		crc ^= *data++ << 8;
+		for (bit = 0; bit < 8; bit++)
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x8005 : (crc << 1);
+	}
+	return crc;
+}
+
+static bool bad_block(uint32_t block)
+{
+	uint32_t i;
+
+	for (i = 0; i < sizeof(bad_blocks); i++) {
+		if (bad_blocks[i] == block)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/*
+ * Rows multiple of 7 are erased, the others have a pattern with its ECC
+ * (spare offset 40). The marker byte of the pages after the first two of
+ * a block holds metadata in the rows r % 13 == 9. As read, the bad blocks
+ * have their marker cleared, the rows r % 11 == 3 one bit error per ECC
+ * step and the other rows r % 97 == 5 two bit errors in the first step.
+ */
+void host_nand_page(uint32_t row, uint8_t *data, bool errors)
+{
+	uint8_t *spare = data + DATA_SIZE;
+	uint32_t i, step;
+
+	memset(data, 0xFF, HOST_NAND_PAGE_SIZE);
+	if (row % 7 != 0) {
+		for (i = 0; i < DATA_SIZE; i++)
+			data[i] = row * 31 + i * 7;
+		for (step = 0; step < DATA_SIZE / NAND_ECC_STEP_SIZE; step++)
+			nand_ecc_calc(&data[step * NAND_ECC_STEP_SIZE],
+				      &spare[40 + step * NAND_ECC_BYTES]);
+		if (row % HOST_NAND_PAGES_PER_BLOCK >= 2 && row % 13 == 9)
+			spare[0] = 0x00;
+	}
+	if (!errors)
+		return;
+
+	if (bad_block(row / HOST_NAND_PAGES_PER_BLOCK) &&
+	    row % HOST_NAND_PAGES_PER_BLOCK == 0) {
+		spare[0] = 0x00;
+	} else if (row % 11 == 3) {
+		for (step = 0; step < DATA_SIZE / NAND_ECC_STEP_SIZE; step++)
+			data[step * NAND_ECC_STEP_SIZE +
+			     (row + step * 37) % NAND_ECC_STEP_SIZE] ^= 1 << step;
+	} else if (row % 97 == 5) {
+		data[10] ^= 0x04;
+		data[200] ^= 0x10;
+	}
+}
+
+const uint8_t *host_nand_onfi_param(void)
+{
+	return &param[NAND_ONFI_PARAM_SIZE];
+}
+
+static void set_out(const uint8_t *out, uint32_t out_len)
+{
+	nand.out = out;
+	nand.out_len = out_len;
+	nand.pos = 0;
+}
+
+static void nand_command(uint8_t cmd)
+{
+	uint32_t row, i;
+
+	if (cmd == 0x30 && nand.cmd == 0x00) {
+		row = 0;
+		for (i = 2; i < nand.nb_addr; i++)
+			row |= nand.addr[i] << (8 * (i - 2));
+		host_nand_page(row % NB_PAGES, page, TRUE);
+		set_out(page, sizeof(page));
+	} else if (cmd == 0x70) {
+		set_out(&status_ready, 1);
+	} else {
+		set_out(NULL, 0);
+	}
+	nand.cmd = cmd;
+	nand.nb_addr = 0;
+}
+
+static void nand_address(uint8_t addr)
+{
+	if (nand.nb_addr < MAX_ADDR)
+		nand.addr[nand.nb_addr] = addr;
+	if (nand.nb_addr++ != 0)
+		return;
+
+	if (nand.cmd == 0x90) {
+		if (addr == 0x00)
+			set_out(nand_id, sizeof(nand_id));
+		else if (addr == 0x20)
+			set_out(param, 4);
+		else
+			set_out(NULL, 0);
+	} else if (nand.cmd == 0xEC) {
+		set_out(param, sizeof(param));
+	}
+}
+
+static uint8_t nand_out(void)
+{
+	if (nand.pos >= nand.out_len)
+		return 0x00;
+	return nand.out[nand.pos++];
+}
+
+static uint32_t nand_gpio(uint32_t idr)
+{
+	uint32_t rising, falling;
+
+	rising = idr & ~nand.last;
+	falling = ~idr & nand.last;
+	nand.last = idr;
+	if (idr & (1U << CE_PAD))
+		return 0;
+
+	if (rising & (1U << WE_PAD)) {
+		if (idr & (1U << CLE_PAD))
+			nand_command(host_gpio_odr(GPIOC));
+		else if (idr & (1U << ALE_PAD))
+			nand_address(host_gpio_odr(GPIOC));
+	}
+	/* Data bus in input mode */
+	if ((falling & (1U << RE_PAD)) && (GPIOC->MODER & 0xFFFF) == 0)
+		host_gpio_drive(GPIOC, 0xFF, nand_out());
+	return 0;
+}
+
+void host_nand_attach(void)
+{
+	uint8_t *p;
+
+	/* ONFI 1.0 parameter page, 2048+64 bytes pages, 1 bit ECC */
+	p = &param[NAND_ONFI_PARAM_SIZE];
+	memset(p, 0, NAND_ONFI_PARAM_SIZE);
+	memcpy(p, "ONFI", 4);
+	put_le16(&p[4], 0x0002);
+	memcpy(&p[32], "MICRON      ", 12);
+	memcpy(&p[44], "MT29F2G08ABAEAWP    ", 20);
+	put_le32(&p[80], DATA_SIZE);
+	put_le16(&p[84], SPARE_SIZE);
+	put_le32(&p[92], HOST_NAND_PAGES_PER_BLOCK);
+	put_le32(&p[96], HOST_NAND_NB_BLOCKS);
+	p[100] = 1;
+	p[101] = 0x23;
+	p[112] = 1;
+	put_le16(&p[NAND_ONFI_PARAM_SIZE - 2],
+		 onfi_crc16(p, NAND_ONFI_PARAM_SIZE - 2));
+	memcpy(param, p, NAND_ONFI_PARAM_SIZE);
+	memcpy(&param[2 * NAND_ONFI_PARAM_SIZE], p, NAND_ONFI_PARAM_SIZE);
+	param[80] ^= 0x01;
+
+	memset(&nand, 0, sizeof(nand));
+	nand.last = 1U << CE_PAD;
+	host_gpio_set_device(GPIOB, nand_gpio);
+}
@@ -0,0 +1,176 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host build: 1MB SPI NOR flash (JEDEC ID EF 40 14) with a SFDP Basic Flash
+ * Parameter Table, answering read ID, read SFDP, read and fast read.
+ * The content is a pattern of the address, see host_spi_flash_data().
+ */
+
+#include <string.h>
+
+#include "ch.h"
+#include "bsp_host.h"
+
+#define FLASH_SIZE		0x100000
+#define SFDP_SIZE		0x100
+#define SFDP_BFPT		0x80
+
+#define CMD_READ_ID		0x9F
+#define CMD_READ_SFDP		0x5A
+#define CMD_READ		0x03
+#define CMD_FAST_READ		0x0B
+#define CMD_FAST_READ4		0x0C
+
+typedef struct {
+	uint8_t cmd;
+	uint8_t addr_bytes;
+	uint8_t dummy_bytes;
+	uint32_t count; /* Bytes received since CS low */
+	uint32_t addr;
+} t_flash_frame;
+
+static const uint8_t jedec_id[3] = { 0xEF, 0x40, 0x14 };
+static uint8_t sfdp[SFDP_SIZE];
+static t_flash_frame frame;
+
+static void put_le32(uint8_t *p, uint32_t val)
+{
+	p[0] = val;
+	p[1] = val >> 8;
+	p[2] = val >> 16;
+	p[3] = val >> 24;
+}
+
+uint8_t host_spi_flash_data(uint32_t addr)
+{
+	return (addr * 7 + (addr >> 12)) & 0xFF;
+}
+
+static uint8_t flash_out(void)
+{
+	uint8_t val;
+
+	switch (frame.cmd) {
+	case CMD_READ_ID:
+		val = (frame.addr < sizeof(jedec_id)) ? jedec_id[frame.addr] : 0xFF;
+		break;
+	case CMD_READ_SFDP:
+		val = (frame.addr < SFDP_SIZE) ? sfdp[frame.addr] : 0xFF;
+		break;
+	default:
+		val = host_spi_flash_data(frame.addr & (FLASH_SIZE - 1));
+		break;
+	}
+	frame.addr++;
+	return val;
+}
+
+static uint8_t flash_in(uint8_t val)
+{
+	uint32_t header;
+
+	if (frame.count++ == 0) {
+		frame.cmd = val;
+		frame.addr = 0;
+		switch (val) {
+		case CMD_READ_SFDP:
+		case CMD_FAST_READ:
+			frame.addr_bytes = 3;
+			frame.dummy_bytes = 1;
+			break;
+		case CMD_FAST_READ4:
+			frame.addr_bytes = 4;
+			frame.dummy_bytes = 1;
+			break;
+		case CMD_READ:
+			frame.addr_bytes = 3;
+			frame.dummy_bytes = 0;
+			break;
+		case CMD_READ_ID:
+			frame.addr_bytes = 0;
+			frame.dummy_bytes = 0;
+			break;
+		default:
+			/* Not supported, MISO stays high */
+			frame.cmd = 0;
+			break;
+		}
+		return 0xFF;
+	}
+	if (frame.cmd == 0)
+		return 0xFF;
+
+	header = 1 + frame.addr_bytes;
+	if (frame.count <= header) {
+		frame.addr = (frame.addr << 8) | val;
+		return 0xFF;
+	}
+	if (frame.count <= header + frame.dummy_bytes)
+		return 0xFF;
+	return flash_out();
+}
+
+static void flash_select(bool selected)
+{
+	(void)selected;
+
+	frame.count = 0;
+}
+
+static void flash_xfer(const uint8_t *tx_data, uint8_t *rx_data, uint16_t nb_data)
+{
+	uint8_t val;
+	uint16_t i;
+
+	for (i = 0; i < nb_data; i++) {
+		val = flash_in(tx_data != NULL ? tx_data[i] : 0xFF);
+		if (rx_data != NULL)
+			rx_data[i] = val;
+	}
+}
+
+static const t_bsp_host_spi_dev flash_dev = {
+	.select = flash_select,
+	.xfer = flash_xfer,
+};
+
+/*
+ * density is the BFPT density dword, HOST_SPI_FLASH_DENSITY for the 1MB
+ * the flash really has.
+ */
+void host_spi_flash_attach(bsp_dev_spi_t dev_num, uint32_t density)
+{
+	static const uint8_t sfdp_header[16] = {
+		'S', 'F', 'D', 'P', 0x06, 0x01, 0x00, 0xFF,
+		/* BFPT v1.6, 9 dwords at SFDP_BFPT */
+		0x00, 0x06, 0x01, 0x09, SFDP_BFPT, 0x00, 0x00, 0xFF,
+	};
+
+	/* 4KB erase, 3 bytes addresses, 4KB and 64KB erase types */
+	memset(sfdp, 0xFF, sizeof(sfdp));
+	memcpy(sfdp, sfdp_header, sizeof(sfdp_header));
+	put_le32(&sfdp[SFDP_BFPT], 0xFFF120E5);
+	put_le32(&sfdp[SFDP_BFPT + 4], density);
+	memset(&sfdp[SFDP_BFPT + 8], 0, 5 * 4);
+	put_le32(&sfdp[SFDP_BFPT + 28], 0x520F200C);
+	put_le32(&sfdp[SFDP_BFPT + 32], 0x0000D810);
+
+	memset(&frame, 0, sizeof(frame));
+	bsp_host_spi_attach(dev_num, &flash_dev);
+}
@@ -0,0 +1,515 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host build: ST25R3916 mock on SPI2, as driven by the HydraNFC v2 RFAL.
+ * Each HAL_SPI_TransmitReceive() call is one SPI frame (ST25R_COM_SINGLETXRX):
+ * register access (space A, space B or test), FIFO load/read or direct
+ * command. A thread runs the timers (oscillator, wake-up, general purpose,
+ * no-response, direct commands) and drives the IRQ line on PA1, whose PAL
+ * callback runs st25r3916Isr() like the EXTI ISR does on the board.
+ * With host_st25r3916_card(), a card answers REQA/WUPA with its ATQA.
+ */
+
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "platform.h"
+#include "st25r3916.h"
+#include "st25r3916_com.h"
+#include "st25r3916_irq.h"
+
+#define ST25R_PERIOD_NS		50000
+#define ST25R_NB_REGS		64
+
+/* Timers run from the 13.56MHz carrier */
+#define FC_NS(fc)		((uint64_t)(fc) * 1000000 / 13560)
+
+#define ST25R_OSC_NS		1000000
+#define ST25R_DCT_NS		100000
+#define ST25R_FRAME_NS		100000
+#define ST25R_CA_NS		500000
+
+/* Measure VDD result, 141 * 23.4mV = 3.3V */
+#define ST25R_AD_RESULT		141
+
+typedef enum {
+	ST25R_TMR_OSC,
+	ST25R_TMR_WUP,
+	ST25R_TMR_GPT,
+	ST25R_TMR_NRT,
+	ST25R_TMR_DCT,
+	ST25R_TMR_TXE,
+	ST25R_TMR_RX,
+	ST25R_TMR_APON,
+	ST25R_TMR_CAT,
+	ST25R_TMR_END
+} st25r_tmr_t;
+
+typedef struct {
+	pthread_mutex_t mtx;
+	uint8_t rega[ST25R_NB_REGS];
+	uint8_t regb[ST25R_NB_REGS];
+	uint8_t regt[ST25R_NB_REGS];
+	/* Latched interrupts, the IRQ line is high while one is not masked */
+	uint32_t irq;
+	bool irq_line;
+	uint64_t tmr[ST25R_TMR_END];
+	uint8_t fifo[ST25R3916_FIFO_DEPTH];
+	uint16_t fifo_len;
+	uint16_t fifo_rd;
+	bool card;
+	uint8_t atqa[2];
+	bool answer;
+} t_st25r;
+
+static t_st25r st25r = { .mtx = PTHREAD_MUTEX_INITIALIZER };
+static pthread_mutex_t st25r_comm_mtx;
+static pthread_once_t st25r_once = PTHREAD_ONCE_INIT;
+
+static uint64_t st25r_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t st25r_irq_mask(void)
+{
+	return st25r.rega[ST25R3916_REG_IRQ_MASK_MAIN] |
+	       (st25r.rega[ST25R3916_REG_IRQ_MASK_TIMER_NFC] << 8) |
+	       (st25r.rega[ST25R3916_REG_IRQ_MASK_ERROR_WUP] << 16) |
+	       ((uint32_t)st25r.rega[ST25R3916_REG_IRQ_MASK_TARGET] << 24);
+}
+
+/* Masked interrupts are not latched */
+static void st25r_irq_set(uint32_t irq)
+{
+	st25r.irq |= irq & ~st25r_irq_mask();
+}
+
+static void st25r_tmr_start(st25r_tmr_t tmr, uint64_t ns)
+{
+	st25r.tmr[tmr] = st25r_ns() + ns;
+}
+
+static void st25r_fifo_put(const uint8_t *data, uint16_t len)
+{
+	if (len > ST25R3916_FIFO_DEPTH - st25r.fifo_len)
+		len = ST25R3916_FIFO_DEPTH - st25r.fifo_len;
+	memcpy(&st25r.fifo[st25r.fifo_len], data, len);
+	st25r.fifo_len += len;
+}
+
+static void st25r_fifo_status(void)
+{
+	uint16_t len;
+
+	len = st25r.fifo_len - st25r.fifo_rd;
+	st25r.rega[ST25R3916_REG_FIFO_STATUS1] = len & 0xFF;
+	st25r.rega[ST25R3916_REG_FIFO_STATUS2] =
+		(len >> 8) << ST25R3916_REG_FIFO_STATUS2_fifo_b_shift;
+}
+
+static void st25r_fifo_clear(void)
+{
+	st25r.fifo_len = 0;
+	st25r.fifo_rd = 0;
+	st25r_fifo_status();
+}
+
+static void st25r_set_default(void)
+{
+	memset(st25r.rega, 0, sizeof(st25r.rega));
+	memset(st25r.regb, 0, sizeof(st25r.regb));
+	memset(st25r.regt, 0, sizeof(st25r.regt));
+	memset(st25r.tmr, 0, sizeof(st25r.tmr));
+	st25r.rega[ST25R3916_REG_IC_IDENTITY] =
+		ST25R3916_REG_IC_IDENTITY_ic_type_st25r3916;
+	st25r.irq = 0;
+	st25r.answer = FALSE;
+	st25r_fifo_clear();
+}
+
+static void st25r_stop(void)
+{
+	st25r.tmr[ST25R_TMR_GPT] = 0;
+	st25r.tmr[ST25R_TMR_NRT] = 0;
+	st25r.tmr[ST25R_TMR_TXE] = 0;
+	st25r.tmr[ST25R_TMR_RX] = 0;
+	st25r.rega[ST25R3916_REG_NFCIP1_BIT_RATE] &=
+		~(ST25R3916_REG_NFCIP1_BIT_RATE_gpt_on |
+		  ST25R3916_REG_NFCIP1_BIT_RATE_nrt_on);
+	st25r_fifo_clear();
+}
+
+static uint64_t st25r_nrt_ns(void)
+{
+	uint32_t nrt;
+
+	nrt = (st25r.rega[ST25R3916_REG_NO_RESPONSE_TIMER1] << 8) |
+	      st25r.rega[ST25R3916_REG_NO_RESPONSE_TIMER2];
+	if (st25r.rega[ST25R3916_REG_TIMER_EMV_CONTROL] &
+	    ST25R3916_REG_TIMER_EMV_CONTROL_nrt_step)
+		return FC_NS(nrt * 4096);
+	return FC_NS(nrt * 64);
+}
+
+static void st25r_nrt_start(void)
+{
+	uint64_t ns;
+
+	ns = st25r_nrt_ns();
+	if (ns == 0)
+		return;
+	st25r_tmr_start(ST25R_TMR_NRT, ns);
+	st25r.rega[ST25R3916_REG_NFCIP1_BIT_RATE] |=
+		ST25R3916_REG_NFCIP1_BIT_RATE_nrt_on;
+}
+
+static void st25r_transmit(bool reqa)
+{
+	st25r_fifo_clear();
+	st25r.answer = reqa && st25r.card;
+	st25r_tmr_start(ST25R_TMR_TXE, ST25R_FRAME_NS);
+}
+
+static void st25r_command(uint8_t cmd)
+{
+	uint32_t wut;
+
+	switch (cmd) {
+	case ST25R3916_CMD_SET_DEFAULT:
+		st25r_set_default();
+		break;
+	case ST25R3916_CMD_STOP:
+		st25r_stop();
+		break;
+	case ST25R3916_CMD_CLEAR_FIFO:
+		st25r_fifo_clear();
+		break;
+	case ST25R3916_CMD_TRANSMIT_WITH_CRC:
+	case ST25R3916_CMD_TRANSMIT_WITHOUT_CRC:
+		st25r_transmit(FALSE);
+		break;
+	case ST25R3916_CMD_TRANSMIT_REQA:
+	case ST25R3916_CMD_TRANSMIT_WUPA:
+		st25r_transmit(TRUE);
+		break;
+	case ST25R3916_CMD_INITIAL_RF_COLLISION:
+	case ST25R3916_CMD_RESPONSE_RF_COLLISION_N:
+		st25r_tmr_start(ST25R_TMR_APON, ST25R_CA_NS);
+		break;
+	case ST25R3916_CMD_MEASURE_AMPLITUDE:
+	case ST25R3916_CMD_MEASURE_PHASE:
+	case ST25R3916_CMD_MEASURE_CAPACITANCE:
+	case ST25R3916_CMD_MEASURE_VDD:
+	case ST25R3916_CMD_ADJUST_REGULATORS:
+	case ST25R3916_CMD_CALIBRATE_C_SENSOR:
+		st25r.rega[ST25R3916_REG_AD_RESULT] = ST25R_AD_RESULT;
+		st25r_tmr_start(ST25R_TMR_DCT, ST25R_DCT_NS);
+		break;
+	case ST25R3916_CMD_START_GP_TIMER:
+		st25r_tmr_start(ST25R_TMR_GPT,
+				FC_NS(((st25r.rega[ST25R3916_REG_GPT1] << 8) |
+				       st25r.rega[ST25R3916_REG_GPT2]) * 8));
+		st25r.rega[ST25R3916_REG_NFCIP1_BIT_RATE] |=
+			ST25R3916_REG_NFCIP1_BIT_RATE_gpt_on;
+		break;
+	case ST25R3916_CMD_START_WUP_TIMER:
+		wut = ((st25r.rega[ST25R3916_REG_WUP_TIMER_CONTROL] &
+			ST25R3916_REG_WUP_TIMER_CONTROL_wut_mask) >>
+		       ST25R3916_REG_WUP_TIMER_CONTROL_wut_shift) + 1;
+		if (st25r.rega[ST25R3916_REG_WUP_TIMER_CONTROL] &
+		    ST25R3916_REG_WUP_TIMER_CONTROL_wur)
+			st25r_tmr_start(ST25R_TMR_WUP, wut * 10000000ULL);
+		else
+			st25r_tmr_start(ST25R_TMR_WUP, wut * 100000000ULL);
+		break;
+	case ST25R3916_CMD_START_NO_RESPONSE_TIMER:
+		st25r_nrt_start();
+		break;
+	case ST25R3916_CMD_STOP_NRT:
+		st25r.tmr[ST25R_TMR_NRT] = 0;
+		st25r.rega[ST25R3916_REG_NFCIP1_BIT_RATE] &=
+			~ST25R3916_REG_NFCIP1_BIT_RATE_nrt_on;
+		break;
+	default:
+		break;
+	}
+}
+
+static void st25r_write(uint8_t *regs, uint8_t addr, uint8_t data)
+{
+	uint8_t old;
+
+	old = regs[addr];
+	regs[addr] = data;
+	if (regs != st25r.rega || addr != ST25R3916_REG_OP_CONTROL)
+		return;
+
+	if ((data & ST25R3916_REG_OP_CONTROL_en) &&
+	    !(old & ST25R3916_REG_OP_CONTROL_en))
+		st25r_tmr_start(ST25R_TMR_OSC, ST25R_OSC_NS);
+	if (!(data & ST25R3916_REG_OP_CONTROL_en)) {
+		st25r.tmr[ST25R_TMR_OSC] = 0;
+		st25r.rega[ST25R3916_REG_AUX_DISPLAY] &=
+			~ST25R3916_REG_AUX_DISPLAY_osc_ok;
+	}
+	if (data & ST25R3916_REG_OP_CONTROL_tx_en)
+		st25r.rega[ST25R3916_REG_AUX_DISPLAY] |=
+			ST25R3916_REG_AUX_DISPLAY_tx_on;
+	else
+		st25r.rega[ST25R3916_REG_AUX_DISPLAY] &=
+			~ST25R3916_REG_AUX_DISPLAY_tx_on;
+}
+
+/* Interrupt registers are cleared on read */
+static uint8_t st25r_read(uint8_t *regs, uint8_t addr)
+{
+	uint8_t data;
+	uint32_t shift;
+
+	if (regs != st25r.rega || addr < ST25R3916_REG_IRQ_MAIN ||
+	    addr > ST25R3916_REG_IRQ_TARGET)
+		return regs[addr];
+
+	shift = (addr - ST25R3916_REG_IRQ_MAIN) * 8;
+	data = st25r.irq >> shift;
+	st25r.irq &= ~(0xFFU << shift);
+
+	return data;
+}
+
+static void st25r_frame(const uint8_t *tx, uint8_t *rx, uint16_t len)
+{
+	uint8_t *regs;
+	uint8_t op, addr;
+	uint16_t i;
+
+	memset(rx, 0, len);
+	regs = st25r.rega;
+	i = 0;
+	if (tx[0] == ST25R3916_CMD_SPACE_B_ACCESS && len > 1) {
+		regs = st25r.regb;
+		i++;
+	} else if (tx[0] == ST25R3916_CMD_TEST_ACCESS && len > 1) {
+		regs = st25r.regt;
+		i++;
+	}
+	op = tx[i++];
+
+	switch (op & 0xC0) {
+	case 0x00:
+		for (addr = op & 0x3F; i < len; i++, addr++)
+			st25r_write(regs, addr & 0x3F, tx[i]);
+		break;
+	case 0x40:
+		for (addr = op & 0x3F; i < len; i++, addr++)
+			rx[i] = st25r_read(regs, addr & 0x3F);
+		break;
+	case 0x80:
+		/* FIFO load and read, passive target memory is not emulated */
+		if (op == 0x80) {
+			st25r_fifo_put(&tx[i], len - i);
+			st25r_fifo_status();
+		} else if (op == 0x9F) {
+			for (; i < len && st25r.fifo_rd < st25r.fifo_len; i++)
+				rx[i] = st25r.fifo[st25r.fifo_rd++];
+			st25r_fifo_status();
+		}
+		break;
+	default:
+		st25r_command(op);
+		break;
+	}
+}
+
+static void st25r_tmr_expired(st25r_tmr_t tmr)
+{
+	switch (tmr) {
+	case ST25R_TMR_OSC:
+		st25r.rega[ST25R3916_REG_AUX_DISPLAY] |=
+			ST25R3916_REG_AUX_DISPLAY_osc_ok;
+		st25r_irq_set(ST25R3916_IRQ_MASK_OSC);
+		break;
+	case ST25R_TMR_WUP:
+		st25r_irq_set(ST25R3916_IRQ_MASK_WT);
+		break;
+	case ST25R_TMR_GPT:
+		st25r.rega[ST25R3916_REG_NFCIP1_BIT_RATE] &=
+			~ST25R3916_REG_NFCIP1_BIT_RATE_gpt_on;
+		st25r_irq_set(ST25R3916_IRQ_MASK_GPE);
+		break;
+	case ST25R_TMR_NRT:
+		st25r.rega[ST25R3916_REG_NFCIP1_BIT_RATE] &=
+			~ST25R3916_REG_NFCIP1_BIT_RATE_nrt_on;
+		st25r_irq_set(ST25R3916_IRQ_MASK_NRE);
+		break;
+	case ST25R_TMR_DCT:
+		st25r_irq_set(ST25R3916_IRQ_MASK_DCT);
+		break;
+	case ST25R_TMR_TXE:
+		st25r_irq_set(ST25R3916_IRQ_MASK_TXE);
+		st25r_nrt_start();
+		if (st25r.answer)
+			st25r_tmr_start(ST25R_TMR_RX, ST25R_FRAME_NS);
+		break;
+	case ST25R_TMR_RX:
+		st25r.tmr[ST25R_TMR_NRT] = 0;
+		st25r.rega[ST25R3916_REG_NFCIP1_BIT_RATE] &=
+			~ST25R3916_REG_NFCIP1_BIT_RATE_nrt_on;
+		st25r_fifo_put(st25r.atqa, sizeof(st25r.atqa));
+		st25r_fifo_status();
+		st25r_irq_set(ST25R3916_IRQ_MASK_RXS | ST25R3916_IRQ_MASK_RXE);
+		break;
+	case ST25R_TMR_APON:
+		st25r.rega[ST25R3916_REG_OP_CONTROL] |=
+			ST25R3916_REG_OP_CONTROL_tx_en;
+		st25r.rega[ST25R3916_REG_AUX_DISPLAY] |=
+			ST25R3916_REG_AUX_DISPLAY_tx_on;
+		st25r_irq_set(ST25R3916_IRQ_MASK_APON);
+		st25r_tmr_start(ST25R_TMR_CAT, ST25R_CA_NS);
+		break;
+	default:
+		st25r_irq_set(ST25R3916_IRQ_MASK_CAT);
+		break;
+	}
+}
+
+/* Returns the level of the IRQ line, if it changed */
+static bool st25r_irq_line(bool *level)
+{
+	bool line;
+
+	line = (st25r.irq & ~st25r_irq_mask()) != 0;
+	if (line == st25r.irq_line)
+		return FALSE;
+
+	st25r.irq_line = line;
+	*level = line;
+
+	return TRUE;
+}
+
+static void *st25r_thread(void *arg)
+{
+	struct timespec next;
+	uint64_t now;
+	uint32_t tmr;
+	bool changed, level;
+
+	(void)arg;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (1) {
+		next.tv_nsec += ST25R_PERIOD_NS;
+		if (next.tv_nsec >= 1000000000) {
+			next.tv_sec++;
+			next.tv_nsec -= 1000000000;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+		pthread_mutex_lock(&st25r.mtx);
+		now = st25r_ns();
+		for (tmr = 0; tmr < ST25R_TMR_END; tmr++) {
+			if (st25r.tmr[tmr] == 0 || now < st25r.tmr[tmr])
+				continue;
+			st25r.tmr[tmr] = 0;
+			st25r_tmr_expired(tmr);
+		}
+		changed = st25r_irq_line(&level);
+		pthread_mutex_unlock(&st25r.mtx);
+
+		/* The PAL callback (ISR) reads the interrupts back over SPI */
+		if (changed)
+			host_gpio_set_input(GPIOA, 1, level);
+	}
+
+	return NULL;
+}
+
+static void st25r_init(void)
+{
+	pthread_mutexattr_t attr;
+	pthread_t thread;
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&st25r_comm_mtx, &attr);
+	pthread_mutexattr_destroy(&attr);
+
+	st25r_set_default();
+	if (pthread_create(&thread, NULL, st25r_thread, NULL) != 0)
+		chSysHalt("st25r3916");
+	pthread_detach(thread);
+}
+
+HAL_StatusTypeDef HAL_SPI_TransmitReceive(SPI_HandleTypeDef *hspi, uint8_t *pTxData,
+					  uint8_t *pRxData, uint16_t Size, uint32_t Timeout)
+{
+	bool lower;
+
+	(void)Timeout;
+
+	if (hspi->Instance != SPI2 || Size == 0)
+		return HAL_ERROR;
+
+	pthread_once(&st25r_once, st25r_init);
+
+	pthread_mutex_lock(&st25r.mtx);
+	st25r_frame(pTxData, pRxData, Size);
+	/* The IRQ line goes low as soon as the interrupts are read */
+	lower = st25r.irq_line && (st25r.irq & ~st25r_irq_mask()) == 0;
+	if (lower)
+		st25r.irq_line = FALSE;
+	pthread_mutex_unlock(&st25r.mtx);
+
+	if (lower)
+		host_gpio_set_input(GPIOA, 1, 0);
+
+	return HAL_OK;
+}
+
+/*
+ * On the board the ST25R3916 EXTI interrupt is disabled during an SPI
+ * frame, here the frames and the ISR thread are serialized by a mutex.
+ */
+void host_st25r3916_protect(void)
+{
+	pthread_once(&st25r_once, st25r_init);
+	pthread_mutex_lock(&st25r_comm_mtx);
+}
+
+void host_st25r3916_unprotect(void)
+{
+	pthread_mutex_unlock(&st25r_comm_mtx);
+}
+
+/* A card in the field answers REQA/WUPA with atqa, NULL removes it */
+void host_st25r3916_card(const uint8_t *atqa)
+{
+	pthread_mutex_lock(&st25r.mtx);
+	st25r.card = (atqa != NULL);
+	if (atqa != NULL)
+		memcpy(st25r.atqa, atqa, sizeof(st25r.atqa));
+	pthread_mutex_unlock(&st25r.mtx);
+}
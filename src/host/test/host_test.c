@@ -0,0 +1,185 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host tests helpers, see host_test.h */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <ftw.h>
+
+#include "host_test.h"
+
+static int failures;
+static char sd_root[] = "/tmp/hydrafw-test-XXXXXX";
+
+void host_test_init(void)
+{
+	host_map_registers();
+	halInit();
+	chSysInit();
+}
+
+/* Returns the exit status of the test */
+int host_test_end(const char *name)
+{
+	if (failures) {
+		printf("%s: %d check(s) FAILED\n", name, failures);
+		return 1;
+	}
+	printf("%s: OK\n", name);
+
+	return 0;
+}
+
+void host_test_check(int cond, const char *expr, const char *file, int line)
+{
+	if (cond)
+		return;
+
+	failures++;
+	printf("%s:%d: check failed: %s\n", file, line, expr);
+}
+
+/* CPU cycles on x86, nanoseconds elsewhere */
+uint64_t host_test_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	return host_test_ns();
+#endif
+}
+
+uint64_t host_test_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int sd_remove_entry(const char *path, const struct stat *st, int flag,
+			   struct FTW *ftw)
+{
+	(void)st;
+	(void)flag;
+	(void)ftw;
+
+	return remove(path);
+}
+
+static void sd_remove(void)
+{
+	nftw(sd_root, sd_remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+/* Empty SD card in a temporary directory, removed at exit */
+void host_test_sd(void)
+{
+	if (mkdtemp(sd_root) == NULL)
+		chSysHalt("host_test_sd");
+	ff_host_set_root(sd_root);
+	atexit(sd_remove);
+}
+
+/* Reads the console output from the pseudo terminal slave side */
+static void *console_reader(void *arg)
+{
+	t_host_console *hc = arg;
+	uint8_t buf[4096];
+	uint32_t copy;
+	ssize_t len;
+
+	while (1) {
+		len = read(hc->sdu.slave_fd, buf, sizeof(buf));
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len <= 0)
+			break;
+
+		pthread_mutex_lock(&hc->mtx);
+		copy = MIN((uint32_t)len, hc->out_size - hc->out_len);
+		memcpy(&hc->out[hc->out_len], buf, copy);
+		hc->out_len += copy;
+		hc->received += len;
+		pthread_mutex_unlock(&hc->mtx);
+	}
+
+	return NULL;
+}
+
+/* Keeps up to out_size bytes of output in hc->out */
+void host_test_console(t_host_console *hc, char *name, uint32_t out_size)
+{
+	static const SerialUSBConfig cfg = { &USBD1, 1, 1, 2 };
+
+	memset(hc, 0, sizeof(t_host_console));
+	sduObjectInit(&hc->sdu);
+	sduStart(&hc->sdu, &cfg);
+
+	hc->con.thread_name = name;
+	hc->con.sdu = &hc->sdu;
+	hc->con.tl = &hc->tl;
+	hc->con.mode = &hc->mode;
+	console_tx_init(&hc->con);
+
+	pthread_mutex_init(&hc->mtx, NULL);
+	hc->out_size = out_size;
+	hc->out = calloc(1, out_size + 1);
+	if (hc->out == NULL ||
+	    pthread_create(&hc->reader, NULL, console_reader, hc) != 0)
+		chSysHalt("host_test_console");
+}
+
+/* Data received by the console, as sent by the USB host */
+void host_test_console_input(t_host_console *hc, const void *data, uint32_t size)
+{
+	if (write(hc->sdu.slave_fd, data, size) != (ssize_t)size)
+		chSysHalt("host_test_console_input");
+}
+
+/* Waits until size bytes have been received since the last clear */
+bool host_test_console_wait(t_host_console *hc, uint32_t size, uint32_t timeout_ms)
+{
+	uint64_t end;
+
+	end = host_test_ns() + (uint64_t)timeout_ms * 1000000;
+	while (hc->received < size) {
+		if (host_test_ns() > end)
+			return FALSE;
+		usleep(100);
+	}
+
+	return TRUE;
+}
+
+void host_test_console_clear(t_host_console *hc)
+{
+	pthread_mutex_lock(&hc->mtx);
+	hc->out_len = 0;
+	hc->received = 0;
+	memset(hc->out, 0, hc->out_size + 1);
+	pthread_mutex_unlock(&hc->mtx);
+	hc->sdu.nb_writes = 0;
+	hc->sdu.nb_written = 0;
+}
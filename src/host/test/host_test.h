@@ -0,0 +1,66 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host tests: each test is a program linked with the firmware objects of
+ * the host build (without host_main.c), run by make host-test.
+ * A test console is a t_hydra_console on a pseudo terminal, its output is
+ * read back by a thread.
+ */
+
+#ifndef _HOST_TEST_H_
+#define _HOST_TEST_H_
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "common.h"
+#include "hydrabus_mode.h"
+#include "ff.h"
+
+typedef struct {
+	t_hydra_console con;
+	SerialUSBDriver sdu;
+	t_tokenline tl;
+	t_mode_config mode;
+	pthread_t reader;
+	pthread_mutex_t mtx;
+	/* Output kept for the checks, the rest is only counted */
+	uint8_t *out;
+	uint32_t out_size;
+	uint32_t out_len;
+	volatile uint32_t received;
+} t_host_console;
+
+#define CHECK(cond) host_test_check((cond), #cond, __FILE__, __LINE__)
+
+void host_test_init(void);
+int host_test_end(const char *name);
+void host_test_check(int cond, const char *expr, const char *file, int line);
+uint64_t host_test_cycles(void);
+uint64_t host_test_ns(void);
+void host_test_sd(void);
+
+void host_test_console(t_host_console *hc, char *name, uint32_t out_size);
+void host_test_console_input(t_host_console *hc, const void *data, uint32_t size);
+bool host_test_console_wait(t_host_console *hc, uint32_t size, uint32_t timeout_ms);
+void host_test_console_clear(t_host_console *hc);
+
+#endif /* _HOST_TEST_H_ */
@@ -0,0 +1,129 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * AVR ISP against the ATmega2560 model (host/avr_isp.c): pages on both
+ * sides of the extended address boundary, EEPROM and fuses.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "bsp_host.h"
+#include "hydrabus_avr_isp.h"
+#include "hydrabus_spi_flash.h"
+
+#define PAGE_SIZE	256
+/* Pages written from the end of the first 128KB */
+#define WRITE_ADDR	(0x20000 - 4 * PAGE_SIZE)
+#define WRITE_SIZE	(8 * PAGE_SIZE)
+#define EEPROM_ADDR	0x0FF0
+
+static uint8_t buf[AVR_ISP_BUF_SIZE];
+static uint8_t data[WRITE_SIZE];
+static uint8_t rx[WRITE_SIZE];
+
+static void spi_init(void)
+{
+	mode_config_proto_t proto;
+
+	memset(&proto, 0, sizeof(proto));
+	proto.config.spi.dev_mode = DEV_MASTER;
+	bsp_spi_init(BSP_DEV_SPI1, &proto);
+}
+
+static bool program_enable(t_avr_isp *isp)
+{
+	bsp_spi_unselect(BSP_DEV_SPI1);
+	bsp_spi_select(BSP_DEV_SPI1);
+	return avr_isp_program_enable(isp);
+}
+
+int main(void)
+{
+	static const uint8_t factory_fuses[AVR_ISP_NB_FUSES] = {
+		0x62, 0x99, 0xFF, 0xFF
+	};
+	t_avr_isp isp;
+	uint8_t sig[3], fuses[AVR_ISP_NB_FUSES], eeprom[16];
+	uint32_t i, addr, crc;
+
+	host_test_init();
+	host_avr_attach(BSP_DEV_SPI1);
+	spi_init();
+	avr_isp_init(&isp, BSP_DEV_SPI1);
+	for (i = 0; i < WRITE_SIZE; i++)
+		data[i] = i * 13 + (i >> 8);
+
+	/* RESET high */
+	CHECK(!avr_isp_program_enable(&isp));
+
+	CHECK(program_enable(&isp));
+	avr_isp_read_signature(&isp, sig);
+	CHECK(sig[0] == 0x1E && sig[1] == 0x98 && sig[2] == 0x01);
+	avr_isp_read_fuses(&isp, fuses);
+	CHECK(memcmp(fuses, factory_fuses, sizeof(fuses)) == 0);
+	CHECK(avr_isp_chip_erase(&isp));
+
+	for (i = 0; i < WRITE_SIZE; i += PAGE_SIZE) {
+		CHECK(avr_isp_write_flash_page(&isp, WRITE_ADDR + i, &data[i],
+					       PAGE_SIZE, buf));
+	}
+	for (i = 0; i < WRITE_SIZE; i++) {
+		if (host_avr_flash_data(WRITE_ADDR + i) != data[i])
+			break;
+	}
+	CHECK(i == WRITE_SIZE);
+
+	/* One read across the boundary, then from the first 128KB again */
+	avr_isp_read(&isp, AVR_ISP_MEM_FLASH, WRITE_ADDR, rx, WRITE_SIZE, buf);
+	CHECK(memcmp(rx, data, WRITE_SIZE) == 0);
+	crc = avr_isp_crc32(&isp, AVR_ISP_MEM_FLASH, WRITE_ADDR, WRITE_SIZE, buf);
+	CHECK(crc == spi_flash_crc32(0, data, WRITE_SIZE));
+	avr_isp_read(&isp, AVR_ISP_MEM_FLASH, WRITE_ADDR, rx, PAGE_SIZE, buf);
+	CHECK(memcmp(rx, data, PAGE_SIZE) == 0);
+
+	/* A new session starts with the extended address back to 0 */
+	addr = WRITE_ADDR + WRITE_SIZE - PAGE_SIZE;
+	avr_isp_read(&isp, AVR_ISP_MEM_FLASH, addr, rx, PAGE_SIZE, buf);
+	CHECK(program_enable(&isp));
+	avr_isp_read(&isp, AVR_ISP_MEM_FLASH, addr, rx, PAGE_SIZE, buf);
+	CHECK(memcmp(rx, &data[WRITE_SIZE - PAGE_SIZE], PAGE_SIZE) == 0);
+
+	/* Unaligned or odd pages */
+	CHECK(!avr_isp_write_flash_page(&isp, PAGE_SIZE / 2, data, PAGE_SIZE, buf));
+	CHECK(!avr_isp_write_flash_page(&isp, 0, data, 3, buf));
+
+	CHECK(avr_isp_write_eeprom(&isp, EEPROM_ADDR, data, sizeof(eeprom)));
+	avr_isp_read(&isp, AVR_ISP_MEM_EEPROM, EEPROM_ADDR, eeprom,
+		     sizeof(eeprom), buf);
+	CHECK(memcmp(eeprom, data, sizeof(eeprom)) == 0);
+
+	CHECK(avr_isp_write_fuse(&isp, AVR_ISP_FUSE_LOW, 0xFF));
+	CHECK(avr_isp_write_fuse(&isp, AVR_ISP_LOCK, 0xFC));
+	CHECK(!avr_isp_write_fuse(&isp, AVR_ISP_NB_FUSES, 0));
+	avr_isp_read_fuses(&isp, fuses);
+	CHECK(fuses[AVR_ISP_FUSE_LOW] == 0xFF && fuses[AVR_ISP_FUSE_HIGH] == 0x99 &&
+	      fuses[AVR_ISP_LOCK] == 0xFC);
+
+	printf("test_avr_isp: %u bytes flash across 0x20000, crc %08x\n",
+	       WRITE_SIZE, crc);
+
+	return host_test_end("test_avr_isp");
+}
@@ -0,0 +1,298 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * BBIO I2C, RAWWIRE and 1-Wire: nibble bulk commands and byte reads against
+ * the length prefixed bulk commands, through the bit banged pin drivers.
+ * The I2C bus has the FRAM model (host/i2c_fram.c), the RAWWIRE and 1-Wire
+ * pins read their idle level.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "bsp_host.h"
+#include "hydrabus_bbio.h"
+#include "hydrabus_bbio_i2c.h"
+#include "hydrabus_bbio_onewire.h"
+#include "hydrabus_bbio_rawwire.h"
+
+#define SIZE		256
+#define OUT_SIZE	(8 * SIZE)
+#define LEGACY_ADDR	0x0100
+#define BULK_ADDR	0x4000
+
+typedef struct {
+	const char *name;
+	void (*run)(t_hydra_console *con);
+	const char *header;
+	uint8_t read_byte;
+	uint8_t write_bulk;
+	uint8_t read_bulk;
+	uint8_t nibble_write;
+} t_bbio_mode;
+
+/* Commands sent and answers expected since the last clear */
+typedef struct {
+	t_host_console *hc;
+	uint32_t expected;
+	uint32_t round_trips;
+	bool error;
+} t_link;
+
+typedef struct {
+	uint32_t round_trips;
+	uint32_t writes;
+	uint64_t ns;
+} t_run;
+
+static const t_bbio_mode modes[] = {
+	{ "I2C", bbio_mode_i2c, BBIO_I2C_HEADER, BBIO_I2C_READ_BYTE,
+	  BBIO_I2C_WRITE_BULK, BBIO_I2C_READ_BULK, BBIO_I2C_BULK_WRITE },
+	{ "RAWWIRE", bbio_mode_rawwire, BBIO_RAWWIRE_HEADER,
+	  BBIO_RAWWIRE_READ_BYTE, BBIO_RAWWIRE_WRITE_BULK,
+	  BBIO_RAWWIRE_READ_BULK, BBIO_RAWWIRE_BULK_TRANSFER },
+	{ "1-Wire", bbio_mode_onewire, BBIO_ONEWIRE_HEADER, BBIO_ONEWIRE_READ,
+	  BBIO_ONEWIRE_WRITE_BULK, BBIO_ONEWIRE_READ_BULK,
+	  BBIO_ONEWIRE_BULK_TRANSFER },
+};
+
+static const t_bbio_mode *cur_mode;
+static uint8_t data[SIZE + 3];
+static uint8_t legacy_rx[SIZE];
+static uint8_t bulk_rx[SIZE];
+static uint8_t cmd[SIZE + 3];
+
+static THD_WORKING_AREA(wa_bbio, 4096);
+
+static THD_FUNCTION(bbio, arg)
+{
+	chRegSetThreadName("bbio");
+	cur_mode->run(arg);
+}
+
+static void link_clear(t_link *l, t_host_console *hc)
+{
+	host_test_console_clear(hc);
+	l->hc = hc;
+	l->expected = 0;
+	l->round_trips = 0;
+	l->error = FALSE;
+}
+
+/* One host to device round trip, returns the position of the answer */
+static uint32_t send(t_link *l, const uint8_t *tx, uint32_t len, uint32_t answer)
+{
+	uint32_t pos;
+
+	pos = l->expected;
+	host_test_console_input(l->hc, tx, len);
+	l->expected += answer;
+	l->round_trips++;
+	if (!host_test_console_wait(l->hc, l->expected, 5000))
+		l->error = TRUE;
+	return pos;
+}
+
+static bool is_i2c(void)
+{
+	return cur_mode->run == bbio_mode_i2c;
+}
+
+static void i2c_cond(t_link *l, uint8_t cond)
+{
+	if (l->hc->out[send(l, &cond, 1, 1)] != 0x01)
+		l->error = TRUE;
+}
+
+static void legacy_write(t_link *l, const uint8_t *tx, uint32_t len)
+{
+	uint32_t i, n, pos;
+
+	for (i = 0; i < len; i += n) {
+		n = (len - i > 16) ? 16 : len - i;
+		cmd[0] = cur_mode->nibble_write | (n - 1);
+		memcpy(&cmd[1], &tx[i], n);
+		if (is_i2c()) {
+			send(l, cmd, 1, 1);
+			pos = send(l, &cmd[1], n, n);
+			/* ACKed */
+			if (memchr(&l->hc->out[pos], 0x01, n) != NULL)
+				l->error = TRUE;
+		} else if (cur_mode->run == bbio_mode_rawwire) {
+			send(l, cmd, 1 + n, 1 + n);
+		} else {
+			send(l, cmd, 1 + n, 1);
+		}
+	}
+}
+
+static void legacy_read(t_link *l, uint8_t *rx, uint32_t len)
+{
+	uint32_t i;
+	uint8_t ack;
+
+	for (i = 0; i < len; i++) {
+		rx[i] = l->hc->out[send(l, &cur_mode->read_byte, 1, 1)];
+		if (is_i2c()) {
+			ack = (i < len - 1) ? BBIO_I2C_ACK_BIT : BBIO_I2C_NACK_BIT;
+			send(l, &ack, 1, 1);
+		}
+	}
+}
+
+static void bulk_write(t_link *l, const uint8_t *tx, uint32_t len)
+{
+	uint32_t pos;
+
+	cmd[0] = cur_mode->write_bulk;
+	cmd[1] = len >> 8;
+	cmd[2] = len;
+	memcpy(&cmd[3], tx, len);
+	pos = send(l, cmd, 3 + len,
+		   1 + (cur_mode->run == bbio_mode_onewire ? 1 : len));
+	if (l->hc->out[pos] != 0x01 ||
+	    (is_i2c() && memchr(&l->hc->out[pos + 1], 0x01, len) != NULL))
+		l->error = TRUE;
+}
+
+static void bulk_read(t_link *l, uint8_t *rx, uint32_t len)
+{
+	uint32_t pos;
+
+	cmd[0] = cur_mode->read_bulk;
+	cmd[1] = len >> 8;
+	cmd[2] = len;
+	pos = send(l, cmd, 3, 1 + len);
+	if (l->hc->out[pos] != 0x01)
+		l->error = TRUE;
+	memcpy(rx, &l->hc->out[pos + 1], len);
+}
+
+/* Writes then reads back SIZE bytes, at addr of the FRAM in I2C mode */
+static void write_read(t_link *l, bool bulk, uint16_t addr, uint8_t *rx)
+{
+	void (*wr)(t_link *l, const uint8_t *tx, uint32_t len);
+	uint8_t rd;
+
+	wr = bulk ? bulk_write : legacy_write;
+	if (is_i2c()) {
+		data[0] = HOST_I2C_FRAM_ADDR << 1;
+		data[1] = addr >> 8;
+		data[2] = addr;
+		i2c_cond(l, BBIO_I2C_START_BIT);
+		wr(l, data, SIZE + 3);
+		i2c_cond(l, BBIO_I2C_STOP_BIT);
+
+		rd = (HOST_I2C_FRAM_ADDR << 1) | 1;
+		i2c_cond(l, BBIO_I2C_START_BIT);
+		wr(l, data, 3);
+		i2c_cond(l, BBIO_I2C_START_BIT);
+		wr(l, &rd, 1);
+	} else {
+		wr(l, &data[3], SIZE);
+	}
+
+	if (bulk)
+		bulk_read(l, rx, SIZE);
+	else
+		legacy_read(l, rx, SIZE);
+	if (is_i2c())
+		i2c_cond(l, BBIO_I2C_STOP_BIT);
+}
+
+/* No device at the next address */
+static bool i2c_nack(t_host_console *hc)
+{
+	t_link l;
+	uint8_t addr;
+
+	link_clear(&l, hc);
+	addr = (HOST_I2C_FRAM_ADDR + 1) << 1;
+	i2c_cond(&l, BBIO_I2C_START_BIT);
+	legacy_write(&l, &addr, 1);
+	i2c_cond(&l, BBIO_I2C_STOP_BIT);
+	return l.error && hc->out[2] == 0x01;
+}
+
+static void run(t_host_console *hc, bool bulk, uint16_t addr, uint8_t *rx,
+		t_run *r)
+{
+	t_link l;
+	uint64_t start;
+
+	link_clear(&l, hc);
+	start = host_test_ns();
+	write_read(&l, bulk, addr, rx);
+	r->ns = host_test_ns() - start;
+	r->round_trips = l.round_trips;
+	r->writes = hc->sdu.nb_writes;
+	CHECK(!l.error);
+}
+
+int main(void)
+{
+	t_host_console hc;
+	t_run legacy, bulk;
+	thread_t *thd;
+	uint32_t i, m;
+	uint8_t reset;
+
+	host_test_init();
+	host_test_console(&hc, "bbio_bulk test", OUT_SIZE);
+	host_i2c_fram_attach();
+	for (i = 0; i < SIZE; i++)
+		data[3 + i] = i * 7 + 3;
+
+	for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+		cur_mode = &modes[m];
+		host_test_console_clear(&hc);
+		thd = chThdCreateStatic(wa_bbio, sizeof(wa_bbio), NORMALPRIO,
+					bbio, &hc.con);
+		CHECK(host_test_console_wait(&hc, 4, 1000));
+		CHECK(memcmp(hc.out, cur_mode->header, 4) == 0);
+
+		run(&hc, FALSE, LEGACY_ADDR, legacy_rx, &legacy);
+		run(&hc, TRUE, BULK_ADDR, bulk_rx, &bulk);
+		CHECK(memcmp(legacy_rx, bulk_rx, SIZE) == 0);
+		if (is_i2c()) {
+			CHECK(memcmp(bulk_rx, &data[3], SIZE) == 0);
+			for (i = 0; i < SIZE; i++) {
+				if (host_i2c_fram_data(LEGACY_ADDR + i) != data[3 + i] ||
+				    host_i2c_fram_data(BULK_ADDR + i) != data[3 + i])
+					break;
+			}
+			CHECK(i == SIZE);
+			CHECK(i2c_nack(&hc));
+		}
+		printf("test_bbio_bulk: %s %u bytes, nibble %u round trips "
+		       "%u writes %u us, bulk %u round trips %u writes %u us\n",
+		       cur_mode->name, SIZE, legacy.round_trips, legacy.writes,
+		       (uint32_t)(legacy.ns / 1000), bulk.round_trips,
+		       bulk.writes, (uint32_t)(bulk.ns / 1000));
+		CHECK(bulk.round_trips * 10 < legacy.round_trips);
+		CHECK(bulk.writes * 4 < legacy.writes);
+
+		reset = BBIO_RESET;
+		host_test_console_input(&hc, &reset, 1);
+		chThdWait(thd);
+	}
+
+	return host_test_end("test_bbio_bulk");
+}
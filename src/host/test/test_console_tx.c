@@ -0,0 +1,89 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Console TX buffer: chnWrite() calls and bytes per call */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "host_test.h"
+
+#define NB_BYTES	256
+#define BLOCK_SIZE	2048
+
+int main(void)
+{
+	t_host_console hc;
+	uint8_t data[BLOCK_SIZE];
+	char expected[4];
+	uint32_t i, size;
+
+	host_test_init();
+	host_test_console(&hc, "console_tx test", 4 * BLOCK_SIZE);
+
+	/* One cprintf() per byte, as print_hex() used to do */
+	for (i = 0; i < NB_BYTES; i++)
+		cprintf(&hc.con, "%02X ", i);
+	CHECK(hc.sdu.nb_writes == (NB_BYTES * 3) / CONSOLE_TX_BUF_SIZE);
+	cflush(&hc.con);
+	CHECK(host_test_console_wait(&hc, NB_BYTES * 3, 1000));
+	CHECK(hc.sdu.nb_written == NB_BYTES * 3);
+	CHECK(hc.sdu.nb_writes == (NB_BYTES * 3 + CONSOLE_TX_BUF_SIZE - 1) /
+				  CONSOLE_TX_BUF_SIZE);
+	for (i = 0; i < NB_BYTES; i++) {
+		snprintf(expected, sizeof(expected), "%02X ", i);
+		if (memcmp(&hc.out[i * 3], expected, 3) != 0)
+			break;
+	}
+	CHECK(i == NB_BYTES);
+	printf("test_console_tx: %u cprintf() calls, %u chnWrite() calls\n",
+	       NB_BYTES, hc.sdu.nb_writes);
+
+	/* Hex dump lines are written in full packets */
+	host_test_console_clear(&hc);
+	for (i = 0; i < BLOCK_SIZE; i++)
+		data[i] = i;
+	print_hex(&hc.con, data, BLOCK_SIZE);
+	cflush(&hc.con);
+	size = hc.sdu.nb_written;
+	CHECK(host_test_console_wait(&hc, size, 1000));
+	CHECK(hc.sdu.nb_writes == (size + CONSOLE_TX_BUF_SIZE - 1) /
+				  CONSOLE_TX_BUF_SIZE);
+	printf("test_console_tx: print_hex() %u bytes, %u chnWrite() calls\n",
+	       size, hc.sdu.nb_writes);
+
+	/* Large blocks are not copied */
+	host_test_console_clear(&hc);
+	cprint(&hc.con, (char *)data, BLOCK_SIZE);
+	CHECK(hc.sdu.nb_writes == 1);
+	CHECK(hc.sdu.nb_written == BLOCK_SIZE);
+	CHECK(host_test_console_wait(&hc, BLOCK_SIZE, 1000));
+
+	/* Pending output is sent once the console is idle */
+	host_test_console_clear(&hc);
+	cprintf(&hc.con, "idle\r\n");
+	cflush_idle(&hc.con);
+	CHECK(hc.sdu.nb_writes == 0);
+	chThdSleepMilliseconds(CONSOLE_TX_IDLE_MS + 1);
+	cflush_idle(&hc.con);
+	CHECK(hc.sdu.nb_writes == 1);
+	CHECK(host_test_console_wait(&hc, 6, 1000));
+	CHECK(memcmp(hc.out, "idle\r\n", 6) == 0);
+
+	return host_test_end("test_console_tx");
+}
@@ -0,0 +1,126 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Hexdump cycles per byte: print_hex() with the lookup table formatter
+ * against one cprintf() per byte as print_hex() used to do.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "hexdump.h"
+
+#define DUMP_SIZE	(64 * 1024)
+#define NB_RUNS		4
+
+static uint8_t data[DUMP_SIZE];
+
+/* print_hex() before the lookup table formatter */
+static void print_hex_cprintf(t_hydra_console *con, uint8_t *data, uint32_t size)
+{
+	uint8_t ascii[17];
+	uint32_t i, j;
+	ascii[16] = '\0';
+	for (i = 0; i < size; ++i) {
+		cprintf(con, "%02X ", data[i]);
+		if (data[i] >= 0x20 && data[i] < 0x7f) {
+			ascii[i % 16] = data[i];
+		} else {
+			ascii[i % 16] = '.';
+		}
+		if ((i+1) % 8 == 0 || i+1 == size) {
+			cprintf(con, " ");
+			if ((i+1) % 16 == 0) {
+				cprintf(con, "|  %s \r\n", ascii);
+			} else if (i+1 == size) {
+				ascii[(i+1) % 16] = '\0';
+				if ((i+1) % 16 <= 8) {
+					cprintf(con, " ");
+				}
+				for (j = (i+1) % 16; j < 16; ++j) {
+					cprintf(con, "   ");
+				}
+				cprintf(con, "|  %s \r\n", ascii);
+			}
+		}
+	}
+}
+
+/* Best of NB_RUNS, in cycles per dumped byte */
+static uint64_t dump_cycles(t_host_console *hc,
+			    void (*dump)(t_hydra_console *, uint8_t *, uint32_t),
+			    uint32_t *written)
+{
+	uint64_t start, cycles, best = UINT64_MAX;
+	uint32_t run;
+
+	for (run = 0; run < NB_RUNS; run++) {
+		host_test_console_clear(hc);
+		start = host_test_cycles();
+		dump(&hc->con, data, DUMP_SIZE);
+		cflush(&hc->con);
+		cycles = host_test_cycles() - start;
+		if (cycles < best)
+			best = cycles;
+		*written = hc->sdu.nb_written;
+		CHECK(host_test_console_wait(hc, *written, 5000));
+	}
+
+	return best / DUMP_SIZE;
+}
+
+int main(void)
+{
+	static const uint8_t line[] = "0123456789ABC\x7f\x00\xff";
+	static const char expected[] =
+		"00000010  30 31 32 33 34 35 36 37  38 39 41 42 43 7F 00 FF  "
+		"|  0123456789ABC... \r\n";
+	t_host_console hc;
+	char out[HEXDUMP_LINE_MAX];
+	uint64_t table_cpb, cprintf_cpb;
+	uint32_t i, len, table_written, cprintf_written;
+
+	host_test_init();
+
+	/* Offset column, separators, ASCII column */
+	len = hexdump_line(out, line, HEXDUMP_BYTES_PER_LINE, 0x10);
+	CHECK(len == sizeof(expected) - 1);
+	CHECK(memcmp(out, expected, len) == 0);
+	len = hexdump_line(out, line, 3, HEXDUMP_NO_OFFSET);
+	CHECK(len == HEXDUMP_HEX_LEN + 3 + 3 + 3);
+	CHECK(memcmp(out, "30 31 32 ", 9) == 0);
+	CHECK(memcmp(&out[HEXDUMP_HEX_LEN], "|  012 \r\n", 9) == 0);
+
+	host_test_console(&hc, "hexdump test", 0);
+	for (i = 0; i < DUMP_SIZE; i++)
+		data[i] = i * 7;
+
+	table_cpb = dump_cycles(&hc, print_hex, &table_written);
+	cprintf_cpb = dump_cycles(&hc, print_hex_cprintf, &cprintf_written);
+
+	printf("test_hexdump: %u bytes dumped, %llu cycles/byte with print_hex(), "
+	       "%llu with one cprintf() per byte\n", DUMP_SIZE,
+	       (unsigned long long)table_cpb, (unsigned long long)cprintf_cpb);
+	/* Same layout without the offset column */
+	CHECK(table_written == cprintf_written);
+	CHECK(table_cpb * 2 < cprintf_cpb);
+
+	return host_test_end("test_hexdump");
+}
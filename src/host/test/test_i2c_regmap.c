@@ -0,0 +1,288 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * I2C slave register map (hydrabus/hydrabus_i2c_regmap.c) driven as the
+ * I2C1 interrupt handlers do, against a 24Cxx EEPROM model: random writes,
+ * current address reads and random reads (repeated START), the master
+ * NACK before or after the next byte is loaded, and write log overflow.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "hydrabus_i2c_regmap.h"
+
+#define MAX_SIZE	32768
+#define MAX_LOG		(1 << 17)
+#define MAX_WRITE	(2 * 64 + 2)
+#define MAX_READ	40
+#define NB_TRANSACTIONS	2000
+
+typedef struct {
+	uint32_t size;
+	uint8_t addr_bytes;
+	uint16_t page;
+	bool read_only;
+	uint32_t log_len;
+} t_case;
+
+/* 24Cxx: register pointer, auto increment in the page */
+typedef struct {
+	uint8_t data[MAX_SIZE];
+	uint32_t size;
+	uint8_t addr_bytes;
+	uint32_t page;
+	bool read_only;
+	uint32_t reg;
+	t_i2c_regmap_log log[MAX_LOG];
+	uint32_t nb_log;
+} t_eeprom;
+
+static uint8_t map[MAX_SIZE];
+static t_i2c_regmap_log fw_log[1024];
+static t_i2c_regmap_log log[MAX_LOG];
+static uint32_t nb_log;
+static t_eeprom model;
+static uint32_t seed = 1;
+
+static uint32_t rnd(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+static uint32_t eeprom_next(const t_eeprom *e, uint32_t reg)
+{
+	return (reg - reg % e->page) + (reg + 1) % e->page;
+}
+
+static void eeprom_write(t_eeprom *e, const uint8_t *data, uint32_t len)
+{
+	uint32_t reg, i;
+
+	if (len < e->addr_bytes)
+		return;
+	reg = 0;
+	for (i = 0; i < e->addr_bytes; i++)
+		reg = (reg << 8) | data[i];
+	e->reg = reg % e->size;
+	for (i = e->addr_bytes; i < len; i++) {
+		if (e->nb_log < MAX_LOG) {
+			e->log[e->nb_log].reg = e->reg;
+			e->log[e->nb_log].value = data[i];
+			e->log[e->nb_log].flags = (i == e->addr_bytes) ?
+						  I2C_REGMAP_LOG_START : 0;
+			e->nb_log++;
+		}
+		if (!e->read_only)
+			e->data[e->reg] = data[i];
+		e->reg = eeprom_next(e, e->reg);
+	}
+}
+
+static void eeprom_read(t_eeprom *e, uint8_t *data, uint32_t len)
+{
+	uint32_t i;
+
+	for (i = 0; i < len; i++) {
+		data[i] = e->data[e->reg];
+		e->reg = eeprom_next(e, e->reg);
+	}
+}
+
+/* ADDR then RXNE for each byte, STOPF unless a repeated START follows */
+static void periph_write(t_i2c_regmap *rm, const uint8_t *data, uint32_t len,
+			 bool stop)
+{
+	uint32_t i;
+
+	i2c_regmap_start(rm, FALSE);
+	for (i = 0; i < len; i++)
+		i2c_regmap_rx(rm, data[i]);
+	if (stop)
+		i2c_regmap_stop(rm, 0);
+}
+
+/*
+ * ADDR then TXE, the next byte is loaded while the current one is sent.
+ * The master NACKs the last byte, the error handler gives back the byte
+ * left in DR unless the TXE handler was still pending (1 in 5).
+ */
+static void periph_read(t_i2c_regmap *rm, uint8_t *data, uint32_t len)
+{
+	uint32_t i, unsent;
+	uint8_t dr;
+
+	i2c_regmap_start(rm, TRUE);
+	dr = i2c_regmap_tx(rm);
+	unsent = 0;
+	for (i = 0; i < len; i++) {
+		data[i] = dr;
+		if (i < len - 1 || rnd() % 5 != 0) {
+			dr = i2c_regmap_tx(rm);
+			unsent = 1;
+		} else {
+			unsent = 0;
+		}
+	}
+	i2c_regmap_stop(rm, unsent);
+	/* STOPF after the NACK */
+	if (rnd() % 10 < 3)
+		i2c_regmap_stop(rm, 0);
+}
+
+static void log_get(t_i2c_regmap *rm)
+{
+	t_i2c_regmap_log entry;
+
+	while (i2c_regmap_log_get(rm, &entry)) {
+		if (nb_log < MAX_LOG)
+			log[nb_log++] = entry;
+	}
+}
+
+/* Entries are dropped when the log is full, never reordered */
+static bool log_match(void)
+{
+	uint32_t i, j;
+
+	if (nb_log > model.nb_log)
+		return FALSE;
+	for (i = 0, j = 0; i < nb_log; i++, j++) {
+		while (j < model.nb_log && memcmp(&log[i], &model.log[j],
+						   sizeof(log[i])) != 0)
+			j++;
+		if (j == model.nb_log)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static bool run_case(const t_case *tc, uint32_t *lost)
+{
+	t_i2c_regmap rm;
+	uint8_t data[2 + MAX_WRITE], got[MAX_READ], expected[MAX_READ];
+	uint32_t n, i, kind, reg, len, nb_reads, nb_writes;
+
+	for (i = 0; i < tc->size; i++)
+		map[i] = rnd();
+	memcpy(model.data, map, tc->size);
+	model.size = tc->size;
+	model.addr_bytes = tc->addr_bytes;
+	model.page = tc->page ? tc->page : tc->size;
+	model.read_only = tc->read_only;
+	model.reg = 0;
+	model.nb_log = 0;
+	nb_log = 0;
+	i2c_regmap_init(&rm, map, tc->size, tc->addr_bytes, tc->page,
+			tc->read_only, fw_log, tc->log_len);
+
+	nb_reads = 0;
+	nb_writes = 0;
+	for (n = 0; n < NB_TRANSACTIONS; n++) {
+		kind = rnd() % 4;
+		reg = rnd() % (tc->size + 16);
+		for (i = 0; i < tc->addr_bytes; i++)
+			data[i] = reg >> (8 * (tc->addr_bytes - 1 - i));
+		switch (kind) {
+		case 0:
+			/* Write */
+			len = tc->addr_bytes + 1 + rnd() % (2 * (tc->page ? tc->page : 8) + 1);
+			for (i = tc->addr_bytes; i < len; i++)
+				data[i] = rnd();
+			periph_write(&rm, data, len, TRUE);
+			eeprom_write(&model, data, len);
+			nb_writes++;
+			break;
+		case 1:
+			/* Register pointer only */
+			periph_write(&rm, data, tc->addr_bytes, TRUE);
+			eeprom_write(&model, data, tc->addr_bytes);
+			nb_writes++;
+			break;
+		case 2:
+			/* Current address read */
+			len = 1 + rnd() % (MAX_READ - 1);
+			periph_read(&rm, got, len);
+			eeprom_read(&model, expected, len);
+			nb_reads++;
+			if (memcmp(got, expected, len) != 0) {
+				printf("test_i2c_regmap: transaction %u: current read\n", n);
+				return FALSE;
+			}
+			break;
+		default:
+			/* Register address, repeated START then read */
+			len = 1 + rnd() % (MAX_READ - 1);
+			periph_write(&rm, data, tc->addr_bytes, FALSE);
+			eeprom_write(&model, data, tc->addr_bytes);
+			periph_read(&rm, got, len);
+			eeprom_read(&model, expected, len);
+			nb_writes++;
+			nb_reads++;
+			if (memcmp(got, expected, len) != 0) {
+				printf("test_i2c_regmap: transaction %u: random read "
+				       "at 0x%x\n", n, reg % tc->size);
+				return FALSE;
+			}
+			break;
+		}
+		/* The console thread empties the log now and then */
+		if (rnd() % 10 < 3)
+			log_get(&rm);
+	}
+	log_get(&rm);
+	*lost = rm.log_lost;
+
+	CHECK(memcmp(map, model.data, tc->size) == 0);
+	CHECK(nb_log + rm.log_lost == model.nb_log);
+	CHECK(log_match());
+	CHECK(rm.nb_reads == nb_reads && rm.nb_writes == nb_writes);
+	return TRUE;
+}
+
+int main(void)
+{
+	static const t_case cases[] = {
+		{ 256, 1, 0, FALSE, 1024 },
+		{ 256, 1, 8, FALSE, 1024 },
+		{ 128, 1, 16, FALSE, 1024 },
+		{ 4096, 2, 32, FALSE, 1024 },
+		{ 32768, 2, 64, FALSE, 1024 },
+		{ 256, 1, 0, TRUE, 1024 },
+		{ 256, 1, 16, FALSE, 16 },
+	};
+	uint32_t i, lost;
+
+	host_test_init();
+
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		lost = 0;
+		CHECK(run_case(&cases[i], &lost));
+		printf("test_i2c_regmap: size %u addr %u page %u%s log %u: "
+		       "%u lost\n", cases[i].size, cases[i].addr_bytes,
+		       cases[i].page, cases[i].read_only ? " read only" : "",
+		       cases[i].log_len, lost);
+	}
+	/* The small log overflows */
+	CHECK(lost > 0);
+
+	return host_test_end("test_i2c_regmap");
+}
@@ -0,0 +1,404 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * I2C sniffer decoder (hydrabus/hydrabus_i2c_sniff.c) on synthetic
+ * 100kHz and 400kHz traces of random transactions, with fast mode setup
+ * times. The edges are sampled exactly, then as the EXTI handler does:
+ * SCL rising and SDA edges set the pending flags of a shared vector, the
+ * handler clears them then runs the SCL then the SDA callback, edges seen
+ * while a flag is pending are merged and the interrupt entry may be
+ * delayed by higher priority interrupts.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "hydrabus_i2c_sniff.h"
+
+/* DWT cycles of the STM32F405 core */
+#define HCLK		168000000
+
+#define MAX_EDGES	(1 << 19)
+#define MAX_RECS	(1 << 15)
+#define NB_TRANSACTIONS	300
+#define MAX_BYTES	17
+
+#define LINE_SCL	0
+#define LINE_SDA	1
+
+/* EXTI handler timings in cycles, see exti_events() */
+typedef struct {
+	uint32_t entry;
+	uint32_t sample; /* From the callback start to the lines read */
+	uint32_t callback;
+	uint32_t exit;
+	uint32_t jitter; /* Up to this many cycles added to each entry */
+} t_exti;
+
+typedef struct {
+	int64_t t; /* Cycles */
+	uint8_t line;
+	uint8_t level;
+} t_edge;
+
+typedef struct {
+	uint8_t type;
+	uint8_t data;
+	bool ack;
+} t_rec;
+
+/* Waveform generator, lines idle high */
+typedef struct {
+	double t; /* s */
+	double half;
+	double t_su;
+	uint8_t levels[2];
+} t_wave;
+
+/* Edge times of one line, for the sampler */
+typedef struct {
+	int64_t t[MAX_EDGES];
+	uint8_t level[MAX_EDGES];
+	uint32_t nb;
+} t_line;
+
+static const t_exti exti_ideal = { 0, 0, 0, 0, 0 };
+
+static t_edge edges[MAX_EDGES];
+static uint32_t nb_edges;
+static t_rec expected[MAX_RECS];
+static uint32_t nb_expected;
+static uint32_t events[MAX_EDGES];
+static uint32_t nb_events;
+static t_line scl, sda, scl_rise;
+static uint32_t seed = 1;
+
+static uint32_t rnd(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+static double rnd_uniform(double max)
+{
+	return max * (rnd() & 0xFFFF) / 0xFFFF;
+}
+
+static void wave_init(t_wave *w, uint32_t freq, double start)
+{
+	w->t = start;
+	w->half = 0.5 / freq;
+	/* Fast mode setup time */
+	w->t_su = (w->half / 4 < 100e-9) ? w->half / 4 : 100e-9;
+	w->levels[LINE_SCL] = 1;
+	w->levels[LINE_SDA] = 1;
+}
+
+static void set_line(t_wave *w, uint8_t line, uint8_t level)
+{
+	if (w->levels[line] == level || nb_edges == MAX_EDGES)
+		return;
+	w->levels[line] = level;
+	edges[nb_edges].t = (int64_t)(w->t * HCLK);
+	edges[nb_edges].line = line;
+	edges[nb_edges].level = level;
+	nb_edges++;
+}
+
+static void expect(uint8_t type, uint8_t data, bool ack)
+{
+	if (nb_expected == MAX_RECS)
+		return;
+	expected[nb_expected].type = type;
+	expected[nb_expected].data = data;
+	expected[nb_expected].ack = ack;
+	nb_expected++;
+}
+
+/* START (repeated if not the first segment) then the bytes */
+static void wave_segment(t_wave *w, bool repeated, const uint8_t *data,
+			 const bool *acks, uint32_t len)
+{
+	uint32_t i, b;
+	uint8_t bit;
+	double hold;
+
+	if (repeated) {
+		/* SDA high while SCL low, then SCL high */
+		w->t += rnd_uniform(w->half - w->t_su);
+		set_line(w, LINE_SDA, 1);
+		w->t += w->half;
+		set_line(w, LINE_SCL, 1);
+		w->t += w->half;
+	}
+	set_line(w, LINE_SDA, 0);
+	expect(I2C_SNIFF_REC_START, 0, FALSE);
+	w->t += w->half;
+	set_line(w, LINE_SCL, 0);
+
+	for (i = 0; i < len; i++) {
+		for (b = 0; b < 9; b++) {
+			bit = (b < 8) ? (data[i] >> (7 - b)) & 1 : !acks[i];
+			hold = rnd_uniform(w->half - w->t_su);
+			w->t += hold;
+			set_line(w, LINE_SDA, bit);
+			w->t += w->half - hold;
+			set_line(w, LINE_SCL, 1);
+			w->t += w->half;
+			set_line(w, LINE_SCL, 0);
+		}
+		expect(i == 0 ? I2C_SNIFF_REC_ADDR : I2C_SNIFF_REC_DATA, data[i],
+		       acks[i]);
+	}
+}
+
+/* SDA low while SCL low, SCL high, then SDA high */
+static void wave_stop(t_wave *w)
+{
+	w->t += rnd_uniform(w->half - w->t_su);
+	set_line(w, LINE_SDA, 0);
+	w->t += w->half;
+	set_line(w, LINE_SCL, 1);
+	w->t += w->half;
+	set_line(w, LINE_SDA, 1);
+	expect(I2C_SNIFF_REC_STOP, 0, FALSE);
+}
+
+/* 1 or 2 segments of an address and 0, 1, 2 or 16 bytes, 5% NACKs */
+static void wave_random(t_wave *w)
+{
+	static const uint32_t sizes[] = { 0, 1, 2, 16 };
+	const double gaps[] = { w->half * 4, 20e-6, 1e-3 };
+	uint8_t data[MAX_BYTES];
+	bool acks[MAX_BYTES];
+	uint32_t seg, nb_segs, len, i;
+
+	nb_segs = (rnd() % 3 == 2) ? 2 : 1;
+	for (seg = 0; seg < nb_segs; seg++) {
+		len = 1 + sizes[rnd() % 4];
+		for (i = 0; i < len; i++) {
+			data[i] = rnd();
+			acks[i] = (rnd() % 100) >= 5;
+		}
+		wave_segment(w, seg > 0, data, acks, len);
+	}
+	wave_stop(w);
+	w->t += gaps[rnd() % 3];
+}
+
+/* Level at t, first before the first edge */
+static uint8_t line_level(const t_line *l, uint8_t first, int64_t t)
+{
+	uint32_t lo = 0, hi = l->nb, mid;
+
+	/* Edges at or before t */
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (l->t[mid] <= t)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo ? l->level[lo - 1] : first;
+}
+
+/* First edge after t, FALSE if none */
+static bool next_edge(const t_line *l, int64_t after, int64_t *next)
+{
+	uint32_t lo = 0, hi = l->nb, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (l->t[mid] <= after)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == l->nb)
+		return FALSE;
+	*next = l->t[lo];
+	return TRUE;
+}
+
+static void line_add(t_line *l, int64_t t, uint8_t level)
+{
+	l->t[l->nb] = t;
+	l->level[l->nb] = level;
+	l->nb++;
+}
+
+/* Edge events recorded by the EXTI handler, lines idle high before */
+static void exti_events(const t_exti *x)
+{
+	/* SCL rising and SDA edges set the pending flags */
+	const t_line *pend[2] = { &scl_rise, &sda };
+	int64_t cleared[2] = { -1, -1 };
+	int64_t next[2], t, ts, cpu_free;
+	bool pending[2], snapshot[2];
+	uint8_t line, scl_level, sda_level;
+	uint32_t i, ev;
+
+	scl.nb = sda.nb = scl_rise.nb = 0;
+	for (i = 0; i < nb_edges; i++) {
+		if (edges[i].line == LINE_SCL) {
+			line_add(&scl, edges[i].t, edges[i].level);
+			if (edges[i].level)
+				line_add(&scl_rise, edges[i].t, 1);
+		} else {
+			line_add(&sda, edges[i].t, edges[i].level);
+		}
+	}
+
+	nb_events = 0;
+	cpu_free = 0;
+	while (1) {
+		for (line = 0; line < 2; line++)
+			pending[line] = next_edge(pend[line], cleared[line], &next[line]);
+		if (!pending[LINE_SCL] && !pending[LINE_SDA])
+			break;
+		if (pending[LINE_SCL] && pending[LINE_SDA])
+			t = (next[LINE_SCL] < next[LINE_SDA]) ? next[LINE_SCL] : next[LINE_SDA];
+		else
+			t = pending[LINE_SCL] ? next[LINE_SCL] : next[LINE_SDA];
+		if (t < cpu_free)
+			t = cpu_free;
+		t += x->entry;
+		if (x->jitter)
+			t += rnd() % (x->jitter + 1);
+
+		/* The handler clears the pending flags then runs the callbacks */
+		for (line = 0; line < 2; line++) {
+			snapshot[line] = pending[line] && next[line] <= t;
+			if (snapshot[line])
+				cleared[line] = t;
+		}
+		for (line = 0; line < 2; line++) {
+			if (!snapshot[line])
+				continue;
+			ts = t + x->sample;
+			scl_level = line_level(&scl, 1, ts);
+			sda_level = line_level(&sda, 1, ts);
+			ev = I2C_SNIFF_TIME((uint32_t)ts);
+			if (line == LINE_SCL) {
+				ev |= I2C_SNIFF_CLOCK;
+			} else if (next_edge(&scl_rise, cleared[LINE_SCL], &next[LINE_SCL]) &&
+				   next[LINE_SCL] <= ts) {
+				/* SCL rose before the SDA level was read */
+				scl_level = 0;
+			}
+			if (scl_level)
+				ev |= I2C_SNIFF_SCL;
+			if (sda_level)
+				ev |= I2C_SNIFF_SDA;
+			if (nb_events < MAX_EDGES)
+				events[nb_events++] = ev;
+			t += x->callback;
+		}
+		cpu_free = t + x->exit;
+	}
+}
+
+/* Decodes the events, returns the number of bytes cut, -1 on mismatch */
+static int decode(void)
+{
+	t_i2c_sniff s;
+	t_i2c_sniff_rec rec;
+	uint32_t i, nb_recs;
+	bool match;
+
+	i2c_sniff_init(&s, I2C_SNIFF_SCL | I2C_SNIFF_SDA);
+	nb_recs = 0;
+	match = TRUE;
+	for (i = 0; i < nb_events; i++) {
+		if (!i2c_sniff_decode(&s, events[i], &rec))
+			continue;
+		if (nb_recs >= nb_expected || rec.type != expected[nb_recs].type ||
+		    rec.data != expected[nb_recs].data ||
+		    (bool)rec.ack != expected[nb_recs].ack) {
+			if (match)
+				printf("test_i2c_sniff: record %u: type %u data 0x%02x "
+				       "ack %u\n", nb_recs, rec.type, rec.data, rec.ack);
+			match = FALSE;
+		}
+		nb_recs++;
+	}
+	if (!match || nb_recs != nb_expected)
+		return -1;
+	return s.errors;
+}
+
+static void check_case(const char *name, uint32_t freq, const t_exti *x)
+{
+	t_wave w;
+	uint32_t i;
+
+	nb_edges = 0;
+	nb_expected = 0;
+	wave_init(&w, freq, 10e-6);
+	for (i = 0; i < NB_TRANSACTIONS; i++)
+		wave_random(&w);
+	CHECK(nb_edges < MAX_EDGES && nb_expected < MAX_RECS);
+	exti_events(x);
+	CHECK(decode() == 0);
+	printf("test_i2c_sniff: %s %uHz jitter %u: %u edges, %u events, "
+	       "%u records\n", name, freq, x->jitter, nb_edges, nb_events,
+	       nb_expected);
+}
+
+/* A START after 3 bits of the address */
+static void check_cut(void)
+{
+	static const uint8_t addr[] = { 0xA0 }, addr2[] = { 0xA1 };
+	static const bool ack[] = { TRUE };
+	t_wave w;
+
+	nb_edges = 0;
+	nb_expected = 0;
+	wave_init(&w, 100000, 10e-6);
+	wave_segment(&w, FALSE, addr, ack, 1);
+	nb_edges = 10;
+	nb_expected = 0;
+	wave_init(&w, 100000, 1e-3);
+	wave_segment(&w, FALSE, addr2, ack, 1);
+	wave_stop(&w);
+	/* START of the cut byte */
+	memmove(&expected[1], expected, nb_expected * sizeof(expected[0]));
+	expected[0].type = I2C_SNIFF_REC_START;
+	nb_expected++;
+	exti_events(&exti_ideal);
+	CHECK(decode() == 1);
+}
+
+int main(void)
+{
+	/* Handler timings of the firmware at 168MHz */
+	const t_exti exti = { 40, 20, 60, 12, 0 };
+	const t_exti exti_jitter = { 40, 20, 60, 12, 60 };
+
+	host_test_init();
+
+	check_case("ideal", 400000, &exti_ideal);
+	check_case("exti", 100000, &exti);
+	check_case("exti", 400000, &exti);
+	check_case("exti", 400000, &exti_jitter);
+	check_cut();
+
+	return host_test_end("test_i2c_sniff");
+}
@@ -0,0 +1,113 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Mode bulk transfers: BSP driver calls made by the bulk_* callbacks
+ * against the 255 bytes write_read() calls used before.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "bsp.h"
+#include "bsp_host.h"
+
+#define SPI_SIZE	100000
+#define UART_SIZE	1500
+#define CHUNK_SIZE	255
+
+extern const mode_exec_t mode_spi_exec;
+extern const mode_exec_t mode_uart_exec;
+
+static uint8_t tx[SPI_SIZE];
+static uint8_t rx[SPI_SIZE];
+
+/* Mode with its default parameters */
+static void mode_init(t_host_console *hc, const mode_exec_t *exec)
+{
+	static t_tokenline_parsed p;
+
+	memset(&p, 0, sizeof(p));
+	hc->mode.exec = exec;
+	exec->init(&hc->con, &p);
+}
+
+int main(void)
+{
+	t_host_console hc;
+	t_bsp_host_stats stats;
+	uint32_t i, len, chunk_calls;
+
+	host_test_init();
+	host_test_console(&hc, "mode_bulk test", 0);
+	for (i = 0; i < SPI_SIZE; i++)
+		tx[i] = i * 13;
+
+	/* SPI, MISO is wired to MOSI */
+	mode_init(&hc, &mode_spi_exec);
+	bsp_host_reset_stats();
+	for (i = 0; i < SPI_SIZE; i += len) {
+		len = (SPI_SIZE - i > CHUNK_SIZE) ? CHUNK_SIZE : SPI_SIZE - i;
+		CHECK(mode_spi_exec.write_read(&hc.con, &tx[i], &rx[i], len) == BSP_OK);
+	}
+	bsp_host_get_stats(&stats);
+	chunk_calls = stats.calls[BSP_HOST_SPI];
+	CHECK(chunk_calls == (SPI_SIZE + CHUNK_SIZE - 1) / CHUNK_SIZE);
+
+	memset(rx, 0, SPI_SIZE);
+	bsp_host_reset_stats();
+	CHECK(mode_spi_exec.bulk_write_read(&hc.con, tx, rx, SPI_SIZE) == BSP_OK);
+	bsp_host_get_stats(&stats);
+	CHECK(stats.calls[BSP_HOST_SPI] ==
+	      (SPI_SIZE + HYDRABUS_MODE_BULK_CHUNK - 1) / HYDRABUS_MODE_BULK_CHUNK);
+	CHECK(stats.calls[BSP_HOST_SPI_DMA] == stats.calls[BSP_HOST_SPI]);
+	CHECK(stats.bytes[BSP_HOST_SPI] == SPI_SIZE);
+	CHECK(memcmp(tx, rx, SPI_SIZE) == 0);
+	printf("test_mode_bulk: SPI %u bytes, %u driver calls with write_read(), "
+	       "%u with bulk_write_read()\n", SPI_SIZE, chunk_calls,
+	       stats.calls[BSP_HOST_SPI]);
+
+	bsp_host_reset_stats();
+	CHECK(mode_spi_exec.bulk_write(&hc.con, tx, SPI_SIZE) == BSP_OK);
+	CHECK(mode_spi_exec.bulk_read(&hc.con, rx, HYDRABUS_MODE_BULK_CHUNK) == BSP_OK);
+	bsp_host_get_stats(&stats);
+	CHECK(stats.calls[BSP_HOST_SPI] == 3);
+	CHECK(stats.bytes[BSP_HOST_SPI] == SPI_SIZE + HYDRABUS_MODE_BULK_CHUNK);
+	mode_spi_exec.cleanup(&hc.con);
+
+	/* UART, RX is wired to TX */
+	mode_init(&hc, &mode_uart_exec);
+	memset(rx, 0, UART_SIZE);
+	bsp_host_reset_stats();
+	CHECK(mode_uart_exec.bulk_write_read(&hc.con, tx, rx, UART_SIZE) == BSP_OK);
+	CHECK(memcmp(tx, rx, UART_SIZE) == 0);
+	CHECK(mode_uart_exec.bulk_write(&hc.con, &tx[UART_SIZE], UART_SIZE) == BSP_OK);
+	CHECK(mode_uart_exec.bulk_read(&hc.con, rx, UART_SIZE) == BSP_OK);
+	CHECK(memcmp(&tx[UART_SIZE], rx, UART_SIZE) == 0);
+	bsp_host_get_stats(&stats);
+	CHECK(stats.calls[BSP_HOST_UART_TX] == 2);
+	CHECK(stats.calls[BSP_HOST_UART_RX] == 2);
+	CHECK(stats.bytes[BSP_HOST_UART_RX] == 2 * UART_SIZE);
+	printf("test_mode_bulk: UART %u bytes, %u TX and %u RX driver calls\n",
+	       2 * UART_SIZE, stats.calls[BSP_HOST_UART_TX],
+	       stats.calls[BSP_HOST_UART_RX]);
+	mode_uart_exec.cleanup(&hc.con);
+
+	return host_test_end("test_mode_bulk");
+}
@@ -0,0 +1,310 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * NAND dump: Hamming ECC and ONFI parsing, then the BBIO probe and page
+ * read commands against the NAND model (host/nand.c), to USB with and
+ * without ECC and to the microSD.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "bsp_host.h"
+#include "hydrabus_bbio.h"
+#include "hydrabus_bbio_flash.h"
+#include "hydrabus_nand.h"
+#include "hydrabus_spi_flash.h"
+
+#define NB_PAGES	(4 * HOST_NAND_PAGES_PER_BLOCK)
+#define SD_PAGES	HOST_NAND_PAGES_PER_BLOCK
+#define OUT_SIZE	(NB_PAGES * (HOST_NAND_PAGE_SIZE + 5) + 16)
+
+#define READ_PAGES_SD		0x01
+#define READ_PAGES_ECC		0x02
+#define READ_PAGES_STATUS	0x04
+
+static uint8_t expected[HOST_NAND_PAGE_SIZE];
+static uint8_t sd_data[HOST_NAND_PAGE_SIZE];
+
+static THD_WORKING_AREA(wa_bbio, 4096);
+
+static THD_FUNCTION(bbio, arg)
+{
+	chRegSetThreadName("bbio flash");
+	bbio_mode_flash(arg);
+}
+
+static uint32_t be32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void put_be32(uint8_t *p, uint32_t val)
+{
+	p[0] = val >> 24;
+	p[1] = val >> 16;
+	p[2] = val >> 8;
+	p[3] = val;
+}
+
+static void flip_bit(uint8_t *data, uint32_t bit)
+{
+	data[bit / 8] ^= 1 << (bit % 8);
+}
+
+/* Single errors in data or ECC are corrected, double errors detected */
+static void check_ecc(void)
+{
+	uint8_t data[NAND_ECC_STEP_SIZE], bad[NAND_ECC_STEP_SIZE];
+	uint8_t ecc[NAND_ECC_BYTES], calc[NAND_ECC_BYTES], bad_ecc[NAND_ECC_BYTES];
+	uint32_t n, i, pos, pos2, nb_errors;
+
+	/* Bit 3 of byte 0x5A, as the Linux software ECC */
+	memset(data, 0, sizeof(data));
+	data[0x5A] = 0x08;
+	nand_ecc_calc(data, ecc);
+	CHECK(ecc[0] == 0x99 && ecc[1] == 0x66 && ecc[2] == 0x97);
+	memset(data, 0xFF, sizeof(data));
+	nand_ecc_calc(data, ecc);
+	CHECK(ecc[0] == 0xFF && ecc[1] == 0xFF && ecc[2] == 0xFF);
+
+	srand(1);
+	nb_errors = 0;
+	for (n = 0; n < 2000; n++) {
+		for (i = 0; i < sizeof(data); i++)
+			data[i] = rand();
+		nand_ecc_calc(data, ecc);
+
+		memcpy(bad, data, sizeof(bad));
+		flip_bit(bad, rand() % (NAND_ECC_STEP_SIZE * 8));
+		nand_ecc_calc(bad, calc);
+		if (nand_ecc_correct(bad, ecc, calc) != 1 ||
+		    memcmp(bad, data, sizeof(data)) != 0)
+			nb_errors++;
+
+		/* The 2 low bits of the last byte are not used */
+		memcpy(bad_ecc, ecc, sizeof(bad_ecc));
+		pos = rand() % 22;
+		flip_bit(bad_ecc, (pos < 16) ? pos : pos + 2);
+		memcpy(bad, data, sizeof(bad));
+		if (nand_ecc_correct(bad, bad_ecc, ecc) != 1 ||
+		    memcmp(bad, data, sizeof(data)) != 0)
+			nb_errors++;
+
+		memcpy(bad, data, sizeof(bad));
+		pos = rand() % (NAND_ECC_STEP_SIZE * 8);
+		do {
+			pos2 = rand() % (NAND_ECC_STEP_SIZE * 8);
+		} while (pos2 == pos);
+		flip_bit(bad, pos);
+		flip_bit(bad, pos2);
+		nand_ecc_calc(bad, calc);
+		if (nand_ecc_correct(bad, ecc, calc) != -1)
+			nb_errors++;
+	}
+	CHECK(nb_errors == 0);
+}
+
+static void check_onfi(void)
+{
+	uint8_t param[NAND_ONFI_PARAM_SIZE];
+	t_nand nand;
+
+	memcpy(param, host_nand_onfi_param(), sizeof(param));
+	memset(&nand, 0, sizeof(nand));
+	CHECK(nand_parse_onfi(param, &nand));
+	CHECK(strcmp(nand.model, "MT29F2G08ABAEAWP") == 0);
+	CHECK(nand.page_size == HOST_NAND_PAGE_SIZE &&
+	      nand.nb_blocks == HOST_NAND_NB_BLOCKS && nand.row_cycles == 3 &&
+	      nand.col_cycles == 2 && nand.ecc_bits == 1);
+
+	param[80] ^= 0x01;
+	memset(&nand, 0, sizeof(nand));
+	CHECK(!nand_parse_onfi(param, &nand));
+	CHECK(!nand.onfi);
+}
+
+/* The first parameter page copy has a bad CRC */
+static void probe(t_host_console *hc)
+{
+	uint8_t cmd;
+
+	host_test_console_clear(hc);
+	cmd = BBIO_FLASH_PROBE;
+	host_test_console_input(hc, &cmd, 1);
+	CHECK(host_test_console_wait(hc, 26, 1000));
+	CHECK(hc->out[0] == 0x01);
+	CHECK(memcmp(&hc->out[1], "\x2C\xDA\x90\x95\x06", 5) == 0);
+	/* ONFI, 2 column and 3 row cycles */
+	CHECK(hc->out[6] == 0x01 && hc->out[7] == 2 && hc->out[8] == 3);
+	CHECK(be32(&hc->out[9]) == 2048);
+	CHECK(be32(&hc->out[13]) == HOST_NAND_PAGE_SIZE);
+	CHECK(be32(&hc->out[17]) == HOST_NAND_PAGES_PER_BLOCK);
+	CHECK(be32(&hc->out[21]) == HOST_NAND_NB_BLOCKS);
+	CHECK(hc->out[25] == 1);
+}
+
+/* Pages from row 0, FALSE if the command failed */
+static bool read_pages(t_host_console *hc, uint32_t nb_pages, uint8_t flags)
+{
+	uint8_t cmd[18];
+	uint32_t size;
+
+	cmd[0] = BBIO_FLASH_READ_PAGES;
+	cmd[1] = 2;
+	cmd[2] = 3;
+	cmd[3] = HOST_NAND_PAGE_SIZE >> 8;
+	cmd[4] = HOST_NAND_PAGE_SIZE & 0xFF;
+	put_be32(&cmd[5], HOST_NAND_PAGES_PER_BLOCK);
+	put_be32(&cmd[9], 0);
+	put_be32(&cmd[13], nb_pages);
+	cmd[17] = flags | READ_PAGES_STATUS;
+
+	size = nb_pages * (((flags & READ_PAGES_SD) ? 0 : HOST_NAND_PAGE_SIZE) + 5);
+	host_test_console_clear(hc);
+	host_test_console_input(hc, cmd, sizeof(cmd));
+	if (!host_test_console_wait(hc, 2 + size, 10000) || hc->out[0] != 0x01 ||
+	    hc->out[1 + size] != 0x01)
+		return FALSE;
+	return TRUE;
+}
+
+static bool bad_block(uint32_t row)
+{
+	static const uint8_t bad_blocks[] = HOST_NAND_BAD_BLOCKS;
+	uint32_t i;
+
+	for (i = 0; i < sizeof(bad_blocks); i++) {
+		if (row == bad_blocks[i] * HOST_NAND_PAGES_PER_BLOCK)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/* Expected status of a row, see host_nand_page() */
+static uint8_t row_status(uint32_t row, bool ecc)
+{
+	if (bad_block(row))
+		return NAND_PAGE_BAD_BLOCK;
+	if (!ecc)
+		return 0;
+	if (row % 11 == 3)
+		return NAND_PAGE_ECC_CORRECTED;
+	if (row % 97 == 5)
+		return NAND_PAGE_ECC_FAILED;
+	return 0;
+}
+
+/* Data and CRC32 of the pages, returns the number of bad pages */
+static uint32_t check_pages(t_host_console *hc, bool ecc, uint32_t *nb_status)
+{
+	const uint8_t *p;
+	uint8_t status;
+	uint32_t row, nb_bad;
+
+	nb_bad = 0;
+	p = &hc->out[1];
+	for (row = 0; row < NB_PAGES; row++) {
+		status = row_status(row, ecc);
+		/* Uncorrectable pages and bad block markers are left as read */
+		host_nand_page(row, expected,
+			       !ecc || (status & ~NAND_PAGE_ECC_CORRECTED));
+		if (memcmp(p, expected, HOST_NAND_PAGE_SIZE) != 0 ||
+		    be32(&p[HOST_NAND_PAGE_SIZE]) !=
+		    spi_flash_crc32(0, expected, HOST_NAND_PAGE_SIZE) ||
+		    p[HOST_NAND_PAGE_SIZE + 4] != status)
+			nb_bad++;
+		if (status)
+			nb_status[status >> 1]++;
+		p += HOST_NAND_PAGE_SIZE + 5;
+	}
+	return nb_bad;
+}
+
+/* Only the CRC32 are sent, the pages are in nand_dump.bin */
+static void check_sd(t_host_console *hc)
+{
+	FIL file;
+	UINT nb_read;
+	uint32_t row, nb_bad;
+
+	CHECK(read_pages(hc, SD_PAGES, READ_PAGES_SD));
+	CHECK(f_open(&file, "nand_dump.bin", FA_READ) == FR_OK);
+	nb_bad = 0;
+	for (row = 0; row < SD_PAGES; row++) {
+		host_nand_page(row, expected, TRUE);
+		if (f_read(&file, sd_data, sizeof(sd_data), &nb_read) != FR_OK ||
+		    nb_read != sizeof(sd_data) ||
+		    memcmp(sd_data, expected, sizeof(sd_data)) != 0 ||
+		    be32(&hc->out[1 + row * 5]) !=
+		    spi_flash_crc32(0, expected, sizeof(expected)))
+			nb_bad++;
+	}
+	f_close(&file);
+	CHECK(nb_bad == 0);
+}
+
+int main(void)
+{
+	t_host_console hc;
+	thread_t *thd;
+	uint32_t nb_status[3];
+	uint64_t start, ns;
+	uint8_t cmd;
+
+	host_test_init();
+	host_test_sd();
+	check_ecc();
+	host_nand_attach();
+	check_onfi();
+
+	host_test_console(&hc, "nand_dump test", OUT_SIZE);
+	thd = chThdCreateStatic(wa_bbio, sizeof(wa_bbio), NORMALPRIO, bbio,
+				&hc.con);
+	CHECK(host_test_console_wait(&hc, 4, 1000));
+	CHECK(memcmp(hc.out, BBIO_FLASH_HEADER, 4) == 0);
+
+	probe(&hc);
+
+	start = host_test_ns();
+	CHECK(read_pages(&hc, NB_PAGES, 0));
+	ns = host_test_ns() - start;
+	memset(nb_status, 0, sizeof(nb_status));
+	CHECK(check_pages(&hc, FALSE, nb_status) == 0);
+	/* Block 3, the metadata in other pages is not a marker */
+	CHECK(nb_status[0] == 1);
+
+	CHECK(read_pages(&hc, NB_PAGES, READ_PAGES_ECC));
+	memset(nb_status, 0, sizeof(nb_status));
+	CHECK(check_pages(&hc, TRUE, nb_status) == 0);
+	CHECK(nb_status[1] > 0 && nb_status[2] == 2);
+
+	check_sd(&hc);
+
+	printf("test_nand_dump: %u pages in %u ms, %u corrected, %u uncorrectable\n",
+	       NB_PAGES, (uint32_t)(ns / 1000000), nb_status[1], nb_status[2]);
+
+	cmd = BBIO_RESET;
+	host_test_console_input(&hc, &cmd, 1);
+	chThdWait(thd);
+
+	return host_test_end("test_nand_dump");
+}
@@ -0,0 +1,163 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Scratch buffer leases: ownership, and two console threads leasing,
+ * filling and checking buffers at the same time.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "sbuf.h"
+
+#define NB_LEASES	20000
+
+typedef struct {
+	t_host_console hc;
+	uint8_t id;
+	uint32_t leases;
+	uint32_t failed;
+	uint32_t corrupted;
+	uint32_t bad_free;
+} t_lease_console;
+
+static THD_WORKING_AREA(wa_console1, 1024);
+static THD_WORKING_AREA(wa_console2, 1024);
+
+static THD_FUNCTION(lease_thread, arg)
+{
+	t_lease_console *lc = arg;
+	t_hydra_console *con = &lc->hc.con;
+	sbuf_arena_t arena;
+	uint32_t i, j, size, seed = lc->id;
+	uint8_t *buf, fill;
+
+	chRegSetThreadName(lc->hc.con.thread_name);
+	for (i = 0; i < NB_LEASES; i++) {
+		seed = seed * 1103515245 + 12345;
+		arena = (seed >> 16) & 1 ? SBUF_CCM : SBUF_RAM;
+		size = ((seed >> 17) % 3 + 1) *
+		       (arena == SBUF_RAM ? SBUF_RAM_BLOCK_SIZE : SBUF_CCM_BLOCK_SIZE);
+		buf = sbuf_alloc(con, arena, size);
+		if (buf == NULL) {
+			lc->failed++;
+			chThdYield();
+			continue;
+		}
+		lc->leases++;
+
+		/* The other console must not write into the lease */
+		fill = lc->id ^ i;
+		memset(buf, fill, size);
+		chThdYield();
+		for (j = 0; j < size; j++) {
+			if (buf[j] != fill) {
+				lc->corrupted++;
+				break;
+			}
+		}
+		if (!sbuf_free(con, buf))
+			lc->bad_free++;
+	}
+}
+
+/* Blocks used and high water of one arena, as shown by 'show memory' */
+static bool arena_usage(t_host_console *hc, const char *name,
+			uint32_t *used, uint32_t *high_water)
+{
+	char prefix[16], *line;
+	uint32_t nb_blocks;
+
+	host_test_console_clear(hc);
+	sbuf_show(&hc->con);
+	cflush(&hc->con);
+	if (!host_test_console_wait(hc, hc->sdu.nb_written, 1000))
+		return FALSE;
+
+	snprintf(prefix, sizeof(prefix), "sbuf %s ", name);
+	line = strstr((char *)hc->out, prefix);
+	if (line == NULL)
+		return FALSE;
+	line = strchr(line, ':');
+
+	return sscanf(line, ": %u/%u blocks of %*u bytes used, high water %u",
+		      used, &nb_blocks, high_water) == 3;
+}
+
+int main(void)
+{
+	static t_lease_console lc1, lc2;
+	t_hydra_console *con1 = &lc1.hc.con, *con2 = &lc2.hc.con;
+	thread_t *thd1, *thd2;
+	uint32_t used, high_water;
+	void *ptr, *ptr2;
+
+	host_test_init();
+	host_test_console(&lc1.hc, "sbuf test 1", 1024);
+	host_test_console(&lc2.hc, "sbuf test 2", 1024);
+	lc1.id = 0x11;
+	lc2.id = 0x22;
+
+	/* Only the owner releases a lease */
+	ptr = sbuf_alloc(con1, SBUF_RAM, 100);
+	CHECK(ptr != NULL);
+	CHECK(!sbuf_free(con2, ptr));
+	CHECK(!sbuf_free(con1, (uint8_t *)ptr + 4));
+	CHECK(sbuf_free(con1, ptr));
+	CHECK(!sbuf_free(con1, ptr));
+
+	/* A full arena fails until the command of the owner is over */
+	ptr = sbuf_alloc(con1, SBUF_CCM, SBUF_CCM_SIZE);
+	CHECK(ptr != NULL);
+	CHECK(sbuf_alloc(con2, SBUF_CCM, 1) == NULL);
+	ptr2 = sbuf_alloc(con2, SBUF_RAM, SBUF_RAM_BLOCK_SIZE);
+	CHECK(ptr2 != NULL);
+	sbuf_free_all(con1);
+	CHECK(sbuf_alloc(con2, SBUF_CCM, 1) != NULL);
+	sbuf_free_all(con2);
+	CHECK(arena_usage(&lc1.hc, "RAM", &used, &high_water));
+	CHECK(used == 0 && high_water == 1);
+	CHECK(arena_usage(&lc1.hc, "CCM", &used, &high_water));
+	CHECK(used == 0 && high_water == SBUF_CCM_NB_BLOCKS);
+
+	/* Both consoles at the same time */
+	thd1 = chThdCreateStatic(wa_console1, sizeof(wa_console1), NORMALPRIO,
+				 lease_thread, &lc1);
+	thd2 = chThdCreateStatic(wa_console2, sizeof(wa_console2), NORMALPRIO,
+				 lease_thread, &lc2);
+	chThdWait(thd1);
+	chThdWait(thd2);
+
+	printf("test_sbuf: %u + %u leases, %u + %u failed, %u + %u corrupted\n",
+	       lc1.leases, lc2.leases, lc1.failed, lc2.failed,
+	       lc1.corrupted, lc2.corrupted);
+	CHECK(lc1.leases + lc1.failed == NB_LEASES);
+	CHECK(lc2.leases + lc2.failed == NB_LEASES);
+	CHECK(lc1.corrupted == 0 && lc2.corrupted == 0);
+	CHECK(lc1.bad_free == 0 && lc2.bad_free == 0);
+
+	/* Every lease was released, at most two at a time */
+	CHECK(arena_usage(&lc1.hc, "RAM", &used, &high_water));
+	CHECK(used == 0 && high_water <= 2 * 3);
+	CHECK(arena_usage(&lc1.hc, "CCM", &used, &high_water));
+	CHECK(used == 0);
+
+	return host_test_end("test_sbuf");
+}
@@ -0,0 +1,124 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * SD logging write amplification: console output logged by the logger
+ * thread, against one file_append() per output fragment and one
+ * file_sync() per command as done before.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "microsd.h"
+#include "logger.h"
+
+#define NB_COMMANDS	200
+#define NB_FRAGMENTS	8
+#define FRAGMENT_SIZE	24
+#define LOG_SIZE	(NB_COMMANDS * NB_FRAGMENTS * FRAGMENT_SIZE)
+
+static char fragment[FRAGMENT_SIZE + 1];
+
+static const char *make_fragment(uint32_t cmd, uint32_t i)
+{
+	snprintf(fragment, sizeof(fragment), "cmd %05u fragment %03u\r\n",
+		 cmd, i);
+	return fragment;
+}
+
+/* Sectors written per sector of data */
+static uint32_t amplification_x100(void)
+{
+	t_ff_host_stats stats;
+
+	ff_host_get_stats(&stats);
+	printf("test_sd_log: %u sectors written, %u read, %u syncs for %u bytes\n",
+	       stats.sector_writes, stats.sector_reads, stats.syncs, LOG_SIZE);
+
+	return stats.sector_writes * 100 / (LOG_SIZE / MMCSD_BLOCK_SIZE);
+}
+
+static bool check_file(const char *filename)
+{
+	FIL fp;
+	char data[FRAGMENT_SIZE];
+	uint32_t cmd, i;
+	bool ok;
+
+	if (!file_open(&fp, filename, 'r'))
+		return FALSE;
+
+	ok = (f_size(&fp) == LOG_SIZE);
+	for (cmd = 0; cmd < NB_COMMANDS && ok; cmd++) {
+		for (i = 0; i < NB_FRAGMENTS && ok; i++) {
+			ok = file_read(&fp, (uint8_t *)data, FRAGMENT_SIZE) == FRAGMENT_SIZE &&
+			     memcmp(data, make_fragment(cmd, i), FRAGMENT_SIZE) == 0;
+		}
+	}
+	file_close(&fp);
+
+	return ok;
+}
+
+int main(void)
+{
+	t_host_console hc;
+	FIL fp;
+	uint32_t cmd, i, append_x100, logger_x100;
+
+	host_test_init();
+	host_test_sd();
+	host_test_console(&hc, "sd_log test", 0);
+	logger_init();
+
+	/* Previous path */
+	CHECK(file_open(&fp, "/append.txt", 'w'));
+	ff_host_reset_stats();
+	for (cmd = 0; cmd < NB_COMMANDS; cmd++) {
+		for (i = 0; i < NB_FRAGMENTS; i++)
+			file_append(&fp, (uint8_t *)make_fragment(cmd, i), FRAGMENT_SIZE);
+		file_sync(&fp);
+	}
+	file_close(&fp);
+	append_x100 = amplification_x100();
+	CHECK(check_file("/append.txt"));
+
+	/* Logger thread, console output is flushed at the end of each command */
+	CHECK(logger_start(&hc.con, "/logger.txt"));
+	ff_host_reset_stats();
+	for (cmd = 0; cmd < NB_COMMANDS; cmd++) {
+		for (i = 0; i < NB_FRAGMENTS; i++)
+			cprintf(&hc.con, "%s", make_fragment(cmd, i));
+		cflush(&hc.con);
+		chThdSleepMilliseconds(1);
+	}
+	CHECK(logger_stop(&hc.con) == 0);
+	logger_x100 = amplification_x100();
+	CHECK(check_file("/logger.txt"));
+
+	printf("test_sd_log: write amplification %u.%02u per fragment, %u.%02u with the logger\n",
+	       append_x100 / 100, append_x100 % 100,
+	       logger_x100 / 100, logger_x100 % 100);
+	/* Data sectors written once, plus a few syncs */
+	CHECK(logger_x100 < 110);
+	CHECK(logger_x100 * 2 < append_x100);
+
+	return host_test_end("test_sd_log");
+}
@@ -0,0 +1,74 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* ChibiOS shim, register mapping and console pseudo terminal */
+
+#include <string.h>
+
+#include "host_test.h"
+
+static THD_WORKING_AREA(wa_waiter, 512);
+static SEMAPHORE_DECL(sem_start, 0);
+static SEMAPHORE_DECL(sem_done, 0);
+
+static THD_FUNCTION(waiter, arg)
+{
+	(void)arg;
+
+	chRegSetThreadName("waiter");
+	chSemWait(&sem_start);
+	chSemSignal(&sem_done);
+}
+
+int main(void)
+{
+	t_host_console hc;
+	uint8_t input[8];
+	systime_t start;
+
+	host_test_init();
+
+	/* Unique ID and flash size as read by the firmware */
+	CHECK(*(volatile uint32_t *)0x1FFF7A10 == 0x484F5354);
+	CHECK(*(volatile uint16_t *)0x1FFF7A22 == 1024);
+
+	/* Threads, semaphores and timeouts */
+	chThdCreateStatic(wa_waiter, sizeof(wa_waiter), NORMALPRIO, waiter, NULL);
+	CHECK(chSemWaitTimeout(&sem_done, TIME_MS2I(10)) == MSG_TIMEOUT);
+	chSemSignal(&sem_start);
+	CHECK(chSemWaitTimeout(&sem_done, TIME_MS2I(1000)) == MSG_OK);
+
+	start = chVTGetSystemTimeX();
+	chThdSleepMilliseconds(20);
+	CHECK(chVTTimeElapsedSinceX(start) >= TIME_MS2I(20));
+
+	/* Console output and input */
+	host_test_console(&hc, "console test", 256);
+	cprintf(&hc.con, "%s %d\r\n", "hydrabus", 42);
+	cflush(&hc.con);
+	CHECK(host_test_console_wait(&hc, 13, 1000));
+	CHECK(strcmp((char *)hc.out, "hydrabus 42\r\n") == 0);
+	CHECK(hc.sdu.nb_written == 13);
+
+	host_test_console_input(&hc, "abc", 3);
+	CHECK(cread_timeout(&hc.con, input, 3, TIME_MS2I(1000)) == 3);
+	CHECK(memcmp(input, "abc", 3) == 0);
+	CHECK(cread_timeout(&hc.con, input, 1, TIME_MS2I(10)) == 0);
+
+	return host_test_end("test_shim");
+}
@@ -0,0 +1,135 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* SPI DMA transfers against the mock DMA of host/bsp/bsp_spi.c */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "bsp_host.h"
+
+#define XFER_SIZE	0xFFFF
+/* Time on the wire at 42MHz */
+#define XFER_NS		((uint64_t)XFER_SIZE * 8 * 1000 / 42)
+
+typedef struct {
+	uint32_t calls;
+	bsp_dev_spi_t dev_num;
+	bsp_status_t status;
+} t_xfer_end;
+
+static uint8_t tx[XFER_SIZE];
+static uint8_t rx[XFER_SIZE];
+static uint8_t rx2[XFER_SIZE];
+
+/* Run by the DMA at the end of the transfer */
+static void xfer_end(bsp_dev_spi_t dev_num, bsp_status_t status, void *arg)
+{
+	t_xfer_end *end = arg;
+
+	end->dev_num = dev_num;
+	end->status = status;
+	__atomic_add_fetch(&end->calls, 1, __ATOMIC_SEQ_CST);
+}
+
+static void spi_init(bsp_dev_spi_t dev_num, uint8_t dev_mode)
+{
+	mode_config_proto_t proto;
+
+	memset(&proto, 0, sizeof(proto));
+	proto.config.spi.dev_mode = dev_mode;
+	bsp_spi_init(dev_num, &proto);
+}
+
+static uint32_t dma_calls(void)
+{
+	t_bsp_host_stats stats;
+
+	bsp_host_get_stats(&stats);
+	return stats.calls[BSP_HOST_SPI_DMA];
+}
+
+int main(void)
+{
+	t_xfer_end end;
+	uint64_t start, start_ns, wait_ns;
+	uint32_t i;
+
+	host_test_init();
+	for (i = 0; i < XFER_SIZE; i++)
+		tx[i] = i * 5;
+	spi_init(BSP_DEV_SPI1, DEV_MASTER);
+	spi_init(BSP_DEV_SPI2, DEV_MASTER);
+
+	/* The caller runs while the transfer is in progress */
+	memset(&end, 0, sizeof(end));
+	start = host_test_ns();
+	CHECK(bsp_spi_dma_start(BSP_DEV_SPI1, tx, rx, XFER_SIZE, xfer_end, &end) == BSP_OK);
+	start_ns = host_test_ns() - start;
+	CHECK(bsp_spi_dma_start(BSP_DEV_SPI1, tx, rx, XFER_SIZE, NULL, NULL) == BSP_BUSY);
+	CHECK(bsp_spi_dma_rx_circular_start(BSP_DEV_SPI1, rx, XFER_SIZE) == BSP_BUSY);
+	CHECK(end.calls == 0);
+
+	/* Other SPI at the same time */
+	CHECK(bsp_spi_dma_xfer(BSP_DEV_SPI2, NULL, rx2, XFER_SIZE) == BSP_OK);
+	for (i = 0; i < XFER_SIZE && rx2[i] == 0xFF; i++)
+		;
+	CHECK(i == XFER_SIZE);
+
+	CHECK(bsp_spi_dma_wait(BSP_DEV_SPI1) == BSP_OK);
+	wait_ns = host_test_ns() - start;
+	CHECK(memcmp(tx, rx, XFER_SIZE) == 0);
+	/* Callback run once, before the end of the wait */
+	CHECK(end.calls == 1);
+	CHECK(end.dev_num == BSP_DEV_SPI1 && end.status == BSP_OK);
+	CHECK(start_ns < XFER_NS / 10);
+	CHECK(wait_ns >= XFER_NS);
+	printf("test_spi_dma: %u bytes, started in %llu us, done in %llu us\n",
+	       XFER_SIZE, (unsigned long long)start_ns / 1000,
+	       (unsigned long long)wait_ns / 1000);
+	CHECK(bsp_spi_dma_wait(BSP_DEV_SPI1) == BSP_OK);
+
+	/* Transfer errors reach both the callback and the waiter */
+	memset(&end, 0, sizeof(end));
+	bsp_host_spi_dma_fail(BSP_DEV_SPI1);
+	CHECK(bsp_spi_dma_start(BSP_DEV_SPI1, tx, NULL, 64, xfer_end, &end) == BSP_OK);
+	CHECK(bsp_spi_dma_wait(BSP_DEV_SPI1) == BSP_ERROR);
+	CHECK(end.calls == 1 && end.status == BSP_ERROR);
+	CHECK(bsp_spi_dma_xfer(BSP_DEV_SPI1, tx, rx, 64) == BSP_OK);
+	CHECK(bsp_spi_dma_start(BSP_DEV_SPI1, tx, rx, 0, NULL, NULL) == BSP_ERROR);
+
+	/* Polled transfers below 16 bytes and in slave mode */
+	bsp_host_reset_stats();
+	CHECK(bsp_spi_write_read_u8(BSP_DEV_SPI1, tx, rx, 15) == BSP_OK);
+	CHECK(dma_calls() == 0);
+	CHECK(bsp_spi_write_read_u8(BSP_DEV_SPI1, tx, rx, 16) == BSP_OK);
+	CHECK(bsp_spi_write_u8(BSP_DEV_SPI1, tx, 16) == BSP_OK);
+	CHECK(bsp_spi_read_u8(BSP_DEV_SPI1, rx, 16) == BSP_OK);
+	CHECK(dma_calls() == 3);
+	CHECK(rx[0] == 0xFF && rx[15] == 0xFF);
+	spi_init(BSP_DEV_SPI1, DEV_SLAVE);
+	CHECK(bsp_spi_write_read_u8(BSP_DEV_SPI1, tx, rx, XFER_SIZE) == BSP_OK);
+	CHECK(dma_calls() == 3);
+	CHECK(memcmp(tx, rx, XFER_SIZE) == 0);
+
+	bsp_spi_deinit(BSP_DEV_SPI1);
+	bsp_spi_deinit(BSP_DEV_SPI2);
+
+	return host_test_end("test_spi_dma");
+}
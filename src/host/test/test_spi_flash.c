@@ -0,0 +1,147 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* SPI flash probe and dump against the SPI NOR flash model (host/spi_flash.c) */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "bsp.h"
+#include "bsp_host.h"
+#include "hydrabus_spi_flash.h"
+
+#define FLASH_SIZE	0x100000
+#define DUMP_ADDR	0x1234
+#define DUMP_SIZE	(5 * SPI_FLASH_BLOCK_SIZE + 100)
+
+extern const mode_exec_t mode_spi_exec;
+
+typedef struct {
+	uint32_t addr;
+	uint32_t nb_blocks;
+	uint32_t nb_bad;
+	uint32_t crc;
+	uint32_t max_blocks;
+} t_dump_check;
+
+static uint8_t buf[2 * SPI_FLASH_BLOCK_SIZE];
+
+static bool check_block(t_hydra_console *con, uint8_t *data, uint32_t nb_data,
+			void *arg)
+{
+	t_dump_check *check = arg;
+	uint32_t i;
+
+	(void)con;
+
+	for (i = 0; i < nb_data; i++) {
+		if (data[i] != host_spi_flash_data(check->addr + i)) {
+			check->nb_bad++;
+			break;
+		}
+	}
+	check->crc = spi_flash_crc32(check->crc, data, nb_data);
+	check->addr += nb_data;
+	return ++check->nb_blocks < check->max_blocks;
+}
+
+static void mode_init(t_host_console *hc)
+{
+	static t_tokenline_parsed p;
+
+	memset(&p, 0, sizeof(p));
+	hc->mode.exec = &mode_spi_exec;
+	mode_spi_exec.init(&hc->con, &p);
+}
+
+int main(void)
+{
+	t_host_console hc;
+	t_spi_flash flash;
+	t_dump_check check;
+	uint32_t i, crc;
+
+	host_test_init();
+	host_test_console(&hc, "spi_flash test", 0);
+	mode_init(&hc);
+
+	/* MISO wired to MOSI: no flash */
+	CHECK(!spi_flash_probe(&hc.con, &flash));
+
+	host_spi_flash_attach(BSP_DEV_SPI1, HOST_SPI_FLASH_DENSITY);
+	CHECK(spi_flash_probe(&hc.con, &flash));
+	CHECK(flash.jedec_id[0] == 0xEF && flash.jedec_id[1] == 0x40 &&
+	      flash.jedec_id[2] == 0x14);
+	CHECK(flash.sfdp);
+	CHECK(flash.size == FLASH_SIZE);
+	CHECK(flash.erase_size == 4096);
+	CHECK(flash.addr_bytes == 3);
+
+	CHECK(spi_flash_check_range(&flash, FLASH_SIZE - 1, 1));
+	CHECK(!spi_flash_check_range(&flash, FLASH_SIZE - 1, 2));
+	CHECK(!spi_flash_check_range(&flash, 0, 0));
+
+	/* Blocks and their state go through the callback argument */
+	crc = 0;
+	for (i = 0; i < DUMP_SIZE; i++) {
+		buf[0] = host_spi_flash_data(DUMP_ADDR + i);
+		crc = spi_flash_crc32(crc, buf, 1);
+	}
+	memset(&check, 0, sizeof(check));
+	check.addr = DUMP_ADDR;
+	check.max_blocks = UINT32_MAX;
+	CHECK(spi_flash_dump(&hc.con, &flash, DUMP_ADDR, DUMP_SIZE, buf,
+			     check_block, &check) == BSP_OK);
+	CHECK(check.nb_blocks == 6);
+	CHECK(check.nb_bad == 0);
+	CHECK(check.addr == DUMP_ADDR + DUMP_SIZE);
+	CHECK(check.crc == crc);
+	printf("test_spi_flash: %u bytes dumped, CRC %08X\n", DUMP_SIZE, check.crc);
+
+	/* The callback aborts the dump */
+	memset(&check, 0, sizeof(check));
+	check.addr = DUMP_ADDR;
+	check.max_blocks = 2;
+	CHECK(spi_flash_dump(&hc.con, &flash, DUMP_ADDR, DUMP_SIZE, buf,
+			     check_block, &check) == BSP_ERROR);
+	CHECK(check.nb_blocks == 2);
+	CHECK(check.nb_bad == 0);
+
+	/* Density of 2^2 bits is invalid, the size is guessed from the JEDEC ID */
+	host_spi_flash_attach(BSP_DEV_SPI1, 0x80000002);
+	CHECK(spi_flash_probe(&hc.con, &flash));
+	CHECK(!flash.sfdp);
+	CHECK(flash.size == FLASH_SIZE);
+	CHECK(flash.erase_size == 0);
+
+	/* Density of 2^23 bits */
+	host_spi_flash_attach(BSP_DEV_SPI1, 0x80000017);
+	CHECK(spi_flash_probe(&hc.con, &flash));
+	CHECK(flash.sfdp);
+	CHECK(flash.size == FLASH_SIZE);
+
+	host_spi_flash_attach(BSP_DEV_SPI1, 0x80000003);
+	CHECK(spi_flash_probe(&hc.con, &flash));
+	CHECK(flash.sfdp);
+	CHECK(flash.size == 1);
+
+	bsp_host_spi_attach(BSP_DEV_SPI1, NULL);
+
+	return host_test_end("test_spi_flash");
+}
@@ -0,0 +1,255 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * BBIO SPI DMA sniffer: CS framed transactions clocked into both circular
+ * receptions, decoded back from the record stream.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "bsp.h"
+#include "bsp_host.h"
+#include "hydrabus_bbio.h"
+#include "hydrabus_bbio_spi.h"
+
+#define NB_TRANS	200
+#define OUT_SIZE	(1024 * 1024)
+#define RING_SIZE	16384
+#define OVERRUN_SIZE	(2 * RING_SIZE + 100)
+/* Transaction held low for 2ms */
+#define SLOW_CYCLES	(STM32_HCLK / 1000)
+
+#define REC_CS_LOW	0x01
+#define REC_CS_HIGH	0x02
+#define REC_DATA	0x03
+#define REC_STATUS	0x04
+#define REC_END		0x05
+
+static const uint32_t trans_sizes[] = { 1, 4, 256, 3000 };
+
+static uint8_t mosi[3000];
+static uint8_t miso[3000];
+static uint8_t overrun[OVERRUN_SIZE];
+
+typedef struct {
+	uint32_t nb_trans;
+	uint32_t nb_bad;
+	uint32_t nb_status;
+	uint32_t nb_out; /* Data outside of CS */
+	uint32_t lost;
+	uint32_t events_lost;
+	uint32_t last_ts;
+	bool end;
+	bool ts_error;
+	bool slow_ok;
+} t_sniff_check;
+
+static THD_WORKING_AREA(wa_bbio, 4096);
+
+static THD_FUNCTION(bbio, arg)
+{
+	chRegSetThreadName("bbio spi");
+	bbio_mode_spi(arg);
+}
+
+static uint32_t trans_size(uint32_t t)
+{
+	return trans_sizes[(t * 7) % 4];
+}
+
+static void trans_data(uint32_t t)
+{
+	uint32_t i;
+
+	for (i = 0; i < trans_size(t); i++) {
+		mosi[i] = t + i * 3;
+		miso[i] = ~(t * 5 + i);
+	}
+}
+
+static uint32_t le32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void check_ts(t_sniff_check *check, uint32_t ts)
+{
+	if ((int32_t)(ts - check->last_ts) < 0)
+		check->ts_error = TRUE;
+	check->last_ts = ts;
+}
+
+/* Decodes the records, returns the length parsed */
+static uint32_t decode(t_sniff_check *check, const uint8_t *p, uint32_t len)
+{
+	uint32_t pos, nb, i, size, data_len, start_ts;
+	bool in_cs;
+
+	pos = 0;
+	in_cs = FALSE;
+	data_len = 0;
+	start_ts = 0;
+	while (pos < len && !check->end) {
+		switch (p[pos]) {
+		case REC_CS_LOW:
+			if (pos + 5 > len)
+				return pos;
+			check_ts(check, le32(&p[pos + 1]));
+			start_ts = le32(&p[pos + 1]);
+			trans_data(check->nb_trans);
+			in_cs = TRUE;
+			data_len = 0;
+			pos += 5;
+			break;
+		case REC_CS_HIGH:
+			if (pos + 5 > len)
+				return pos;
+			check_ts(check, le32(&p[pos + 1]));
+			if (!in_cs || data_len != trans_size(check->nb_trans))
+				check->nb_bad++;
+			if (check->nb_trans % 10 == 9 &&
+			    le32(&p[pos + 1]) - start_ts >= SLOW_CYCLES)
+				check->slow_ok = TRUE;
+			in_cs = FALSE;
+			check->nb_trans++;
+			pos += 5;
+			break;
+		case REC_DATA:
+			if (pos + 3 > len)
+				return pos;
+			nb = p[pos + 1] | (p[pos + 2] << 8);
+			if (pos + 3 + 2 * nb > len)
+				return pos;
+			if (!in_cs) {
+				check->nb_out += nb;
+			} else {
+				size = trans_size(check->nb_trans);
+				for (i = 0; i < nb; i++, data_len++) {
+					if (data_len >= size ||
+					    p[pos + 3 + 2 * i] != mosi[data_len] ||
+					    p[pos + 4 + 2 * i] != miso[data_len]) {
+						check->nb_bad++;
+						break;
+					}
+				}
+			}
+			pos += 3 + 2 * nb;
+			break;
+		case REC_STATUS:
+		case REC_END:
+			if (pos + 13 > len)
+				return pos;
+			check_ts(check, le32(&p[pos + 1]));
+			check->lost = le32(&p[pos + 5]);
+			check->events_lost = le32(&p[pos + 9]);
+			if (p[pos] == REC_END)
+				check->end = TRUE;
+			else
+				check->nb_status++;
+			pos += 13;
+			break;
+		default:
+			check->nb_bad++;
+			return len;
+		}
+	}
+	return pos;
+}
+
+/* Both channels are clocked by the same SCK, MISO is received first */
+static void clock_in(const uint8_t *mosi_data, const uint8_t *miso_data,
+		     uint32_t nb_data)
+{
+	bsp_host_spi_circular_rx(BSP_DEV_SPI2, miso_data, nb_data);
+	bsp_host_spi_circular_rx(BSP_DEV_SPI1, mosi_data, nb_data);
+}
+
+int main(void)
+{
+	t_host_console hc;
+	t_sniff_check check;
+	thread_t *thd;
+	uint8_t cmd;
+	uint32_t t, total;
+
+	host_test_init();
+	bsp_scs_dwt_cycle_counter_enabled();
+	host_test_console(&hc, "spi_sniff test", OUT_SIZE);
+	thd = chThdCreateStatic(wa_bbio, sizeof(wa_bbio), NORMALPRIO, bbio,
+				&hc.con);
+	CHECK(host_test_console_wait(&hc, 4, 1000));
+	CHECK(memcmp(hc.out, BBIO_SPI_HEADER, 4) == 0);
+
+	host_gpio_set_input(GPIOA, 15, 1);
+	cmd = BBIO_SPI_SNIFF_DMA;
+	host_test_console_clear(&hc);
+	host_test_console_input(&hc, &cmd, 1);
+	CHECK(host_test_console_wait(&hc, 1, 1000));
+	CHECK(hc.out[0] == 0x01);
+
+	total = 0;
+	for (t = 0; t < NB_TRANS; t++) {
+		trans_data(t);
+		host_gpio_set_input(GPIOA, 15, 0);
+		clock_in(mosi, miso, trans_size(t));
+		if (t % 10 == 9)
+			chThdSleepMilliseconds(2);
+		host_gpio_set_input(GPIOA, 15, 1);
+		total += trans_size(t);
+		/* Far less than the ring between two polls of the sniffer */
+		if (t % 4 == 3)
+			chThdSleepMilliseconds(1);
+	}
+	chThdSleepMilliseconds(1100);
+
+	/* More than the ring without CS: lost */
+	memset(overrun, 0x5A, sizeof(overrun));
+	clock_in(overrun, overrun, OVERRUN_SIZE);
+	chThdSleepMilliseconds(20);
+
+	/* Any byte stops the sniffer */
+	host_test_console_input(&hc, &cmd, 1);
+	memset(&check, 0, sizeof(check));
+	for (t = 0; t < 100 && !check.end; t++) {
+		chThdSleepMilliseconds(10);
+		memset(&check, 0, sizeof(check));
+		pthread_mutex_lock(&hc.mtx);
+		decode(&check, &hc.out[1], hc.out_len - 1);
+		pthread_mutex_unlock(&hc.mtx);
+	}
+	printf("test_spi_sniff: %u transactions, %u bytes, %u status, %u lost\n",
+	       check.nb_trans, total, check.nb_status, check.lost);
+	CHECK(check.end);
+	CHECK(check.nb_trans == NB_TRANS);
+	CHECK(check.nb_bad == 0);
+	CHECK(check.nb_out == 0);
+	CHECK(check.nb_status >= 1);
+	CHECK(!check.ts_error);
+	CHECK(check.slow_ok);
+	CHECK(check.lost == OVERRUN_SIZE);
+	CHECK(check.events_lost == 0);
+
+	cmd = BBIO_RESET;
+	host_test_console_input(&hc, &cmd, 1);
+	chThdWait(thd);
+
+	return host_test_end("test_spi_sniff");
+}
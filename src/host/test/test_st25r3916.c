@@ -0,0 +1,87 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* HydraNFC v2 RFAL against the ST25R3916 mock (host/st25r3916.c) */
+
+#include <string.h>
+
+#include "host_test.h"
+#include "bsp_spi.h"
+#include "platform.h"
+#include "rfal_rf.h"
+#include "rfal_nfca.h"
+#include "st25r3916.h"
+#include "st25r3916_irq.h"
+
+/* Same as the EXTI callback of hydranfc_v2.c */
+static void st25r3916_irq(void *arg)
+{
+	(void)arg;
+
+	st25r3916Isr();
+}
+
+/* Same SPI and IRQ setup as hydranfc_v2_init() */
+static void nfc_init(void)
+{
+	mode_config_proto_t proto;
+
+	memset(&proto, 0, sizeof(proto));
+	proto.config.spi.dev_mode = DEV_MASTER;
+	bsp_spi_init(BSP_DEV_SPI2, &proto);
+
+	palSetPadMode(GPIOA, 1, PAL_MODE_INPUT);
+	palSetPadCallback(GPIOA, 1, st25r3916_irq, NULL);
+	palEnablePadEvent(GPIOA, 1, PAL_EVENT_MODE_RISING_EDGE);
+
+	hal_st25r3916_spiInit(BSP_DEV_SPI2);
+}
+
+int main(void)
+{
+	static const uint8_t card_atqa[2] = { 0x44, 0x00 };
+	rfalNfcaSensRes sens_res;
+
+	host_test_init();
+	nfc_init();
+
+	/* Chip ID, SPI self test, wake-up and GP timers IRQ, oscillator */
+	CHECK(rfalInitialize() == ERR_NONE);
+	CHECK(st25r3916CheckChipID(NULL));
+	CHECK(st25r3916IsOscOn());
+
+	CHECK(rfalNfcaPollerInitialize() == ERR_NONE);
+	CHECK(rfalFieldOnAndStartGT() == ERR_NONE);
+	CHECK(st25r3916IsTxEnabled());
+
+	/* No card: the no-response timer expires */
+	memset(&sens_res, 0, sizeof(sens_res));
+	CHECK(rfalNfcaPollerCheckPresence(RFAL_14443A_SHORTFRAME_CMD_REQA,
+					  &sens_res) == ERR_TIMEOUT);
+
+	host_st25r3916_card(card_atqa);
+	CHECK(rfalNfcaPollerCheckPresence(RFAL_14443A_SHORTFRAME_CMD_REQA,
+					  &sens_res) == ERR_NONE);
+	CHECK(memcmp(&sens_res, card_atqa, sizeof(card_atqa)) == 0);
+	host_st25r3916_card(NULL);
+
+	CHECK(rfalFieldOff() == ERR_NONE);
+	CHECK(!st25r3916IsTxEnabled());
+
+	return host_test_end("test_st25r3916");
+}
@@ -0,0 +1,297 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * SUMP capture (hydrabus/hydrabus_sump_trigger.c) on 8 and 16 bits rings
+ * filled in chunks as by the DMA: simple trigger, multi-stage parallel and
+ * serial triggers, RLE encoding. The data returned is checked against the
+ * generated signal around the trigger sample.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "hydrabus_sump_trigger.h"
+
+#define RING_LEN	4096
+#define RLE_RING_LEN	1024
+#define RLE_LEN		4096
+#define READ_COUNT	2048
+#define DELAY_COUNT	512
+#define MAX_SAMPLES	(1 << 20)
+
+/* Trigger sample of the raw and RLE signals */
+#define RAW_TRIG	5000
+#define RLE_TRIG	100000
+#define RLE_RUN		37
+
+/* Multi-stage signal */
+#define STAGE_EARLY	1600 /* Start value, before the level is raised */
+#define STAGE_LEVEL	2000
+#define STAGE_START	2500
+#define STAGE_DELAY	3
+#define SERIAL_START	3000
+#define SERIAL_CHANNEL	4
+#define SERIAL_VALUE	0xA5
+
+typedef uint16_t (*t_gen)(uint32_t n);
+
+static uint16_t ring[RING_LEN];
+static uint16_t rle_buf[RLE_LEN];
+static uint16_t trig_bit;
+
+/* Channel trig_bit high only on the trigger sample */
+static uint16_t gen_raw(uint32_t n)
+{
+	uint16_t val = (n * 7) & (trig_bit - 1);
+
+	return (n == RAW_TRIG) ? (val | trig_bit) : val;
+}
+
+static uint16_t gen_stages(uint32_t n)
+{
+	switch (n) {
+	case STAGE_EARLY:
+	case STAGE_START:
+		return 0x22;
+	case STAGE_LEVEL:
+		return 0x11;
+	}
+	return n & 0x0F;
+}
+
+/* SERIAL_VALUE on SERIAL_CHANNEL, MSB first */
+static uint16_t gen_serial(uint32_t n)
+{
+	uint16_t val = n & 0x0F;
+
+	if (n >= SERIAL_START && n < SERIAL_START + 8)
+		val |= ((SERIAL_VALUE >> (7 - (n - SERIAL_START))) & 1) << SERIAL_CHANNEL;
+	return val;
+}
+
+/* Runs of RLE_RUN samples, trig_bit high for 20 samples from RLE_TRIG */
+static uint16_t gen_rle(uint32_t n)
+{
+	uint16_t val = ((n / RLE_RUN) * 13) & (trig_bit - 1);
+
+	if (n >= RLE_TRIG && n < RLE_TRIG + 20)
+		val |= trig_bit;
+	return val;
+}
+
+static uint16_t ring_get(const t_sump_capture *c, const void *buf, uint32_t idx)
+{
+	if (c->sample_size == 1)
+		return ((const uint8_t *)buf)[idx];
+	return ((const uint16_t *)buf)[idx];
+}
+
+/* Fills the ring in chunks of 1 to 61 samples until the capture is done */
+static bool run(t_sump_capture *c, t_gen gen)
+{
+	uint32_t n, i, chunk, idx;
+
+	n = 0;
+	while (n < MAX_SAMPLES) {
+		chunk = 1 + n % 61;
+		for (i = 0; i < chunk; i++, n++) {
+			idx = n & (c->len - 1);
+			if (c->sample_size == 1)
+				((uint8_t *)ring)[idx] = gen(n);
+			else
+				ring[idx] = gen(n);
+		}
+		if (sump_capture_update(c, n & (c->len - 1)))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/* Raw samples returned, trig is at read_count - delay_count */
+static bool check_raw(const t_sump_capture *c, t_gen gen, uint32_t trig)
+{
+	uint32_t end, first, i;
+
+	end = sump_capture_end(c);
+	first = trig - (c->read_count - c->delay_count);
+	for (i = 0; i < c->read_count; i++) {
+		if (ring_get(c, c->out, (end - c->read_count + i) & (c->out_len - 1)) !=
+		    gen(first + i))
+			return FALSE;
+	}
+	return (c->skipped == 0 && c->lost == 0);
+}
+
+static void init(t_sump_capture *c, uint32_t len, uint8_t sample_size,
+		 uint32_t read_count, uint32_t delay_count, const uint32_t *masks,
+		 const uint32_t *values, const uint32_t *configs)
+{
+	memset(ring, 0, sizeof(ring));
+	sump_capture_init(c, ring, len, sample_size, read_count, delay_count,
+			  masks, values, configs);
+}
+
+static void check_simple(uint8_t sample_size)
+{
+	uint32_t masks[SUMP_NB_STAGES] = { 0 };
+	uint32_t values[SUMP_NB_STAGES] = { 0 };
+	uint32_t configs[SUMP_NB_STAGES] = { SUMP_TRIG_CONF_START };
+	t_sump_capture c;
+
+	trig_bit = (sample_size == 1) ? 0x80 : 0x8000;
+	masks[0] = trig_bit;
+	values[0] = trig_bit;
+	init(&c, RING_LEN, sample_size, READ_COUNT, DELAY_COUNT, masks, values,
+	     configs);
+	CHECK(c.simple);
+	CHECK(run(&c, gen_raw));
+	CHECK(check_raw(&c, gen_raw, RAW_TRIG));
+
+	/* Clamped to 3/4 of the ring */
+	init(&c, RING_LEN, sample_size, RING_LEN, RING_LEN, masks, values, configs);
+	CHECK(c.read_count == RING_LEN * 3 / 4 && c.delay_count == c.read_count);
+	CHECK(run(&c, gen_raw));
+	CHECK(check_raw(&c, gen_raw, RAW_TRIG));
+
+	printf("test_sump_trigger: %u bits raw, %u samples around %u\n",
+	       sample_size * 8, READ_COUNT, RAW_TRIG);
+}
+
+/*
+ * Level 0 raises the level on 0x11, the start stage at level 1 waits
+ * STAGE_DELAY samples after 0x22, then a serial start stage.
+ */
+static void check_stages(uint8_t sample_size)
+{
+	const uint32_t masks[SUMP_NB_STAGES] = { 0xFF, 0xFF };
+	const uint32_t values[SUMP_NB_STAGES] = { 0x11, 0x22 };
+	const uint32_t configs[SUMP_NB_STAGES] = {
+		0,
+		SUMP_TRIG_CONF_START | (1 << 16) | STAGE_DELAY
+	};
+	const uint32_t serial_masks[SUMP_NB_STAGES] = { 0xFF };
+	const uint32_t serial_values[SUMP_NB_STAGES] = { SERIAL_VALUE };
+	const uint32_t serial_configs[SUMP_NB_STAGES] = {
+		SUMP_TRIG_CONF_START | SUMP_TRIG_CONF_SERIAL |
+		(SERIAL_CHANNEL << 20)
+	};
+	t_sump_capture c;
+
+	init(&c, RING_LEN, sample_size, READ_COUNT, DELAY_COUNT, masks, values,
+	     configs);
+	CHECK(!c.simple && c.nb_active == 1);
+	CHECK(run(&c, gen_stages));
+	CHECK(c.level == 1);
+	CHECK(check_raw(&c, gen_stages, STAGE_START + STAGE_DELAY));
+
+	init(&c, RING_LEN, sample_size, READ_COUNT, DELAY_COUNT, serial_masks,
+	     serial_values, serial_configs);
+	CHECK(!c.simple && c.serial);
+	CHECK(run(&c, gen_serial));
+	CHECK(check_raw(&c, gen_serial, SERIAL_START + 7));
+
+	printf("test_sump_trigger: %u bits multi-stage and serial\n",
+	       sample_size * 8);
+}
+
+/*
+ * Decodes the words from the first value, the trigger word is at
+ * read_count - delay_count. Returns the number of samples, 0 on mismatch.
+ */
+static uint32_t check_rle(const t_sump_capture *c, t_gen gen, uint32_t trig)
+{
+	const t_sump_rle *r = &c->rle;
+	uint32_t end, i, first, ti, n, count, nb;
+	uint16_t word, value;
+
+	end = sump_capture_end(c);
+	ti = c->read_count - c->delay_count;
+	for (first = 0; first < ti; first++) {
+		if (!(rle_buf[(end - c->read_count + first) & (r->len - 1)] & r->flag))
+			break;
+	}
+	if (rle_buf[(end - c->read_count + ti) & (r->len - 1)] !=
+	    (gen(trig) & r->chan_mask))
+		return 0;
+
+	/* Samples before the trigger word */
+	nb = 0;
+	for (i = first; i < ti; i++) {
+		word = rle_buf[(end - c->read_count + i) & (r->len - 1)];
+		nb += (word & r->flag) ? (word & ~r->flag) >> r->shift : 1;
+	}
+
+	n = trig - nb;
+	value = 0;
+	for (i = first; i < c->read_count; i++) {
+		word = rle_buf[(end - c->read_count + i) & (r->len - 1)];
+		if (!(word & r->flag)) {
+			if ((gen(n++) & r->chan_mask) != word)
+				return 0;
+			value = word;
+			continue;
+		}
+		for (count = (word & ~r->flag) >> r->shift; count; count--) {
+			if ((gen(n++) & r->chan_mask) != value)
+				return 0;
+		}
+	}
+	if (c->skipped != 0)
+		return 0;
+	return n - (trig - nb);
+}
+
+static void check_encoded(uint8_t sample_size)
+{
+	uint32_t masks[SUMP_NB_STAGES] = { 0 };
+	uint32_t values[SUMP_NB_STAGES] = { 0 };
+	uint32_t configs[SUMP_NB_STAGES] = { SUMP_TRIG_CONF_START };
+	t_sump_capture c;
+	uint32_t nb;
+
+	/* Highest channel is the count flag */
+	trig_bit = (sample_size == 1) ? 0x40 : 0x4000;
+	masks[0] = trig_bit;
+	values[0] = trig_bit;
+	init(&c, RLE_RING_LEN, sample_size, RLE_LEN, RLE_LEN / 4, masks, values,
+	     configs);
+	sump_capture_set_rle(&c, rle_buf, RLE_LEN, (sample_size == 1) ? 1 : 3);
+	CHECK(c.read_count == RLE_LEN && c.delay_count == RLE_LEN / 4);
+	CHECK(run(&c, gen_rle));
+	nb = check_rle(&c, gen_rle, RLE_TRIG);
+	CHECK(nb > 8 * c.read_count);
+
+	printf("test_sump_trigger: %u bits RLE, %u words for %u samples\n",
+	       sample_size * 8, c.read_count, nb);
+}
+
+int main(void)
+{
+	host_test_init();
+
+	check_simple(1);
+	check_simple(2);
+	check_stages(1);
+	check_stages(2);
+	check_encoded(1);
+	check_encoded(2);
+
+	return host_test_end("test_sump_trigger");
+}
@@ -115,6 +115,7 @@ t_token_dict tl_dict[] = {
 	{ T_TOKENLINE, "tokenline" },
 	{ T_TIMING, "timing" },
 	{ T_DEBUG_TEST_RX, "test-rx" },
+	{ T_DEBUG_TEST_TX, "test-tx" },
 	{ T_RM, "rm" },
 	{ T_MKDIR, "mkdir" },
 	{ T_LOGGING, "logging" },
@@ -165,6 +166,15 @@ t_token_dict tl_dict[] = {
 	{ T_PRESCALER, "prescaler" },
 	{ T_CONVENTION, "convention" },
 	{ T_DELAY, "delay" },
+	{ T_DUMP, "dump" },
+	{ T_ADDRESS, "address" },
+	{ T_LENGTH, "length" },
+	{ T_ECC, "ecc" },
+	{ T_RLE, "rle" },
+	{ T_MASK, "mask" },
+	{ T_PAGE, "page" },
+	{ T_ADDR16, "addr16" },
+	{ T_READONLY, "readonly" },
 	/* Developer warning add new command(s) here */
 
 	/* BP-compatible commands */
@@ -931,6 +941,38 @@ t_token tokens_can[] = {
 		.help = "Bus frequency"\
 	},
 
+t_token tokens_mode_i2c_slave[] = {
+	{
+		T_ADDRESS,
+		.arg_type = T_ARG_UINT,
+		.help = "7 bits slave address (default 0x50)"
+	},
+	{
+		T_LENGTH,
+		.arg_type = T_ARG_UINT,
+		.help = "Register map size in bytes (default 256, up to 32768)"
+	},
+	{
+		T_ADDR16,
+		.help = "Two bytes register address, MSB first (24C32 and up)"
+	},
+	{
+		T_PAGE,
+		.arg_type = T_ARG_UINT,
+		.help = "Auto increment wraps in pages of this size (default map size)"
+	},
+	{
+		T_FILE,
+		.arg_type = T_ARG_STRING,
+		.help = "Load the register map from microSD (default all 0xFF)"
+	},
+	{
+		T_READONLY,
+		.help = "Log the writes without applying them"
+	},
+	{ }
+};
+
 t_token tokens_mode_i2c[] = {
 	{
 		T_SHOW,
@@ -952,6 +994,11 @@ t_token tokens_mode_i2c[] = {
 		T_SNIFF,
 		.help = "Sniff I2C bus"
 	},
+	{
+		T_SLAVE,
+		.subtokens = tokens_mode_i2c_slave,
+		.help = "Emulate a slave register map or EEPROM, log the writes"
+	},
 	{
 		T_START,
 		.help = "Start"
@@ -1058,6 +1105,25 @@ t_token tokens_i2c[] = {
 	{ T_LSB_FIRST, \
 		.help = "Send/receive LSB first" },
 
+t_token tokens_mode_spi_dump[] = {
+	{
+		T_ADDRESS,
+		.arg_type = T_ARG_UINT,
+		.help = "Start address (default 0)"
+	},
+	{
+		T_LENGTH,
+		.arg_type = T_ARG_UINT,
+		.help = "Length in bytes (default up to the end of the flash)"
+	},
+	{
+		T_FILE,
+		.arg_type = T_ARG_STRING,
+		.help = "microSD filename"
+	},
+	{ }
+};
+
 t_token tokens_mode_spi[] = {
 	{
 		T_SHOW,
@@ -1071,6 +1137,15 @@ t_token tokens_mode_spi[] = {
 	},
 	SPI_PARAMETERS
 	/* SPI-specific commands */
+	{
+		T_ID,
+		.help = "Display SPI flash JEDEC ID and geometry"
+	},
+	{
+		T_DUMP,
+		.subtokens = tokens_mode_spi_dump,
+		.help = "Dump SPI flash with CRC32 (fast read at highest frequency)"
+	},
 	{
 		T_READ,
 		.flags = T_FLAG_SUFFIX_TOKEN_DELIM_INT,
@@ -1674,6 +1749,29 @@ t_token tokens_threewire[] = {
 	{ }
 };
 
+t_token tokens_mode_flash_dump[] = {
+	{
+		T_ADDRESS,
+		.arg_type = T_ARG_UINT,
+		.help = "First page (default 0)"
+	},
+	{
+		T_LENGTH,
+		.arg_type = T_ARG_UINT,
+		.help = "Number of pages (default up to the end of the flash)"
+	},
+	{
+		T_ECC,
+		.help = "Check and correct pages with the 1 bit Hamming ECC (256 bytes steps)"
+	},
+	{
+		T_FILE,
+		.arg_type = T_ARG_STRING,
+		.help = "microSD filename"
+	},
+	{ }
+};
+
 t_token tokens_mode_flash[] = {
 	{
 		T_SHOW,
@@ -1685,6 +1783,11 @@ t_token tokens_mode_flash[] = {
 		T_ID,
 		.help = "Displays the ID and status registers"
 	},
+	{
+		T_DUMP,
+		.subtokens = tokens_mode_flash_dump,
+		.help = "Dump NAND pages (data and spare areas) with CRC32"
+	},
 	/* BP commands */
 	{
 		T_EXIT,
@@ -1920,6 +2023,39 @@ t_token tokens_dac[] = {
 	{ }
 };
 
+t_token tokens_sump[] = {
+	{
+		T_FILE,
+		.arg_type = T_ARG_STRING,
+		.help = "Stream the capture to this microSD file"
+	},
+	{
+		T_FREQUENCY,
+		.arg_type = T_ARG_UINT,
+		.help = "Sample rate in Hz (default 1000000)"
+	},
+	{
+		T_LENGTH,
+		.arg_type = T_ARG_UINT,
+		.help = "File size in MB (default 64)"
+	},
+	{
+		T_RLE,
+		.help = "Run length encoding (channel 15 not recorded)"
+	},
+	{
+		T_TRIGGER,
+		.arg_type = T_ARG_UINT,
+		.help = "Trigger value, marks the samples starting a match"
+	},
+	{
+		T_MASK,
+		.arg_type = T_ARG_UINT,
+		.help = "Trigger mask (default 0xFFFF)"
+	},
+	{ }
+};
+
 t_token tokens_pwm[] = {
 	{
 		T_HELP,
@@ -2043,6 +2179,16 @@ t_token tokens_debug[] = {
 		T_DEBUG_TEST_RX,
 		.help = "Test USB1 or 2 RX(read all data until UBTN+Key pressed)"
 	},
+	{
+		T_DEBUG_TEST_TX,
+		.arg_type = T_ARG_UINT,
+		.help = "Test USB1 or 2 TX(send packets of n bytes, see scripts/rx_bench.py)"
+	},
+	{
+		T_SAMPLES,
+		.arg_type = T_ARG_UINT,
+		.help = "Number of packets for test-tx (default 1000)"
+	},
 	{
 		T_ON,
 		.help = "Enable"
@@ -2177,7 +2323,9 @@ t_token tl_tokens[] = {
 	},
 	{
 		T_SUMP,
-		.help = "SUMP mode"
+		.subtokens = tokens_sump,
+		.help = "SUMP mode, or streaming capture to microSD",
+		.help_full = "Usage: sump [filename <name> [frequency <Hz>] [length <MB>] [rle] [trigger <value>] [mask <mask>]]"
 	},
 	{
 		T_JTAG,
@@ -107,6 +107,7 @@ enum {
 	T_TOKENLINE,
 	T_TIMING,
 	T_DEBUG_TEST_RX,
+	T_DEBUG_TEST_TX,
 	T_RM,
 	T_MKDIR,
 	T_LOGGING,
@@ -157,6 +158,15 @@ enum {
 	T_PRESCALER,
 	T_CONVENTION,
 	T_DELAY,
+	T_DUMP,
+	T_ADDRESS,
+	T_LENGTH,
+	T_ECC,
+	T_RLE,
+	T_MASK,
+	T_PAGE,
+	T_ADDR16,
+	T_READONLY,
 	/* Developer warning add new command(s) here */
 
 	/* BP-compatible commands */
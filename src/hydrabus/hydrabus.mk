@@ -10,7 +10,11 @@ HYDRABUSSRC = hydrabus/hydrabus.c \
             hydrabus/hydrabus_mode_uart.c \
             hydrabus/hydrabus_mode_smartcard.c \
             hydrabus/hydrabus_mode_i2c.c \
+            hydrabus/hydrabus_i2c_sniff.c \
+            hydrabus/hydrabus_i2c_regmap.c \
             hydrabus/hydrabus_sump.c \
+            hydrabus/hydrabus_sump_trigger.c \
+            hydrabus/hydrabus_sump_stream.c \
             hydrabus/hydrabus_mode_jtag.c \
             hydrabus/hydrabus_rng.c \
             hydrabus/hydrabus_mode_onewire.c \
@@ -36,6 +40,11 @@ HYDRABUSSRC = hydrabus/hydrabus.c \
             hydrabus/hydrabus_mode_wiegand.c \
             hydrabus/hydrabus_mode_lin.c \
             hydrabus/hydrabus_bbio_aux.c \
+            hydrabus/hydrabus_bbio_batch.c \
+            hydrabus/hydrabus_bbio_bulk.c \
+            hydrabus/hydrabus_spi_flash.c \
+            hydrabus/hydrabus_avr_isp.c \
+            hydrabus/hydrabus_nand.c \
             hydrabus/hydrabus_aux.c
 
 # Required include directories
@@ -0,0 +1,379 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common.h"
+#include <string.h>
+
+#include "hydrabus_avr_isp.h"
+#include "hydrabus_spi_flash.h"
+
+#define AVR_CMD_PROG_ENABLE	0xAC, 0x53, 0x00, 0x00
+#define AVR_CMD_CHIP_ERASE	0xAC, 0x80, 0x00, 0x00
+#define AVR_CMD_POLL		0xF0, 0x00, 0x00, 0x00
+#define AVR_READ_FLASH_LOW	0x20
+#define AVR_READ_FLASH_HIGH	0x28
+#define AVR_LOAD_PAGE_LOW	0x40
+#define AVR_LOAD_PAGE_HIGH	0x48
+#define AVR_WRITE_PAGE		0x4C
+#define AVR_LOAD_EXT_ADDR	0x4D
+#define AVR_READ_EEPROM		0xA0
+#define AVR_WRITE_EEPROM	0xC0
+#define AVR_READ_SIGNATURE	0x30
+
+/* 64K words flash pages, selected by the extended address byte */
+#define AVR_EXT_ADDR_SIZE	(0x20000)
+
+static const uint8_t avr_fuse_read[AVR_ISP_NB_FUSES][2] = {
+	[AVR_ISP_FUSE_LOW] = { 0x50, 0x00 },
+	[AVR_ISP_FUSE_HIGH] = { 0x58, 0x08 },
+	[AVR_ISP_FUSE_EXT] = { 0x50, 0x08 },
+	[AVR_ISP_LOCK] = { 0x58, 0x00 },
+};
+
+static const uint8_t avr_fuse_write[AVR_ISP_NB_FUSES] = {
+	[AVR_ISP_FUSE_LOW] = 0xA0,
+	[AVR_ISP_FUSE_HIGH] = 0xA8,
+	[AVR_ISP_FUSE_EXT] = 0xA4,
+	[AVR_ISP_LOCK] = 0xE0,
+};
+
+/**
+ * @brief   Starts an ISP session on a SPI device
+ *
+ * @param[out] isp		ISP session
+ * @param[in] dev_num		SPI device
+ */
+void avr_isp_init(t_avr_isp *isp, bsp_dev_spi_t dev_num)
+{
+	isp->dev_num = dev_num;
+	isp->ext = 0;
+}
+
+static void avr_cmd(t_avr_isp *isp, uint8_t *cmd, uint8_t *answer)
+{
+	bsp_spi_write_read_u8(isp->dev_num, cmd, answer, 4);
+}
+
+static bool avr_wait_ready(t_avr_isp *isp)
+{
+	uint8_t cmd[4] = { AVR_CMD_POLL };
+	uint8_t answer[4];
+	systime_t start;
+
+	start = chVTGetSystemTime();
+	do {
+		avr_cmd(isp, cmd, answer);
+		if ((answer[3] & 1) == 0)
+			return TRUE;
+	} while (chVTTimeElapsedSinceX(start) < TIME_MS2I(AVR_ISP_TIMEOUT_MS));
+	return FALSE;
+}
+
+/*
+ * Only devices above 128KB have the extended address byte, it is only
+ * sent when it changes so smaller devices never see the command.
+ */
+static void avr_ext_addr(t_avr_isp *isp, uint32_t addr)
+{
+	uint8_t cmd[4], answer[4];
+
+	if ((addr / AVR_EXT_ADDR_SIZE) == isp->ext)
+		return;
+	isp->ext = addr / AVR_EXT_ADDR_SIZE;
+	cmd[0] = AVR_LOAD_EXT_ADDR;
+	cmd[1] = 0;
+	cmd[2] = isp->ext;
+	cmd[3] = 0;
+	avr_cmd(isp, cmd, answer);
+}
+
+/**
+ * @brief   Enters serial programming mode
+ *
+ * @param[in] isp		ISP session, RESET shall be low
+ *
+ * @return			TRUE if the device answered.
+ */
+bool avr_isp_program_enable(t_avr_isp *isp)
+{
+	uint8_t cmd[4] = { AVR_CMD_PROG_ENABLE };
+	uint8_t answer[4];
+
+	isp->ext = 0;
+	avr_cmd(isp, cmd, answer);
+	return answer[2] == 0x53;
+}
+
+/**
+ * @brief   Erases flash and EEPROM, waits for the end of the erase
+ *
+ * @param[in] isp		ISP session
+ *
+ * @return			FALSE on timeout.
+ */
+bool avr_isp_chip_erase(t_avr_isp *isp)
+{
+	uint8_t cmd[4] = { AVR_CMD_CHIP_ERASE };
+	uint8_t answer[4];
+
+	avr_cmd(isp, cmd, answer);
+	return avr_wait_ready(isp);
+}
+
+/**
+ * @brief   Reads the 3 bytes signature
+ *
+ * @param[in] isp		ISP session
+ * @param[out] sig		signature
+ */
+void avr_isp_read_signature(t_avr_isp *isp, uint8_t *sig)
+{
+	uint8_t cmd[12], answer[12];
+	uint8_t i;
+
+	for (i = 0; i < 3; i++) {
+		cmd[i * 4] = AVR_READ_SIGNATURE;
+		cmd[i * 4 + 1] = 0;
+		cmd[i * 4 + 2] = i;
+		cmd[i * 4 + 3] = 0;
+	}
+	bsp_spi_write_read_u8(isp->dev_num, cmd, answer, sizeof(cmd));
+	for (i = 0; i < 3; i++)
+		sig[i] = answer[i * 4 + 3];
+}
+
+/**
+ * @brief   Reads the fuses and lock bits
+ *
+ * @param[in] isp		ISP session
+ * @param[out] fuses		AVR_ISP_NB_FUSES bytes: low, high, extended
+ *				fuses and lock bits
+ */
+void avr_isp_read_fuses(t_avr_isp *isp, uint8_t *fuses)
+{
+	uint8_t cmd[4 * AVR_ISP_NB_FUSES], answer[4 * AVR_ISP_NB_FUSES];
+	uint8_t i;
+
+	for (i = 0; i < AVR_ISP_NB_FUSES; i++) {
+		cmd[i * 4] = avr_fuse_read[i][0];
+		cmd[i * 4 + 1] = avr_fuse_read[i][1];
+		cmd[i * 4 + 2] = 0;
+		cmd[i * 4 + 3] = 0;
+	}
+	bsp_spi_write_read_u8(isp->dev_num, cmd, answer, sizeof(cmd));
+	for (i = 0; i < AVR_ISP_NB_FUSES; i++)
+		fuses[i] = answer[i * 4 + 3];
+}
+
+/**
+ * @brief   Writes a fuse byte or the lock bits
+ *
+ * @param[in] isp		ISP session
+ * @param[in] fuse		AVR_ISP_FUSE_LOW/HIGH/EXT or AVR_ISP_LOCK
+ * @param[in] value		value
+ *
+ * @return			FALSE on invalid fuse or timeout.
+ */
+bool avr_isp_write_fuse(t_avr_isp *isp, uint8_t fuse, uint8_t value)
+{
+	uint8_t cmd[4], answer[4];
+
+	if (fuse >= AVR_ISP_NB_FUSES)
+		return FALSE;
+
+	cmd[0] = 0xAC;
+	cmd[1] = avr_fuse_write[fuse];
+	cmd[2] = 0;
+	cmd[3] = value;
+	avr_cmd(isp, cmd, answer);
+	return avr_wait_ready(isp);
+}
+
+/* A flash burst shall not cross an extended address boundary */
+static uint32_t avr_burst_size(uint8_t mem, uint32_t addr, uint32_t nb_data)
+{
+	uint32_t chunk;
+
+	chunk = (nb_data > AVR_ISP_BURST_SIZE) ? AVR_ISP_BURST_SIZE : nb_data;
+	if (mem == AVR_ISP_MEM_FLASH &&
+	    (addr % AVR_EXT_ADDR_SIZE) + chunk > AVR_EXT_ADDR_SIZE)
+		chunk = AVR_EXT_ADDR_SIZE - (addr % AVR_EXT_ADDR_SIZE);
+	return chunk;
+}
+
+/*
+ * Reads nb_data bytes (at most AVR_ISP_BURST_SIZE) in one burst.
+ * rx_data can be the answer half of buf.
+ */
+static void avr_read_burst(t_avr_isp *isp, uint8_t mem, uint32_t addr,
+			   uint8_t *rx_data, uint32_t nb_data, uint8_t *buf)
+{
+	uint8_t *cmd, *answer;
+	uint32_t i, a;
+
+	cmd = buf;
+	answer = buf + AVR_ISP_BUF_SIZE / 2;
+
+	for (i = 0; i < nb_data; i++) {
+		a = addr + i;
+		if (mem == AVR_ISP_MEM_FLASH) {
+			cmd[i * 4] = (a & 1) ? AVR_READ_FLASH_HIGH : AVR_READ_FLASH_LOW;
+			a >>= 1;
+		} else {
+			cmd[i * 4] = AVR_READ_EEPROM;
+		}
+		cmd[i * 4 + 1] = a >> 8;
+		cmd[i * 4 + 2] = a;
+		cmd[i * 4 + 3] = 0;
+	}
+	bsp_spi_write_read_u8(isp->dev_num, cmd, answer, nb_data * 4);
+	for (i = 0; i < nb_data; i++)
+		rx_data[i] = answer[i * 4 + 3];
+}
+
+/**
+ * @brief   Reads flash or EEPROM
+ *
+ * @param[in] isp		ISP session
+ * @param[in] mem		AVR_ISP_MEM_FLASH or AVR_ISP_MEM_EEPROM
+ * @param[in] addr		byte address
+ * @param[out] rx_data		data read
+ * @param[in] nb_data		number of bytes to read
+ * @param[in] buf		AVR_ISP_BUF_SIZE bytes scratch buffer
+ */
+void avr_isp_read(t_avr_isp *isp, uint8_t mem, uint32_t addr,
+		  uint8_t *rx_data, uint32_t nb_data, uint8_t *buf)
+{
+	uint32_t chunk;
+
+	while (nb_data > 0) {
+		chunk = avr_burst_size(mem, addr, nb_data);
+		if (mem == AVR_ISP_MEM_FLASH)
+			avr_ext_addr(isp, addr);
+		avr_read_burst(isp, mem, addr, rx_data, chunk, buf);
+		addr += chunk;
+		rx_data += chunk;
+		nb_data -= chunk;
+	}
+}
+
+/**
+ * @brief   Loads and writes one flash page, waits for the end of the write
+ *
+ * @param[in] isp		ISP session
+ * @param[in] addr		byte address of the page start
+ * @param[in] tx_data		page data
+ * @param[in] nb_data		page size in bytes, even and at most
+ *				AVR_ISP_MAX_PAGE_SIZE
+ * @param[in] buf		AVR_ISP_BUF_SIZE bytes scratch buffer
+ *
+ * @return			FALSE on invalid page or timeout.
+ */
+bool avr_isp_write_flash_page(t_avr_isp *isp, uint32_t addr,
+			      const uint8_t *tx_data, uint32_t nb_data,
+			      uint8_t *buf)
+{
+	uint8_t *cmd, *answer;
+	uint32_t i, word;
+
+	if (nb_data == 0 || nb_data > AVR_ISP_MAX_PAGE_SIZE ||
+	    (nb_data & 1) || (addr % nb_data) != 0)
+		return FALSE;
+
+	cmd = buf;
+	answer = buf + AVR_ISP_BUF_SIZE / 2;
+
+	/* Whole page buffer loaded in one burst */
+	for (i = 0; i < nb_data; i++) {
+		word = (addr + i) >> 1;
+		cmd[i * 4] = (i & 1) ? AVR_LOAD_PAGE_HIGH : AVR_LOAD_PAGE_LOW;
+		cmd[i * 4 + 1] = 0;
+		cmd[i * 4 + 2] = word;
+		cmd[i * 4 + 3] = tx_data[i];
+	}
+	bsp_spi_write_read_u8(isp->dev_num, cmd, answer, nb_data * 4);
+
+	avr_ext_addr(isp, addr);
+	word = addr >> 1;
+	cmd[0] = AVR_WRITE_PAGE;
+	cmd[1] = word >> 8;
+	cmd[2] = word;
+	cmd[3] = 0;
+	avr_cmd(isp, cmd, answer);
+	return avr_wait_ready(isp);
+}
+
+/**
+ * @brief   Writes EEPROM bytes, waits for the end of each write
+ *
+ * @param[in] isp		ISP session
+ * @param[in] addr		byte address
+ * @param[in] tx_data		data
+ * @param[in] nb_data		number of bytes
+ *
+ * @return			FALSE on timeout.
+ */
+bool avr_isp_write_eeprom(t_avr_isp *isp, uint32_t addr,
+			  const uint8_t *tx_data, uint32_t nb_data)
+{
+	uint8_t cmd[4], answer[4];
+	uint32_t i;
+
+	for (i = 0; i < nb_data; i++) {
+		cmd[0] = AVR_WRITE_EEPROM;
+		cmd[1] = (addr + i) >> 8;
+		cmd[2] = addr + i;
+		cmd[3] = tx_data[i];
+		avr_cmd(isp, cmd, answer);
+		if (!avr_wait_ready(isp))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * @brief   Computes the CRC32 of flash or EEPROM content
+ *
+ * @param[in] isp		ISP session
+ * @param[in] mem		AVR_ISP_MEM_FLASH or AVR_ISP_MEM_EEPROM
+ * @param[in] addr		byte address
+ * @param[in] nb_data		number of bytes
+ * @param[in] buf		AVR_ISP_BUF_SIZE bytes scratch buffer
+ *
+ * @return			CRC32 (zlib compatible).
+ */
+uint32_t avr_isp_crc32(t_avr_isp *isp, uint8_t mem, uint32_t addr,
+		       uint32_t nb_data, uint8_t *buf)
+{
+	uint8_t *data;
+	uint32_t crc, chunk;
+
+	/* Data is extracted in place in the answer half of buf */
+	data = buf + AVR_ISP_BUF_SIZE / 2;
+	crc = 0;
+	while (nb_data > 0) {
+		chunk = avr_burst_size(mem, addr, nb_data);
+		if (mem == AVR_ISP_MEM_FLASH)
+			avr_ext_addr(isp, addr);
+		avr_read_burst(isp, mem, addr, data, chunk, buf);
+		crc = spi_flash_crc32(crc, data, chunk);
+		addr += chunk;
+		nb_data -= chunk;
+	}
+	return crc;
+}
@@ -0,0 +1,70 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRABUS_AVR_ISP_H_
+#define _HYDRABUS_AVR_ISP_H_
+
+#include "common.h"
+#include "bsp_spi.h"
+
+/*
+ * AVR serial programming (ISP), RESET is driven by the caller (CS) and
+ * shall be low, SCK below 1/4 of the target clock.
+ * Each command is 4 bytes, commands are pipelined in SPI bursts.
+ */
+#define AVR_ISP_MEM_FLASH	(0)
+#define AVR_ISP_MEM_EEPROM	(1)
+
+#define AVR_ISP_FUSE_LOW	(0)
+#define AVR_ISP_FUSE_HIGH	(1)
+#define AVR_ISP_FUSE_EXT	(2)
+#define AVR_ISP_LOCK		(3)
+#define AVR_ISP_NB_FUSES	(4)
+
+/* Scratch buffer size, half for the commands, half for the answers */
+#define AVR_ISP_BUF_SIZE	(4096)
+/* Data bytes per burst */
+#define AVR_ISP_BURST_SIZE	(AVR_ISP_BUF_SIZE / 2 / 4)
+#define AVR_ISP_MAX_PAGE_SIZE	(AVR_ISP_BURST_SIZE)
+
+/* Maximum RDY/BSY polling time (chip erase) */
+#define AVR_ISP_TIMEOUT_MS	(100)
+
+/* ISP session state */
+typedef struct {
+	bsp_dev_spi_t dev_num;
+	uint8_t ext; /* Extended address byte, 0 after reset */
+} t_avr_isp;
+
+void avr_isp_init(t_avr_isp *isp, bsp_dev_spi_t dev_num);
+bool avr_isp_program_enable(t_avr_isp *isp);
+bool avr_isp_chip_erase(t_avr_isp *isp);
+void avr_isp_read_signature(t_avr_isp *isp, uint8_t *sig);
+void avr_isp_read_fuses(t_avr_isp *isp, uint8_t *fuses);
+bool avr_isp_write_fuse(t_avr_isp *isp, uint8_t fuse, uint8_t value);
+void avr_isp_read(t_avr_isp *isp, uint8_t mem, uint32_t addr,
+		  uint8_t *rx_data, uint32_t nb_data, uint8_t *buf);
+bool avr_isp_write_flash_page(t_avr_isp *isp, uint32_t addr,
+			      const uint8_t *tx_data, uint32_t nb_data,
+			      uint8_t *buf);
+bool avr_isp_write_eeprom(t_avr_isp *isp, uint32_t addr,
+			  const uint8_t *tx_data, uint32_t nb_data);
+uint32_t avr_isp_crc32(t_avr_isp *isp, uint8_t mem, uint32_t addr,
+		       uint32_t nb_data, uint8_t *buf);
+
+#endif /* _HYDRABUS_AVR_ISP_H_ */
@@ -55,7 +55,7 @@ int cmd_bbio(t_hydra_console *con)
 	cprint(con, "BBIO1", 5);
 
 	while (!hydrabus_ubtn()) {
-		if(chnRead(con->sdu, &bbio_mode, 1) == 1) {
+		if(cread(con, &bbio_mode, 1) == 1) {
 			switch(bbio_mode) {
 			case BBIO_SPI:
 				bbio_mode_spi(con);
@@ -112,6 +112,8 @@ int cmd_bbio(t_hydra_console *con)
 				cprint(con, "\x01", 1);
 				break;
 			}
+			/* Release the scratch buffers leased by the mode */
+			sbuf_free_all(con);
 			cprint(con, "BBIO1", 5);
 		}
 	}
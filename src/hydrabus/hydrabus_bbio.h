@@ -19,6 +19,10 @@
  */
 
 #include "hydrabus_bbio_aux.h"
+#include "sbuf.h"
+
+/* Scratch buffer leased by the bulk modes, first half TX, second half RX */
+#define BBIO_SBUF_SIZE	(8192)
 
 /*
  * Basic BBIO modes
@@ -55,6 +59,11 @@
 #define BBIO_SPI_CS_HIGH	0b00000011
 #define BBIO_SPI_WRITE_READ	0b00000100
 #define BBIO_SPI_WRITE_READ_NCS	0b00000101
+#define BBIO_SPI_WRITE_READ_STREAM	0b00000111
+#define BBIO_SPI_FLASH_DUMP	0b00001000
+#define BBIO_SPI_BATCH		0b00001001
+#define BBIO_SPI_FLASH_ID	0b00001010
+#define BBIO_SPI_SNIFF_DMA	0b00001011
 #define BBIO_SPI_SNIFF_ALL	0b00001101
 #define BBIO_SPI_SNIFF_CS_LOW	0b00001110
 #define BBIO_SPI_SNIFF_CS_HIGH	0b00001111
@@ -67,6 +76,13 @@
 #define BBIO_SPI_AVR_NULL	0b00000000
 #define BBIO_SPI_AVR_VERSION	0b00000001
 #define BBIO_SPI_AVR_READ	0b00000010
+#define BBIO_SPI_AVR_PROG_ENABLE	0b00000011
+#define BBIO_SPI_AVR_CHIP_ERASE	0b00000100
+#define BBIO_SPI_AVR_READ_INFO	0b00000101
+#define BBIO_SPI_AVR_WRITE_FUSE	0b00000110
+#define BBIO_SPI_AVR_READ_MEM	0b00000111
+#define BBIO_SPI_AVR_WRITE_MEM	0b00001000
+#define BBIO_SPI_AVR_CRC	0b00001001
 
 /*
  * I2C-specific commands
@@ -77,6 +93,9 @@
 #define BBIO_I2C_ACK_BIT	0b00000110
 #define BBIO_I2C_NACK_BIT	0b00000111
 #define BBIO_I2C_WRITE_READ	0b00001000
+#define BBIO_I2C_BATCH		0b00001001
+#define BBIO_I2C_WRITE_BULK	0b00001010
+#define BBIO_I2C_READ_BULK	0b00001011
 #define BBIO_I2C_START_SNIFF	0b00001111
 #define BBIO_I2C_BULK_WRITE	0b00010000
 #define BBIO_I2C_CONFIG_PERIPH	0b01000000
@@ -132,6 +151,8 @@
 #define BBIO_RAWWIRE_CLK_HIGH	0b00001011
 #define BBIO_RAWWIRE_DATA_LOW	0b00001100
 #define BBIO_RAWWIRE_DATA_HIGH	0b00001101
+#define BBIO_RAWWIRE_WRITE_BULK	0b00001110
+#define BBIO_RAWWIRE_READ_BULK	0b00001111
 #define BBIO_RAWWIRE_BULK_TRANSFER 0b00010000
 #define BBIO_RAWWIRE_BULK_CLK	0b00100000
 #define BBIO_RAWWIRE_BULK_BIT	0b00110000
@@ -144,6 +165,8 @@
  */
 #define BBIO_ONEWIRE_RESET	0b00000010
 #define BBIO_ONEWIRE_READ	0b00000100
+#define BBIO_ONEWIRE_WRITE_BULK	0b00000101
+#define BBIO_ONEWIRE_READ_BULK	0b00000110
 #define BBIO_ONEWIRE_BULK_TRANSFER 0b00010000
 #define BBIO_ONEWIRE_CONFIG_PERIPH 0b01000000
 
@@ -159,6 +182,8 @@
 #define BBIO_FLASH_WAIT_READY	0b00001000
 #define BBIO_FLASH_SD_DUMP_OFF	0b00001010
 #define BBIO_FLASH_SD_DUMP_ON	0b00001011
+#define BBIO_FLASH_READ_PAGES	0b00001100
+#define BBIO_FLASH_PROBE	0b00001101
 #define BBIO_FLASH_WRITE_ADDR	0b00010000
 
 /*
@@ -40,7 +40,7 @@ void bbio_adc_continuous(t_hydra_console *con)
 
 	bsp_adc_init(BSP_DEV_ADC1);
 	while(cmd != BBIO_RESET) {
-		chnReadTimeout(con->sdu, &cmd, 1, TIME_IMMEDIATE);
+		cread_timeout(con, &cmd, 1, TIME_IMMEDIATE);
 		bsp_adc_read_u16(BSP_DEV_ADC1, &value, 1);
 		cprintf(con, "%c", value>>8);
 		cprintf(con, "%c", value&0xff);
@@ -92,7 +92,7 @@ uint8_t bbio_aux(t_hydra_console *con, uint8_t command)
 	case BBIO_AUX_MODE_READ:
 		return bbio_aux_mode_get(con);
 	case BBIO_AUX_MODE_SET:
-		chnRead(con->sdu, &config, 1);
+		cread(con, &config, 1);
 		proto->aux_config = config;
 		bbio_aux_mode_set(con);
 		return 1;
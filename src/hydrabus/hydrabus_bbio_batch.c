@@ -0,0 +1,183 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common.h"
+#include <string.h>
+
+#include "hydrabus_bbio.h"
+#include "hydrabus_bbio_batch.h"
+
+/*
+ * Check the frame and compute the answer length.
+ * Return FALSE if the frame is malformed.
+ */
+static bool batch_check(const uint8_t *frame, uint32_t frame_len,
+			uint32_t *answer_len)
+{
+	uint32_t i, len;
+	uint8_t op;
+
+	*answer_len = 0;
+	i = 0;
+	while (i < frame_len) {
+		op = frame[i++];
+		switch (op) {
+		case BBIO_BATCH_SELECT:
+		case BBIO_BATCH_UNSELECT:
+			*answer_len += 1;
+			break;
+		case BBIO_BATCH_DELAY_US:
+			if (i + 2 > frame_len)
+				return FALSE;
+			i += 2;
+			*answer_len += 1;
+			break;
+		case BBIO_BATCH_READ:
+			if (i + 2 > frame_len)
+				return FALSE;
+			len = (frame[i] << 8) + frame[i + 1];
+			i += 2;
+			*answer_len += 1 + len;
+			break;
+		case BBIO_BATCH_WRITE:
+		case BBIO_BATCH_WRITE_READ:
+			if (i + 2 > frame_len)
+				return FALSE;
+			len = (frame[i] << 8) + frame[i + 1];
+			i += 2 + len;
+			if (i > frame_len)
+				return FALSE;
+			*answer_len += 1;
+			if (op == BBIO_BATCH_WRITE_READ)
+				*answer_len += len;
+			break;
+		default:
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/**
+ * @brief   Receives and executes a batch of operations
+ *
+ * @param[in] con		console
+ * @param[in] ops		bus operations
+ * @param[in] buf		scratch buffer, first half for the frame, second
+ *				half for the answer
+ * @param[in] size		scratch buffer size
+ */
+void bbio_batch(t_hydra_console *con, const t_bbio_batch_ops *ops,
+		uint8_t *buf, uint32_t size)
+{
+	uint8_t *frame, *answer, *data;
+	uint8_t hdr[2], op, status;
+	uint32_t frame_len, answer_len, i, a;
+	uint16_t len;
+	bool failed;
+
+	frame = buf;
+	answer = buf + size / 2;
+
+	if (cread(con, hdr, 2) != 2) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+	frame_len = (hdr[0] << 8) + hdr[1];
+	if (frame_len > size / 2) {
+		/* Drop the frame to stay in sync with the host */
+		while (frame_len > 0) {
+			len = (frame_len > size) ? size : frame_len;
+			cread(con, buf, len);
+			frame_len -= len;
+		}
+		cprint(con, "\x00", 1);
+		return;
+	}
+	cread(con, frame, frame_len);
+
+	if (!batch_check(frame, frame_len, &answer_len) ||
+	    answer_len + 1 > size / 2) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+
+	answer[0] = 0x01;
+	a = 1;
+	failed = FALSE;
+	i = 0;
+	while (i < frame_len) {
+		op = frame[i++];
+		len = 0;
+		data = NULL;
+		if (op != BBIO_BATCH_SELECT && op != BBIO_BATCH_UNSELECT) {
+			len = (frame[i] << 8) + frame[i + 1];
+			i += 2;
+		}
+		if (op == BBIO_BATCH_WRITE || op == BBIO_BATCH_WRITE_READ) {
+			data = &frame[i];
+			i += len;
+		}
+
+		if (failed && op != BBIO_BATCH_UNSELECT) {
+			answer[a++] = BBIO_BATCH_SKIPPED;
+			if (op == BBIO_BATCH_READ || op == BBIO_BATCH_WRITE_READ) {
+				memset(&answer[a], 0, len);
+				a += len;
+			}
+			continue;
+		}
+
+		status = BBIO_BATCH_OK;
+		switch (op) {
+		case BBIO_BATCH_SELECT:
+			ops->select(con);
+			break;
+		case BBIO_BATCH_UNSELECT:
+			ops->unselect(con);
+			break;
+		case BBIO_BATCH_DELAY_US:
+			DelayUs(len);
+			break;
+		case BBIO_BATCH_WRITE:
+			if (len > 0 && !ops->write(con, data, len))
+				status = BBIO_BATCH_ERROR;
+			break;
+		case BBIO_BATCH_READ:
+			if (len > 0 && !ops->read(con, &answer[a + 1], len))
+				status = BBIO_BATCH_ERROR;
+			break;
+		case BBIO_BATCH_WRITE_READ:
+			if (ops->write_read == NULL) {
+				memset(&answer[a + 1], 0, len);
+				status = BBIO_BATCH_ERROR;
+			} else if (len > 0 &&
+				   !ops->write_read(con, data, &answer[a + 1], len)) {
+				status = BBIO_BATCH_ERROR;
+			}
+			break;
+		}
+		answer[a++] = status;
+		if (op == BBIO_BATCH_READ || op == BBIO_BATCH_WRITE_READ)
+			a += len;
+		if (status != BBIO_BATCH_OK)
+			failed = TRUE;
+	}
+
+	cprint(con, (char *)answer, a);
+}
@@ -0,0 +1,57 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRABUS_BBIO_BATCH_H_
+#define _HYDRABUS_BBIO_BATCH_H_
+
+/*
+ * Batch of operations, executed back to back with one answer.
+ * Host sends the batch command, the frame length (16bits big endian)
+ * then the frame: a list of operations, each one is the operation code
+ * followed by its parameters (lengths are 16bits big endian).
+ * Device answers 0x00 if the frame is rejected, else 0x01 followed by
+ * the status of each operation and the data read by READ/WRITE_READ
+ * operations (always the requested length).
+ */
+#define BBIO_BATCH_SELECT	0x01 /* CS low / I2C start */
+#define BBIO_BATCH_UNSELECT	0x02 /* CS high / I2C stop */
+#define BBIO_BATCH_WRITE	0x03 /* len, data */
+#define BBIO_BATCH_READ		0x04 /* len */
+#define BBIO_BATCH_WRITE_READ	0x05 /* len, data */
+#define BBIO_BATCH_DELAY_US	0x06 /* delay */
+
+/* Operation status */
+#define BBIO_BATCH_ERROR	0x00
+#define BBIO_BATCH_OK		0x01
+/* Not run because a previous operation failed (UNSELECT is always run) */
+#define BBIO_BATCH_SKIPPED	0x02
+
+typedef struct {
+	void (*select)(t_hydra_console *con);
+	void (*unselect)(t_hydra_console *con);
+	bool (*write)(t_hydra_console *con, uint8_t *tx_data, uint16_t nb_data);
+	bool (*read)(t_hydra_console *con, uint8_t *rx_data, uint16_t nb_data);
+	/* NULL if not supported */
+	bool (*write_read)(t_hydra_console *con, uint8_t *tx_data,
+			   uint8_t *rx_data, uint16_t nb_data);
+} t_bbio_batch_ops;
+
+void bbio_batch(t_hydra_console *con, const t_bbio_batch_ops *ops,
+		uint8_t *buf, uint32_t size);
+
+#endif /* _HYDRABUS_BBIO_BATCH_H_ */
@@ -0,0 +1,65 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common.h"
+
+#include "hydrabus_bbio.h"
+#include "hydrabus_bbio_bulk.h"
+
+/**
+ * @brief   Receives and executes a length prefixed bulk transfer
+ * @details The transfer is split in chunks of half the scratch buffer,
+ *          the answer of each chunk is sent before the next one is read.
+ *
+ * @param[in] con		console
+ * @param[in] xfer		bus transfer function
+ * @param[in] arg		context passed to xfer
+ * @param[in] write		TRUE if the host sends the data to write
+ * @param[in] buf		scratch buffer, first half for the data to
+ *				write, second half for the answer
+ * @param[in] size		scratch buffer size
+ */
+void bbio_bulk(t_hydra_console *con, bbio_bulk_xfer_t xfer, void *arg,
+	       bool write, uint8_t *buf, uint32_t size)
+{
+	uint8_t *tx_data, *rx_data;
+	uint8_t hdr[2];
+	uint32_t len;
+	uint16_t chunk, nb_rx;
+
+	tx_data = buf;
+	rx_data = buf + size / 2;
+
+	if (cread(con, hdr, 2) != 2) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+	len = (hdr[0] << 8) + hdr[1];
+
+	cprint(con, "\x01", 1);
+	while (len > 0) {
+		chunk = (len > size / 2) ? size / 2 : len;
+		if (write)
+			cread(con, tx_data, chunk);
+		len -= chunk;
+		nb_rx = xfer(con, arg, write ? tx_data : NULL, rx_data, chunk,
+			     len == 0);
+		if (nb_rx > 0)
+			cprint(con, (char *)rx_data, nb_rx);
+	}
+}
@@ -0,0 +1,42 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRABUS_BBIO_BULK_H_
+#define _HYDRABUS_BBIO_BULK_H_
+
+/*
+ * Length prefixed bulk transfer.
+ * Host sends the bulk command, the length (16bits big endian) then the
+ * data for write commands. Device answers 0x01 followed by the data
+ * returned by the transfer, if any, streamed as it is produced.
+ */
+
+/*
+ * Transfers nb_data bytes, tx_data is NULL for reads.
+ * arg is the context given to bbio_bulk().
+ * last is TRUE for the chunk holding the last byte of the command.
+ * Returns the number of bytes stored in rx_data to send to the host.
+ */
+typedef uint16_t (*bbio_bulk_xfer_t)(t_hydra_console *con, void *arg,
+				     uint8_t *tx_data, uint8_t *rx_data,
+				     uint16_t nb_data, bool last);
+
+void bbio_bulk(t_hydra_console *con, bbio_bulk_xfer_t xfer, void *arg,
+	       bool write, uint8_t *buf, uint32_t size);
+
+#endif /* _HYDRABUS_BBIO_BULK_H_ */
@@ -76,7 +76,7 @@ void bbio_mode_can(t_hydra_console *con)
 	bbio_mode_id(con);
 
 	while(!hydrabus_ubtn()) {
-		if(chnRead(con->sdu, &bbio_subcommand, 1) == 1) {
+		if(cread(con, &bbio_subcommand, 1) == 1) {
 			switch(bbio_subcommand) {
 			case BBIO_RESET:
 				bsp_can_deinit(proto->dev_num);
@@ -85,7 +85,7 @@ void bbio_mode_can(t_hydra_console *con)
 				bbio_mode_id(con);
 				break;
 			case BBIO_CAN_ID:
-				chnRead(con->sdu, rx_buff, 4);
+				cread(con, rx_buff, 4);
 				can_id =  rx_buff[0] << 24;
 				can_id += rx_buff[1] << 16;
 				can_id += rx_buff[2] << 8;
@@ -133,7 +133,7 @@ void bbio_mode_can(t_hydra_console *con)
 				slcan(con);
 				break;
 			case BBIO_CAN_SET_TIMINGS:
-				chnRead(con->sdu, rx_buff, 3);
+				cread(con, rx_buff, 3);
 				if(rx_buff[0] > 0 && rx_buff[0] <= 16) {
 					cprint(con, "\x00", 1);
 					break;
@@ -175,8 +175,7 @@ void bbio_mode_can(t_hydra_console *con)
 					tx_msg.header.RTR = CAN_RTR_DATA;
 					tx_msg.header.DLC = to_tx;
 
-					chnRead(con->sdu, rx_buff,
-							       to_tx);
+					cread(con, rx_buff, to_tx);
 
 					for(i=0; i<to_tx; i++) {
 						tx_msg.data[i] = rx_buff[i];
@@ -190,7 +189,7 @@ void bbio_mode_can(t_hydra_console *con)
 						cprint(con, "\x00", 1);
 					}
 				} else if((bbio_subcommand & BBIO_CAN_FILTER) == BBIO_CAN_FILTER) {
-					chnRead(con->sdu, rx_buff, 4);
+					cread(con, rx_buff, 4);
 					if(bbio_subcommand & 1) {
 						filter_high =  rx_buff[0] << 24;
 						filter_high += rx_buff[1] << 16;
@@ -27,29 +27,185 @@
 #include "hydrabus_bbio.h"
 #include "hydrabus_bbio_flash.h"
 #include "hydrabus_mode_flash.h"
+#include "hydrabus_nand.h"
+#include "hydrabus_spi_flash.h"
+
+#define BBIO_FLASH_READ_PAGES_SD	0b00000001
+#define BBIO_FLASH_READ_PAGES_ECC	0b00000010
+#define BBIO_FLASH_READ_PAGES_STATUS	0b00000100
 
 static FIL outfile;
+static FIL dump_file;
+static bool dump_to_sd;
+static bool dump_sd_error;
+static bool dump_status;
 
 static void bbio_mode_id(t_hydra_console *con)
 {
 	cprint(con, BBIO_FLASH_HEADER, 4);
 }
 
+static void put_u32(uint8_t *buf, uint32_t value)
+{
+	buf[0] = value >> 24;
+	buf[1] = value >> 16;
+	buf[2] = value >> 8;
+	buf[3] = value;
+}
+
+static uint32_t get_u32(const uint8_t *buf)
+{
+	return ((uint32_t)buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3];
+}
+
+static bool dump_page(t_hydra_console *con, uint8_t *data, uint32_t nb_data,
+		      uint8_t status)
+{
+	uint8_t crc[5];
+	UINT written;
+
+	put_u32(crc, spi_flash_crc32(0, data, nb_data));
+	crc[4] = status;
+	if (dump_to_sd) {
+		if (!dump_sd_error &&
+		    (f_write(&dump_file, data, nb_data, &written) != FR_OK ||
+		     written != nb_data))
+			dump_sd_error = TRUE;
+	} else {
+		cprint(con, (char *)data, nb_data);
+	}
+	cprint(con, (char *)crc, dump_status ? 5 : 4);
+	/* Never abort, the host expects all the pages */
+	return TRUE;
+}
+
+/*
+ * Reads the ID and the geometry (ONFI parameter page, else from the ID).
+ * Device answers 0x00 if no NAND answered, else 0x01, the 5 ID bytes,
+ * 0x01 if the geometry comes from ONFI, the column and row address
+ * cycles, the data and page sizes, pages per block and number of blocks
+ * (32bits big endian, blocks 0 if unknown) and the ONFI required ECC bits.
+ */
+static void bbio_flash_probe(t_hydra_console *con)
+{
+	t_nand nand;
+	uint8_t answer[26];
+
+	if (!nand_probe(con, &nand)) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+	answer[0] = 0x01;
+	memcpy(&answer[1], nand.id, 5);
+	answer[6] = nand.onfi ? 0x01 : 0x00;
+	answer[7] = nand.col_cycles;
+	answer[8] = nand.row_cycles;
+	put_u32(&answer[9], nand.data_size);
+	put_u32(&answer[13], nand.page_size);
+	put_u32(&answer[17], nand.pages_per_block);
+	put_u32(&answer[21], nand.nb_blocks);
+	answer[25] = nand.ecc_bits;
+	cprint(con, (char *)answer, 26);
+}
+
+/*
+ * Reads consecutive pages, data and spare areas.
+ * Host sends the column and row address cycles, the page size (16bits
+ * big endian), the pages per block, the first page and number of pages
+ * (32bits big endian) then flags.
+ * The bad block marker is only checked in the first two pages of a block.
+ * Device answers 0x00 if the command is rejected, else 0x01, then for
+ * each page the data (unless dumped to microSD), its CRC32 (big endian,
+ * as zlib) and with the status flag the page status (NAND_PAGE_x), then
+ * 0x01 if the dump succeeded else 0x00.
+ * With the ECC flag, the data is corrected before the CRC32 is computed.
+ * The microSD file is preallocated to the dump size.
+ */
+static void bbio_flash_read_pages(t_hydra_console *con)
+{
+	t_nand nand;
+	uint8_t hdr[17];
+	uint8_t *buf, flags;
+	uint32_t page, nb_pages;
+	bsp_status_t status;
+
+	if (cread(con, hdr, 17) != 17) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+	memset(&nand, 0, sizeof(t_nand));
+	nand.col_cycles = hdr[0];
+	nand.row_cycles = hdr[1];
+	nand.page_size = (hdr[2] << 8) + hdr[3];
+	/* Data area is a power of two, the spare area is smaller */
+	nand.data_size = 1;
+	while (nand.data_size * 2 <= nand.page_size)
+		nand.data_size *= 2;
+	nand.pages_per_block = get_u32(&hdr[4]);
+	page = get_u32(&hdr[8]);
+	nb_pages = get_u32(&hdr[12]);
+	dump_to_sd = (hdr[16] & BBIO_FLASH_READ_PAGES_SD) ? TRUE : FALSE;
+	dump_status = (hdr[16] & BBIO_FLASH_READ_PAGES_STATUS) ? TRUE : FALSE;
+	flags = (hdr[16] & BBIO_FLASH_READ_PAGES_ECC) ? NAND_DUMP_ECC : 0;
+	dump_sd_error = FALSE;
+
+	if (!nand_check_geometry(&nand) ||
+	    ((flags & NAND_DUMP_ECC) && !nand_ecc_supported(&nand)) ||
+	    (uint64_t)nb_pages * nand.page_size > 0xFFFFFFFF) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+	buf = sbuf_alloc(con, SBUF_RAM, 2 * nand.page_size);
+	if (buf == NULL) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+	if (dump_to_sd) {
+		if (!file_open(&dump_file, "nand_dump.bin", 'w')) {
+			sbuf_free(con, buf);
+			cprint(con, "\x00", 1);
+			return;
+		}
+		if (!file_preallocate(&dump_file, nb_pages * nand.page_size)) {
+			file_close(&dump_file);
+			sbuf_free(con, buf);
+			cprint(con, "\x00", 1);
+			return;
+		}
+	}
+	cprint(con, "\x01", 1);
+
+	status = nand_dump(con, &nand, page, nb_pages, flags, buf, dump_page);
+
+	if (dump_to_sd && !file_close(&dump_file))
+		dump_sd_error = TRUE;
+	sbuf_free(con, buf);
+	if (status == BSP_OK && !dump_sd_error) {
+		cprint(con, "\x01", 1);
+	} else {
+		cprint(con, "\x00", 1);
+	}
+}
+
 void bbio_mode_flash(t_hydra_console *con)
 {
 	uint32_t to_rx, to_tx, i;
 	uint8_t bbio_subcommand;
-	uint8_t *tx_data = (uint8_t *)g_sbuf;
-	uint8_t *rx_data = (uint8_t *)g_sbuf+4096;
+	uint8_t *tx_data, *rx_data;
 	bool to_sd = FALSE;
 
+	tx_data = sbuf_alloc(con, SBUF_RAM, BBIO_SBUF_SIZE);
+	if (tx_data == NULL)
+		return;
+	rx_data = tx_data + BBIO_SBUF_SIZE / 2;
+
 	flash_init_proto_default(con);
 	flash_pin_init(con);
 
 	bbio_mode_id(con);
 
 	while (!hydrabus_ubtn()) {
-		if(chnRead(con->sdu, &bbio_subcommand, 1) == 1) {
+		if(cread(con, &bbio_subcommand, 1) == 1) {
 			switch(bbio_subcommand) {
 			case BBIO_RESET:
 				flash_cleanup(con);
@@ -66,7 +222,7 @@ void bbio_mode_flash(t_hydra_console *con)
 				cprint(con, "\x01", 1);
 				break;
 			case BBIO_FLASH_WRITE_CMD:
-				chnRead(con->sdu, rx_data, 1);
+				cread(con, rx_data, 1);
 				flash_write_command(con, rx_data[0]);
 				cprint(con, "\x01", 1);
 				break;
@@ -79,7 +235,7 @@ void bbio_mode_flash(t_hydra_console *con)
 				cprint(con, "\x01", 1);
 				break;
 			case BBIO_FLASH_WRITE_READ:
-				chnRead(con->sdu, rx_data, 4);
+				cread(con, rx_data, 4);
 				to_tx = (rx_data[0] << 8) + rx_data[1];
 				to_rx = (rx_data[2] << 8) + rx_data[3];
 				if ((to_tx > 4096) || (to_rx > 4096)) {
@@ -88,7 +244,7 @@ void bbio_mode_flash(t_hydra_console *con)
 				}
 
 				if(to_tx > 0) {
-					chnRead(con->sdu, tx_data, to_tx);
+					cread(con, tx_data, to_tx);
 				}
 
 				/* Write operations */
@@ -126,6 +282,12 @@ void bbio_mode_flash(t_hydra_console *con)
 					cprint(con, "\x00", 1);
 				}
 				break;
+			case BBIO_FLASH_READ_PAGES:
+				bbio_flash_read_pages(con);
+				break;
+			case BBIO_FLASH_PROBE:
+				bbio_flash_probe(con);
+				break;
 			case BBIO_FLASH_SD_DUMP_OFF:
 				to_sd = FALSE;
 				if(file_close(&outfile)) {
@@ -140,7 +302,7 @@ void bbio_mode_flash(t_hydra_console *con)
 					// write
 					to_tx = (bbio_subcommand & 0b1111) + 1;
 
-					chnRead(con->sdu, tx_data, to_tx);
+					cread(con, tx_data, to_tx);
 					i=0;
 					while(i<to_tx) {
 						flash_write_address(con,
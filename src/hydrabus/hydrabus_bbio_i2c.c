@@ -25,12 +25,17 @@
 
 #include "hydrabus_bbio.h"
 #include "hydrabus_bbio_i2c.h"
+#include "hydrabus_mode_i2c.h"
 #include "bsp_i2c_master.h"
 #include "bsp_i2c_slave.h"
 #include "hydrabus_bbio_aux.h"
+#include "hydrabus_bbio_batch.h"
+#include "hydrabus_bbio_bulk.h"
 
 #define I2C_DEV_NUM (1)
 
+extern const mode_exec_t mode_i2c_exec;
+
 void bbio_i2c_init_proto_default(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -44,38 +49,93 @@ void bbio_i2c_init_proto_default(t_hydra_console *con)
 
 void bbio_i2c_sniff(t_hydra_console *con)
 {
-	(void)con;
-	bsp_status_t status;
-	uint16_t data;
-	uint8_t dummy;
+	i2c_sniff(con, TRUE);
+	cprint(con, "\x01", 1);
+}
 
-	mode_config_proto_t* proto = &con->mode->proto;
+static void batch_select(t_hydra_console *con)
+{
+	bsp_i2c_start(con->mode->proto.dev_num);
+}
 
-	bsp_i2c_master_deinit(proto->dev_num);
-	bsp_i2c_slave_init(proto->dev_num, proto);
+static void batch_unselect(t_hydra_console *con)
+{
+	bsp_i2c_stop(con->mode->proto.dev_num);
+}
 
-	while(!hydrabus_ubtn() || chnReadTimeout(con->sdu, &dummy, 1, TIME_IMMEDIATE)) {
-		status = bsp_i2c_slave_sniff(proto->dev_num, &data);
-		if (status != BSP_OK) {
-			continue;
-		}
-		switch(data) {
-		case 0x400:
-			cprint(con, "[", 1);
-			break;
-		case 0x200:
-			cprint(con, "]", 1);
-			break;
-		default:
-			cprintf(con, "\\%c", data>>1);
-			cprint(con, data & 1 ? "-" : "+", 1);
-			break;
-		}
+/* Fails on the first byte not acknowledged */
+static bool batch_write(t_hydra_console *con, uint8_t *tx_data,
+			uint16_t nb_data)
+{
+	uint8_t tx_ack_flag;
+	uint16_t i;
+
+	for(i = 0; i < nb_data; i++) {
+		bsp_i2c_master_write_u8(con->mode->proto.dev_num, tx_data[i],
+					&tx_ack_flag);
+		if(tx_ack_flag != TRUE)
+			return FALSE;
 	}
+	return TRUE;
+}
 
-	bsp_i2c_slave_deinit(proto->dev_num);
-	bsp_i2c_master_init(proto->dev_num, proto);
-	cprint(con, "\x01", 1);
+/* ACK all bytes but the last one */
+static bool batch_read(t_hydra_console *con, uint8_t *rx_data,
+		       uint16_t nb_data)
+{
+	uint16_t i;
+
+	for(i = 0; i < nb_data; i++) {
+		if(bsp_i2c_master_read_u8(con->mode->proto.dev_num,
+					  &rx_data[i]) != BSP_OK)
+			return FALSE;
+		bsp_i2c_read_ack(con->mode->proto.dev_num, i < nb_data - 1);
+	}
+	return TRUE;
+}
+
+static const t_bbio_batch_ops batch_ops = {
+	.select = batch_select,
+	.unselect = batch_unselect,
+	.write = batch_write,
+	.read = batch_read,
+	.write_read = NULL,
+};
+
+/*
+ * One status byte per byte written, ACK (0x00) or NACK (0x01), so the
+ * bytes are written one at a time as the mode stops on a NACK
+ */
+static uint16_t bulk_write(t_hydra_console *con, void *arg, uint8_t *tx_data,
+			   uint8_t *rx_data, uint16_t nb_data, bool last)
+{
+	uint16_t i;
+	(void)arg;
+	(void)last;
+
+	for(i = 0; i < nb_data; i++) {
+		if(mode_i2c_exec.bulk_write(con, &tx_data[i], 1) == BSP_OK)
+			rx_data[i] = 0x00;
+		else
+			rx_data[i] = 0x01;
+	}
+	return nb_data;
+}
+
+/* The mode ACKs each byte before the next one, NACK the last of the command */
+static uint16_t bulk_read(t_hydra_console *con, void *arg, uint8_t *tx_data,
+			  uint8_t *rx_data, uint16_t nb_data, bool last)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	(void)arg;
+	(void)tx_data;
+
+	mode_i2c_exec.bulk_read(con, rx_data, nb_data);
+	if(last) {
+		bsp_i2c_read_ack(proto->dev_num, FALSE);
+		proto->config.i2c.ack_pending = 0;
+	}
+	return nb_data;
 }
 
 static void bbio_mode_id(t_hydra_console *con)
@@ -87,20 +147,24 @@ void bbio_mode_i2c(t_hydra_console *con)
 {
 	uint8_t bbio_subcommand;
 	uint16_t to_rx, to_tx, i;
-	uint8_t *tx_data = (uint8_t *)g_sbuf;
-	uint8_t *rx_data = (uint8_t *)g_sbuf+4096;
+	uint8_t *tx_data, *rx_data;
 	uint8_t data;
 	uint8_t tx_ack_flag;
 	bsp_status_t status;
 	mode_config_proto_t* proto = &con->mode->proto;
 
+	tx_data = sbuf_alloc(con, SBUF_RAM, BBIO_SBUF_SIZE);
+	if (tx_data == NULL)
+		return;
+	rx_data = tx_data + BBIO_SBUF_SIZE / 2;
+
 	bbio_i2c_init_proto_default(con);
 	bsp_i2c_master_init(proto->dev_num, proto);
 
 	bbio_mode_id(con);
 
 	while (!hydrabus_ubtn()) {
-		if(chnRead(con->sdu, &bbio_subcommand, 1) == 1) {
+		if(cread(con, &bbio_subcommand, 1) == 1) {
 			switch(bbio_subcommand) {
 			case BBIO_RESET:
 				bsp_i2c_master_deinit(proto->dev_num);
@@ -132,14 +196,14 @@ void bbio_mode_i2c(t_hydra_console *con)
 				bbio_i2c_sniff(con);
 				break;
 			case BBIO_I2C_WRITE_READ:
-				chnRead(con->sdu, rx_data, 4);
+				cread(con, rx_data, 4);
 				to_tx = (rx_data[0] << 8) + rx_data[1];
 				to_rx = (rx_data[2] << 8) + rx_data[3];
 				if ((to_tx > 4096) || (to_rx > 4096)) {
 					cprint(con, "\x00", 1);
 					break;
 				}
-				chnRead(con->sdu, tx_data, to_tx);
+				cread(con, tx_data, to_tx);
 
 				/* Send I2C Start */
 				bsp_i2c_start(proto->dev_num);
@@ -181,6 +245,18 @@ void bbio_mode_i2c(t_hydra_console *con)
 				cprint(con, "\x01", 1);
 				cprint(con, (char *)rx_data, to_rx);
 				break;
+			case BBIO_I2C_BATCH:
+				bbio_batch(con, &batch_ops, tx_data,
+					   BBIO_SBUF_SIZE);
+				break;
+			case BBIO_I2C_WRITE_BULK:
+				bbio_bulk(con, bulk_write, NULL, TRUE, tx_data,
+					  BBIO_SBUF_SIZE);
+				break;
+			case BBIO_I2C_READ_BULK:
+				bbio_bulk(con, bulk_read, NULL, FALSE, tx_data,
+					  BBIO_SBUF_SIZE);
+				break;
 			default:
 				if ((bbio_subcommand & BBIO_AUX_MASK) == BBIO_AUX_MASK) {
 					cprintf(con, "%c", bbio_aux(con, bbio_subcommand));
@@ -190,7 +266,7 @@ void bbio_mode_i2c(t_hydra_console *con)
 					data = (bbio_subcommand & 0b1111) + 1;
 					cprint(con, "\x01", 1);
 
-					chnRead(con->sdu, tx_data, data);
+					cread(con, tx_data, data);
 					/* Send all I2C Data */
 					for(i = 0; i < data; i++)
 					{
@@ -28,7 +28,34 @@
 #include "hydrabus_bbio_onewire.h"
 #include "hydrabus_mode_onewire.h"
 #include "hydrabus_bbio_aux.h"
+#include "hydrabus_bbio_bulk.h"
 
+extern const mode_exec_t mode_onewire_exec;
+
+static uint16_t bulk_write(t_hydra_console *con, void *arg, uint8_t *tx_data,
+			   uint8_t *rx_data, uint16_t nb_data, bool last)
+{
+	(void)arg;
+
+	mode_onewire_exec.bulk_write(con, tx_data, nb_data);
+	/* Single ack at the end of the transfer */
+	if(last) {
+		rx_data[0] = 0x01;
+		return 1;
+	}
+	return 0;
+}
+
+static uint16_t bulk_read(t_hydra_console *con, void *arg, uint8_t *tx_data,
+			  uint8_t *rx_data, uint16_t nb_data, bool last)
+{
+	(void)arg;
+	(void)tx_data;
+	(void)last;
+
+	mode_onewire_exec.bulk_read(con, rx_data, nb_data);
+	return nb_data;
+}
 
 static void bbio_mode_id(t_hydra_console *con)
 {
@@ -41,15 +68,20 @@ void bbio_mode_onewire(t_hydra_console *con)
 	uint8_t bbio_subcommand, i;
 	uint8_t rx_data[16], tx_data[16];
 	uint8_t data;
+	uint8_t *bulk_buf;
 	bsp_status_t status;
 
+	bulk_buf = sbuf_alloc(con, SBUF_RAM, BBIO_SBUF_SIZE);
+	if (bulk_buf == NULL)
+		return;
+
 	onewire_init_proto_default(con);
 	onewire_pin_init(con);
 
 	bbio_mode_id(con);
 
 	while (!hydrabus_ubtn()) {
-		if(chnRead(con->sdu, &bbio_subcommand, 1) == 1) {
+		if(cread(con, &bbio_subcommand, 1) == 1) {
 			switch(bbio_subcommand) {
 			case BBIO_RESET:
 				onewire_cleanup(con);
@@ -64,6 +96,14 @@ void bbio_mode_onewire(t_hydra_console *con)
 				rx_data[0] = onewire_read_u8(con);
 				cprint(con, (char *)&rx_data[0], 1);
 				break;
+			case BBIO_ONEWIRE_WRITE_BULK:
+				bbio_bulk(con, bulk_write, NULL, TRUE, bulk_buf,
+					  BBIO_SBUF_SIZE);
+				break;
+			case BBIO_ONEWIRE_READ_BULK:
+				bbio_bulk(con, bulk_read, NULL, FALSE, bulk_buf,
+					  BBIO_SBUF_SIZE);
+				break;
 			default:
 				if ((bbio_subcommand & BBIO_AUX_MASK) == BBIO_AUX_MASK) {
 					cprintf(con, "%c", bbio_aux(con, bbio_subcommand));
@@ -72,7 +112,7 @@ void bbio_mode_onewire(t_hydra_console *con)
 					// write
 					data = (bbio_subcommand & 0b1111) + 1;
 
-					chnRead(con->sdu, tx_data, data);
+					cread(con, tx_data, data);
 					for(i=0; i<data; i++) {
 						onewire_write_u8(con, tx_data[i]);
 					}
@@ -53,7 +53,7 @@ void bbio_mode_pin(t_hydra_console *con)
 	bbio_mode_id(con);
 
 	while (true) {
-		if(chnRead(con->sdu, &bbio_subcommand, 1) == 1) {
+		if(cread(con, &bbio_subcommand, 1) == 1) {
 			switch(bbio_subcommand) {
 			case BBIO_RESET:
 				return;
@@ -65,7 +65,7 @@ void bbio_mode_pin(t_hydra_console *con)
 				cprintf(con, "\x01%c", data & 0xff);
 				break;
 			case BBIO_PIN_NOPULL:
-				chnRead(con->sdu, &rx_buff, 1);
+				cread(con, &rx_buff, 1);
 				for(i=0; i<8; i++){
 					if((rx_buff>>i)&1){
 						pin_pull[i] = MODE_CONFIG_DEV_GPIO_NOPULL;
@@ -75,7 +75,7 @@ void bbio_mode_pin(t_hydra_console *con)
 				cprint(con, "\x01", 1);
 				break;
 			case BBIO_PIN_PULLUP:
-				chnRead(con->sdu, &rx_buff, 1);
+				cread(con, &rx_buff, 1);
 				for(i=0; i<8; i++){
 					if((rx_buff>>i)&1){
 						pin_pull[i] = MODE_CONFIG_DEV_GPIO_PULLUP;
@@ -85,7 +85,7 @@ void bbio_mode_pin(t_hydra_console *con)
 				cprint(con, "\x01", 1);
 				break;
 			case BBIO_PIN_PULLDOWN:
-				chnRead(con->sdu, &rx_buff, 1);
+				cread(con, &rx_buff, 1);
 				for(i=0; i<8; i++){
 					if((rx_buff>>i)&1){
 						pin_pull[i] = MODE_CONFIG_DEV_GPIO_PULLDOWN;
@@ -95,7 +95,7 @@ void bbio_mode_pin(t_hydra_console *con)
 				cprint(con, "\x01", 1);
 				break;
 			case BBIO_PIN_MODE:
-				chnRead(con->sdu, &rx_buff, 1);
+				cread(con, &rx_buff, 1);
 				for(i=0; i<8; i++){
 					if((rx_buff>>i)&1){
 						pin_mode[i] = MODE_CONFIG_DEV_GPIO_IN;
@@ -107,7 +107,7 @@ void bbio_mode_pin(t_hydra_console *con)
 				cprint(con, "\x01", 1);
 				break;
 			case BBIO_PIN_WRITE:
-				chnRead(con->sdu, &rx_buff, 1);
+				cread(con, &rx_buff, 1);
 				for(i=0; i<8; i++){
 					if((rx_buff>>i)&1){
 						bsp_gpio_set(BSP_GPIO_PORTA, i);
@@ -28,8 +28,12 @@
 #include "hydrabus_mode_twowire.h"
 #include "hydrabus_mode_threewire.h"
 #include "hydrabus_bbio_aux.h"
+#include "hydrabus_bbio_bulk.h"
 
 
+extern const mode_exec_t mode_twowire_exec;
+extern const mode_exec_t mode_threewire_exec;
+
 const mode_rawwire_exec_t bbio_twowire = {
 	.init = &twowire_init_proto_default,
 	.pin_init = &twowire_pin_init,
@@ -46,6 +50,7 @@ const mode_rawwire_exec_t bbio_twowire = {
 	.data_high = &twowire_sda_high,
 	.data_low = &twowire_sda_low,
 	.cleanup = &twowire_cleanup,
+	.exec = &mode_twowire_exec,
 };
 const mode_rawwire_exec_t bbio_threewire = {
 	.init = &threewire_init_proto_default,
@@ -63,8 +68,39 @@ const mode_rawwire_exec_t bbio_threewire = {
 	.data_high = &threewire_sdo_high,
 	.data_low = &threewire_sdo_low,
 	.cleanup = &threewire_cleanup,
+	.exec = &mode_threewire_exec,
 };
 
+/*
+ * arg is the current mode of the console, 2-WIRE only writes and answers
+ * 0x01 for each byte, 3-WIRE answers the bytes read while writing
+ */
+static uint16_t bulk_write(t_hydra_console *con, void *arg, uint8_t *tx_data,
+			   uint8_t *rx_data, uint16_t nb_data, bool last)
+{
+	const mode_rawwire_exec_t *mode = arg;
+	(void)last;
+
+	if (mode->exec->bulk_write_read != NULL) {
+		mode->exec->bulk_write_read(con, tx_data, rx_data, nb_data);
+	} else {
+		mode->exec->bulk_write(con, tx_data, nb_data);
+		memset(rx_data, 1, nb_data);
+	}
+	return nb_data;
+}
+
+static uint16_t bulk_read(t_hydra_console *con, void *arg, uint8_t *tx_data,
+			  uint8_t *rx_data, uint16_t nb_data, bool last)
+{
+	const mode_rawwire_exec_t *mode = arg;
+	(void)tx_data;
+	(void)last;
+
+	mode->exec->bulk_read(con, rx_data, nb_data);
+	return nb_data;
+}
+
 static void bbio_mode_id(t_hydra_console *con)
 {
 	cprint(con, BBIO_RAWWIRE_HEADER, 4);
@@ -75,9 +111,14 @@ void bbio_mode_rawwire(t_hydra_console *con)
 	uint8_t bbio_subcommand, i;
 	uint8_t rx_data[16], tx_data[16];
 	uint8_t data;
+	uint8_t *bulk_buf;
 	mode_rawwire_exec_t curmode = bbio_twowire;
 	mode_config_proto_t* proto = &con->mode->proto;
 
+	bulk_buf = sbuf_alloc(con, SBUF_RAM, BBIO_SBUF_SIZE);
+	if (bulk_buf == NULL)
+		return;
+
 	curmode.init(con);
 	curmode.pin_init(con);
 	curmode.tim_init(con);
@@ -87,7 +128,7 @@ void bbio_mode_rawwire(t_hydra_console *con)
 	bbio_mode_id(con);
 
 	while (!hydrabus_ubtn()) {
-		if(chnRead(con->sdu, &bbio_subcommand, 1) == 1) {
+		if(cread(con, &bbio_subcommand, 1) == 1) {
 			switch(bbio_subcommand) {
 			case BBIO_RESET:
 				curmode.cleanup(con);
@@ -127,6 +168,14 @@ void bbio_mode_rawwire(t_hydra_console *con)
 				curmode.data_high(con);
 				cprint(con, "\x01", 1);
 				break;
+			case BBIO_RAWWIRE_WRITE_BULK:
+				bbio_bulk(con, bulk_write, &curmode, TRUE, bulk_buf,
+					  BBIO_SBUF_SIZE);
+				break;
+			case BBIO_RAWWIRE_READ_BULK:
+				bbio_bulk(con, bulk_read, &curmode, FALSE, bulk_buf,
+					  BBIO_SBUF_SIZE);
+				break;
 			default:
 				if ((bbio_subcommand & BBIO_AUX_MASK) == BBIO_AUX_MASK) {
 					cprintf(con, "%c", bbio_aux(con, bbio_subcommand));
@@ -135,7 +184,7 @@ void bbio_mode_rawwire(t_hydra_console *con)
 					// write
 					data = (bbio_subcommand & 0b1111) + 1;
 
-					chnRead(con->sdu, tx_data, data);
+					cread(con, tx_data, data);
 					cprint(con, "\x01", 1);
 					for(i=0; i<data; i++) {
 						rx_data[i] = curmode.write_u8(con, tx_data[i]);
@@ -146,7 +195,7 @@ void bbio_mode_rawwire(t_hydra_console *con)
 					// write
 					data = (bbio_subcommand & 0b1111) + 1;
 
-					chnRead(con->sdu, &tx_data[0], 1);
+					cread(con, &tx_data[0], 1);
 					if(proto->config.rawwire.dev_bit_lsb_msb == DEV_FIRSTBIT_MSB) {
 						tx_data[0] = reverse_u8(tx_data[0]);
 					}
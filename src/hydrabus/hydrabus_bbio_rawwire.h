@@ -16,6 +16,8 @@
  * limitations under the License.
  */
 
+#include "hydrabus_mode.h"
+
 #define BBIO_RAWWIRE_HEADER	"RAW1"
 
 void bbio_mode_rawwire(t_hydra_console *con);
@@ -36,4 +38,6 @@ typedef struct mode_rawwire_exec_t {
 	void (*data_high)(t_hydra_console *con);
 	void (*data_low)(t_hydra_console *con);
 	void (*cleanup)(t_hydra_console *con);
+	/* Console mode, for its bulk transfers */
+	const mode_exec_t *exec;
 } mode_rawwire_exec_t;
@@ -55,21 +55,25 @@ void bbio_mode_smartcard(t_hydra_console *con)
 {
 	uint32_t to_rx, to_tx, i;
 	uint8_t bbio_subcommand;
-	uint8_t *tx_data = (uint8_t *)g_sbuf;
-	uint8_t *rx_data = (uint8_t *)g_sbuf+4096;
+	uint8_t *tx_data, *rx_data;
 	uint8_t data;
 	uint32_t dev_speed=0;
 	uint32_t final_baudrate;
 	bsp_status_t status;
 	mode_config_proto_t* proto = &con->mode->proto;
 
+	tx_data = sbuf_alloc(con, SBUF_RAM, BBIO_SBUF_SIZE);
+	if (tx_data == NULL)
+		return;
+	rx_data = tx_data + BBIO_SBUF_SIZE / 2;
+
 	bbio_smartcard_init_proto_default(con);
 	bsp_smartcard_init(proto->dev_num, proto);
 
 	bbio_mode_id(con);
 
 	while (!hydrabus_ubtn()) {
-		if(chnRead(con->sdu, &bbio_subcommand, 1) == 1) {
+		if(cread(con, &bbio_subcommand, 1) == 1) {
 			switch(bbio_subcommand) {
 			case BBIO_RESET:
 				bsp_smartcard_deinit(proto->dev_num);
@@ -87,7 +91,7 @@ void bbio_mode_smartcard(t_hydra_console *con)
 				break;
 			case BBIO_SMARTCARD_PRESCALER:
 				/* Not implemented */
-				chnRead(con->sdu, &data, 1);
+				cread(con, &data, 1);
 				proto->config.smartcard.dev_prescaler = data;
 				status = bsp_smartcard_init(proto->dev_num, proto);
 				if(status == BSP_OK) {
@@ -98,7 +102,7 @@ void bbio_mode_smartcard(t_hydra_console *con)
 				break;
 			case BBIO_SMARTCARD_GUARDTIME:
 				/* Not implemented */
-				chnRead(con->sdu, &data, 1);
+				cread(con, &data, 1);
 				proto->config.smartcard.dev_guardtime = data;
 				status = bsp_smartcard_init(proto->dev_num, proto);
 				if(status == BSP_OK) {
@@ -108,7 +112,7 @@ void bbio_mode_smartcard(t_hydra_console *con)
 				}
 				break;
 			case BBIO_SMARTCARD_WRITE_READ:
-				chnRead(con->sdu, rx_data, 4);
+				cread(con, rx_data, 4);
 				to_tx = (rx_data[0] << 8) + rx_data[1];
 				to_rx = (rx_data[2] << 8) + rx_data[3];
 				if ((to_tx > 4096) || (to_rx > 4096)) {
@@ -116,7 +120,7 @@ void bbio_mode_smartcard(t_hydra_console *con)
 					break;
 				}
 				if(to_tx > 0) {
-					chnRead(con->sdu, tx_data, to_tx);
+					cread(con, tx_data, to_tx);
 					i=0;
 					while(i<to_tx) {
 						if((to_tx-i) >= 255) {
@@ -148,7 +152,7 @@ void bbio_mode_smartcard(t_hydra_console *con)
 				cprint(con, (char *)rx_data, to_rx);
 				break;
 			case BBIO_SMARTCARD_SET_SPEED:
-				chnRead(con->sdu, rx_data, 4);
+				cread(con, rx_data, 4);
 				dev_speed =  rx_data[0] << 24;
 				dev_speed += rx_data[1] << 16;
 				dev_speed += rx_data[2] << 8;
@@ -27,6 +27,22 @@
 #include "hydrabus_bbio_spi.h"
 #include "bsp_spi.h"
 #include "hydrabus_bbio_aux.h"
+#include "hydrabus_bbio_batch.h"
+#include "hydrabus_spi_flash.h"
+#include "hydrabus_avr_isp.h"
+#include "microsd.h"
+
+#define BBIO_SPI_STREAM_CHUNK (BBIO_SBUF_SIZE / 2)
+
+/* BBIO_SPI_FLASH_DUMP flags */
+#define BBIO_SPI_FLASH_DUMP_SD	0b00000001
+
+/* BBIO_SPI_FLASH_DUMP state, passed to the block callback */
+typedef struct {
+	FIL file;
+	bool to_sd;
+	bool sd_error;
+} t_spi_dump;
 
 void bbio_spi_init_proto_default(t_hydra_console *con)
 {
@@ -62,7 +78,7 @@ void bbio_spi_sniff(t_hydra_console *con)
 		return;
 	}
 	cs_state = 1;
-	while(!hydrabus_ubtn() || chnReadTimeout(con->sdu, &data, 1,1)) {
+	while(!hydrabus_ubtn() || cread_timeout(con, &data, 1,1)) {
 		if (cs_state == 0 && bsp_spi_get_cs(BSP_DEV_SPI1)) {
 			cprint(con, "]", 1);
 			cs_state = 1;
@@ -87,6 +103,645 @@ void bbio_spi_sniff(t_hydra_console *con)
 	status = bsp_spi_deinit(BSP_DEV_SPI2);
 }
 
+/*
+ * DMA sniffer: SPI1 (slave) receives MOSI, SPI2 (slave) receives MISO on
+ * its MOSI pin, both share SCK and CS. Bytes are captured in two circular
+ * DMA buffers, CS edges (PA15) are timestamped with the DWT cycle counter
+ * (STM32_HCLK) from the EXTI callback.
+ * Host sends the command, device answers 0x01 (or 0x00 if the sniffer
+ * cannot be started) then streams records until the host sends a byte or
+ * UBTN is pressed. Records are little endian:
+ * - SNIFF_REC_CS_LOW/CS_HIGH, timestamp (32bits)
+ * - SNIFF_REC_DATA, number of pairs (16bits), then MOSI/MISO pairs
+ * - SNIFF_REC_STATUS (every second) and SNIFF_REC_END (last record),
+ *   timestamp, lost bytes and lost CS edges (32bits each)
+ */
+#define SNIFF_REC_CS_LOW	0x01
+#define SNIFF_REC_CS_HIGH	0x02
+#define SNIFF_REC_DATA		0x03
+#define SNIFF_REC_STATUS	0x04
+#define SNIFF_REC_END		0x05
+
+#define SNIFF_CS_LEN		(5)
+#define SNIFF_DATA_LEN(nb)	(3 + 2 * (nb))
+#define SNIFF_STATUS_LEN	(13)
+
+#define SNIFF_RING_SIZE		(16384) /* Power of 2 */
+#define SNIFF_OUT_SIZE		(2048)
+#define SNIFF_NB_EVENTS		(64) /* Power of 2 */
+#define SNIFF_STATUS_PERIOD_MS	(1000)
+
+typedef struct {
+	uint32_t timestamp;
+	uint16_t pos;
+	uint8_t level;
+} t_sniff_event;
+
+typedef struct {
+	t_sniff_event events[SNIFF_NB_EVENTS];
+	volatile uint32_t head;
+	volatile uint32_t tail;
+	volatile uint32_t events_lost;
+} t_sniff;
+
+static t_sniff sniff;
+
+/* Called from ISR context */
+static void sniff_cs_cb(void *arg)
+{
+	t_sniff_event *ev;
+	uint32_t timestamp;
+
+	(void)arg;
+	timestamp = bsp_get_cyclecounter();
+
+	chSysLockFromISR();
+	if(sniff.head - sniff.tail < SNIFF_NB_EVENTS) {
+		ev = &sniff.events[sniff.head & (SNIFF_NB_EVENTS - 1)];
+		ev->timestamp = timestamp;
+		ev->pos = bsp_spi_dma_rx_circular_pos(BSP_DEV_SPI1);
+		ev->level = palReadPad(GPIOA, 15);
+		sniff.head++;
+	} else {
+		sniff.events_lost++;
+	}
+	chSysUnlockFromISR();
+}
+
+static void put_le32(uint8_t *buf, uint32_t value)
+{
+	buf[0] = value;
+	buf[1] = value >> 8;
+	buf[2] = value >> 16;
+	buf[3] = value >> 24;
+}
+
+static uint32_t sniff_put_status(uint8_t *out, uint8_t type, uint32_t lost)
+{
+	out[0] = type;
+	put_le32(&out[1], bsp_get_cyclecounter());
+	put_le32(&out[5], lost);
+	put_le32(&out[9], sniff.events_lost);
+	return SNIFF_STATUS_LEN;
+}
+
+/* Copies up to max pairs from position from, returns the pairs written */
+static uint32_t sniff_put_data(uint8_t *out, uint8_t *mosi, uint8_t *miso,
+			       uint32_t from, uint32_t nb, uint32_t max)
+{
+	uint32_t i, idx;
+
+	if(nb > max)
+		nb = max;
+	out[0] = SNIFF_REC_DATA;
+	out[1] = nb;
+	out[2] = nb >> 8;
+	for(i = 0; i < nb; i++) {
+		idx = (from + i) & (SNIFF_RING_SIZE - 1);
+		out[3 + i * 2] = mosi[idx];
+		out[3 + i * 2 + 1] = miso[idx];
+	}
+	return nb;
+}
+
+static void bbio_spi_sniff_dma(t_hydra_console *con)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	t_sniff_event *ev;
+	uint8_t *mosi, *miso, *out;
+	uint8_t data;
+	uint32_t out_len, room, consumed, avail, count, ev_count, lost, nb;
+	uint32_t head;
+	systime_t last_status;
+	bsp_status_t status;
+	bool active;
+
+	mosi = sbuf_alloc(con, SBUF_RAM, 2 * SNIFF_RING_SIZE + SNIFF_OUT_SIZE);
+	if(mosi == NULL) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+	miso = mosi + SNIFF_RING_SIZE;
+	out = miso + SNIFF_RING_SIZE;
+
+	proto->config.spi.dev_mode = DEV_SLAVE;
+	status = bsp_spi_init(BSP_DEV_SPI1, proto);
+	if(status == BSP_OK)
+		status = bsp_spi_init(BSP_DEV_SPI2, proto);
+	if(status == BSP_OK)
+		status = bsp_spi_dma_rx_circular_start(BSP_DEV_SPI1, mosi,
+						       SNIFF_RING_SIZE);
+	if(status == BSP_OK)
+		status = bsp_spi_dma_rx_circular_start(BSP_DEV_SPI2, miso,
+						       SNIFF_RING_SIZE);
+	if(status != BSP_OK) {
+		cprint(con, "\x00", 1);
+		goto exit;
+	}
+
+	/* CS is only sampled, never driven */
+	sniff.head = 0;
+	sniff.tail = 0;
+	sniff.events_lost = 0;
+	palSetPadMode(GPIOA, 15, PAL_MODE_INPUT);
+	palEnablePadEvent(GPIOA, 15, PAL_EVENT_MODE_BOTH_EDGES);
+	palSetPadCallback(GPIOA, 15, sniff_cs_cb, NULL);
+
+	cprint(con, "\x01", 1);
+
+	consumed = 0;
+	lost = 0;
+	out_len = 0;
+	last_status = chVTGetSystemTime();
+	while(!hydrabus_ubtn()) {
+		/* Events read first, their position is before count */
+		head = sniff.head;
+		/* A pair is complete once both channels received it */
+		count = bsp_spi_dma_rx_circular_count(BSP_DEV_SPI1);
+		avail = bsp_spi_dma_rx_circular_count(BSP_DEV_SPI2);
+		if((int32_t)(avail - count) > 0)
+			avail = count;
+		if(avail - consumed > SNIFF_RING_SIZE) {
+			lost += avail - consumed;
+			consumed = avail;
+		}
+		active = FALSE;
+
+		/* CS edges, with the data received before them */
+		while(sniff.tail != head) {
+			room = SNIFF_OUT_SIZE - SNIFF_STATUS_LEN - out_len;
+			if(room < SNIFF_DATA_LEN(1) + SNIFF_CS_LEN)
+				break;
+			ev = &sniff.events[sniff.tail & (SNIFF_NB_EVENTS - 1)];
+			ev_count = count - ((count - ev->pos) & (SNIFF_RING_SIZE - 1));
+			if((int32_t)(ev_count - avail) > 0)
+				break;
+			if((int32_t)(ev_count - consumed) > 0) {
+				nb = sniff_put_data(&out[out_len], mosi, miso,
+						    consumed, ev_count - consumed,
+						    (room - SNIFF_DATA_LEN(0) - SNIFF_CS_LEN) / 2);
+				out_len += SNIFF_DATA_LEN(nb);
+				consumed += nb;
+				active = TRUE;
+				if(consumed != ev_count)
+					break;
+			}
+			out[out_len] = ev->level ? SNIFF_REC_CS_HIGH : SNIFF_REC_CS_LOW;
+			put_le32(&out[out_len + 1], ev->timestamp);
+			out_len += SNIFF_CS_LEN;
+			sniff.tail++;
+			active = TRUE;
+		}
+
+		/* Data received since the last CS edge */
+		room = SNIFF_OUT_SIZE - SNIFF_STATUS_LEN - out_len;
+		if(avail != consumed && room >= SNIFF_DATA_LEN(1)) {
+			nb = sniff_put_data(&out[out_len], mosi, miso, consumed,
+					    avail - consumed,
+					    (room - SNIFF_DATA_LEN(0)) / 2);
+			out_len += SNIFF_DATA_LEN(nb);
+			consumed += nb;
+			active = TRUE;
+		}
+
+		if(chVTTimeElapsedSinceX(last_status) >= TIME_MS2I(SNIFF_STATUS_PERIOD_MS)) {
+			out_len += sniff_put_status(&out[out_len],
+						    SNIFF_REC_STATUS, lost);
+			last_status = chVTGetSystemTime();
+		}
+
+		/* Send in bulk, or what is pending once the bus is idle */
+		if(out_len > SNIFF_OUT_SIZE / 2 || (!active && out_len > 0)) {
+			cprint(con, (char *)out, out_len);
+			out_len = 0;
+		}
+		if(!active) {
+			if(cread_timeout(con, &data, 1, TIME_IMMEDIATE) == 1)
+				break;
+			chThdSleepMilliseconds(1);
+		}
+	}
+
+	palDisablePadEvent(GPIOA, 15);
+	out_len += sniff_put_status(&out[out_len], SNIFF_REC_END, lost);
+	cprint(con, (char *)out, out_len);
+
+exit:
+	bsp_spi_dma_rx_circular_stop(BSP_DEV_SPI1);
+	bsp_spi_dma_rx_circular_stop(BSP_DEV_SPI2);
+	proto->config.spi.dev_mode = DEV_MASTER;
+	bsp_spi_init(BSP_DEV_SPI1, proto);
+	bsp_spi_deinit(BSP_DEV_SPI2);
+	sbuf_free(con, mosi);
+}
+
+/* Start a transfer, polled if the DMA is not available */
+static bsp_status_t stream_start(bsp_dev_spi_t dev_num, uint8_t *tx_data,
+				 uint8_t *rx_data, uint32_t nb_data, bool *dma)
+{
+	*dma = (bsp_spi_dma_start(dev_num, tx_data, rx_data, nb_data,
+				  NULL, NULL) == BSP_OK);
+	if(*dma)
+		return BSP_OK;
+	if(tx_data != NULL)
+		return bsp_spi_write_u8(dev_num, tx_data, nb_data);
+	return bsp_spi_read_u8(dev_num, rx_data, nb_data);
+}
+
+static bsp_status_t stream_wait(bsp_dev_spi_t dev_num, bool dma,
+				bsp_status_t status)
+{
+	if(dma)
+		return bsp_spi_dma_wait(dev_num);
+	return status;
+}
+
+/*
+ * Write-then-read without size limit, CS is held low for the whole
+ * transfer.
+ * Host sends to_tx and to_rx (32bits big endian) then the to_tx bytes.
+ * Device answers 0x01 (or 0x00 if the command is rejected), the to_rx
+ * bytes, then 0x01 if all SPI transfers succeeded else 0x00.
+ * If fewer than to_tx bytes are received, the transfer is aborted and
+ * 0x00 is sent instead of the to_rx bytes.
+ * USB transfers and SPI transfers are overlapped using two halves of
+ * the BBIO scratch buffer.
+ */
+static void bbio_spi_write_read_stream(t_hydra_console *con, uint8_t *buf)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	uint8_t *chunk[2];
+	uint8_t hdr[8];
+	uint32_t to_tx, to_rx, len, next_len;
+	bsp_status_t status, xfer_status;
+	bool dma;
+	int cur;
+
+	chunk[0] = buf;
+	chunk[1] = buf + BBIO_SPI_STREAM_CHUNK;
+
+	if(cread(con, hdr, 8) != 8) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+	to_tx = (hdr[0] << 24) + (hdr[1] << 16) + (hdr[2] << 8) + hdr[3];
+	to_rx = (hdr[4] << 24) + (hdr[5] << 16) + (hdr[6] << 8) + hdr[7];
+	cprint(con, "\x01", 1);
+
+	status = BSP_OK;
+	xfer_status = BSP_OK;
+	dma = FALSE;
+	bsp_spi_select(proto->dev_num);
+
+	/* Receive the next chunk from USB while the current one is sent */
+	cur = 0;
+	len = (to_tx > BBIO_SPI_STREAM_CHUNK) ? BBIO_SPI_STREAM_CHUNK : to_tx;
+	if(len > 0 && cread(con, chunk[cur], len) != len)
+		goto abort;
+	while(len > 0) {
+		xfer_status = stream_start(proto->dev_num, chunk[cur], NULL,
+					   len, &dma);
+		to_tx -= len;
+		next_len = (to_tx > BBIO_SPI_STREAM_CHUNK) ? BBIO_SPI_STREAM_CHUNK : to_tx;
+		if(next_len > 0 && cread(con, chunk[!cur], next_len) != next_len) {
+			stream_wait(proto->dev_num, dma, xfer_status);
+			goto abort;
+		}
+		xfer_status = stream_wait(proto->dev_num, dma, xfer_status);
+		if(xfer_status != BSP_OK)
+			status = xfer_status;
+		cur = !cur;
+		len = next_len;
+	}
+
+	/* Send the previous chunk to USB while the next one is read */
+	len = (to_rx > BBIO_SPI_STREAM_CHUNK) ? BBIO_SPI_STREAM_CHUNK : to_rx;
+	if(len > 0)
+		xfer_status = stream_start(proto->dev_num, NULL, chunk[cur],
+					   len, &dma);
+	while(len > 0) {
+		xfer_status = stream_wait(proto->dev_num, dma, xfer_status);
+		if(xfer_status != BSP_OK)
+			status = xfer_status;
+		to_rx -= len;
+		next_len = (to_rx > BBIO_SPI_STREAM_CHUNK) ? BBIO_SPI_STREAM_CHUNK : to_rx;
+		if(next_len > 0)
+			xfer_status = stream_start(proto->dev_num, NULL,
+						   chunk[!cur], next_len, &dma);
+		cprint(con, (char *)chunk[cur], len);
+		cur = !cur;
+		len = next_len;
+	}
+
+	bsp_spi_unselect(proto->dev_num);
+
+	if(status == BSP_OK) {
+		cprint(con, "\x01", 1);
+	} else {
+		cprint(con, "\x00", 1);
+	}
+	return;
+
+abort:
+	bsp_spi_unselect(proto->dev_num);
+	cprint(con, "\x00", 1);
+}
+
+static void batch_select(t_hydra_console *con)
+{
+	bsp_spi_select(con->mode->proto.dev_num);
+}
+
+static void batch_unselect(t_hydra_console *con)
+{
+	bsp_spi_unselect(con->mode->proto.dev_num);
+}
+
+static bool batch_write(t_hydra_console *con, uint8_t *tx_data,
+			uint16_t nb_data)
+{
+	return bsp_spi_write_u8(con->mode->proto.dev_num, tx_data,
+				nb_data) == BSP_OK;
+}
+
+static bool batch_read(t_hydra_console *con, uint8_t *rx_data,
+		       uint16_t nb_data)
+{
+	return bsp_spi_read_u8(con->mode->proto.dev_num, rx_data,
+			       nb_data) == BSP_OK;
+}
+
+static bool batch_write_read(t_hydra_console *con, uint8_t *tx_data,
+			     uint8_t *rx_data, uint16_t nb_data)
+{
+	return bsp_spi_write_read_u8(con->mode->proto.dev_num, tx_data,
+				     rx_data, nb_data) == BSP_OK;
+}
+
+static const t_bbio_batch_ops batch_ops = {
+	.select = batch_select,
+	.unselect = batch_unselect,
+	.write = batch_write,
+	.read = batch_read,
+	.write_read = batch_write_read,
+};
+
+static void put_u32(uint8_t *buf, uint32_t value)
+{
+	buf[0] = value >> 24;
+	buf[1] = value >> 16;
+	buf[2] = value >> 8;
+	buf[3] = value;
+}
+
+/*
+ * Device answers 0x00 if no flash is found, else 0x01, the JEDEC ID
+ * (3 bytes), flags (bit0: geometry from SFDP, bit1: 4 bytes addresses),
+ * the size and the smallest erase size (32bits big endian, 0 if unknown).
+ */
+static void bbio_spi_flash_id(t_hydra_console *con)
+{
+	t_spi_flash flash;
+	uint8_t answer[13];
+
+	if (!spi_flash_probe(con, &flash)) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+	answer[0] = 0x01;
+	memcpy(&answer[1], flash.jedec_id, 3);
+	answer[4] = (flash.sfdp ? 0b01 : 0) |
+		    ((flash.addr_bytes == 4) ? 0b10 : 0);
+	put_u32(&answer[5], flash.size);
+	put_u32(&answer[9], flash.erase_size);
+	cprint(con, (char *)answer, 13);
+}
+
+static bool dump_block(t_hydra_console *con, uint8_t *data, uint32_t nb_data,
+		       void *arg)
+{
+	t_spi_dump *dump = arg;
+	uint8_t crc[4];
+	UINT written;
+
+	put_u32(crc, spi_flash_crc32(0, data, nb_data));
+	if (dump->to_sd) {
+		if (!dump->sd_error &&
+		    (f_write(&dump->file, data, nb_data, &written) != FR_OK ||
+		     written != nb_data))
+			dump->sd_error = TRUE;
+	} else {
+		cprint(con, (char *)data, nb_data);
+	}
+	cprint(con, (char *)crc, 4);
+	/* Never abort, the host expects the whole range */
+	return TRUE;
+}
+
+/*
+ * Continuous fast read of a flash range.
+ * Host sends the address and length (32bits big endian) then flags.
+ * Device answers 0x00 if the command is rejected, else 0x01, then for
+ * each 4KB block the data (unless dumped to microSD) and its CRC32
+ * (big endian, as zlib), then 0x01 if the dump succeeded else 0x00.
+ */
+static void bbio_spi_flash_dump(t_hydra_console *con, uint8_t *buf)
+{
+	t_spi_flash flash;
+	t_spi_dump dump;
+	uint8_t hdr[9];
+	uint32_t addr, len;
+	bsp_status_t status;
+
+	if (cread(con, hdr, 9) != 9) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+	addr = (hdr[0] << 24) + (hdr[1] << 16) + (hdr[2] << 8) + hdr[3];
+	len = (hdr[4] << 24) + (hdr[5] << 16) + (hdr[6] << 8) + hdr[7];
+	dump.to_sd = (hdr[8] & BBIO_SPI_FLASH_DUMP_SD) ? TRUE : FALSE;
+	dump.sd_error = FALSE;
+
+	if (!spi_flash_probe(con, &flash) ||
+	    !spi_flash_check_range(&flash, addr, len)) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+	if (dump.to_sd) {
+		if (!file_open(&dump.file, "spi_dump.bin", 'w')) {
+			cprint(con, "\x00", 1);
+			return;
+		}
+		/* Overwrites a previous dump */
+		if (!file_preallocate(&dump.file, len)) {
+			file_close(&dump.file);
+			cprint(con, "\x00", 1);
+			return;
+		}
+	}
+	cprint(con, "\x01", 1);
+
+	status = spi_flash_dump(con, &flash, addr, len, buf, dump_block, &dump);
+
+	if (dump.to_sd && !file_close(&dump.file))
+		dump.sd_error = TRUE;
+	if (status == BSP_OK && !dump.sd_error) {
+		cprint(con, "\x01", 1);
+	} else {
+		cprint(con, "\x00", 1);
+	}
+}
+
+/*
+ * Writes flash pages or EEPROM bytes.
+ * Host sends the memory (AVR_ISP_MEM_x), address and length (32bits big
+ * endian) and the flash page size (16bits big endian).
+ * Device answers 0x00 if the command is rejected, else 0x01, then the
+ * host sends the data, device answers 0x01 once written else 0x00.
+ * Flash writes shall start on a page boundary, the last page is padded
+ * with 0xFF.
+ */
+static void bbio_spi_avr_write(t_hydra_console *con, t_avr_isp *isp,
+			       uint8_t *buf)
+{
+	uint8_t *data = buf + BBIO_SBUF_SIZE / 2;
+	uint8_t hdr[11];
+	uint32_t addr, len, chunk;
+	uint16_t page_size;
+	bool ok;
+
+	if (cread(con, hdr, 11) != 11) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+	addr = (hdr[1] << 24) + (hdr[2] << 16) + (hdr[3] << 8) + hdr[4];
+	len = (hdr[5] << 24) + (hdr[6] << 16) + (hdr[7] << 8) + hdr[8];
+	page_size = (hdr[9] << 8) + hdr[10];
+
+	if (hdr[0] == AVR_ISP_MEM_FLASH) {
+		ok = (page_size > 0 && page_size <= AVR_ISP_MAX_PAGE_SIZE &&
+		      (page_size & 1) == 0 && (addr % page_size) == 0);
+	} else {
+		ok = (hdr[0] == AVR_ISP_MEM_EEPROM);
+		page_size = AVR_ISP_BURST_SIZE;
+	}
+	if (!ok) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+	cprint(con, "\x01", 1);
+
+	while (len > 0) {
+		chunk = (len > page_size) ? page_size : len;
+		cread(con, data, chunk);
+		len -= chunk;
+		/* On error, the remaining data is read to stay in sync */
+		if (!ok)
+			continue;
+		if (hdr[0] == AVR_ISP_MEM_FLASH) {
+			memset(&data[chunk], 0xFF, page_size - chunk);
+			ok = avr_isp_write_flash_page(isp, addr, data, page_size,
+						      buf);
+		} else {
+			ok = avr_isp_write_eeprom(isp, addr, data, chunk);
+		}
+		addr += chunk;
+	}
+
+	cprint(con, ok ? "\x01" : "\x00", 1);
+}
+
+/*
+ * AVR serial programming, RESET is driven with CS.
+ * Each subcommand is acked with 0x01 (0x00 if unknown), then answers:
+ * - PROG_ENABLE, CHIP_ERASE: 0x01 on success else 0x00
+ * - READ: word address and length (32bits big endian), 0x01 then the
+ *   flash data, 0x00 if above 4KB (kept for compatibility)
+ * - READ_INFO: signature (3 bytes), low, high, extended fuses and lock
+ * - WRITE_FUSE: fuse (AVR_ISP_FUSE_x/AVR_ISP_LOCK) and value, 0x01 on
+ *   success else 0x00
+ * - READ_MEM: memory, address and length, 0x01 then the data
+ * - WRITE_MEM: see bbio_spi_avr_write()
+ * - CRC: memory, address and length, 0x01 then CRC32 (big endian)
+ */
+static void bbio_spi_avr(t_hydra_console *con, t_avr_isp *isp, uint8_t *buf)
+{
+	uint8_t *data = buf + BBIO_SBUF_SIZE / 2;
+	uint8_t subcommand, hdr[9], info[3 + AVR_ISP_NB_FUSES];
+	uint32_t addr, len, chunk;
+	bool ok;
+
+	cprint(con, "\x01", 1);
+	cread(con, &subcommand, 1);
+	switch (subcommand) {
+	case BBIO_SPI_AVR_NULL:
+		cprint(con, "\x01", 1);
+		break;
+	case BBIO_SPI_AVR_VERSION:
+		cprint(con, "\x01\x00\x02", 3);
+		break;
+	case BBIO_SPI_AVR_READ:
+		cread(con, hdr, 8);
+		addr = (hdr[0] << 24) + (hdr[1] << 16) + (hdr[2] << 8) + hdr[3];
+		len = (hdr[4] << 24) + (hdr[5] << 16) + (hdr[6] << 8) + hdr[7];
+		if ((addr > 4096) || (len > 4096) || (addr + len > 4096)) {
+			cprint(con, "\x00", 1);
+			break;
+		}
+		cprint(con, "\x01", 1);
+		avr_isp_read(isp, AVR_ISP_MEM_FLASH, addr * 2, data, len, buf);
+		cprint(con, (char *)data, len);
+		break;
+	case BBIO_SPI_AVR_PROG_ENABLE:
+		ok = avr_isp_program_enable(isp);
+		cprint(con, ok ? "\x01" : "\x00", 1);
+		break;
+	case BBIO_SPI_AVR_CHIP_ERASE:
+		ok = avr_isp_chip_erase(isp);
+		cprint(con, ok ? "\x01" : "\x00", 1);
+		break;
+	case BBIO_SPI_AVR_READ_INFO:
+		avr_isp_read_signature(isp, info);
+		avr_isp_read_fuses(isp, &info[3]);
+		cprint(con, (char *)info, sizeof(info));
+		break;
+	case BBIO_SPI_AVR_WRITE_FUSE:
+		cread(con, hdr, 2);
+		ok = avr_isp_write_fuse(isp, hdr[0], hdr[1]);
+		cprint(con, ok ? "\x01" : "\x00", 1);
+		break;
+	case BBIO_SPI_AVR_READ_MEM:
+	case BBIO_SPI_AVR_CRC:
+		cread(con, hdr, 9);
+		addr = (hdr[1] << 24) + (hdr[2] << 16) + (hdr[3] << 8) + hdr[4];
+		len = (hdr[5] << 24) + (hdr[6] << 16) + (hdr[7] << 8) + hdr[8];
+		if (hdr[0] != AVR_ISP_MEM_FLASH && hdr[0] != AVR_ISP_MEM_EEPROM) {
+			cprint(con, "\x00", 1);
+			break;
+		}
+		cprint(con, "\x01", 1);
+		if (subcommand == BBIO_SPI_AVR_CRC) {
+			put_u32(hdr, avr_isp_crc32(isp, hdr[0], addr, len, buf));
+			cprint(con, (char *)hdr, 4);
+			break;
+		}
+		while (len > 0) {
+			chunk = (len > BBIO_SBUF_SIZE / 2) ? BBIO_SBUF_SIZE / 2 : len;
+			avr_isp_read(isp, hdr[0], addr, data, chunk, buf);
+			cprint(con, (char *)data, chunk);
+			addr += chunk;
+			len -= chunk;
+		}
+		break;
+	case BBIO_SPI_AVR_WRITE_MEM:
+		bbio_spi_avr_write(con, isp, buf);
+		break;
+	default:
+		cprint(con, "\x00", 1);
+		break;
+	}
+}
+
 static void bbio_mode_id(t_hydra_console *con)
 {
 	cprint(con, BBIO_SPI_HEADER, 4);
@@ -96,19 +751,25 @@ void bbio_mode_spi(t_hydra_console *con)
 {
 	uint8_t bbio_subcommand;
 	uint32_t to_rx, to_tx, i;
-	uint8_t *tx_data = (uint8_t *)g_sbuf;
-	uint8_t *rx_data = (uint8_t *)g_sbuf+4096;
+	uint8_t *tx_data, *rx_data;
 	uint8_t data;
 	bsp_status_t status;
+	t_avr_isp avr_isp;
 	mode_config_proto_t* proto = &con->mode->proto;
 
+	tx_data = sbuf_alloc(con, SBUF_RAM, BBIO_SBUF_SIZE);
+	if (tx_data == NULL)
+		return;
+	rx_data = tx_data + BBIO_SBUF_SIZE / 2;
+
 	bbio_spi_init_proto_default(con);
 	bsp_spi_init(proto->dev_num, proto);
+	avr_isp_init(&avr_isp, proto->dev_num);
 
 	bbio_mode_id(con);
 
 	while (!hydrabus_ubtn()) {
-		if(chnRead(con->sdu, &bbio_subcommand, 1) == 1) {
+		if(cread(con, &bbio_subcommand, 1) == 1) {
 			switch(bbio_subcommand) {
 			case BBIO_RESET:
 				bsp_spi_deinit(proto->dev_num);
@@ -131,7 +792,7 @@ void bbio_mode_spi(t_hydra_console *con)
 				break;
 			case BBIO_SPI_WRITE_READ:
 			case BBIO_SPI_WRITE_READ_NCS:
-				chnRead(con->sdu, rx_data, 4);
+				cread(con, rx_data, 4);
 				to_tx = (rx_data[0] << 8) + rx_data[1];
 				to_rx = (rx_data[2] << 8) + rx_data[3];
 				if ((to_tx > 4096) || (to_rx > 4096)) {
@@ -142,33 +803,13 @@ void bbio_mode_spi(t_hydra_console *con)
 					bsp_spi_select(proto->dev_num);
 				}
 				if(to_tx > 0) {
-					chnRead(con->sdu, tx_data, to_tx);
-					i=0;
-					while(i<to_tx) {
-						if((to_tx-i) >= 255) {
-							bsp_spi_write_u8(proto->dev_num,
-									tx_data+i,
-									255);
-						} else {
-							bsp_spi_write_u8(proto->dev_num,
-									tx_data+i,
-									to_tx-i);
-						}
-						i+=255;
-					}
+					cread(con, tx_data, to_tx);
+					bsp_spi_write_u8(proto->dev_num, tx_data,
+							 to_tx);
 				}
-				i=0;
-				while(i<to_rx) {
-					if((to_rx-i) >= 255) {
-						bsp_spi_read_u8(proto->dev_num,
-						                rx_data+i,
-						                255);
-					} else {
-						bsp_spi_read_u8(proto->dev_num,
-						                rx_data+i,
-						                to_rx-i);
-					}
-					i+=255;
+				if(to_rx > 0) {
+					bsp_spi_read_u8(proto->dev_num, rx_data,
+							to_rx);
 				}
 				if(bbio_subcommand == BBIO_SPI_WRITE_READ) {
 					bsp_spi_unselect(proto->dev_num);
@@ -176,73 +817,24 @@ void bbio_mode_spi(t_hydra_console *con)
 				cprint(con, "\x01", 1);
 				cprint(con, (char *)rx_data, to_rx);
 				break;
+			case BBIO_SPI_WRITE_READ_STREAM:
+				bbio_spi_write_read_stream(con, tx_data);
+				break;
+			case BBIO_SPI_SNIFF_DMA:
+				bbio_spi_sniff_dma(con);
+				break;
+			case BBIO_SPI_FLASH_ID:
+				bbio_spi_flash_id(con);
+				break;
+			case BBIO_SPI_FLASH_DUMP:
+				bbio_spi_flash_dump(con, tx_data);
+				break;
+			case BBIO_SPI_BATCH:
+				bbio_batch(con, &batch_ops, tx_data,
+					   BBIO_SBUF_SIZE);
+				break;
 			case BBIO_SPI_AVR:
-				cprint(con, "\x01", 1);
-				// data contains the subcommand in AVR mode
-				chnRead(con->sdu, &data, 1);
-				switch(data) {
-				case BBIO_SPI_AVR_NULL:
-					cprint(con, "\x01", 1);
-					break;
-				case BBIO_SPI_AVR_VERSION:
-					cprint(con, "\x01\x00\x01", 3);
-					break;
-				case BBIO_SPI_AVR_READ:
-					// to_tx contains the base address
-					chnRead(con->sdu, rx_data, 4);
-					to_tx =(rx_data[0]<<24) + (rx_data[1]<<16);
-					to_tx +=(rx_data[2]<<8) + rx_data[3];
-					// to_tx contains the number of bytes to
-					// read
-					chnRead(con->sdu, rx_data, 4);
-					to_rx =(rx_data[0]<<24) + (rx_data[1]<<16);
-					to_rx +=(rx_data[2]<<8) + rx_data[3];
-
-					if ((to_tx > 4096) || (to_rx > 4096) ||
-					    (to_tx + to_rx > 4096)) {
-						cprint(con, "\x00", 1);
-						break;
-					}
-
-					cprint(con, "\x01", 1);
-
-					for(i=to_tx; to_rx>0; i++) {
-						// Fetch low byte
-						data = 0x20;
-						bsp_spi_write_u8(proto->dev_num,
-								 &data, 1);
-						data = i>>8;
-						bsp_spi_write_u8(proto->dev_num,
-								 &data, 1);
-						data = i&0xff;
-						bsp_spi_write_u8(proto->dev_num,
-								 &data, 1);
-						bsp_spi_read_u8(proto->dev_num,
-								&data, 1);
-						cprint(con, (char *)&data, 1);
-						to_rx--;
-
-						if(to_rx == 0) break;
-
-						data = 0x28;
-						bsp_spi_write_u8(proto->dev_num,
-								 &data, 1);
-						data = i>>8;
-						bsp_spi_write_u8(proto->dev_num,
-								 &data, 1);
-						data = i&0xff;
-						bsp_spi_write_u8(proto->dev_num,
-								 &data, 1);
-						bsp_spi_read_u8(proto->dev_num,
-								&data, 1);
-						cprint(con, (char *)&data, 1);
-						to_rx--;
-					}
-					break;
-				default:
-					cprint(con, "\x00", 1);
-					break;
-				}
+				bbio_spi_avr(con, &avr_isp, tx_data);
 				break;
 
 			default:
@@ -254,7 +846,7 @@ void bbio_mode_spi(t_hydra_console *con)
 					data = (bbio_subcommand & 0b1111) + 1;
 					cprint(con, "\x01", 1);
 
-					chnRead(con->sdu, tx_data, data);
+					cread(con, tx_data, data);
 					bsp_spi_write_read_u8(proto->dev_num,
 					                      tx_data,
 					                      rx_data,
@@ -277,6 +869,7 @@ void bbio_mode_spi(t_hydra_console *con)
 					proto->config.spi.dev_phase = (bbio_subcommand & 0b10)?0:1;
 					proto->dev_num = (bbio_subcommand & 0b1)?BSP_DEV_SPI1:BSP_DEV_SPI2;
 					status = bsp_spi_init(proto->dev_num, proto);
+					avr_isp_init(&avr_isp, proto->dev_num);
 					if(status == BSP_OK) {
 						cprint(con, "\x01", 1);
 					} else {
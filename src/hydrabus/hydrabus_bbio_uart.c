@@ -46,22 +46,18 @@ static THD_FUNCTION(uart_reader_thread, arg)
 	con = arg;
 	chRegSetThreadName("UART reader");
 	chThdSleepMilliseconds(10);
-	uint8_t bytes_read;
+	uint32_t bytes_read;
 	mode_config_proto_t* proto = &con->mode->proto;
 
 	while (!hydrabus_ubtn()) {
 		if(!chThdShouldTerminateX())
 		{
-			if(bsp_uart_rxne(proto->dev_num)) {
-				bytes_read = bsp_uart_read_u8_timeout(proto->dev_num,
-											proto->buffer_rx,
-											UART_BRIDGE_BUFF_SIZE,
-											TIME_US2I(100));
-				if(bytes_read > 0) {
-					cprint(con, (char *)proto->buffer_rx, bytes_read);
-				}
-			} else {
-				chThdYield();
+			bytes_read = bsp_uart_rx_dma_read(proto->dev_num,
+							  proto->buffer_rx,
+							  sizeof(proto->buffer_rx),
+							  TIME_MS2I(10));
+			if(bytes_read > 0) {
+				cprint(con, (char *)proto->buffer_rx, bytes_read);
 			}
 		} else
 		{
@@ -70,6 +66,26 @@ static THD_FUNCTION(uart_reader_thread, arg)
 	}
 }
 
+static thread_t *uart_reader_start(t_hydra_console *con)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+
+	if(bsp_uart_rx_dma_start(proto->dev_num) != BSP_OK)
+		return NULL;
+
+	return chThdCreateFromHeap(NULL, CONSOLE_WA_SIZE, "uart_reader",
+				   NORMALPRIO, uart_reader_thread, con);
+}
+
+static void uart_reader_stop(t_hydra_console *con, thread_t *rthread)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+
+	chThdTerminate(rthread);
+	chThdWait(rthread);
+	bsp_uart_rx_dma_stop(proto->dev_num);
+}
+
 static void bbio_mode_id(t_hydra_console *con)
 {
 	cprint(con, BBIO_UART_HEADER, 4);
@@ -92,9 +108,11 @@ void bbio_mode_uart(t_hydra_console *con)
 	bbio_mode_id(con);
 
 	while (!hydrabus_ubtn()) {
-		if(chnRead(con->sdu, &bbio_subcommand, 1) == 1) {
+		if(cread(con, &bbio_subcommand, 1) == 1) {
 			switch(bbio_subcommand) {
 			case BBIO_RESET:
+				if(rthread != NULL)
+					uart_reader_stop(con, rthread);
 				bsp_uart_deinit(proto->dev_num);
 				return;
 			case BBIO_MODE_ID:
@@ -103,26 +121,24 @@ void bbio_mode_uart(t_hydra_console *con)
 			case BBIO_UART_START_ECHO:
 				if(rthread == NULL)
 				{
-					rthread = chThdCreateFromHeap(NULL,
-								      CONSOLE_WA_SIZE,
-								      "uart_reader",
-								      NORMALPRIO,
-								      uart_reader_thread,
-								      con);
+					rthread = uart_reader_start(con);
+				}
+				if(rthread != NULL) {
+					cprint(con, "\x01", 1);
+				} else {
+					cprint(con, "\x00", 1);
 				}
-				cprint(con, "\x01", 1);
 				break;
 			case BBIO_UART_STOP_ECHO:
 				if(rthread != NULL)
 				{
-					chThdTerminate(rthread);
-					chThdWait(rthread);
+					uart_reader_stop(con, rthread);
 					rthread = NULL;
 				}
 				cprint(con, "\x01", 1);
 				break;
 			case BBIO_UART_BAUD_RATE:
-				chnRead(con->sdu, rx_data, 4);
+				cread(con, rx_data, 4);
 				baud_rate =(rx_data[0]<<24) + (rx_data[1]<<16);
 				baud_rate +=(rx_data[2]<<8) + rx_data[3];
 				proto->config.uart.dev_speed = baud_rate;
@@ -136,24 +152,18 @@ void bbio_mode_uart(t_hydra_console *con)
 			case BBIO_UART_BRIDGE:
 				if(rthread == NULL)
 				{
-					rthread = chThdCreateFromHeap(NULL,
-								      CONSOLE_WA_SIZE,
-								      "uart_reader",
-								      NORMALPRIO,
-								      uart_reader_thread,
-								      con);
+					rthread = uart_reader_start(con);
 				}
 				while(!hydrabus_ubtn()) {
-					data = chnReadTimeout(con->sdu, proto->buffer_tx,
-								    UART_BRIDGE_BUFF_SIZE, TIME_US2I(100));
+					data = cread_timeout(con, proto->buffer_tx,
+							    UART_BRIDGE_BUFF_SIZE, TIME_US2I(100));
 					if(data > 0) {
 						bsp_uart_write_u8(proto->dev_num, proto->buffer_tx, data);
 					}
 				}
 				if(rthread != NULL)
 				{
-					chThdTerminate(rthread);
-					chThdWait(rthread);
+					uart_reader_stop(con, rthread);
 					rthread = NULL;
 				}
 				cprint(con, "\x01", 1);
@@ -168,7 +178,7 @@ void bbio_mode_uart(t_hydra_console *con)
 
 					i=0;
 					while(i < data) {
-						chnRead(con->sdu, &tx_data, 1);
+						cread(con, &tx_data, 1);
 						bsp_uart_write_u8(proto->dev_num,
 								  &tx_data, 1);
 						cprint(con, "\x01", 1);
@@ -251,8 +261,7 @@ void bbio_mode_uart(t_hydra_console *con)
 	}
 	if(rthread != NULL)
 	{
-		chThdTerminate(rthread);
-		chThdWait(rthread);
+		uart_reader_stop(con, rthread);
 		rthread = NULL;
 	}
 }
@@ -31,7 +31,10 @@ int cmd_freq(t_hydra_console *con, t_tokenline_parsed *p)
 	mode_config_proto_t* proto = &con->mode->proto;
 	(void) p;
 
-	bsp_freq_get_values(proto->dev_num, &frequency, &duty);
+	if(bsp_freq_get_values(proto->dev_num, &frequency, &duty) == FALSE) {
+		frequency = 0;
+		duty = 0;
+	}
 	cprintf(con, "Frequency : %dHz\r\n", frequency);
 	cprintf(con, "Duty : %d%%\r\n", duty);
 	cprintf(con, "\r\n");
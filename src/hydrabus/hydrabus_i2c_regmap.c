@@ -0,0 +1,167 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hydrabus_i2c_regmap.h"
+
+/**
+ * @brief   Prepares a register map
+ * @note    A write transaction sets the register address then writes the
+ *          data from there, a read transaction reads from the current
+ *          register. The register is incremented after each byte, like a
+ *          24Cxx EEPROM.
+ *
+ * @param[out] rm		register map
+ * @param[in] map		register values
+ * @param[in] size		map size in bytes, up to 65536
+ * @param[in] addr_bytes	register address bytes, 1 or 2
+ * @param[in] page		auto increment wraps in a page, 0: in the map
+ * @param[in] read_only		writes are logged but not applied
+ * @param[in] log		write log
+ * @param[in] log_len		write log entries, power of 2
+ */
+void i2c_regmap_init(t_i2c_regmap *rm, uint8_t *map, uint32_t size,
+		     uint8_t addr_bytes, uint16_t page, bool read_only,
+		     t_i2c_regmap_log *log, uint32_t log_len)
+{
+	rm->map = map;
+	rm->size = size;
+	rm->addr_bytes = addr_bytes;
+	rm->page = page;
+	rm->read_only = read_only;
+	rm->reg = 0;
+	rm->addr_count = 0;
+	rm->logged = false;
+	rm->log = log;
+	rm->log_len = log_len;
+	rm->log_head = 0;
+	rm->log_tail = 0;
+	rm->log_lost = 0;
+	rm->nb_reads = 0;
+	rm->nb_writes = 0;
+}
+
+static inline uint16_t next_reg(t_i2c_regmap *rm, uint16_t reg)
+{
+	if (rm->page != 0)
+		return (reg & ~(rm->page - 1)) | ((reg + 1) & (rm->page - 1));
+	return ((uint32_t)reg + 1 < rm->size) ? reg + 1 : 0;
+}
+
+static inline uint16_t prev_reg(t_i2c_regmap *rm, uint16_t reg)
+{
+	if (rm->page != 0)
+		return (reg & ~(rm->page - 1)) | ((reg - 1) & (rm->page - 1));
+	return (reg > 0) ? reg - 1 : (uint16_t)(rm->size - 1);
+}
+
+/**
+ * @brief   Address matched, a transaction (or a repeated START) begins
+ *
+ * @param[in,out] rm		register map
+ * @param[in] read		TRUE if the master reads
+ */
+void i2c_regmap_start(t_i2c_regmap *rm, bool read)
+{
+	rm->addr_count = 0;
+	rm->logged = false;
+	if (read)
+		rm->nb_reads++;
+	else
+		rm->nb_writes++;
+}
+
+/**
+ * @brief   Byte written by the master
+ *
+ * @param[in,out] rm		register map
+ * @param[in] data		byte received
+ */
+void i2c_regmap_rx(t_i2c_regmap *rm, uint8_t data)
+{
+	volatile t_i2c_regmap_log *entry;
+
+	if (rm->addr_count < rm->addr_bytes) {
+		rm->reg = (rm->addr_count == 0) ? data : (rm->reg << 8) | data;
+		if (++rm->addr_count == rm->addr_bytes)
+			rm->reg %= rm->size;
+		return;
+	}
+
+	if (rm->log_head - rm->log_tail < rm->log_len) {
+		entry = &rm->log[rm->log_head & (rm->log_len - 1)];
+		entry->reg = rm->reg;
+		entry->value = data;
+		entry->flags = rm->logged ? 0 : I2C_REGMAP_LOG_START;
+		rm->log_head++;
+	} else {
+		rm->log_lost++;
+	}
+	rm->logged = true;
+
+	if (!rm->read_only)
+		rm->map[rm->reg] = data;
+	rm->reg = next_reg(rm, rm->reg);
+}
+
+/**
+ * @brief   Byte to send to the master
+ * @note    The peripheral loads the next byte before the master ACKs the
+ *          current one, the bytes not sent are given back on the stop.
+ *
+ * @param[in,out] rm		register map
+ *
+ * @return			register value
+ */
+uint8_t i2c_regmap_tx(t_i2c_regmap *rm)
+{
+	uint8_t data;
+
+	data = rm->map[rm->reg];
+	rm->reg = next_reg(rm, rm->reg);
+	return data;
+}
+
+/**
+ * @brief   End of the transaction, STOP or master NACK
+ *
+ * @param[in,out] rm		register map
+ * @param[in] unsent		bytes given by i2c_regmap_tx() and not sent
+ */
+void i2c_regmap_stop(t_i2c_regmap *rm, uint32_t unsent)
+{
+	while (unsent--)
+		rm->reg = prev_reg(rm, rm->reg);
+	rm->addr_count = 0;
+}
+
+/**
+ * @brief   Gets the oldest write log entry
+ *
+ * @param[in,out] rm		register map
+ * @param[out] entry		log entry
+ *
+ * @return			FALSE if the log is empty
+ */
+bool i2c_regmap_log_get(t_i2c_regmap *rm, t_i2c_regmap_log *entry)
+{
+	if (rm->log_tail == rm->log_head)
+		return false;
+	*entry = rm->log[rm->log_tail & (rm->log_len - 1)];
+	rm->log_tail++;
+	return true;
+}
@@ -0,0 +1,69 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRABUS_I2C_REGMAP_H_
+#define _HYDRABUS_I2C_REGMAP_H_
+
+/*
+ * I2C slave register map / EEPROM emulation, driven by the slave
+ * interrupt events. No hardware or kernel access, so that it builds on a
+ * host.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Log entry flag: first byte written by a transaction */
+#define I2C_REGMAP_LOG_START	(1 << 0)
+
+typedef struct {
+	uint16_t reg;
+	uint8_t value;
+	uint8_t flags;
+} t_i2c_regmap_log;
+
+typedef struct {
+	uint8_t *map;
+	uint32_t size; /* Bytes, up to 65536 */
+	uint8_t addr_bytes; /* Register address bytes, 1 or 2 (MSB first) */
+	uint16_t page; /* Auto increment wraps in a page (power of 2), 0: in the map */
+	bool read_only;
+	/* Transaction */
+	uint16_t reg; /* Current register */
+	uint8_t addr_count; /* Address bytes received */
+	bool logged; /* Data written by the transaction */
+	/* Write log, emptied by a thread */
+	volatile t_i2c_regmap_log *log;
+	uint32_t log_len; /* Entries, power of 2 */
+	volatile uint32_t log_head;
+	volatile uint32_t log_tail;
+	volatile uint32_t log_lost;
+	/* Statistics */
+	volatile uint32_t nb_reads;
+	volatile uint32_t nb_writes;
+} t_i2c_regmap;
+
+void i2c_regmap_init(t_i2c_regmap *rm, uint8_t *map, uint32_t size,
+		     uint8_t addr_bytes, uint16_t page, bool read_only,
+		     t_i2c_regmap_log *log, uint32_t log_len);
+void i2c_regmap_start(t_i2c_regmap *rm, bool read);
+void i2c_regmap_rx(t_i2c_regmap *rm, uint8_t data);
+uint8_t i2c_regmap_tx(t_i2c_regmap *rm);
+void i2c_regmap_stop(t_i2c_regmap *rm, uint32_t unsent);
+bool i2c_regmap_log_get(t_i2c_regmap *rm, t_i2c_regmap_log *entry);
+
+#endif /* _HYDRABUS_I2C_REGMAP_H_ */
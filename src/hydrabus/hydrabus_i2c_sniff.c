@@ -0,0 +1,87 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hydrabus_i2c_sniff.h"
+
+/**
+ * @brief   Prepares the decoder
+ *
+ * @param[out] s		decoder state
+ * @param[in] lines		SCL/SDA levels before the first event
+ */
+void i2c_sniff_init(t_i2c_sniff *s, uint8_t lines)
+{
+	s->lines = lines & I2C_SNIFF_LINES;
+	s->nb_bits = 0;
+	s->bits = 0;
+	s->address = false;
+	s->errors = 0;
+}
+
+/**
+ * @brief   Decodes one edge event
+ * @note    SDA is read on each SCL rising edge. A SDA edge seen while SCL
+ *          is high is a START (falling) or a STOP (rising), the sampler
+ *          reports SCL low when SCL rose before the SDA level was read.
+ *          The SCL rising edge just before a START or a STOP is not an
+ *          error.
+ *
+ * @param[in,out] s		decoder state
+ * @param[in] event		edge event
+ * @param[out] rec		record, valid when TRUE is returned
+ *
+ * @return			TRUE when a record is decoded
+ */
+bool i2c_sniff_decode(t_i2c_sniff *s, uint32_t event, t_i2c_sniff_rec *rec)
+{
+	uint8_t prev, lines;
+
+	prev = s->lines;
+	lines = event & I2C_SNIFF_LINES;
+	s->lines = lines;
+
+	if (!(event & I2C_SNIFF_CLOCK)) {
+		if (!(lines & I2C_SNIFF_SCL) ||
+		    !((prev ^ lines) & I2C_SNIFF_SDA))
+			return false;
+		if (s->nb_bits > 1)
+			s->errors++;
+		s->nb_bits = 0;
+		s->bits = 0;
+		s->address = !(lines & I2C_SNIFF_SDA);
+		rec->time = I2C_SNIFF_TIME(event);
+		rec->type = s->address ? I2C_SNIFF_REC_START : I2C_SNIFF_REC_STOP;
+		rec->data = 0;
+		rec->ack = false;
+		return true;
+	}
+
+	/* 8 data bits then ACK */
+	s->bits = (s->bits << 1) | ((lines & I2C_SNIFF_SDA) ? 1 : 0);
+	if (++s->nb_bits < 9)
+		return false;
+
+	rec->time = I2C_SNIFF_TIME(event);
+	rec->type = s->address ? I2C_SNIFF_REC_ADDR : I2C_SNIFF_REC_DATA;
+	rec->data = s->bits >> 1;
+	rec->ack = !(s->bits & 1);
+	s->nb_bits = 0;
+	s->bits = 0;
+	s->address = false;
+	return true;
+}
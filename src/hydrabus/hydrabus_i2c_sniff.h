@@ -0,0 +1,66 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRABUS_I2C_SNIFF_H_
+#define _HYDRABUS_I2C_SNIFF_H_
+
+/*
+ * Decoding of the I2C sniffer edge events into bus records. No hardware
+ * or kernel access, so that it builds on a host.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Edge event, 32 bits:
+ * bits 31-3: cycle counter, bit 2: SCL rising edge (else SDA edge),
+ * bit 1: SDA level, bit 0: SCL level
+ * Levels are sampled after the edge.
+ */
+#define I2C_SNIFF_SCL		(1 << 0)
+#define I2C_SNIFF_SDA		(1 << 1)
+#define I2C_SNIFF_LINES		(I2C_SNIFF_SCL | I2C_SNIFF_SDA)
+#define I2C_SNIFF_CLOCK		(1 << 2)
+#define I2C_SNIFF_TIME(ev)	((ev) & ~(I2C_SNIFF_LINES | I2C_SNIFF_CLOCK))
+
+typedef enum {
+	I2C_SNIFF_REC_START = 0,
+	I2C_SNIFF_REC_STOP,
+	I2C_SNIFF_REC_ADDR, /* First byte after a START */
+	I2C_SNIFF_REC_DATA,
+} i2c_sniff_rec_t;
+
+typedef struct {
+	uint32_t time; /* Cycle counter of the last edge */
+	uint8_t type; /* i2c_sniff_rec_t */
+	uint8_t data;
+	uint8_t ack; /* TRUE if SDA was low on the ninth clock */
+} t_i2c_sniff_rec;
+
+typedef struct {
+	uint8_t lines; /* Last levels */
+	uint8_t nb_bits;
+	uint16_t bits;
+	bool address; /* Next byte follows a START */
+	uint32_t errors; /* Bytes cut by a START or a STOP */
+} t_i2c_sniff;
+
+void i2c_sniff_init(t_i2c_sniff *s, uint8_t lines);
+bool i2c_sniff_decode(t_i2c_sniff *s, uint32_t event, t_i2c_sniff_rec *rec);
+
+#endif /* _HYDRABUS_I2C_SNIFF_H_ */
@@ -364,6 +364,44 @@ static int chomp_strings(t_hydra_console *con, t_tokenline_parsed *p,
 	return t - token_pos;
 }
 
+/*
+ * Writes too long for the write callbacks (nb_data is 8 bits) go through
+ * the bulk callbacks, which print nothing.
+ */
+static uint32_t hydrabus_mode_bulk_write(t_hydra_console *con,
+					 unsigned int num_bytes)
+{
+	mode_config_proto_t* p_proto = &con->mode->proto;
+	const mode_exec_t *exec = con->mode->exec;
+	uint32_t mode_status;
+	unsigned int i;
+
+	mode_status = !HYDRABUS_MODE_STATUS_OK;
+	if (p_proto->wwr == 1) {
+		if (exec->bulk_write_read != NULL)
+			mode_status = exec->bulk_write_read(con, p_proto->buffer_tx,
+							    p_proto->buffer_rx, num_bytes);
+	} else {
+		if (exec->bulk_write != NULL)
+			mode_status = exec->bulk_write(con, p_proto->buffer_tx,
+						       num_bytes);
+	}
+	if (mode_status != HYDRABUS_MODE_STATUS_OK)
+		return mode_status;
+
+	cprintf(con, hydrabus_mode_str_mul_write);
+	for (i = 0; i < num_bytes; i++)
+		cprintf(con, hydrabus_mode_str_mul_value_u8, p_proto->buffer_tx[i]);
+	cprintf(con, hydrabus_mode_str_mul_br);
+	if (p_proto->wwr == 1) {
+		cprintf(con, hydrabus_mode_str_mul_read);
+		for (i = 0; i < num_bytes; i++)
+			cprintf(con, hydrabus_mode_str_mul_value_u8, p_proto->buffer_rx[i]);
+		cprintf(con, hydrabus_mode_str_mul_br);
+	}
+	return mode_status;
+}
+
 /*
  * This function can be called for either T_WRITE or a free-standing
  * T_ARG_UINT, so it's called with t pointing to the first token after
@@ -404,7 +442,9 @@ static int hydrabus_mode_write(t_hydra_console *con, t_tokenline_parsed *p,
 		if (p_proto->wwr == 1) {
 			/* Write & Read */
 			mode_status = !HYDRABUS_MODE_STATUS_OK;
-			if(con->mode->exec->write_read != NULL) {
+			if (num_bytes > UINT8_MAX) {
+				mode_status = hydrabus_mode_bulk_write(con, num_bytes);
+			} else if(con->mode->exec->write_read != NULL) {
 				mode_status = con->mode->exec->write_read(con,
 						p_proto->buffer_tx, p_proto->buffer_rx, num_bytes);
 			}
@@ -414,7 +454,9 @@ static int hydrabus_mode_write(t_hydra_console *con, t_tokenline_parsed *p,
 		} else {
 			/* Write only */
 			mode_status = !HYDRABUS_MODE_STATUS_OK;
-			if(con->mode->exec->write != NULL) {
+			if (num_bytes > UINT8_MAX) {
+				mode_status = hydrabus_mode_bulk_write(con, num_bytes);
+			} else if(con->mode->exec->write != NULL) {
 				mode_status = con->mode->exec->write(con,
 								     p_proto->buffer_tx, num_bytes);
 			}
@@ -426,6 +468,27 @@ static int hydrabus_mode_write(t_hydra_console *con, t_tokenline_parsed *p,
 	return tokens_used;
 }
 
+/* Reads in chunks of the RX buffer with the bulk callback, prints them */
+static uint32_t hydrabus_mode_bulk_read(t_hydra_console *con, uint32_t count)
+{
+	mode_config_proto_t* p_proto = &con->mode->proto;
+	uint32_t mode_status, to_rx, i;
+
+	mode_status = HYDRABUS_MODE_STATUS_OK;
+	cprintf(con, hydrabus_mode_str_mul_read);
+	while (count > 0) {
+		to_rx = MIN(count, sizeof(p_proto->buffer_rx));
+		mode_status = con->mode->exec->bulk_read(con, p_proto->buffer_rx, to_rx);
+		if (mode_status != HYDRABUS_MODE_STATUS_OK)
+			break;
+		for (i = 0; i < to_rx; i++)
+			cprintf(con, hydrabus_mode_str_mul_value_u8, p_proto->buffer_rx[i]);
+		count -= to_rx;
+	}
+	cprintf(con, hydrabus_mode_str_mul_br);
+	return mode_status;
+}
+
 /* Returns the number of tokens eaten. */
 static int hydrabus_mode_read(t_hydra_console *con, t_tokenline_parsed *p,
 			      int token_pos)
@@ -445,7 +508,11 @@ static int hydrabus_mode_read(t_hydra_console *con, t_tokenline_parsed *p,
 	}
 
 	mode_status = !HYDRABUS_MODE_STATUS_OK;
-	if(con->mode->exec->read != NULL) {
+	if (count > UINT8_MAX) {
+		/* Too long for read(), nb_data is 8 bits */
+		if(con->mode->exec->bulk_read != NULL)
+			mode_status = hydrabus_mode_bulk_read(con, count);
+	} else if(con->mode->exec->read != NULL) {
 		mode_status = con->mode->exec->read(con, p_proto->buffer_rx, count);
 	}
 	if (mode_status != HYDRABUS_MODE_STATUS_OK)
@@ -463,11 +530,12 @@ static int hydrabus_mode_hexdump(t_hydra_console *con, t_tokenline_parsed *p,
 	#define HEXDUMP_CHUNK_SIZE 64
 
 	mode_config_proto_t* p_proto;
+	const mode_exec_t *exec = con->mode->exec;
 	uint32_t mode_status;
 	uint32_t count;
 	uint32_t bytes_read = 0;
+	uint32_t chunk, to_rx;
 	int t;
-	uint8_t to_rx;
 
 	p_proto = &con->mode->proto;
 
@@ -479,19 +547,23 @@ static int hydrabus_mode_hexdump(t_hydra_console *con, t_tokenline_parsed *p,
 		count = 1;
 	}
 
+	/* dump() is limited to 255 bytes, the bulk read to the RX buffer */
+	if (exec->bulk_read != NULL)
+		chunk = sizeof(p_proto->buffer_rx);
+	else
+		chunk = HEXDUMP_CHUNK_SIZE;
+
 	while((bytes_read < count) && !hydrabus_ubtn()){
 		mode_status = !HYDRABUS_MODE_STATUS_OK;
-		if((count-bytes_read) >= HEXDUMP_CHUNK_SIZE) {
-			to_rx = HEXDUMP_CHUNK_SIZE;
-		} else {
-			to_rx = (count-bytes_read);
-		}
+		to_rx = MIN(count - bytes_read, chunk);
 
-		if(con->mode->exec->read != NULL) {
-			mode_status = con->mode->exec->dump(con, p_proto->buffer_rx, to_rx);
+		if(exec->bulk_read != NULL) {
+			mode_status = exec->bulk_read(con, p_proto->buffer_rx, to_rx);
+		} else if(exec->dump != NULL) {
+			mode_status = exec->dump(con, p_proto->buffer_rx, to_rx);
 		}
 		if (mode_status == HYDRABUS_MODE_STATUS_OK) {
-			print_hex(con, p_proto->buffer_rx, to_rx);
+			print_hexdump(con, bytes_read, p_proto->buffer_rx, to_rx);
 		} else {
 			hydrabus_mode_read_error(con, mode_status);
 		}
@@ -24,6 +24,9 @@
 
 #define HYDRABUS_MODE_STATUS_OK (0)
 
+/* Largest transfer done in one BSP call by the bulk_* callbacks */
+#define HYDRABUS_MODE_BULK_CHUNK (0xFFFF)
+
 /* Common string for hydrabus mode */
 /* "/CS ENABLED\r\n" */
 extern const char hydrabus_mode_str_cs_enabled[];
@@ -69,6 +72,13 @@ typedef struct mode_exec_t {
 	uint32_t (*dump)(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data);
 	/* Write & Read data (return status 0=OK) */
 	uint32_t (*write_read)(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_data, uint8_t nb_data);
+	/*
+	 * Bulk transfers: caller owned buffers, no length limit and no
+	 * console output, NULL if not supported (return status 0=OK)
+	 */
+	uint32_t (*bulk_write)(t_hydra_console *con, uint8_t *tx_data, uint32_t nb_data);
+	uint32_t (*bulk_read)(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data);
+	uint32_t (*bulk_write_read)(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_data, uint32_t nb_data);
 	/* Set CLK High (x-WIRE or other raw mode) command '/' */
 	void (*clkh)(t_hydra_console *con);
 	/* Set CLK Low (x-WIRE or other raw mode) command '\' */
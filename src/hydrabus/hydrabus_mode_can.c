@@ -160,8 +160,8 @@ static void slcan_read_command(t_hydra_console *con, uint8_t *buff){
 	uint8_t input = 0;
 	uint8_t bytes_read = 0;
 	while(!hydrabus_ubtn() && input!='\r' && i<SLCAN_BUFF_LEN){
-		bytes_read = chnReadTimeout(con->sdu, &input,
-					    1, TIME_US2I(1));
+		bytes_read = cread_timeout(con, &input,
+					  1, TIME_US2I(1));
 		if (bytes_read != 0) {
 			buff[i++] = input;
 		}
@@ -22,6 +22,11 @@
 #include "bsp.h"
 #include "bsp_gpio.h"
 #include "hydrabus_mode_flash.h"
+#include "hydrabus_nand.h"
+#include "hydrabus_spi_flash.h"
+#include "microsd.h"
+#include "sbuf.h"
+#include <stdio.h>
 #include <string.h>
 
 static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
@@ -32,6 +37,16 @@ static const char* str_prompt_flash[] = {
 	"nandflash" PROMPT,
 };
 
+static FIL dump_file;
+static bool dump_to_sd;
+static uint32_t dump_crc;
+static uint32_t dump_page_nb;
+static uint32_t dump_pages_per_block;
+static uint32_t dump_bad_blocks;
+static uint32_t dump_last_bad;
+static uint32_t dump_corrected;
+static uint32_t dump_failed;
+
 /* WE# High to RE# low - Around 60ns */
 static void delay_tWHR(void)
 {
@@ -231,6 +246,263 @@ uint8_t flash_read_value(t_hydra_console *con)
 	return result;
 }
 
+/**
+ * @brief   Reads consecutive bytes from the data bus
+ * @note    The data bus is switched to input once for the whole burst, only
+ *          RE# is toggled for each byte.
+ *
+ * @param[in] con		console
+ * @param[out] rx_data		read data
+ * @param[in] nb_data		number of bytes to read
+ */
+void flash_read_burst(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
+{
+	uint32_t i;
+
+	flash_data_mode_input();
+
+	for(i = 0; i < nb_data; i++) {
+		flash_read_en_low();
+		delay_tREA();
+		rx_data[i] = flash_read_u8(con);
+		flash_read_en_high();
+	}
+}
+
+/**
+ * @brief   Reads the ID bytes at the given address
+ *
+ * @param[in] con		console
+ * @param[in] addr		0x00 for the JEDEC ID, 0x20 for the ONFI signature
+ * @param[out] rx_data		ID bytes
+ * @param[in] nb_data		number of bytes to read
+ */
+void flash_read_id(t_hydra_console *con, uint8_t addr, uint8_t *rx_data,
+		   uint32_t nb_data)
+{
+	flash_chip_en_low();
+
+	flash_write_command(con, 0x90);
+	flash_write_address(con, addr);
+	/* Wait a Delay after address => tWHR (WE# HIGH to RE# LOW) 60ns on Micron */
+	delay_tWHR();
+
+	flash_read_burst(con, rx_data, nb_data);
+
+	flash_chip_en_high();
+}
+
+/**
+ * @brief   Reads a copy of the ONFI parameter page
+ * @note    The parameter page is repeated, the previous copies are read and
+ *          discarded.
+ *
+ * @param[in] con		console
+ * @param[in] copy		copy number, from 0
+ * @param[out] rx_data		parameter page
+ * @param[in] nb_data		parameter page size
+ */
+void flash_read_param_page(t_hydra_console *con, uint8_t copy,
+			   uint8_t *rx_data, uint32_t nb_data)
+{
+	uint8_t i;
+
+	flash_chip_en_low();
+
+	flash_write_command(con, 0xEC);
+	flash_write_address(con, 0x00);
+
+	/* WE# high to busy (tWB), then busy to data out (tRR) */
+	delay_tWHR();
+	delay_tWHR();
+	flash_wait_ready();
+	delay_tREA();
+
+	for(i = 0; i <= copy; i++)
+		flash_read_burst(con, rx_data, nb_data);
+
+	flash_chip_en_high();
+}
+
+/**
+ * @brief   Reads a NAND page from column 0
+ * @note    Large page devices (2 column cycles) get the 0x30 read confirm,
+ *          small page devices read the data and spare areas in sequence.
+ *
+ * @param[in] con		console
+ * @param[in] col_cycles	column address cycles (1 or 2)
+ * @param[in] row_cycles	row address cycles (2 or 3)
+ * @param[in] row		page (row) address
+ * @param[out] rx_data		page data, data and spare areas
+ * @param[in] nb_data		number of bytes to read
+ */
+void flash_read_page(t_hydra_console *con, uint8_t col_cycles,
+		     uint8_t row_cycles, uint32_t row, uint8_t *rx_data,
+		     uint32_t nb_data)
+{
+	uint8_t i;
+
+	flash_chip_en_low();
+
+	flash_write_command(con, 0x00);
+	for(i = 0; i < col_cycles; i++)
+		flash_write_address(con, 0x00);
+	for(i = 0; i < row_cycles; i++)
+		flash_write_address(con, (row >> (8 * i)) & 0xff);
+	if(col_cycles > 1)
+		flash_write_command(con, 0x30);
+
+	/* WE# high to busy (tWB), then busy to data out (tRR) */
+	delay_tWHR();
+	delay_tWHR();
+	flash_wait_ready();
+	delay_tREA();
+
+	flash_read_burst(con, rx_data, nb_data);
+
+	flash_chip_en_high();
+}
+
+static bool dump_page(t_hydra_console *con, uint8_t *data, uint32_t nb_data,
+		      uint8_t status)
+{
+	UINT written;
+
+	if (hydrabus_ubtn()) {
+		cprintf(con, "Aborted.\r\n");
+		return FALSE;
+	}
+	/* Marker may be in both the first and second page of the block */
+	if ((status & NAND_PAGE_BAD_BLOCK) &&
+	    dump_page_nb / dump_pages_per_block != dump_last_bad) {
+		dump_last_bad = dump_page_nb / dump_pages_per_block;
+		cprintf(con, "Bad block %lu\r\n", dump_last_bad);
+		dump_bad_blocks++;
+	}
+	if (status & NAND_PAGE_ECC_CORRECTED)
+		dump_corrected++;
+	if (status & NAND_PAGE_ECC_FAILED) {
+		cprintf(con, "Uncorrectable page %lu\r\n", dump_page_nb);
+		dump_failed++;
+	}
+	dump_page_nb++;
+	dump_crc = spi_flash_crc32(dump_crc, data, nb_data);
+	if (dump_to_sd &&
+	    (f_write(&dump_file, data, nb_data, &written) != FR_OK ||
+	     written != nb_data)) {
+		cprintf(con, "Error writing file.\r\n");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* Parses the dump arguments and runs it, returns the tokens used */
+static int dump_nand(t_hydra_console *con, t_tokenline_parsed *p,
+		     int token_pos)
+{
+	t_nand nand;
+	filename_t sd_file;
+	uint32_t page, nb_pages, start, elapsed;
+	uint8_t *buf, flags;
+	int t, str_offset;
+	bsp_status_t status;
+
+	page = 0;
+	nb_pages = 0;
+	flags = 0;
+	dump_to_sd = FALSE;
+	for (t = token_pos; p->tokens[t]; t++) {
+		if (p->tokens[t] == T_ADDRESS) {
+			t += 2;
+			memcpy(&page, p->buf + p->tokens[t], sizeof(int));
+		} else if (p->tokens[t] == T_LENGTH) {
+			t += 2;
+			memcpy(&nb_pages, p->buf + p->tokens[t], sizeof(int));
+		} else if (p->tokens[t] == T_FILE) {
+			t += 2;
+			memcpy(&str_offset, &p->tokens[t], sizeof(int));
+			snprintf(sd_file.filename, FILENAME_SIZE, "0:%s",
+				 p->buf + str_offset);
+			dump_to_sd = TRUE;
+		} else if (p->tokens[t] == T_ECC) {
+			flags |= NAND_DUMP_ECC;
+		} else {
+			break;
+		}
+	}
+
+	if (dump_to_sd && is_file_present(sd_file.filename)) {
+		cprintf(con, "File %s already exists.\r\n", sd_file.filename);
+		return t - token_pos;
+	}
+	if (!nand_probe(con, &nand) || !nand_check_geometry(&nand)) {
+		cprintf(con, "No NAND flash found.\r\n");
+		return t - token_pos;
+	}
+	if ((flags & NAND_DUMP_ECC) && !nand_ecc_supported(&nand)) {
+		cprintf(con, "ECC not supported for %lu+%lu bytes pages.\r\n",
+			nand.data_size, nand.page_size - nand.data_size);
+		return t - token_pos;
+	}
+	if (nb_pages == 0 && nand.nb_blocks * nand.pages_per_block > page)
+		nb_pages = nand.nb_blocks * nand.pages_per_block - page;
+	if (nb_pages == 0 ||
+	    (uint64_t)nb_pages * nand.page_size > 0xFFFFFFFF) {
+		cprintf(con, "Invalid page or length.\r\n");
+		return t - token_pos;
+	}
+
+	buf = sbuf_alloc(con, SBUF_RAM, 2 * nand.page_size);
+	if (buf == NULL) {
+		cprintf(con, "Not enough memory.\r\n");
+		return t - token_pos;
+	}
+	if (dump_to_sd) {
+		if (!file_open(&dump_file, sd_file.filename, 'w')) {
+			cprintf(con, "Cannot open file %s\r\n", sd_file.filename);
+			sbuf_free(con, buf);
+			return t - token_pos;
+		}
+		if (!file_preallocate(&dump_file, nb_pages * nand.page_size)) {
+			cprintf(con, "Not enough space on microSD.\r\n");
+			file_close(&dump_file);
+			sbuf_free(con, buf);
+			return t - token_pos;
+		}
+	}
+
+	cprintf(con, "Dumping %lu pages of %lu bytes from page %lu\r\n",
+		nb_pages, nand.page_size, page);
+	dump_crc = 0;
+	dump_page_nb = page;
+	dump_pages_per_block = nand.pages_per_block;
+	dump_bad_blocks = 0;
+	dump_last_bad = 0xFFFFFFFF;
+	dump_corrected = 0;
+	dump_failed = 0;
+	start = chVTGetSystemTime();
+	status = nand_dump(con, &nand, page, nb_pages, flags, buf, dump_page);
+	elapsed = TIME_I2MS(chVTGetSystemTime() - start);
+
+	if (dump_to_sd)
+		file_close(&dump_file);
+	sbuf_free(con, buf);
+
+	if (status == BSP_OK) {
+		cprintf(con, "CRC32: 0x%08lX\r\nTime: %lu ms\r\n",
+			dump_crc, elapsed);
+		cprintf(con, "Bad blocks: %lu\r\n", dump_bad_blocks);
+		if (flags & NAND_DUMP_ECC)
+			cprintf(con, "ECC corrected pages: %lu\r\n"
+				"ECC uncorrectable pages: %lu\r\n",
+				dump_corrected, dump_failed);
+	} else {
+		cprintf(con, "Dump failed.\r\n");
+	}
+
+	return t - token_pos;
+}
+
 static int init(t_hydra_console *con, t_tokenline_parsed *p)
 {
 	int tokens_used;
@@ -279,6 +551,9 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 		case T_ID:
 			flash_display_id(con);
 			break;
+		case T_DUMP:
+			t += dump_nand(con, p, t + 1);
+			break;
 		default:
 			return t - token_pos;
 		}
@@ -318,6 +593,8 @@ static void flash_display_id(t_hydra_console *con)
 	#define READ_ID_DATA_NB_DATA (5)
 	uint8_t read_data[READ_ID_DATA_NB_DATA];
 	uint8_t data;
+	t_nand nand;
+	bool found;
 
 	cprintf(con, "IDCode : ");
 
@@ -325,17 +602,7 @@ static void flash_display_id(t_hydra_console *con)
 	memset(read_data, 0, READ_ID_DATA_NB_DATA);
 
 	/* Read ID Operation */
-	flash_chip_en_low();
-
-	flash_write_command(con, 0x90);
-	flash_write_address(con, 0x00);
-	/* Wait a Delay after address => tWHR (WE# HIGH to RE# LOW) 60ns on Micron */
-	delay_tWHR();
-
-	for(i = 0; i < READ_ID_DATA_NB_DATA; i++)
-		read_data[i] = flash_read_value(con);
-
-	flash_chip_en_high();
+	flash_read_id(con, 0x00, read_data, READ_ID_DATA_NB_DATA);
 
 	chSysUnlock();
 
@@ -358,6 +625,23 @@ static void flash_display_id(t_hydra_console *con)
 	chSysUnlock();
 
 	cprintf(con, "%02X\r\n", data);
+
+	chSysLock();
+	found = nand_probe(con, &nand);
+	chSysUnlock();
+	if (!found)
+		return;
+	if (nand.onfi)
+		cprintf(con, "ONFI model : %s\r\n", nand.model);
+	cprintf(con, "Page size : %lu+%lu bytes\r\n", nand.data_size,
+		nand.page_size - nand.data_size);
+	cprintf(con, "Pages per block : %lu\r\n", nand.pages_per_block);
+	if (nand.nb_blocks)
+		cprintf(con, "Blocks : %lu\r\n", nand.nb_blocks);
+	cprintf(con, "Address cycles : %d column, %d row\r\n",
+		nand.col_cycles, nand.row_cycles);
+	if (nand.ecc_bits)
+		cprintf(con, "Required ECC : %d bits\r\n", nand.ecc_bits);
 }
 
 static int show(t_hydra_console *con, t_tokenline_parsed *p)
@@ -377,6 +661,26 @@ static int show(t_hydra_console *con, t_tokenline_parsed *p)
 	return tokens_used;
 }
 
+static uint32_t bulk_write(t_hydra_console *con, uint8_t *tx_data, uint32_t nb_data)
+{
+	uint32_t i;
+
+	for(i = 0; i < nb_data; i++)
+		flash_write_value(con, tx_data[i]);
+
+	return BSP_OK;
+}
+
+static uint32_t bulk_read(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
+{
+	uint32_t i;
+
+	for(i = 0; i < nb_data; i++)
+		rx_data[i] = flash_read_value(con);
+
+	return BSP_OK;
+}
+
 static const char *get_prompt(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -428,6 +732,8 @@ bool flash_pin_init(t_hydra_console *con)
 const mode_exec_t mode_flash_exec = {
 	.init = &init,
 	.exec = &exec,
+	.bulk_write = &bulk_write,
+	.bulk_read = &bulk_read,
 	.cleanup = &flash_cleanup,
 	.get_prompt = &get_prompt,
 };
@@ -32,5 +32,13 @@ void flash_send_bit(uint8_t bit);
 void flash_write_value(t_hydra_console *con, uint8_t tx_data);
 void flash_write_command(t_hydra_console *con, uint8_t tx_data);
 void flash_write_address(t_hydra_console *con, uint8_t tx_data);
+void flash_read_burst(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data);
+void flash_read_id(t_hydra_console *con, uint8_t addr, uint8_t *rx_data,
+		   uint32_t nb_data);
+void flash_read_param_page(t_hydra_console *con, uint8_t copy,
+			   uint8_t *rx_data, uint32_t nb_data);
+void flash_read_page(t_hydra_console *con, uint8_t col_cycles,
+		     uint8_t row_cycles, uint32_t row, uint8_t *rx_data,
+		     uint32_t nb_data);
 inline void flash_wait_ready(void);
 void flash_cleanup(t_hydra_console *con);
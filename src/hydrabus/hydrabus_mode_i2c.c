@@ -20,12 +20,17 @@
 #include "hydrabus_mode_i2c.h"
 #include "bsp_i2c_master.h"
 #include "bsp_i2c_slave.h"
+#include "hydrabus_i2c_sniff.h"
+#include "hydrabus_i2c_regmap.h"
+#include "microsd.h"
+#include "sbuf.h"
+#include <stdio.h>
 #include <string.h>
 
 static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
 static int show(t_hydra_console *con, t_tokenline_parsed *p);
 static void scan(t_hydra_console *con, t_tokenline_parsed *p);
-static void sniff(t_hydra_console *con);
+static int slave(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
 
 #define I2C_DEV_NUM (1)
 
@@ -49,7 +54,11 @@ static uint32_t speeds[SPEED_NB] = {
 	1000000,
 };
 
-#define SNIFF_BUFFER_LENGTH 4096
+#define SNIFF_RING_LEN (8192) /* Edge events, power of 2 */
+#define SNIFF_RELEASE_MASK (63) /* Ring space released every 64 events */
+
+#define SLAVE_MAP_MAX (32768)
+#define SLAVE_LOG_LEN (1024) /* Write log entries, power of 2 */
 
 static void init_proto_default(t_hydra_console *con)
 {
@@ -157,7 +166,10 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 			scan(con, p);
 			break;
 		case T_SNIFF:
-			sniff(con);
+			i2c_sniff(con, FALSE);
+			break;
+		case T_SLAVE:
+			t += slave(con, p, t + 1);
 			break;
 		default:
 			return t - token_pos;
@@ -173,12 +185,12 @@ static void start(t_hydra_console *con)
 
 	if(proto->config.i2c.ack_pending) {
 		/* Send I2C NACK*/
-		bsp_i2c_read_ack(I2C_DEV_NUM, FALSE);
+		bsp_i2c_read_ack(proto->dev_num, FALSE);
 		cprintf(con, str_i2c_nack_br);
 		proto->config.i2c.ack_pending = 0;
 	}
 
-	bsp_i2c_start(I2C_DEV_NUM);
+	bsp_i2c_start(proto->dev_num);
 	cprintf(con, str_i2c_start_br);
 }
 
@@ -188,11 +200,11 @@ static void stop(t_hydra_console *con)
 
 	if(proto->config.i2c.ack_pending) {
 		/* Send I2C NACK */
-		bsp_i2c_read_ack(I2C_DEV_NUM, FALSE);
+		bsp_i2c_read_ack(proto->dev_num, FALSE);
 		cprintf(con, str_i2c_nack_br);
 		proto->config.i2c.ack_pending = 0;
 	}
-	bsp_i2c_stop(I2C_DEV_NUM);
+	bsp_i2c_stop(proto->dev_num);
 	cprintf(con, str_i2c_stop_br);
 }
 
@@ -205,7 +217,7 @@ static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data)
 
 	if(proto->config.i2c.ack_pending) {
 		/* Send I2C ACK */
-		bsp_i2c_read_ack(I2C_DEV_NUM, TRUE);
+		bsp_i2c_read_ack(proto->dev_num, TRUE);
 		cprintf(con, str_i2c_ack_br);
 		proto->config.i2c.ack_pending = 0;
 	}
@@ -214,7 +226,7 @@ static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data)
 
 	status = BSP_ERROR;
 	for(i = 0; i < nb_data; i++) {
-		status = bsp_i2c_master_write_u8(I2C_DEV_NUM, tx_data[i], &tx_ack_flag);
+		status = bsp_i2c_master_write_u8(proto->dev_num, tx_data[i], &tx_ack_flag);
 		/* Write 1 data */
 		cprintf(con, hydrabus_mode_str_mul_value_u8, tx_data[i]);
 		/* Print received ACK or NACK */
@@ -242,7 +254,7 @@ static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
 	for(i = 0; i < nb_data; i++) {
 		if(proto->config.i2c.ack_pending) {
 			/* Send I2C ACK */
-			bsp_i2c_read_ack(I2C_DEV_NUM, TRUE);
+			bsp_i2c_read_ack(proto->dev_num, TRUE);
 			cprintf(con, str_i2c_ack);
 			cprintf(con, hydrabus_mode_str_mul_br);
 		}
@@ -269,7 +281,7 @@ static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
 	for(i = 0; i < nb_data; i++) {
 		if(proto->config.i2c.ack_pending) {
 			/* Send I2C ACK */
-			bsp_i2c_read_ack(I2C_DEV_NUM, TRUE);
+			bsp_i2c_read_ack(proto->dev_num, TRUE);
 		}
 
 		status = bsp_i2c_master_read_u8(proto->dev_num, &tmp);
@@ -283,6 +295,54 @@ static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
 	return status;
 }
 
+static uint32_t bulk_write(t_hydra_console *con, uint8_t *tx_data, uint32_t nb_data)
+{
+	uint32_t i, status;
+	uint8_t tx_ack_flag;
+	mode_config_proto_t* proto = &con->mode->proto;
+
+	if(proto->config.i2c.ack_pending) {
+		/* Send I2C ACK */
+		bsp_i2c_read_ack(proto->dev_num, TRUE);
+		proto->config.i2c.ack_pending = 0;
+	}
+
+	status = BSP_OK;
+	for(i = 0; i < nb_data; i++) {
+		status = bsp_i2c_master_write_u8(proto->dev_num, tx_data[i], &tx_ack_flag);
+		if(status != BSP_OK)
+			break;
+		/* Stop on NACK */
+		if(!tx_ack_flag) {
+			status = BSP_ERROR;
+			break;
+		}
+	}
+	return status;
+}
+
+/* Each byte is ACKed before reading the next one, the last ACK is left pending */
+static uint32_t bulk_read(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
+{
+	uint32_t i, status;
+	mode_config_proto_t* proto = &con->mode->proto;
+
+	status = BSP_OK;
+	for(i = 0; i < nb_data; i++) {
+		if(proto->config.i2c.ack_pending) {
+			/* Send I2C ACK */
+			bsp_i2c_read_ack(proto->dev_num, TRUE);
+		}
+
+		status = bsp_i2c_master_read_u8(proto->dev_num, &rx_data[i]);
+		if(status != BSP_OK)
+			break;
+
+		proto->config.i2c.ack_pending = 1;
+	}
+	return status;
+}
+
 static void cleanup(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -314,16 +374,16 @@ static void scan(t_hydra_console *con, t_tokenline_parsed *p)
 	(void)p;
 
 	if(proto->config.i2c.ack_pending) {
-		bsp_i2c_read_ack(I2C_DEV_NUM, TRUE);
+		bsp_i2c_read_ack(proto->dev_num, TRUE);
 		proto->config.i2c.ack_pending = 0;
 	}
 
 	/* Skip address 0x00 (general call) and >= 0x78 (10-bit address prefix) */
 	found = FALSE;
 	for (i = 0x1; i < 0x78; i++) {
-		bsp_i2c_start(I2C_DEV_NUM);
-		bsp_i2c_master_write_u8(I2C_DEV_NUM, i << 1, &ack);
-		bsp_i2c_stop(I2C_DEV_NUM);
+		bsp_i2c_start(proto->dev_num);
+		bsp_i2c_master_write_u8(proto->dev_num, i << 1, &ack);
+		bsp_i2c_stop(proto->dev_num);
 		if (ack) {
 			cprintf(con, "Device found at address 0x%02x (0x%02x W / 0x%02x R)\r\n",
 				i, (i << 1), (i << 1)+1);
@@ -335,52 +395,314 @@ static void scan(t_hydra_console *con, t_tokenline_parsed *p)
 		cprintf(con, "No devices found.\r\n");
 }
 
-static void print_sniff_buffer(t_hydra_console *con, uint16_t *buffer, uint16_t length)
+typedef struct {
+	t_hydra_console *con;
+	uint32_t *ring;
+	t_i2c_sniff decoder;
+	bool bbio;
+	volatile bool stop;
+} t_i2c_sniffer;
+
+static void print_sniff_rec(t_hydra_console *con, t_i2c_sniff_rec *rec,
+			    bool bbio)
 {
-	uint16_t i = 0;
-	while(i < length) {
-		switch(buffer[i]) {
-		case 0x400:
-			cprint(con, "[", 1);
-			break;
-		case 0x200:
+	static const char hex[] = "0123456789abcdef";
+	char out[5];
+
+	switch(rec->type) {
+	case I2C_SNIFF_REC_START:
+		cprint(con, "[", 1);
+		break;
+	case I2C_SNIFF_REC_STOP:
+		if(bbio)
+			cprint(con, "]", 1);
+		else
 			cprint(con, "]\r\n", 3);
-			break;
-		default:
-			cprintf(con, "0x%02x", buffer[i]>>1);
-			cprint(con, buffer[i] & 1 ? "-" : "+", 1);
-			break;
+		break;
+	default:
+		if(bbio) {
+			out[0] = '\\';
+			out[1] = rec->data;
+			out[2] = rec->ack ? '+' : '-';
+			cprint(con, out, 3);
+		} else {
+			out[0] = '0';
+			out[1] = 'x';
+			out[2] = hex[rec->data >> 4];
+			out[3] = hex[rec->data & 0xf];
+			out[4] = rec->ack ? '+' : '-';
+			cprint(con, out, 5);
 		}
-		i++;
+		break;
 	}
 }
 
-static void sniff(t_hydra_console *con)
+/* Decodes the edge events recorded by the EXTI handler */
+static THD_FUNCTION(sniff_decoder_thread, arg)
 {
-	bsp_status_t status = BSP_OK;
-	uint16_t *buffer = (uint16_t *)g_sbuf;
-	uint16_t index = 0;
+	t_i2c_sniffer *sniffer = arg;
+	t_hydra_console *con = sniffer->con;
+	mode_config_proto_t* proto = &con->mode->proto;
+	t_i2c_sniff_rec rec;
+	uint32_t head, tail;
+	bool done;
+
+	chRegSetThreadName("I2C sniff decoder");
+	tail = 0;
+	do {
+		/* Stop read first, so that the last events are decoded */
+		done = sniffer->stop;
+		head = bsp_i2c_slave_sniff_count(proto->dev_num);
+		if(head == tail) {
+			cflush_idle(con);
+			if(!done)
+				chThdSleepMilliseconds(1);
+			continue;
+		}
+		while(tail != head) {
+			if(i2c_sniff_decode(&sniffer->decoder,
+					    sniffer->ring[tail & (SNIFF_RING_LEN - 1)],
+					    &rec))
+				print_sniff_rec(con, &rec, sniffer->bbio);
+			tail++;
+			if((tail & SNIFF_RELEASE_MASK) == 0)
+				bsp_i2c_slave_sniff_release(proto->dev_num, tail);
+		}
+		bsp_i2c_slave_sniff_release(proto->dev_num, tail);
+	} while(!done);
+	cflush(con);
+}
 
+/**
+ * @brief   Live I2C sniffer
+ * @note    Edges are recorded by the EXTI handler into a ring and decoded
+ *          by a separate thread. Runs until the user button is pressed, or
+ *          a byte is received in BBIO mode.
+ *
+ * @param[in] con	console
+ * @param[in] bbio	TRUE for the BBIO output format
+ */
+void i2c_sniff(t_hydra_console *con, bool bbio)
+{
 	mode_config_proto_t* proto = &con->mode->proto;
+	t_i2c_sniffer sniffer;
+	thread_t *thread;
+	uint8_t lines, data;
+
+	sniffer.ring = sbuf_alloc(con, SBUF_RAM,
+				  SNIFF_RING_LEN * sizeof(uint32_t));
+	if (sniffer.ring == NULL) {
+		if(!bbio)
+			cprintf(con, "Scratch buffer busy.\r\n");
+		return;
+	}
+	sniffer.con = con;
+	sniffer.bbio = bbio;
+	sniffer.stop = FALSE;
 
 	bsp_i2c_master_deinit(proto->dev_num);
 	bsp_i2c_slave_init(proto->dev_num, proto);
 
-	cprintf(con, "Interrupt by pressing user button.\r\n");
-	cprint(con, "\r\n", 2);
+	if(!bbio) {
+		cprintf(con, "Interrupt by pressing user button.\r\n");
+		cprint(con, "\r\n", 2);
+	}
 
-	while(!hydrabus_ubtn()) {
-		status = bsp_i2c_slave_sniff(proto->dev_num, &buffer[index]);
-		if(buffer[index] == 0x200 || index == SNIFF_BUFFER_LENGTH || status == BSP_TIMEOUT) {
-			print_sniff_buffer(con, buffer, index+1);
-			index = 0;
-		} else {
-			index++;
+	bsp_i2c_slave_sniff_start(proto->dev_num, sniffer.ring, SNIFF_RING_LEN,
+				  &lines);
+	i2c_sniff_init(&sniffer.decoder, lines);
+	thread = chThdCreateFromHeap(NULL, CONSOLE_WA_SIZE, "i2c_sniff",
+				     chThdGetPriorityX() + 1,
+				     sniff_decoder_thread, &sniffer);
+	if(thread != NULL) {
+		while(!hydrabus_ubtn()) {
+			if(bbio && cread_timeout(con, &data, 1, TIME_IMMEDIATE) == 1)
+				break;
+			chThdSleepMilliseconds(10);
 		}
+	} else if(!bbio) {
+		cprintf(con, "Cannot start the decoder thread.\r\n");
+	}
+
+	bsp_i2c_slave_sniff_stop(proto->dev_num);
+	if(thread != NULL) {
+		sniffer.stop = TRUE;
+		chThdWait(thread);
+	}
+
+	if(!bbio && (bsp_i2c_slave_sniff_lost(proto->dev_num) ||
+		     sniffer.decoder.errors)) {
+		cprintf(con, "\r\nEdges lost: %d, bytes cut: %d\r\n",
+			bsp_i2c_slave_sniff_lost(proto->dev_num),
+			sniffer.decoder.errors);
 	}
 
 	bsp_i2c_slave_deinit(proto->dev_num);
 	bsp_i2c_master_init(proto->dev_num, proto);
+
+	sbuf_free(con, sniffer.ring);
+}
+
+/* Called from ISR context */
+static void slave_start(void *arg, bool read)
+{
+	i2c_regmap_start(arg, read);
+}
+
+static void slave_rx(void *arg, uint8_t data)
+{
+	i2c_regmap_rx(arg, data);
+}
+
+static uint8_t slave_tx(void *arg)
+{
+	return i2c_regmap_tx(arg);
+}
+
+static void slave_stop(void *arg, uint32_t unsent)
+{
+	i2c_regmap_stop(arg, unsent);
+}
+
+/* Prints the write log, one line per write transaction */
+static bool print_slave_log(t_hydra_console *con, t_i2c_regmap *regmap,
+			    bool line)
+{
+	t_i2c_regmap_log entry;
+
+	while (i2c_regmap_log_get(regmap, &entry)) {
+		if (entry.flags & I2C_REGMAP_LOG_START) {
+			if (line)
+				cprint(con, "\r\n", 2);
+			cprintf(con, "W 0x%04x:", entry.reg);
+			line = TRUE;
+		}
+		cprintf(con, " %02x", entry.value);
+	}
+	return line;
+}
+
+/* Parses the slave arguments and runs it, returns the tokens used */
+static int slave(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	t_i2c_regmap regmap;
+	bsp_i2c_slave_cb_t cb;
+	filename_t sd_file;
+	FIL file;
+	t_i2c_regmap_log *log;
+	uint32_t addr, len, page, nb;
+	uint8_t *buf, *map, addr_bytes;
+	bool from_sd, read_only, line;
+	int t, str_offset;
+
+	addr = 0x50;
+	len = 256;
+	page = 0;
+	addr_bytes = 1;
+	from_sd = FALSE;
+	read_only = FALSE;
+	for (t = token_pos; p->tokens[t]; t++) {
+		if (p->tokens[t] == T_ADDRESS) {
+			t += 2;
+			memcpy(&addr, p->buf + p->tokens[t], sizeof(int));
+		} else if (p->tokens[t] == T_LENGTH) {
+			t += 2;
+			memcpy(&len, p->buf + p->tokens[t], sizeof(int));
+		} else if (p->tokens[t] == T_PAGE) {
+			t += 2;
+			memcpy(&page, p->buf + p->tokens[t], sizeof(int));
+		} else if (p->tokens[t] == T_ADDR16) {
+			addr_bytes = 2;
+		} else if (p->tokens[t] == T_READONLY) {
+			read_only = TRUE;
+		} else if (p->tokens[t] == T_FILE) {
+			t += 2;
+			memcpy(&str_offset, &p->tokens[t], sizeof(int));
+			snprintf(sd_file.filename, FILENAME_SIZE, "0:%s",
+				 p->buf + str_offset);
+			from_sd = TRUE;
+		} else {
+			break;
+		}
+	}
+
+	if (addr < 0x08 || addr > 0x77) {
+		cprintf(con, "Address must be between 0x08 and 0x77.\r\n");
+		return t - token_pos;
+	}
+	if (len == 0 || len > SLAVE_MAP_MAX || (addr_bytes == 1 && len > 256)) {
+		cprintf(con, "Length must be between 1 and %d (256 without addr16).\r\n",
+			SLAVE_MAP_MAX);
+		return t - token_pos;
+	}
+	if (page != 0 && ((page & (page - 1)) != 0 || len % page != 0)) {
+		cprintf(con, "Page must be a power of 2 dividing the length.\r\n");
+		return t - token_pos;
+	}
+
+	buf = sbuf_alloc(con, SBUF_RAM,
+			 SLAVE_LOG_LEN * sizeof(t_i2c_regmap_log) + len);
+	if (buf == NULL) {
+		cprintf(con, "Scratch buffer busy.\r\n");
+		return t - token_pos;
+	}
+	log = (t_i2c_regmap_log *)buf;
+	map = buf + SLAVE_LOG_LEN * sizeof(t_i2c_regmap_log);
+
+	/* Like an erased EEPROM */
+	memset(map, 0xFF, len);
+	if (from_sd) {
+		if (!file_open(&file, sd_file.filename, 'r')) {
+			cprintf(con, "Cannot open file %s\r\n", sd_file.filename);
+			sbuf_free(con, buf);
+			return t - token_pos;
+		}
+		nb = file_read(&file, map, len);
+		file_close(&file);
+		cprintf(con, "Loaded %lu bytes from %s\r\n", nb, sd_file.filename);
+	}
+
+	i2c_regmap_init(&regmap, map, len, addr_bytes, page, read_only,
+			log, SLAVE_LOG_LEN);
+	cb.start = slave_start;
+	cb.rx = slave_rx;
+	cb.tx = slave_tx;
+	cb.stop = slave_stop;
+	cb.arg = &regmap;
+
+	bsp_i2c_master_deinit(proto->dev_num);
+	if (bsp_i2c_slave_listen_start(proto->dev_num, proto, addr, &cb) != BSP_OK) {
+		cprintf(con, "Cannot start the slave.\r\n");
+	} else {
+		cprintf(con, "Emulating %lu bytes at address 0x%02lx.\r\n", len, addr);
+		cprintf(con, "Interrupt by pressing user button.\r\n\r\n");
+		line = FALSE;
+		while (!hydrabus_ubtn()) {
+			if (regmap.log_head == regmap.log_tail) {
+				/* Transaction ended */
+				if (line && regmap.addr_count == 0) {
+					cprint(con, "\r\n", 2);
+					line = FALSE;
+				}
+				chThdSleepMilliseconds(10);
+				continue;
+			}
+			line = print_slave_log(con, &regmap, line);
+		}
+		if (line)
+			cprint(con, "\r\n", 2);
+		bsp_i2c_slave_listen_stop(proto->dev_num);
+		print_slave_log(con, &regmap, FALSE);
+
+		cprintf(con, "\r\nReads: %lu, writes: %lu, log lost: %lu, bus errors: %lu\r\n",
+			regmap.nb_reads, regmap.nb_writes, regmap.log_lost,
+			bsp_i2c_slave_listen_errors(proto->dev_num));
+	}
+	bsp_i2c_master_init(proto->dev_num, proto);
+
+	sbuf_free(con, buf);
+	return t - token_pos;
 }
 
 static const char *get_prompt(t_hydra_console *con)
@@ -397,6 +719,8 @@ const mode_exec_t mode_i2c_exec = {
 	.write = &write,
 	.read = &read,
 	.dump = &dump,
+	.bulk_write = &bulk_write,
+	.bulk_read = &bulk_read,
 	.cleanup = &cleanup,
 	.get_prompt = &get_prompt,
 };
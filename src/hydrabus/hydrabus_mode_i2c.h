@@ -21,5 +21,7 @@
 
 #include "hydrabus_mode.h"
 
+void i2c_sniff(t_hydra_console *con, bool bbio);
+
 #endif /* _HYDRABUS_MODE_I2C_H_ */
 
@@ -23,6 +23,7 @@
 #include "bsp_gpio.h"
 #include "bsp_tim.h"
 #include "hydrabus_mode_jtag.h"
+#include "sbuf.h"
 #include <string.h>
 
 static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
@@ -641,6 +642,8 @@ static uint8_t ocd_shift_u8(t_hydra_console *con, uint8_t tdi, uint8_t tms, uint
 	return tdo;
 }
 
+#define OCD_BUFFER_SIZE (((0xFFFF + 7) / 8) * 2)
+
 void openOCD(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -649,10 +652,15 @@ void openOCD(t_hydra_console *con)
 
 	uint8_t ocd_command, values;
 	uint8_t ocd_parameters[2] = {0};
-	static uint8_t *buffer = (uint8_t *)g_sbuf;
+	uint8_t *buffer;
+
+	/* Worst case TAP shift: 0xFFFF sequences, 2 bytes per 8 sequences */
+	buffer = sbuf_alloc(con, SBUF_RAM, OCD_BUFFER_SIZE);
+	if (buffer == NULL)
+		return;
 
 	while (!hydrabus_ubtn()) {
-		if(chnReadTimeout(con->sdu, &ocd_command, 1, 1)) {
+		if(cread_timeout(con, &ocd_command, 1, 1)) {
 			switch(ocd_command) {
 			case CMD_OCD_UNKNOWN:
 				cprint(con, "BBIO1", 5);
@@ -664,7 +672,7 @@ void openOCD(t_hydra_console *con)
 				/* Not implemented */
 				break;
 			case CMD_OCD_PORT_MODE:
-				if(chnRead(con->sdu, ocd_parameters, 1) == 1) {
+				if(cread(con, ocd_parameters, 1) == 1) {
 					switch(ocd_parameters[0]) {
 					case OCD_MODE_HIZ:
 						proto->config.jtag.dev_gpio_mode = MODE_CONFIG_DEV_GPIO_IN;
@@ -682,7 +690,7 @@ void openOCD(t_hydra_console *con)
 				}
 				break;
 			case CMD_OCD_FEATURE:
-				if(chnRead(con->sdu, ocd_parameters, 2) == 2) {
+				if(cread(con, ocd_parameters, 2) == 2) {
 					switch(ocd_parameters[0]) {
 					case FEATURE_LED:
 						/* Not implemented */
@@ -711,12 +719,12 @@ void openOCD(t_hydra_console *con)
 				break;
 			case CMD_OCD_JTAG_SPEED:
 				//TODO
-				if(chnRead(con->sdu, ocd_parameters, 2) == 2) {
+				if(cread(con, ocd_parameters, 2) == 2) {
 				}
 				break;
 			case CMD_OCD_UART_SPEED:
 				/* Not implemented */
-				if(chnRead(con->sdu, ocd_parameters, 1) == 1) {
+				if(cread(con, ocd_parameters, 1) == 1) {
 					cprintf(con, "%c%c", CMD_OCD_UART_SPEED,
 						ocd_parameters[0]);
 				} else {
@@ -725,13 +733,13 @@ void openOCD(t_hydra_console *con)
 
 				break;
 			case CMD_OCD_TAP_SHIFT:
-				if(chnRead(con->sdu, ocd_parameters, 2) == 2) {
+				if(cread(con, ocd_parameters, 2) == 2) {
 					num_sequences = ocd_parameters[0] << 8;
 					num_sequences |= ocd_parameters[1];
 					cprintf(con, "%c%c%c", CMD_OCD_TAP_SHIFT, ocd_parameters[0],
 						ocd_parameters[1]);
 
-					chnRead(con->sdu, g_sbuf,((num_sequences+7)/8)*2);
+					cread(con, buffer,((num_sequences+7)/8)*2);
 					i=0;
 					while(num_sequences>0) {
 						bits = (num_sequences > 8) ? 8 : num_sequences;
@@ -752,6 +760,8 @@ void openOCD(t_hydra_console *con)
 			}
 		}
 	}
+
+	sbuf_free(con, buffer);
 }
 
 void jtag_enter_openocd(t_hydra_console *con)
@@ -18,8 +18,12 @@
  */
 
 #include "hydrabus_mode_spi.h"
+#include "hydrabus_spi_flash.h"
 #include "bsp_spi.h"
 #include "common.h"
+#include "microsd.h"
+#include "sbuf.h"
+#include <stdio.h>
 #include <string.h>
 
 static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
@@ -35,6 +39,14 @@ static const char* str_prompt_spi1= { "spi1" PROMPT };
 static const char* str_prompt_spi2= { "spi2" PROMPT };
 
 static const char* str_bsp_init_err= { "bsp_spi_init() error %d\r\n" };
+static const char* str_no_flash= { "No SPI flash found.\r\n" };
+
+/* 'flash dump' state, passed to the block callback */
+typedef struct {
+	FIL file;
+	bool to_sd;
+	uint32_t crc;
+} t_spi_dump;
 
 #define MODE_DEV_NB_ARGC ((int)ARRAY_SIZE(mode_dev_arg)) /* Number of arguments/parameters for this mode */
 
@@ -107,6 +119,134 @@ static void show_params(t_hydra_console *con)
 		proto->config.spi.dev_bit_lsb_msb == DEV_FIRSTBIT_MSB ? "MSB" : "LSB");
 }
 
+static void show_flash_id(t_hydra_console *con)
+{
+	t_spi_flash flash;
+
+	if (!spi_flash_probe(con, &flash)) {
+		cprintf(con, str_no_flash);
+		return;
+	}
+
+	cprintf(con, "JEDEC ID: 0x%02X 0x%02X 0x%02X\r\n",
+		flash.jedec_id[0], flash.jedec_id[1], flash.jedec_id[2]);
+	if (flash.size)
+		cprintf(con, "Size: %lu bytes\r\n", flash.size);
+	else
+		cprintf(con, "Size: unknown\r\n");
+	if (flash.erase_size)
+		cprintf(con, "Erase size: %lu bytes\r\n", flash.erase_size);
+	cprintf(con, "Address bytes: %d\r\nGeometry from: %s\r\n",
+		flash.addr_bytes, flash.sfdp ? "SFDP" : "JEDEC ID");
+}
+
+static bool dump_block(t_hydra_console *con, uint8_t *data, uint32_t nb_data,
+		       void *arg)
+{
+	t_spi_dump *dump = arg;
+	UINT written;
+
+	if (hydrabus_ubtn()) {
+		cprintf(con, "Aborted.\r\n");
+		return FALSE;
+	}
+	dump->crc = spi_flash_crc32(dump->crc, data, nb_data);
+	if (dump->to_sd &&
+	    (f_write(&dump->file, data, nb_data, &written) != FR_OK ||
+	     written != nb_data)) {
+		cprintf(con, "Error writing file.\r\n");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* Parses the dump arguments and runs it, returns the tokens used */
+static int dump_flash(t_hydra_console *con, t_tokenline_parsed *p,
+		      int token_pos)
+{
+	t_spi_flash flash;
+	t_spi_dump dump;
+	filename_t sd_file;
+	uint32_t addr, len, start, elapsed;
+	uint8_t *buf;
+	int t, str_offset;
+	bsp_status_t status;
+
+	addr = 0;
+	len = 0;
+	dump.to_sd = FALSE;
+	for (t = token_pos; p->tokens[t]; t++) {
+		if (p->tokens[t] == T_ADDRESS) {
+			t += 2;
+			memcpy(&addr, p->buf + p->tokens[t], sizeof(int));
+		} else if (p->tokens[t] == T_LENGTH) {
+			t += 2;
+			memcpy(&len, p->buf + p->tokens[t], sizeof(int));
+		} else if (p->tokens[t] == T_FILE) {
+			t += 2;
+			memcpy(&str_offset, &p->tokens[t], sizeof(int));
+			snprintf(sd_file.filename, FILENAME_SIZE, "0:%s",
+				 p->buf + str_offset);
+			dump.to_sd = TRUE;
+		} else {
+			break;
+		}
+	}
+
+	if (dump.to_sd && is_file_present(sd_file.filename)) {
+		cprintf(con, "File %s already exists.\r\n", sd_file.filename);
+		return t - token_pos;
+	}
+	if (!spi_flash_probe(con, &flash)) {
+		cprintf(con, str_no_flash);
+		return t - token_pos;
+	}
+	if (len == 0 && flash.size > addr)
+		len = flash.size - addr;
+	if (!spi_flash_check_range(&flash, addr, len)) {
+		cprintf(con, "Invalid address or length.\r\n");
+		return t - token_pos;
+	}
+
+	buf = sbuf_alloc(con, SBUF_RAM, 2 * SPI_FLASH_BLOCK_SIZE);
+	if (buf == NULL) {
+		cprintf(con, "Not enough memory.\r\n");
+		return t - token_pos;
+	}
+	if (dump.to_sd) {
+		if (!file_open(&dump.file, sd_file.filename, 'w')) {
+			cprintf(con, "Cannot open file %s\r\n", sd_file.filename);
+			sbuf_free(con, buf);
+			return t - token_pos;
+		}
+		if (!file_preallocate(&dump.file, len)) {
+			cprintf(con, "Not enough space on microSD.\r\n");
+			file_close(&dump.file);
+			sbuf_free(con, buf);
+			return t - token_pos;
+		}
+	}
+
+	cprintf(con, "Dumping %lu bytes from 0x%08lX\r\n", len, addr);
+	dump.crc = 0;
+	start = chVTGetSystemTime();
+	status = spi_flash_dump(con, &flash, addr, len, buf, dump_block, &dump);
+	elapsed = TIME_I2MS(chVTGetSystemTime() - start);
+
+	if (dump.to_sd)
+		file_close(&dump.file);
+	sbuf_free(con, buf);
+
+	if (status == BSP_OK) {
+		cprintf(con, "CRC32: 0x%08lX\r\nTime: %lu ms\r\n",
+			dump.crc, elapsed);
+	} else {
+		cprintf(con, "Dump failed.\r\n");
+	}
+
+	return t - token_pos;
+}
+
 static int init(t_hydra_console *con, t_tokenline_parsed *p)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -227,6 +367,12 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 			proto->config.spi.dev_phase = arg_int;
 			bsp_spi_init(proto->dev_num, proto);
 			break;
+		case T_ID:
+			show_flash_id(con);
+			break;
+		case T_DUMP:
+			t += dump_flash(con, p, t + 1);
+			break;
 		case T_MSB_FIRST:
 			proto->config.spi.dev_bit_lsb_msb = DEV_FIRSTBIT_MSB;
 			bsp_status = bsp_spi_init(proto->dev_num, proto);
@@ -343,6 +489,52 @@ static uint32_t write_read(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_d
 	return status;
 }
 
+static uint32_t bulk_write(t_hydra_console *con, uint8_t *tx_data, uint32_t nb_data)
+{
+	uint32_t status, len;
+	mode_config_proto_t* proto = &con->mode->proto;
+
+	status = BSP_OK;
+	while (nb_data > 0 && status == BSP_OK) {
+		len = (nb_data > HYDRABUS_MODE_BULK_CHUNK) ? HYDRABUS_MODE_BULK_CHUNK : nb_data;
+		status = bsp_spi_write_u8(proto->dev_num, tx_data, len);
+		tx_data += len;
+		nb_data -= len;
+	}
+	return status;
+}
+
+static uint32_t bulk_read(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
+{
+	uint32_t status, len;
+	mode_config_proto_t* proto = &con->mode->proto;
+
+	status = BSP_OK;
+	while (nb_data > 0 && status == BSP_OK) {
+		len = (nb_data > HYDRABUS_MODE_BULK_CHUNK) ? HYDRABUS_MODE_BULK_CHUNK : nb_data;
+		status = bsp_spi_read_u8(proto->dev_num, rx_data, len);
+		rx_data += len;
+		nb_data -= len;
+	}
+	return status;
+}
+
+static uint32_t bulk_write_read(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_data, uint32_t nb_data)
+{
+	uint32_t status, len;
+	mode_config_proto_t* proto = &con->mode->proto;
+
+	status = BSP_OK;
+	while (nb_data > 0 && status == BSP_OK) {
+		len = (nb_data > HYDRABUS_MODE_BULK_CHUNK) ? HYDRABUS_MODE_BULK_CHUNK : nb_data;
+		status = bsp_spi_write_read_u8(proto->dev_num, tx_data, rx_data, len);
+		tx_data += len;
+		rx_data += len;
+		nb_data -= len;
+	}
+	return status;
+}
+
 static void cleanup(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -388,6 +580,9 @@ const mode_exec_t mode_spi_exec = {
 	.read = &read,
 	.dump = &dump,
 	.write_read = &write_read,
+	.bulk_write = &bulk_write,
+	.bulk_read = &bulk_read,
+	.bulk_write_read = &bulk_write_read,
 	.cleanup = &cleanup,
 	.get_prompt = &get_prompt,
 };
@@ -386,6 +386,36 @@ static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
 	return BSP_OK;
 }
 
+static uint32_t bulk_write(t_hydra_console *con, uint8_t *tx_data, uint32_t nb_data)
+{
+	uint32_t i;
+
+	for(i = 0; i < nb_data; i++) {
+		threewire_write_u8(con, tx_data[i]);
+	}
+	return BSP_OK;
+}
+
+static uint32_t bulk_read(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
+{
+	uint32_t i;
+
+	for(i = 0; i < nb_data; i++) {
+		rx_data[i] = threewire_read_u8(con);
+	}
+	return BSP_OK;
+}
+
+static uint32_t bulk_write_read(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_data, uint32_t nb_data)
+{
+	uint32_t i;
+
+	for(i = 0; i < nb_data; i++) {
+		rx_data[i] = threewire_write_read_u8(con, tx_data[i]);
+	}
+	return BSP_OK;
+}
+
 void threewire_cleanup(t_hydra_console *con)
 {
 	(void)con;
@@ -421,6 +451,9 @@ const mode_exec_t mode_threewire_exec = {
 	.read = &read,
 	.dump = &dump,
 	.write_read = &write_read,
+	.bulk_write = &bulk_write,
+	.bulk_read = &bulk_read,
+	.bulk_write_read = &bulk_write_read,
 	.cleanup = &threewire_cleanup,
 	.get_prompt = &get_prompt,
 	.clkl = &clkl,
@@ -470,6 +470,26 @@ static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
 	return BSP_OK;
 }
 
+static uint32_t bulk_write(t_hydra_console *con, uint8_t *tx_data, uint32_t nb_data)
+{
+	uint32_t i;
+
+	for(i = 0; i < nb_data; i++) {
+		twowire_write_u8(con, tx_data[i]);
+	}
+	return BSP_OK;
+}
+
+static uint32_t bulk_read(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
+{
+	uint32_t i;
+
+	for(i = 0; i < nb_data; i++) {
+		rx_data[i] = twowire_read_u8(con);
+	}
+	return BSP_OK;
+}
+
 void twowire_cleanup(t_hydra_console *con)
 {
 	(void)con;
@@ -504,6 +524,8 @@ const mode_exec_t mode_twowire_exec = {
 	.write = &write,
 	.read = &read,
 	.dump = &dump,
+	.bulk_write = &bulk_write,
+	.bulk_read = &bulk_read,
 	.cleanup = &twowire_cleanup,
 	.get_prompt = &get_prompt,
 	.clkl = &clkl,
@@ -90,20 +90,16 @@ static THD_FUNCTION(bridge_thread, arg)
 	con = arg;
 	chRegSetThreadName("UART reader");
 	chThdSleepMilliseconds(10);
-	uint8_t bytes_read;
+	uint32_t bytes_read;
 	mode_config_proto_t* proto = &con->mode->proto;
 
-	while (!hydrabus_ubtn()) {
-		if(bsp_uart_rxne(proto->dev_num)) {
-			bytes_read = bsp_uart_read_u8_timeout(proto->dev_num,
-							      proto->buffer_rx,
-							      UART_BRIDGE_BUFF_SIZE,
-							      TIME_US2I(100));
-			if(bytes_read > 0) {
-				cprint(con, (char *)proto->buffer_rx, bytes_read);
-			}
-		} else {
-			chThdYield();
+	while (!chThdShouldTerminateX()) {
+		bytes_read = bsp_uart_rx_dma_read(proto->dev_num,
+						  proto->buffer_rx,
+						  sizeof(proto->buffer_rx),
+						  TIME_MS2I(10));
+		if(bytes_read > 0) {
+			cprint(con, (char *)proto->buffer_rx, bytes_read);
 		}
 	}
 }
@@ -111,23 +107,33 @@ static THD_FUNCTION(bridge_thread, arg)
 static void bridge(t_hydra_console *con)
 {
 	uint8_t bytes_read;
-	//uint8_t bytes_read;
+	uint32_t lost;
 	mode_config_proto_t* proto = &con->mode->proto;
 
+	if(bsp_uart_rx_dma_start(proto->dev_num) != BSP_OK) {
+		cprintf(con, "UART RX DMA stream busy.\r\n");
+		return;
+	}
+
 	cprintf(con, "Interrupt by pressing user button.\r\n");
 	cprint(con, "\r\n", 2);
 
 	thread_t *bthread = chThdCreateFromHeap(NULL, CONSOLE_WA_SIZE, "bridge_thread",
 						LOWPRIO, bridge_thread, con);
 	while(!hydrabus_ubtn()) {
-		bytes_read = chnReadTimeout(con->sdu, proto->buffer_tx,
-					    UART_BRIDGE_BUFF_SIZE, TIME_US2I(100));
+		bytes_read = cread_timeout(con, proto->buffer_tx,
+					  UART_BRIDGE_BUFF_SIZE, TIME_US2I(100));
 		if(bytes_read > 0) {
 			bsp_uart_write_u8(proto->dev_num, proto->buffer_tx, bytes_read);
 		}
 	}
 	chThdTerminate(bthread);
 	chThdWait(bthread);
+
+	lost = bsp_uart_rx_dma_lost(proto->dev_num);
+	bsp_uart_rx_dma_stop(proto->dev_num);
+	if(lost > 0)
+		cprintf(con, "\r\n%lu bytes lost\r\n", lost);
 }
 
 static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
@@ -316,6 +322,52 @@ static uint32_t write_read(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_d
 	return status;
 }
 
+static uint32_t bulk_write(t_hydra_console *con, uint8_t *tx_data, uint32_t nb_data)
+{
+	uint32_t status, len;
+	mode_config_proto_t* proto = &con->mode->proto;
+
+	status = BSP_OK;
+	while (nb_data > 0 && status == BSP_OK) {
+		len = (nb_data > HYDRABUS_MODE_BULK_CHUNK) ? HYDRABUS_MODE_BULK_CHUNK : nb_data;
+		status = bsp_uart_write_u8(proto->dev_num, tx_data, len);
+		tx_data += len;
+		nb_data -= len;
+	}
+	return status;
+}
+
+static uint32_t bulk_read(t_hydra_console *con, uint8_t *rx_data, uint32_t nb_data)
+{
+	uint32_t status, len;
+	mode_config_proto_t* proto = &con->mode->proto;
+
+	status = BSP_OK;
+	while (nb_data > 0 && status == BSP_OK) {
+		len = (nb_data > HYDRABUS_MODE_BULK_CHUNK) ? HYDRABUS_MODE_BULK_CHUNK : nb_data;
+		status = bsp_uart_read_u8(proto->dev_num, rx_data, len);
+		rx_data += len;
+		nb_data -= len;
+	}
+	return status;
+}
+
+static uint32_t bulk_write_read(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_data, uint32_t nb_data)
+{
+	uint32_t status, len;
+	mode_config_proto_t* proto = &con->mode->proto;
+
+	status = BSP_OK;
+	while (nb_data > 0 && status == BSP_OK) {
+		len = (nb_data > HYDRABUS_MODE_BULK_CHUNK) ? HYDRABUS_MODE_BULK_CHUNK : nb_data;
+		status = bsp_uart_write_read_u8(proto->dev_num, tx_data, rx_data, len);
+		tx_data += len;
+		rx_data += len;
+		nb_data -= len;
+	}
+	return status;
+}
+
 static void cleanup(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -353,6 +405,9 @@ const mode_exec_t mode_uart_exec = {
 	.read = &read,
 	.dump = &dump,
 	.write_read = &write_read,
+	.bulk_write = &bulk_write,
+	.bulk_read = &bulk_read,
+	.bulk_write_read = &bulk_write_read,
 	.cleanup = &cleanup,
 	.get_prompt = &get_prompt,
 };
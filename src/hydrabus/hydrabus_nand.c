@@ -0,0 +1,439 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common.h"
+#include <string.h>
+
+#include "hydrabus_mode_flash.h"
+#include "hydrabus_nand.h"
+
+/* Data area size of the common 8bits devices, by device ID */
+static const struct {
+	uint8_t dev_id;
+	uint8_t small_page; /* 512 + 16 bytes pages, 32 pages per block */
+	uint16_t size_mb;
+} nand_devices[] = {
+	{ 0x73, 1, 16 },
+	{ 0x75, 1, 32 },
+	{ 0x76, 1, 64 },
+	{ 0x79, 1, 128 },
+	{ 0xF1, 0, 128 },
+	{ 0xA1, 0, 128 },
+	{ 0xDA, 0, 256 },
+	{ 0xAA, 0, 256 },
+	{ 0xDC, 0, 512 },
+	{ 0xAC, 0, 512 },
+	{ 0xD3, 0, 1024 },
+	{ 0xA3, 0, 1024 },
+	{ 0xD5, 0, 2048 },
+	{ 0xA5, 0, 2048 },
+};
+
+/* Page consumer, runs in its own thread while the next page is read */
+typedef struct {
+	t_hydra_console *con;
+	const t_nand *nand;
+	uint8_t flags;
+	nand_page_cb_t cb;
+	uint8_t *page[2];
+	uint32_t first_page;
+	uint32_t page_size;
+	uint32_t nb_pages;
+	semaphore_t full;
+	semaphore_t empty;
+	volatile bool abort;
+} t_nand_writer;
+
+static uint16_t le16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t le32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* ONFI CRC-16, polynomial 0x8005, initial value 0x4F4E */
+static uint16_t onfi_crc16(const uint8_t *data, uint32_t nb_data)
+{
+	uint16_t crc = 0x4F4E;
+	int bit;
+
+	while (nb_data--) {
+		crc ^= *data++ << 8;
+		for (bit = 0; bit < 8; bit++)
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x8005 : (crc << 1);
+	}
+	return crc;
+}
+
+/**
+ * @brief   Parses an ONFI parameter page
+ *
+ * @param[in] param		parameter page, NAND_ONFI_PARAM_SIZE bytes
+ * @param[out] nand		NAND description, only updated if valid
+ *
+ * @return			FALSE if the signature or CRC is wrong.
+ */
+bool nand_parse_onfi(const uint8_t *param, t_nand *nand)
+{
+	int i;
+
+	if (memcmp(param, "ONFI", 4) != 0)
+		return FALSE;
+	if (onfi_crc16(param, NAND_ONFI_PARAM_SIZE - 2) !=
+	    le16(&param[NAND_ONFI_PARAM_SIZE - 2]))
+		return FALSE;
+
+	nand->onfi = TRUE;
+	nand->data_size = le32(&param[80]);
+	nand->page_size = nand->data_size + le16(&param[84]);
+	nand->pages_per_block = le32(&param[92]);
+	/* Blocks per LUN, number of LUNs */
+	nand->nb_blocks = le32(&param[96]) * param[100];
+	nand->row_cycles = param[101] & 0x0F;
+	nand->col_cycles = param[101] >> 4;
+	nand->ecc_bits = param[112];
+
+	memcpy(nand->model, &param[44], 20);
+	nand->model[20] = 0;
+	for (i = 19; i >= 0 && nand->model[i] == ' '; i--)
+		nand->model[i] = 0;
+
+	return TRUE;
+}
+
+/**
+ * @brief   Reads the ID and the geometry
+ * @note    The geometry is read from the ONFI parameter page (first copy
+ *          with a valid CRC). Otherwise the large page geometry is decoded
+ *          from the 4th ID byte, the size from the device ID. For unknown
+ *          devices nb_blocks is 0 and the row address cycles are taken
+ *          from the mode configuration.
+ *
+ * @param[in] con		console
+ * @param[out] nand		NAND description
+ *
+ * @return			FALSE if no device answered.
+ */
+bool nand_probe(t_hydra_console *con, t_nand *nand)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	uint8_t param[NAND_ONFI_PARAM_SIZE];
+	uint32_t i;
+	uint64_t nb_pages;
+
+	memset(nand, 0, sizeof(t_nand));
+	flash_read_id(con, 0x00, nand->id, sizeof(nand->id));
+	if (nand->id[0] == 0x00 || nand->id[0] == 0xFF)
+		return FALSE;
+
+	flash_read_id(con, 0x20, param, 4);
+	if (memcmp(param, "ONFI", 4) == 0) {
+		for (i = 0; i < NAND_ONFI_PARAM_COPIES; i++) {
+			flash_read_param_page(con, i, param, NAND_ONFI_PARAM_SIZE);
+			if (nand_parse_onfi(param, nand))
+				return TRUE;
+		}
+	}
+
+	nand->col_cycles = 2;
+	nand->row_cycles = proto->config.flash.dev_numbits;
+	nand->data_size = 1024 << (nand->id[3] & 0b11);
+	nand->page_size = nand->data_size + (nand->data_size / 512) * (8 << ((nand->id[3] >> 2) & 1));
+	nand->pages_per_block = (65536 << ((nand->id[3] >> 4) & 0b11)) / nand->data_size;
+
+	for (i = 0; i < ARRAY_SIZE(nand_devices); i++) {
+		if (nand_devices[i].dev_id != nand->id[1])
+			continue;
+		if (nand_devices[i].small_page) {
+			nand->col_cycles = 1;
+			nand->data_size = 512;
+			nand->page_size = 512 + 16;
+			nand->pages_per_block = 32;
+		}
+		nb_pages = ((uint64_t)nand_devices[i].size_mb << 20) / nand->data_size;
+		nand->nb_blocks = nb_pages / nand->pages_per_block;
+		nand->row_cycles = (nb_pages > 65536) ? 3 : 2;
+		break;
+	}
+
+	return TRUE;
+}
+
+bool nand_check_geometry(const t_nand *nand)
+{
+	if (nand->col_cycles < 1 || nand->col_cycles > 2)
+		return FALSE;
+	if (nand->row_cycles < 1 || nand->row_cycles > 3)
+		return FALSE;
+	if (nand->data_size == 0 || nand->data_size > nand->page_size)
+		return FALSE;
+	if (nand->pages_per_block == 0)
+		return FALSE;
+	return (nand->page_size <= NAND_MAX_PAGE_SIZE);
+}
+
+/*
+ * ECC layouts of the Linux software Hamming ECC: small page at spare
+ * bytes 0-3 and 6-7, large page from byte 40 (64 bytes spare) or 80
+ * (128 bytes spare).
+ */
+bool nand_ecc_supported(const t_nand *nand)
+{
+	uint32_t spare = nand->page_size - nand->data_size;
+
+	if (nand->data_size == 512)
+		return (spare == 16);
+	if (spare == 64)
+		return (nand->data_size == 2048);
+	if (spare == 128)
+		return (nand->data_size == 2048 || nand->data_size == 4096);
+	return FALSE;
+}
+
+static uint32_t ecc_offset(const t_nand *nand, uint32_t i)
+{
+	uint32_t spare = nand->page_size - nand->data_size;
+
+	if (spare == 16)
+		return (i < 4) ? i : i + 2;
+	return ((spare == 64) ? 40 : 80) + i;
+}
+
+static uint8_t parity8(uint8_t v)
+{
+	v ^= v >> 4;
+	v ^= v >> 2;
+	v ^= v >> 1;
+	return v & 1;
+}
+
+/**
+ * @brief   Computes the 1 bit Hamming ECC of a 256 bytes step
+ * @note    Same byte order as the Linux software ECC: line parities 15-8,
+ *          line parities 7-0, column parities 5-0, all inverted.
+ *
+ * @param[in] data		NAND_ECC_STEP_SIZE bytes
+ * @param[out] ecc		NAND_ECC_BYTES bytes
+ */
+void nand_ecc_calc(const uint8_t *data, uint8_t *ecc)
+{
+	uint8_t all, odd[8];
+	uint32_t i, lp, cp;
+	int bit;
+
+	/* XOR of all bytes, and of the bytes with address bit n set */
+	all = 0;
+	memset(odd, 0, sizeof(odd));
+	for (i = 0; i < NAND_ECC_STEP_SIZE; i++) {
+		all ^= data[i];
+		for (bit = 0; bit < 8; bit++) {
+			if (i & (1 << bit))
+				odd[bit] ^= data[i];
+		}
+	}
+
+	/* Line parity 2n+1 covers address bit n set, 2n address bit n clear */
+	lp = 0;
+	for (bit = 0; bit < 8; bit++) {
+		lp |= parity8(odd[bit]) << (2 * bit + 1);
+		lp |= parity8(all ^ odd[bit]) << (2 * bit);
+	}
+	cp = parity8(all & 0x55) | (parity8(all & 0xAA) << 1) |
+	     (parity8(all & 0x33) << 2) | (parity8(all & 0xCC) << 3) |
+	     (parity8(all & 0x0F) << 4) | (parity8(all & 0xF0) << 5);
+
+	ecc[0] = ~(lp >> 8);
+	ecc[1] = ~lp;
+	ecc[2] = ~(cp << 2);
+}
+
+/**
+ * @brief   Corrects a 256 bytes step
+ *
+ * @param[in,out] data		NAND_ECC_STEP_SIZE bytes
+ * @param[in] stored_ecc	ECC read from the spare area
+ * @param[in] calc_ecc		ECC computed by nand_ecc_calc()
+ *
+ * @return			0 no error, 1 single bit error corrected (in
+ *				data or ECC), -1 uncorrectable.
+ */
+int nand_ecc_correct(uint8_t *data, const uint8_t *stored_ecc,
+		     const uint8_t *calc_ecc)
+{
+	uint32_t lp, cp, diff, byte;
+	int bit, nb_bits;
+
+	lp = ((stored_ecc[0] ^ calc_ecc[0]) << 8) | (stored_ecc[1] ^ calc_ecc[1]);
+	cp = (stored_ecc[2] ^ calc_ecc[2]) >> 2;
+	if (lp == 0 && cp == 0)
+		return 0;
+
+	/* Single data bit error, one bit of each parity pair is flipped */
+	if (((lp ^ (lp >> 1)) & 0x5555) == 0x5555 &&
+	    ((cp ^ (cp >> 1)) & 0x15) == 0x15) {
+		byte = 0;
+		for (bit = 0; bit < 8; bit++) {
+			if (lp & (1 << (2 * bit + 1)))
+				byte |= 1 << bit;
+		}
+		bit = ((cp >> 1) & 1) | ((cp >> 2) & 2) | ((cp >> 3) & 4);
+		data[byte] ^= 1 << bit;
+		return 1;
+	}
+
+	/* Single bit error in the ECC itself */
+	diff = (lp << 6) | cp;
+	for (nb_bits = 0; diff; diff &= diff - 1)
+		nb_bits++;
+	return (nb_bits == 1) ? 1 : -1;
+}
+
+/**
+ * @brief   Checks the bad block marker and the ECC of a page
+ *
+ * @param[in] nand		NAND geometry, pages_per_block shall be set
+ * @param[in] page		page (row address)
+ * @param[in,out] data		page, data and spare areas, corrected in place
+ * @param[in] flags		NAND_DUMP_ECC to check and correct the data,
+ *				nand_ecc_supported() shall be TRUE
+ *
+ * @return			NAND_PAGE_x status flags.
+ */
+uint8_t nand_check_page(const t_nand *nand, uint32_t page, uint8_t *data,
+			uint8_t flags)
+{
+	uint8_t *spare = data + nand->data_size;
+	uint8_t stored[NAND_ECC_BYTES], calc[NAND_ECC_BYTES];
+	uint8_t status;
+	uint32_t step, i;
+
+	status = 0;
+	/*
+	 * Factory marker, 6th spare byte on small page devices, in the first
+	 * or second page of the block. The other pages use this byte for
+	 * filesystem metadata.
+	 */
+	if ((page % nand->pages_per_block) < 2 &&
+	    spare[(nand->data_size == 512) ? 5 : 0] != 0xFF)
+		status |= NAND_PAGE_BAD_BLOCK;
+
+	if (!(flags & NAND_DUMP_ECC))
+		return status;
+
+	for (step = 0; step < nand->data_size / NAND_ECC_STEP_SIZE; step++) {
+		for (i = 0; i < NAND_ECC_BYTES; i++)
+			stored[i] = spare[ecc_offset(nand, step * NAND_ECC_BYTES + i)];
+		nand_ecc_calc(&data[step * NAND_ECC_STEP_SIZE], calc);
+		switch (nand_ecc_correct(&data[step * NAND_ECC_STEP_SIZE],
+					 stored, calc)) {
+		case 1:
+			status |= NAND_PAGE_ECC_CORRECTED;
+			break;
+		case -1:
+			status |= NAND_PAGE_ECC_FAILED;
+			break;
+		}
+	}
+
+	return status;
+}
+
+static THD_FUNCTION(nand_writer_thread, arg)
+{
+	t_nand_writer *w = (t_nand_writer *)arg;
+	uint32_t i;
+	uint8_t status;
+
+	chRegSetThreadName("nand_writer");
+
+	for (i = 0; i < w->nb_pages; i++) {
+		chSemWait(&w->full);
+		status = nand_check_page(w->nand, w->first_page + i,
+					 w->page[i & 1], w->flags);
+		if (!w->cb(w->con, w->page[i & 1], w->page_size, status)) {
+			w->abort = TRUE;
+			chSemSignal(&w->empty);
+			break;
+		}
+		chSemSignal(&w->empty);
+	}
+}
+
+/**
+ * @brief   Reads consecutive NAND pages, data and spare areas
+ * @note    Pages are read in one buffer while the callback processes the
+ *          other one from a higher priority thread, so that USB or SD
+ *          transfers overlap the bus reads. The bad block marker and ECC
+ *          are checked in the same thread, before the callback.
+ *
+ * @param[in] con		console
+ * @param[in] nand		NAND geometry, checked by nand_check_geometry()
+ * @param[in] page		first page (row address)
+ * @param[in] nb_pages		number of pages
+ * @param[in] flags		NAND_DUMP_x flags
+ * @param[in] buf		2 * nand->page_size bytes
+ * @param[in] cb		page callback
+ *
+ * @return			BSP_OK, BSP_ERROR if the callback aborted the
+ *				dump or the thread could not be started.
+ */
+bsp_status_t nand_dump(t_hydra_console *con, const t_nand *nand,
+		       uint32_t page, uint32_t nb_pages, uint8_t flags,
+		       uint8_t *buf, nand_page_cb_t cb)
+{
+	t_nand_writer w;
+	thread_t *thread;
+	uint32_t i;
+
+	if (nb_pages == 0)
+		return BSP_OK;
+
+	w.con = con;
+	w.nand = nand;
+	w.flags = flags;
+	w.cb = cb;
+	w.page[0] = buf;
+	w.page[1] = buf + nand->page_size;
+	w.first_page = page;
+	w.page_size = nand->page_size;
+	w.nb_pages = nb_pages;
+	w.abort = FALSE;
+	chSemObjectInit(&w.full, 0);
+	chSemObjectInit(&w.empty, 2);
+
+	thread = chThdCreateFromHeap(NULL, CONSOLE_WA_SIZE, "nand_writer",
+				     chThdGetPriorityX() + 1,
+				     nand_writer_thread, &w);
+	if (thread == NULL)
+		return BSP_ERROR;
+
+	for (i = 0; i < nb_pages; i++) {
+		chSemWait(&w.empty);
+		if (w.abort)
+			break;
+		flash_read_page(con, nand->col_cycles, nand->row_cycles,
+				page + i, w.page[i & 1], nand->page_size);
+		chSemSignal(&w.full);
+	}
+	chThdWait(thread);
+
+	return w.abort ? BSP_ERROR : BSP_OK;
+}
@@ -0,0 +1,73 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRABUS_NAND_H_
+#define _HYDRABUS_NAND_H_
+
+#include "common.h"
+#include "bsp.h"
+
+/* Data and spare areas, up to 8KB pages */
+#define NAND_MAX_PAGE_SIZE	(8192 + 1024)
+
+#define NAND_ONFI_PARAM_SIZE	(256)
+#define NAND_ONFI_PARAM_COPIES	(3)
+
+/* 1 bit Hamming ECC (Linux software ECC), 3 bytes per 256 bytes step */
+#define NAND_ECC_STEP_SIZE	(256)
+#define NAND_ECC_BYTES		(3)
+
+/* nand_dump() flags */
+#define NAND_DUMP_ECC		(1 << 0)
+
+/* Page status, passed to the page callback */
+#define NAND_PAGE_BAD_BLOCK	(1 << 0) /* Bad block marker set, pages 0-1 of a block */
+#define NAND_PAGE_ECC_CORRECTED	(1 << 1)
+#define NAND_PAGE_ECC_FAILED	(1 << 2) /* Uncorrectable */
+
+typedef struct {
+	uint8_t id[5];
+	bool onfi; /* Geometry read from the ONFI parameter page */
+	char model[21]; /* ONFI device model */
+	uint8_t ecc_bits; /* ONFI required ECC bits, 0 if unknown */
+	uint8_t col_cycles; /* 1 (small page) or 2 */
+	uint8_t row_cycles; /* 2 or 3 */
+	uint32_t data_size; /* Data bytes */
+	uint32_t page_size; /* Data and spare bytes */
+	uint32_t pages_per_block;
+	uint32_t nb_blocks; /* 0 if unknown */
+} t_nand;
+
+/* Called for each page read, returns FALSE to abort the dump */
+typedef bool (*nand_page_cb_t)(t_hydra_console *con, uint8_t *data,
+			       uint32_t nb_data, uint8_t status);
+
+bool nand_probe(t_hydra_console *con, t_nand *nand);
+bool nand_parse_onfi(const uint8_t *param, t_nand *nand);
+bool nand_check_geometry(const t_nand *nand);
+bool nand_ecc_supported(const t_nand *nand);
+void nand_ecc_calc(const uint8_t *data, uint8_t *ecc);
+int nand_ecc_correct(uint8_t *data, const uint8_t *stored_ecc,
+		     const uint8_t *calc_ecc);
+uint8_t nand_check_page(const t_nand *nand, uint32_t page, uint8_t *data,
+			uint8_t flags);
+bsp_status_t nand_dump(t_hydra_console *con, const t_nand *nand,
+		       uint32_t page, uint32_t nb_pages, uint8_t flags,
+		       uint8_t *buf, nand_page_cb_t cb);
+
+#endif /* _HYDRABUS_NAND_H_ */
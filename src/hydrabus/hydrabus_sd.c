@@ -30,6 +30,7 @@
 #include "microsd.h"
 #include "hydrabus_sd.h"
 #include "common.h"
+#include "sbuf.h"
 
 #include "script.h"
 
@@ -162,17 +163,35 @@ static FRESULT sd_dir_list(t_hydra_console *con, char *path)
 	return res;
 }
 
+#define SD_PATH_SIZE (SBUF_CCM_BLOCK_SIZE)
+#define SD_MKFS_WORK_SIZE (4 * SBUF_RAM_BLOCK_SIZE)
+
+static char *sd_path_alloc(t_hydra_console *con)
+{
+	char *path;
+
+	path = sbuf_alloc(con, SBUF_CCM, SD_PATH_SIZE);
+	if (path == NULL)
+		cprintf(con, "No scratch buffer available.\r\n");
+
+	return path;
+}
+
 /* cd [<path>] - change directory */
 int cmd_sd_cd(t_hydra_console *con, t_tokenline_parsed *p)
 {
 	FRESULT err;
 	int offset;
+	char *path;
 
 	if (p->tokens[2] != T_ARG_STRING || p->tokens[4] != 0)
 		return FALSE;
 
+	if ((path = sd_path_alloc(con)) == NULL)
+		return FALSE;
+
 	memcpy(&offset, &p->tokens[3], sizeof(int));
-	snprintf((char *)fbuff, FILENAME_SIZE, "0:%s", p->buf + offset);
+	snprintf(path, FILENAME_SIZE, "0:%s", p->buf + offset);
 
 	if (!is_fs_ready()) {
 		err = mount();
@@ -182,7 +201,7 @@ int cmd_sd_cd(t_hydra_console *con, t_tokenline_parsed *p)
 		}
 	}
 
-	err = f_chdir((char *)fbuff);
+	err = f_chdir(path);
 	if(err) {
 		cprintf(con, "Failed: error %d.\r\n", err);
 	}
@@ -194,9 +213,13 @@ int cmd_sd_cd(t_hydra_console *con, t_tokenline_parsed *p)
 int cmd_sd_pwd(t_hydra_console *con, t_tokenline_parsed *p)
 {
 	FRESULT err;
+	char *path;
 
 	(void)p;
 
+	if ((path = sd_path_alloc(con)) == NULL)
+		return FALSE;
+
 	if (!is_fs_ready()) {
 		err = mount();
 		if(err != 0) {
@@ -205,12 +228,12 @@ int cmd_sd_pwd(t_hydra_console *con, t_tokenline_parsed *p)
 		}
 	}
 
-	err = f_getcwd((char *)fbuff, sizeof(fbuff));
+	err = f_getcwd(path, SD_PATH_SIZE);
 	if(err) {
 		cprintf(con, "Failed: error %d.\r\n", err);
 		return FALSE;
 	}
-	cprintf(con, "%s\r\n", fbuff);
+	cprintf(con, "%s\r\n", path);
 
 	return TRUE;
 }
@@ -224,9 +247,13 @@ int cmd_sd_ls(t_hydra_console *con, t_tokenline_parsed *p)
 	uint64_t free_size_bytes;
 	uint32_t free_size_kb;
 	uint32_t free_size_mb;
+	char *path;
 
 	(void)p;
 
+	if ((path = sd_path_alloc(con)) == NULL)
+		return FALSE;
+
 	if (!is_fs_ready()) {
 		err = mount();
 		if(err != 0) {
@@ -235,7 +262,7 @@ int cmd_sd_ls(t_hydra_console *con, t_tokenline_parsed *p)
 		}
 	}
 
-	if ((err = f_getcwd((char *)fbuff, sizeof(fbuff))))
+	if ((err = f_getcwd(path, SD_PATH_SIZE)))
 		cprintf(con, "Failed to change directory: error %d.\r\n", err);
 
 	if ((err = f_getfree("/", &clusters, &fsp)) == FR_OK) {
@@ -247,7 +274,7 @@ int cmd_sd_ls(t_hydra_console *con, t_tokenline_parsed *p)
 		cprintf(con, "%lu KiBytes free (%lu MiBytes free)\r\n",
 			free_size_kb, free_size_mb);
 
-		err = sd_dir_list(con, (char *)fbuff);
+		err = sd_dir_list(con, path);
 		if (err != FR_OK) {
 			cprintf(con, "Directory list failed: error %d.\r\n", err);
 		}
@@ -312,7 +339,7 @@ int cmd_sd_cat(t_hydra_console *con, t_tokenline_parsed *p)
 			break;
 
 		if (hex) {
-			print_hex(con, inbuf, cnt);
+			print_hexdump(con, offset, inbuf, cnt);
 			offset += cnt;
 		} else {
 			cprint(con, (char *)inbuf, cnt);
@@ -330,6 +357,7 @@ int cmd_sd_cat(t_hydra_console *con, t_tokenline_parsed *p)
 int cmd_sd_erase(t_hydra_console *con, t_tokenline_parsed *p)
 {
 	uint32_t i = 0;
+	uint8_t *work;
 
 	if (p->tokens[2] == 0) {
 		cprintf(con, "This will destroy the contents of the SD card. "
@@ -505,10 +533,18 @@ int cmd_sd_erase(t_hydra_console *con, t_tokenline_parsed *p)
 			cprintf(con, "OK\r\n");
 		}
 
+		work = sbuf_alloc(con, SBUF_RAM, SD_MKFS_WORK_SIZE);
+		if (work == NULL) {
+			cprintf(con, "No scratch buffer available.\r\n");
+			umount();
+			return FALSE;
+		}
+
 		/* DESTRUCTIVE TEST START */
 		cprintf(con, "Formatting... ");
 		chThdSleepMilliseconds(10);
-		err = f_mkfs("", FM_ANY, 0, g_sbuf, NB_SBUFFER);
+		err = f_mkfs("", FM_ANY, 0, work, SD_MKFS_WORK_SIZE);
+		sbuf_free(con, work);
 		if (err != FR_OK) {
 			cprintf(con, "f_mkfs err:%d\r\n", err);
 			umount();
@@ -619,15 +655,19 @@ int cmd_sd_rm(t_hydra_console *con, t_tokenline_parsed *p)
 {
 	FRESULT err;
 	int offset;
+	char *path;
 
 	if (!is_fs_ready() && (err = mount())) {
 		cprintf(con, "Mount failed: error %d.\r\n", err);
 		return FALSE;
 	}
 
+	if ((path = sd_path_alloc(con)) == NULL)
+		return FALSE;
+
 	memcpy(&offset, &p->tokens[3], sizeof(int));
-	snprintf((char *)fbuff, FILENAME_SIZE, "0:%s", p->buf + offset);
-	if ((err = f_unlink((char *)fbuff))) {
+	snprintf(path, FILENAME_SIZE, "0:%s", p->buf + offset);
+	if ((err = f_unlink(path))) {
 		cprintf(con, "Failed: error %d.\r\n", err);
 		return FALSE;
 	}
@@ -639,15 +679,19 @@ int cmd_sd_mkdir(t_hydra_console *con, t_tokenline_parsed *p)
 {
 	FRESULT err;
 	int offset;
+	char *path;
 
 	if (!is_fs_ready() && (err = mount())) {
 		cprintf(con, "Mount failed: error %d.\r\n", err);
 		return FALSE;
 	}
 
+	if ((path = sd_path_alloc(con)) == NULL)
+		return FALSE;
+
 	memcpy(&offset, &p->tokens[3], sizeof(int));
-	snprintf((char *)fbuff, FILENAME_SIZE, "0:%s", p->buf + offset);
-	if ((err = f_mkdir((char *)fbuff))) {
+	snprintf(path, FILENAME_SIZE, "0:%s", p->buf + offset);
+	if ((err = f_mkdir(path))) {
 		cprintf(con, "Failed: error %d.\r\n", err);
 		return FALSE;
 	}
@@ -935,6 +979,7 @@ static void cmd_show_sd_csd(t_hydra_console *con, uint8_t *csd)
 
 int cmd_show_sd(t_hydra_console *con)
 {
+	uint8_t reg[16];
 	int i;
 	char *s;
 
@@ -960,12 +1005,12 @@ int cmd_show_sd(t_hydra_console *con)
 	cprintf(con, "%s\r\n", s);
 
 	for (i = 0; i < 16; i++)
-		buf[i] = *((uint8_t *)&SDCD1.cid + (15 - i));
-	cmd_show_sd_cid(con, buf);
+		reg[i] = *((uint8_t *)&SDCD1.cid + (15 - i));
+	cmd_show_sd_cid(con, reg);
 
 	for (i = 0; i < 16; i++)
-		buf[i] = *((uint8_t *)&SDCD1.csd + (15 - i));
-	cmd_show_sd_csd(con, buf);
+		reg[i] = *((uint8_t *)&SDCD1.csd + (15 - i));
+	cmd_show_sd_csd(con, reg);
 
 	print_padded(con, "Relative card address");
 	cprintf(con, "%04x\r\n", SDCD1.rca >> 16);
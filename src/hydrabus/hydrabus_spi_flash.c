@@ -0,0 +1,302 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common.h"
+#include <string.h>
+
+#include "hydrabus_spi_flash.h"
+
+#define SFDP_SIGNATURE		0x50444653 /* "SFDP" */
+#define SFDP_BFPT_DWORDS	(9)
+
+/* CRC-32 (IEEE 802.3, same as zlib), 4 bits at a time */
+static const uint32_t crc32_nibble[16] = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+	0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+	0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+/**
+ * @brief   Updates a CRC32
+ *
+ * @param[in] crc		CRC of the previous data, 0 to start
+ * @param[in] data		data
+ * @param[in] nb_data		data length
+ *
+ * @return			The updated CRC.
+ */
+uint32_t spi_flash_crc32(uint32_t crc, const uint8_t *data, uint32_t nb_data)
+{
+	crc = ~crc;
+	while (nb_data--) {
+		crc ^= *data++;
+		crc = (crc >> 4) ^ crc32_nibble[crc & 0x0F];
+		crc = (crc >> 4) ^ crc32_nibble[crc & 0x0F];
+	}
+	return ~crc;
+}
+
+static uint32_t le32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void read_sfdp(bsp_dev_spi_t dev_num, uint32_t addr, uint8_t *rx_data,
+		      uint8_t nb_data)
+{
+	uint8_t cmd[5];
+
+	cmd[0] = SPI_FLASH_CMD_READ_SFDP;
+	cmd[1] = addr >> 16;
+	cmd[2] = addr >> 8;
+	cmd[3] = addr;
+	cmd[4] = 0xFF; /* Dummy byte */
+
+	bsp_spi_select(dev_num);
+	bsp_spi_write_u8(dev_num, cmd, 5);
+	bsp_spi_read_u8(dev_num, rx_data, nb_data);
+	bsp_spi_unselect(dev_num);
+}
+
+/* Parses the JEDEC Basic Flash Parameter Table */
+static bool parse_sfdp(bsp_dev_spi_t dev_num, t_spi_flash *flash)
+{
+	uint8_t hdr[8];
+	uint8_t bfpt[SFDP_BFPT_DWORDS * 4];
+	uint32_t ptp, dw, nb_dwords, size;
+	int i;
+
+	read_sfdp(dev_num, 0, hdr, 8);
+	if (le32(hdr) != SFDP_SIGNATURE)
+		return FALSE;
+
+	/* The first parameter header is always the BFPT one */
+	read_sfdp(dev_num, 8, hdr, 8);
+	if (hdr[0] != 0x00 || hdr[3] < 2)
+		return FALSE;
+	nb_dwords = (hdr[3] > SFDP_BFPT_DWORDS) ? SFDP_BFPT_DWORDS : hdr[3];
+	ptp = hdr[4] | (hdr[5] << 8) | (hdr[6] << 16);
+	memset(bfpt, 0, sizeof(bfpt));
+	read_sfdp(dev_num, ptp, bfpt, nb_dwords * 4);
+
+	/* Density, in bits */
+	dw = le32(&bfpt[4]);
+	if (dw & 0x80000000) {
+		dw &= 0x7FFFFFFF;
+		/*
+		 * Less than a byte is invalid, larger than 4GB is not
+		 * addressable with 4 bytes either
+		 */
+		if (dw < 3 || dw >= 35)
+			return FALSE;
+		flash->size = 1UL << (dw - 3);
+	} else {
+		flash->size = (dw >> 3) + 1;
+	}
+
+	dw = le32(&bfpt[0]);
+	switch ((dw >> 17) & 0x03) {
+	case 0x02:
+		flash->addr_bytes = 4;
+		break;
+	case 0x01:
+		flash->addr_bytes = (flash->size > 0x1000000) ? 4 : 3;
+		break;
+	default:
+		flash->addr_bytes = 3;
+		break;
+	}
+
+	flash->erase_size = ((dw & 0x03) == 0x01) ? 4096 : 0;
+	/* Erase types 1 to 4, size is 2^N bytes */
+	if (nb_dwords == SFDP_BFPT_DWORDS) {
+		for (i = 28; i < 36; i += 2) {
+			if (bfpt[i] == 0 || bfpt[i] >= 32)
+				continue;
+			size = 1UL << bfpt[i];
+			if (flash->erase_size == 0 || size < flash->erase_size)
+				flash->erase_size = size;
+		}
+	}
+
+	flash->sfdp = TRUE;
+	return TRUE;
+}
+
+/**
+ * @brief   Reads the JEDEC ID and the geometry of a SPI NOR flash
+ * @note    Without SFDP, the size is guessed from the capacity byte of the
+ *          JEDEC ID, which is log2(size) for most vendors.
+ *
+ * @param[in] con		console
+ * @param[out] flash		flash description
+ *
+ * @return			FALSE if no flash answered.
+ */
+bool spi_flash_probe(t_hydra_console *con, t_spi_flash *flash)
+{
+	bsp_dev_spi_t dev_num = con->mode->proto.dev_num;
+	uint8_t cmd = SPI_FLASH_CMD_READ_ID;
+
+	memset(flash, 0, sizeof(t_spi_flash));
+
+	bsp_spi_select(dev_num);
+	bsp_spi_write_u8(dev_num, &cmd, 1);
+	bsp_spi_read_u8(dev_num, flash->jedec_id, 3);
+	bsp_spi_unselect(dev_num);
+
+	if ((flash->jedec_id[0] == 0x00 && flash->jedec_id[1] == 0x00) ||
+	    (flash->jedec_id[0] == 0xFF && flash->jedec_id[1] == 0xFF))
+		return FALSE;
+
+	if (parse_sfdp(dev_num, flash))
+		return TRUE;
+
+	flash->sfdp = FALSE;
+	flash->erase_size = 0;
+	flash->addr_bytes = 3;
+	if (flash->jedec_id[2] >= 0x10 && flash->jedec_id[2] <= 0x1F) {
+		flash->size = 1UL << flash->jedec_id[2];
+		if (flash->size > 0x1000000)
+			flash->addr_bytes = 4;
+	} else {
+		flash->size = 0;
+	}
+	return TRUE;
+}
+
+/**
+ * @brief   Checks that a range can be read from the flash
+ *
+ * @param[in] flash		flash description
+ * @param[in] addr		start address
+ * @param[in] nb_data		range length
+ *
+ * @return			FALSE if the range is out of the flash.
+ */
+bool spi_flash_check_range(const t_spi_flash *flash, uint32_t addr,
+			   uint32_t nb_data)
+{
+	uint64_t end = (uint64_t)addr + nb_data;
+
+	if (nb_data == 0)
+		return FALSE;
+	if (flash->size != 0)
+		return end <= flash->size;
+	return end <= ((flash->addr_bytes == 4) ? 0x100000000ULL : 0x1000000);
+}
+
+static bsp_status_t block_start(bsp_dev_spi_t dev_num, uint8_t *rx_data,
+				uint32_t nb_data, bool *dma)
+{
+	*dma = (bsp_spi_dma_start(dev_num, NULL, rx_data, nb_data,
+				  NULL, NULL) == BSP_OK);
+	if (*dma)
+		return BSP_OK;
+	return bsp_spi_read_u8(dev_num, rx_data, nb_data);
+}
+
+/**
+ * @brief   Reads a flash range with fast read at the highest speed
+ * @note    The range is read in one continuous fast read command. The next
+ *          block is read by DMA while the callback processes the current
+ *          one. SPI errors do not stop the dump, so that the callback
+ *          always gets the whole range.
+ *
+ * @param[in] con		console
+ * @param[in] flash		flash description, from spi_flash_probe()
+ * @param[in] addr		start address
+ * @param[in] nb_data		range length, checked by spi_flash_check_range()
+ * @param[in] buf		2 * SPI_FLASH_BLOCK_SIZE bytes, DMA capable
+ * @param[in] cb		block callback
+ * @param[in] arg		cb argument
+ *
+ * @return			BSP_OK, BSP_ERROR on SPI error or if the
+ *				callback aborted the dump.
+ */
+bsp_status_t spi_flash_dump(t_hydra_console *con, const t_spi_flash *flash,
+			    uint32_t addr, uint32_t nb_data, uint8_t *buf,
+			    spi_flash_block_cb_t cb, void *arg)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	uint8_t *block[2];
+	uint8_t cmd[6];
+	uint8_t speed, cmd_len;
+	uint32_t len, next_len;
+	bsp_status_t status, xfer_status;
+	bool dma;
+	int cur;
+
+	block[0] = buf;
+	block[1] = buf + SPI_FLASH_BLOCK_SIZE;
+
+	speed = proto->config.spi.dev_speed;
+	proto->config.spi.dev_speed = SPI_FLASH_SPEED;
+	bsp_spi_init(proto->dev_num, proto);
+
+	if (flash->addr_bytes == 4) {
+		cmd[0] = SPI_FLASH_CMD_FAST_READ4;
+		cmd[1] = addr >> 24;
+		cmd[2] = addr >> 16;
+		cmd[3] = addr >> 8;
+		cmd[4] = addr;
+		cmd_len = 6;
+	} else {
+		cmd[0] = SPI_FLASH_CMD_FAST_READ;
+		cmd[1] = addr >> 16;
+		cmd[2] = addr >> 8;
+		cmd[3] = addr;
+		cmd_len = 5;
+	}
+	cmd[cmd_len - 1] = 0xFF; /* Dummy byte */
+
+	bsp_spi_select(proto->dev_num);
+	status = bsp_spi_write_u8(proto->dev_num, cmd, cmd_len);
+
+	cur = 0;
+	dma = FALSE;
+	len = (nb_data > SPI_FLASH_BLOCK_SIZE) ? SPI_FLASH_BLOCK_SIZE : nb_data;
+	xfer_status = block_start(proto->dev_num, block[cur], len, &dma);
+	while (len > 0) {
+		if (dma)
+			xfer_status = bsp_spi_dma_wait(proto->dev_num);
+		if (xfer_status != BSP_OK)
+			status = xfer_status;
+		nb_data -= len;
+		next_len = (nb_data > SPI_FLASH_BLOCK_SIZE) ? SPI_FLASH_BLOCK_SIZE : nb_data;
+		if (next_len > 0)
+			xfer_status = block_start(proto->dev_num, block[!cur],
+						  next_len, &dma);
+		if (!cb(con, block[cur], len, arg)) {
+			status = BSP_ERROR;
+			if (dma && next_len > 0)
+				bsp_spi_dma_wait(proto->dev_num);
+			break;
+		}
+		cur = !cur;
+		len = next_len;
+	}
+
+	bsp_spi_unselect(proto->dev_num);
+
+	proto->config.spi.dev_speed = speed;
+	bsp_spi_init(proto->dev_num, proto);
+
+	return status;
+}
@@ -0,0 +1,58 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRABUS_SPI_FLASH_H_
+#define _HYDRABUS_SPI_FLASH_H_
+
+#include "common.h"
+#include "bsp_spi.h"
+
+#define SPI_FLASH_CMD_READ_ID		0x9F
+#define SPI_FLASH_CMD_READ_SFDP		0x5A
+#define SPI_FLASH_CMD_FAST_READ		0x0B
+#define SPI_FLASH_CMD_FAST_READ4	0x0C
+
+/* Dump granularity, one CRC32 per block */
+#define SPI_FLASH_BLOCK_SIZE		(4096)
+/* Highest dev_speed, 42MHz on SPI1, 21MHz on SPI2 */
+#define SPI_FLASH_SPEED			(7)
+
+typedef struct {
+	uint8_t jedec_id[3];
+	bool sfdp; /* Geometry read from SFDP, else guessed from JEDEC ID */
+	uint8_t addr_bytes; /* 3 or 4 */
+	uint32_t size; /* Bytes, 0 if unknown */
+	uint32_t erase_size; /* Smallest erase size, 0 if unknown */
+} t_spi_flash;
+
+/*
+ * Called for each block read with the arg given to spi_flash_dump(),
+ * returns FALSE to abort the dump
+ */
+typedef bool (*spi_flash_block_cb_t)(t_hydra_console *con, uint8_t *data,
+				     uint32_t nb_data, void *arg);
+
+uint32_t spi_flash_crc32(uint32_t crc, const uint8_t *data, uint32_t nb_data);
+bool spi_flash_probe(t_hydra_console *con, t_spi_flash *flash);
+bool spi_flash_check_range(const t_spi_flash *flash, uint32_t addr,
+			   uint32_t nb_data);
+bsp_status_t spi_flash_dump(t_hydra_console *con, const t_spi_flash *flash,
+			    uint32_t addr, uint32_t nb_data, uint8_t *buf,
+			    spi_flash_block_cb_t cb, void *arg);
+
+#endif /* _HYDRABUS_SPI_FLASH_H_ */
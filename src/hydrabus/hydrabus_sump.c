@@ -22,14 +22,75 @@
 #include "bsp.h"
 #include "bsp_tim.h"
 #include "hydrabus_sump.h"
+#include "hydrabus_sump_trigger.h"
+#include "hydrabus_sump_stream.h"
+#include "microsd.h"
+#include "sbuf.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 
-#define STATES_LEN 8192
+/*
+ * Capture memory, the whole g_sbuf leased by sump(). The DMA ring uses all
+ * of it, or the first half in RLE mode, the second half holding the words.
+ */
+#define SUMP_BUF_SIZE NB_SBUFFER
+/* Readout block, larger than the console buffer so it is not copied again */
+#define SUMP_TX_SIZE 1024
+
+static uint8_t *buffer;
+static uint8_t tx_block[SUMP_TX_SIZE];
+/* Data read back from the capture */
+static const void *samples;
+static uint32_t samples_len;
+static uint8_t samples_size; /* Bytes per element in samples */
+static uint32_t INDEX = 0;
+
+/*
+ * Stages and RLE are evaluated per sample by the CPU, the sample rate is
+ * clamped so that they use at most this part of it. The cost is measured
+ * on SUMP_COST_SAMPLES samples before each capture.
+ */
+#define SUMP_CPU_SHARE_PCT	50
+#define SUMP_COST_SAMPLES	1024
+
+/* Runs refused or clamped in this SUMP session, reported when it ends */
+typedef struct {
+	uint32_t refused;
+	uint32_t skipped;
+	uint32_t lost;
+	uint32_t clamped;
+	uint32_t clamped_rate; /* Last clamped rate, Hz */
+	uint32_t cost; /* Cycles per sample of that capture */
+} t_sump_stats;
+
+static t_sump_stats stats;
 
-static uint16_t *buffer = (uint16_t *)g_sbuf;
-static uint16_t INDEX = 0;
+/*
+ * Streaming capture to microSD: a 16KB DMA ring then two blocks, one
+ * filled while the other is written to the card.
+ */
+#define STREAM_RING_LEN		8192
+#define STREAM_BLOCK_SIZE	((SUMP_BUF_SIZE - STREAM_RING_LEN * 2) / 2)
+#define STREAM_DEFAULT_RATE	1000000
+#define STREAM_DEFAULT_SIZE	64 /* MB */
+#define STREAM_MAX_SIZE		4095 /* MB, FAT32 file size limit */
+
+typedef struct {
+	t_sump_block block[2];
+	bool last[2]; /* Last block of the capture */
+	semaphore_t full;
+	semaphore_t empty;
+	bool error;
+} t_sump_writer;
+
+static FIL stream_file;
+static FIL index_file;
+static filename_t stream_name;
+static filename_t index_name;
+static t_sump_writer stream_writer;
+static t_sump_stream stream;
 
 static void portc_init(void)
 {
@@ -51,78 +112,178 @@ static void portc_init(void)
 	}
 }
 
-static void tim_init(t_hydra_console *con)
+static void sump_init(t_hydra_console *con)
 {
-	mode_config_proto_t* proto = &con->mode->proto;
-
-	bsp_tim_init(21, 2*(proto->config.sump.divider), TIM_CLOCKDIVISION_DIV1, TIM_COUNTERMODE_UP);
+	(void)con;
+	portc_init();
 }
 
-static void tim_set_prescaler(t_hydra_console *con)
+/* Triggers of a single group packed in 8bits samples */
+static void pack_triggers(const sump_config_t *sump, uint8_t shift,
+			  uint32_t *masks, uint32_t *values, uint32_t *configs)
 {
-	mode_config_proto_t* proto = &con->mode->proto;
-
-	bsp_tim_set_prescaler(2*(proto->config.sump.divider));
+	uint32_t channel;
+	int i;
+
+	for (i = 0; i < SUMP_NB_STAGES; i++) {
+		masks[i] = (sump->trigger_masks[i] >> shift) & 0xff;
+		values[i] = (sump->trigger_values[i] >> shift) & 0xff;
+		channel = (SUMP_TRIG_CONF_CHANNEL(sump->trigger_configs[i]) - shift) & 0x1f;
+		configs[i] = (sump->trigger_configs[i] & ~(0x1f << 20)) | (channel << 20);
+	}
 }
 
-static void sump_init(t_hydra_console *con)
+/*
+ * Cycles per sample of the trigger evaluation, measured with the DWT cycle
+ * counter on a copy of the capture. The samples change at each step, so
+ * that the RLE encoder writes one word per sample, and the trigger is
+ * evaluated from the first one.
+ */
+static uint32_t measure_cost(const t_sump_capture *capture)
 {
-	portc_init();
-	tim_init(con);
+	t_sump_capture probe = *capture;
+	uint32_t i, idx, start, cycles, nb;
+
+	for (i = 0; i < SUMP_COST_SAMPLES; i++) {
+		idx = (capture->scan + i) & (capture->len - 1);
+		if (capture->sample_size == 1)
+			buffer[idx] = (i & 1) ? 0xAA : 0x55;
+		else
+			((uint16_t *)buffer)[idx] = (i & 1) ? 0xAA55 : 0x55AA;
+	}
+	probe.rle.pre = 0;
+
+	start = bsp_get_cyclecounter();
+	sump_capture_update(&probe, (capture->scan + SUMP_COST_SAMPLES) &
+			    (capture->len - 1));
+	cycles = bsp_get_cyclecounter() - start;
+
+	/* A match ends the evaluation early, the estimate is then higher */
+	nb = probe.scan - capture->scan;
+	return cycles / ((nb > 0) ? nb : 1) + 1;
 }
 
-static void get_samples(t_hydra_console *con) __attribute__((optimize("-O3")));
-static void get_samples(t_hydra_console *con)
+/*
+ * Each timer update requests a DMA transfer of GPIOC->IDR to the ring, the
+ * trigger is evaluated from the ring by the CPU, without locking the
+ * kernel. With a single channel group enabled, only its byte is sampled,
+ * doubling the depth. Returns FALSE if aborted or if the DMA is not
+ * available.
+ */
+static bool get_samples(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
-	uint32_t config_state;
-	config_state = proto->config.sump.state;
-
-	/* Lock Kernel for logic analyzer */
-	chSysLock();
+	t_sump_capture capture;
+	uint32_t masks[SUMP_NB_STAGES];
+	uint32_t values[SUMP_NB_STAGES];
+	uint32_t configs[SUMP_NB_STAGES];
+	volatile uint8_t *src = (volatile uint8_t *)&GPIOC->IDR;
+	uint8_t groups = proto->config.sump.channels & 0x03;
+	uint8_t sample_size = 2;
+	uint32_t len, rate, max_rate, cost;
+
+	if (groups == 1 || groups == 2) {
+		sample_size = 1;
+		if (groups == 2)
+			src++;
+		pack_triggers(&proto->config.sump, (groups == 2) ? 8 : 0,
+			      masks, values, configs);
+	} else {
+		memcpy(masks, proto->config.sump.trigger_masks, sizeof(masks));
+		memcpy(values, proto->config.sump.trigger_values, sizeof(values));
+		memcpy(configs, proto->config.sump.trigger_configs, sizeof(configs));
+	}
 
-	bsp_tim_start();
+	len = SUMP_BUF_SIZE / sample_size;
+	if (proto->config.sump.rle)
+		len /= 2;
+	sump_capture_init(&capture, buffer, len, sample_size,
+			  proto->config.sump.read_count,
+			  proto->config.sump.delay_count,
+			  masks, values, configs);
+	/* Packed samples are encoded as the first group */
+	if (proto->config.sump.rle)
+		sump_capture_set_rle(&capture,
+				     (uint16_t *)&buffer[SUMP_BUF_SIZE / 2],
+				     SUMP_BUF_SIZE / 2 / sizeof(uint16_t),
+				     (sample_size == 1) ? 1 : groups);
+
+	/* The simple trigger is a memory scan, much faster than the DMA */
+	rate = proto->config.sump.sample_rate;
+	if (!capture.simple || capture.rle_enabled) {
+		cost = measure_cost(&capture);
+		max_rate = (uint64_t)STM32_HCLK * SUMP_CPU_SHARE_PCT / 100 / cost;
+		if (rate > max_rate) {
+			rate = max_rate;
+			stats.clamped++;
+			stats.clamped_rate = rate;
+			stats.cost = cost;
+		}
+	}
 
-	if(config_state == SUMP_STATE_ARMED)
-	{
-		uint32_t config_trigger_value;
-		uint32_t config_trigger_mask;
+	if (bsp_tim_dma_start(src, buffer, len, sample_size, rate) != BSP_OK)
+		return FALSE;
+	proto->config.sump.state = SUMP_STATE_ARMED;
 
-		config_trigger_value =  proto->config.sump.trigger_values[0];
-		config_trigger_mask = proto->config.sump.trigger_masks[0];
+	/* One tick holds far less samples than the ring at the maximum rate */
+	while (!sump_capture_update(&capture, bsp_tim_dma_pos())) {
+		if (hydrabus_ubtn())
+			break;
+		chThdSleep(1);
+	}
 
-		while(1)
-		{
-			bsp_tim_wait_irq();
-			*(buffer+INDEX) = GPIOC->IDR;
-			bsp_tim_clr_irq();
-			if ( !((*(buffer+INDEX) ^ config_trigger_value) & config_trigger_mask) ) {
-				config_state = SUMP_STATE_TRIGGED;
-				break;
-			}
-			INDEX++;
-			INDEX &= STATES_LEN-1;
-		}
+	bsp_tim_dma_stop();
+	proto->config.sump.state = SUMP_STATE_IDLE;
+	if (capture.state != SUMP_CAPTURE_DONE)
+		return FALSE;
+	/*
+	 * The evaluation fell behind: samples were never checked against the
+	 * trigger (or RLE counts do not match the signal), or returned samples
+	 * were overwritten.
+	 */
+	if (capture.skipped || capture.lost) {
+		stats.refused++;
+		stats.skipped += capture.skipped;
+		stats.lost += capture.lost;
+		return FALSE;
 	}
 
-	if(config_state == SUMP_STATE_TRIGGED)
-	{
-		register uint32_t config_delay_count = proto->config.sump.delay_count;
-
-		while(config_delay_count > 0)
-		{
-			bsp_tim_wait_irq();
-			*(buffer+INDEX) = GPIOC->IDR;
-			bsp_tim_clr_irq();
-			config_delay_count--;
-			INDEX++;
-			INDEX &= STATES_LEN-1;
+	samples = capture.out;
+	samples_len = capture.out_len;
+	samples_size = capture.rle_enabled ? sizeof(uint16_t) : sample_size;
+	INDEX = sump_capture_end(&capture);
+	proto->config.sump.read_count = capture.read_count;
+	return TRUE;
+}
+
+/*
+ * Sends the samples newest first (OLS/sigrok order), one byte per enabled
+ * group, in blocks written to the USB channel at once.
+ */
+static void send_samples(t_hydra_console *con, uint32_t count, uint8_t groups)
+{
+	const uint8_t *bytes = samples;
+	const uint16_t *words = samples;
+	uint32_t len;
+	uint16_t sample;
+
+	if (groups == 0)
+		return;
+
+	while (count > 0) {
+		len = 0;
+		while (count > 0 && len + 2 <= SUMP_TX_SIZE) {
+			INDEX = (INDEX - 1) & (samples_len - 1);
+			sample = (samples_size == 1) ? bytes[INDEX] : words[INDEX];
+			/* A single group is always in the low byte */
+			tx_block[len++] = sample & 0xff;
+			if (groups == 3)
+				tx_block[len++] = sample >> 8;
+			count--;
 		}
+		cprint(con, (const char *)tx_block, len);
 	}
-
-	chSysUnlock();
-	proto->config.sump.state = SUMP_STATE_IDLE;
-	bsp_tim_stop();
+	cflush(con);
 }
 
 static void sump_deinit(void)
@@ -131,15 +292,287 @@ static void sump_deinit(void)
 	hal_gpio_port =(GPIO_TypeDef*)GPIOC;
 	uint8_t gpio_pin;
 
-	bsp_tim_deinit();
+	bsp_tim_dma_stop();
 	for(gpio_pin=0; gpio_pin<15; gpio_pin++) {
 		HAL_GPIO_DeInit(hal_gpio_port, 1 << gpio_pin);
 	}
 }
 
+static THD_FUNCTION(sump_writer_thread, arg)
+{
+	t_sump_writer *w = (t_sump_writer *)arg;
+	t_sump_block *b;
+	uint32_t i, len;
+	UINT written;
+
+	chRegSetThreadName("sump_writer");
+
+	for (i = 0; ; i++) {
+		chSemWait(&w->full);
+		b = &w->block[i & 1];
+		len = b->nb_markers * sizeof(t_sump_marker);
+		if (!w->error &&
+		    (f_write(&stream_file, b->data, b->len, &written) != FR_OK ||
+		     written != b->len ||
+		     f_write(&index_file, b->markers, len, &written) != FR_OK ||
+		     written != len))
+			w->error = TRUE;
+		chSemSignal(&w->empty);
+		if (w->last[i & 1])
+			break;
+	}
+}
+
+/*
+ * Index file name: the data file name with the .idx extension, FALSE if
+ * the name leaves no room for it.
+ */
+static bool index_filename(char *name, const char *filename)
+{
+	size_t len;
+	char *ext;
+
+	len = strlen(filename);
+	if (len > FILENAME_SIZE - 5)
+		return FALSE;
+	memcpy(name, filename, len + 1);
+	ext = strrchr(name, '.');
+	if (ext == NULL || strchr(ext, '/') != NULL)
+		ext = name + strlen(name);
+	strcpy(ext, ".idx");
+	return TRUE;
+}
+
+/* Writes the index file header, at the start of the file */
+static bool write_header(uint32_t sample_rate)
+{
+	t_sump_stream_header h;
+	UINT written;
+
+	sump_stream_header(&stream, &h, sample_rate);
+	if (f_lseek(&index_file, 0) != FR_OK)
+		return FALSE;
+	if (f_write(&index_file, &h, sizeof(h), &written) != FR_OK ||
+	    written != sizeof(h))
+		return FALSE;
+	return TRUE;
+}
+
+/* Prints a 64bits counter, chprintf has no long long support */
+static void print_u64(t_hydra_console *con, const char *label, uint64_t val)
+{
+	if (val >= 1000000000)
+		cprintf(con, "%s: %lu%09lu\r\n", label,
+			(uint32_t)(val / 1000000000),
+			(uint32_t)(val % 1000000000));
+	else
+		cprintf(con, "%s: %lu\r\n", label, (uint32_t)val);
+}
+
+/*
+ * Samples GPIOC continuously to a preallocated file until it is full or
+ * the user button is pressed. The capture keeps running if the card is
+ * too slow, the samples lost are recorded in the index file.
+ */
+static void stream_capture(t_hydra_console *con, uint8_t *buf,
+			   uint32_t sample_rate, uint32_t nb_blocks)
+{
+	t_sump_writer *w = &stream_writer;
+	thread_t *thread;
+	uint32_t i, start;
+	bool stop, full;
+
+	w->block[0].data = buf + STREAM_RING_LEN * sizeof(uint16_t);
+	w->block[1].data = w->block[0].data + STREAM_BLOCK_SIZE;
+	sump_stream_set_block(&stream, &w->block[0]);
+	w->last[0] = FALSE;
+	w->last[1] = FALSE;
+	w->error = FALSE;
+	chSemObjectInit(&w->full, 0);
+	chSemObjectInit(&w->empty, 1);
+
+	thread = chThdCreateFromHeap(NULL, CONSOLE_WA_SIZE, "sump_writer",
+				     chThdGetPriorityX() + 1,
+				     sump_writer_thread, w);
+	if (thread == NULL) {
+		cprintf(con, "Cannot start the writer thread.\r\n");
+		return;
+	}
+
+	if (bsp_tim_dma_start(&GPIOC->IDR, buf, STREAM_RING_LEN, 2,
+			      sample_rate) != BSP_OK) {
+		cprintf(con, "DMA busy.\r\n");
+		/* Empty last block, stops the writer */
+		w->last[0] = TRUE;
+		chSemSignal(&w->full);
+		chThdWait(thread);
+		return;
+	}
+	start = chVTGetSystemTime();
+
+	i = 0;
+	while (TRUE) {
+		full = sump_stream_update(&stream, bsp_tim_dma_pos());
+		stop = hydrabus_ubtn() || w->error;
+		if (!full && !stop) {
+			chThdSleep(1);
+			continue;
+		}
+		if (!full)
+			sump_stream_finish(&stream);
+		if (i + 1 == nb_blocks)
+			stop = TRUE;
+		w->last[i & 1] = stop;
+		chSemSignal(&w->full);
+		if (stop)
+			break;
+		i++;
+
+		/* The ring absorbs the card latency while no block is free */
+		sump_stream_set_block(&stream, NULL);
+		while (chSemWaitTimeout(&w->empty, TIME_IMMEDIATE) != MSG_OK) {
+			sump_stream_update(&stream, bsp_tim_dma_pos());
+			chThdSleep(1);
+		}
+		sump_stream_set_block(&stream, &w->block[i & 1]);
+	}
+	bsp_tim_dma_stop();
+	chThdWait(thread);
+
+	cprintf(con, "Time: %lu ms\r\n",
+		TIME_I2MS(chVTGetSystemTime() - start));
+	print_u64(con, "Samples", stream.scan);
+	cprintf(con, "Data: %lu bytes\r\n", stream.offset + w->block[i & 1].len);
+	cprintf(con, "Triggers: %lu\r\n", stream.nb_triggers);
+	if (stream.nb_overflows) {
+		cprintf(con, "Overflows: %lu\r\n", stream.nb_overflows);
+		print_u64(con, "Samples lost", stream.lost);
+	}
+	if (stream.dropped)
+		cprintf(con, "Markers dropped: %lu\r\n", stream.dropped);
+	if (w->error)
+		cprintf(con, "Error writing file.\r\n");
+}
+
+/* Streams a capture to microSD, returns the tokens used */
+static int stream_cmd(t_hydra_console *con, t_tokenline_parsed *p, int t)
+{
+	uint32_t sample_rate = STREAM_DEFAULT_RATE;
+	uint32_t size = STREAM_DEFAULT_SIZE;
+	uint32_t mask = 0xFFFF, value = 0;
+	bool rle = FALSE, trigger = FALSE;
+	int str_offset;
+	uint8_t *buf;
+
+	stream_name.filename[0] = 0;
+	while (p->tokens[t]) {
+		switch (p->tokens[t++]) {
+		case T_FILE:
+			t++;
+			memcpy(&str_offset, &p->tokens[t++], sizeof(int));
+			snprintf(stream_name.filename, FILENAME_SIZE, "0:%s",
+				 p->buf + str_offset);
+			break;
+		case T_FREQUENCY:
+			t++;
+			memcpy(&sample_rate, p->buf + p->tokens[t++], sizeof(int));
+			break;
+		case T_LENGTH:
+			t++;
+			memcpy(&size, p->buf + p->tokens[t++], sizeof(int));
+			break;
+		case T_RLE:
+			rle = TRUE;
+			break;
+		case T_TRIGGER:
+			t++;
+			memcpy(&value, p->buf + p->tokens[t++], sizeof(int));
+			trigger = TRUE;
+			break;
+		case T_MASK:
+			t++;
+			memcpy(&mask, p->buf + p->tokens[t++], sizeof(int));
+			break;
+		}
+	}
+
+	if (stream_name.filename[0] == 0) {
+		cprintf(con, "Specify the microSD filename.\r\n");
+		return t;
+	}
+	if (sample_rate == 0 || sample_rate > SUMP_MAX_SAMPLE_RATE) {
+		cprintf(con, "Frequency must be between 1 and %u Hz.\r\n",
+			SUMP_MAX_SAMPLE_RATE);
+		return t;
+	}
+	if (size == 0 || size > STREAM_MAX_SIZE) {
+		cprintf(con, "Length must be between 1 and %u MB.\r\n",
+			STREAM_MAX_SIZE);
+		return t;
+	}
+	if (!index_filename(index_name.filename, stream_name.filename)) {
+		cprintf(con, "File name too long.\r\n");
+		return t;
+	}
+	if (is_file_present(stream_name.filename) ||
+	    is_file_present(index_name.filename)) {
+		cprintf(con, "File %s or %s already exists.\r\n",
+			stream_name.filename, index_name.filename);
+		return t;
+	}
+
+	buf = sbuf_alloc(con, SBUF_RAM, SUMP_BUF_SIZE);
+	if (buf == NULL) {
+		cprintf(con, "Scratch buffer busy.\r\n");
+		return t;
+	}
+	size = (size * 1024 * 1024 / STREAM_BLOCK_SIZE) * STREAM_BLOCK_SIZE;
+	if (!file_open(&stream_file, stream_name.filename, 'w')) {
+		cprintf(con, "Cannot open file %s\r\n", stream_name.filename);
+		sbuf_free(con, buf);
+		return t;
+	}
+	if (!file_preallocate(&stream_file, size)) {
+		cprintf(con, "Not enough space on microSD.\r\n");
+		file_close(&stream_file);
+		sbuf_free(con, buf);
+		return t;
+	}
+	sump_stream_init(&stream, (uint16_t *)buf, STREAM_RING_LEN,
+			 STREAM_BLOCK_SIZE, rle, trigger ? mask : 0, value);
+	if (!file_open(&index_file, index_name.filename, 'w') ||
+	    !write_header(sample_rate)) {
+		cprintf(con, "Cannot open file %s\r\n", index_name.filename);
+		file_close(&stream_file);
+		sbuf_free(con, buf);
+		return t;
+	}
+
+	cprintf(con, "Streaming to %s at %lu Hz, up to %lu bytes.\r\n",
+		stream_name.filename, sample_rate, size);
+	cprintf(con, "Interrupt by pressing user button.\r\n");
+	sump_init(con);
+	stream_capture(con, buf, sample_rate, size / STREAM_BLOCK_SIZE);
+	sump_deinit();
+
+	/* Unused preallocated space is released */
+	if (!file_preallocate(&stream_file, stream.offset +
+			      (stream.block != NULL ? stream.block->len : 0)) ||
+	    !file_close(&stream_file) ||
+	    !write_header(sample_rate) || !file_close(&index_file))
+		cprintf(con, "Error closing files.\r\n");
+	sbuf_free(con, buf);
+
+	return t;
+}
+
 int cmd_sump(t_hydra_console *con, t_tokenline_parsed *p)
 {
-	(void) p;
+	if (p->tokens[1] != 0) {
+		stream_cmd(con, p, 1);
+		return TRUE;
+	}
+
 	cprintf(con, "Interrupt by pressing user button.\r\n");
 	cprint(con, "\r\n", 2);
 
@@ -153,15 +586,28 @@ void sump(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
 
+	buffer = sbuf_alloc(con, SBUF_RAM, SUMP_BUF_SIZE);
+	if (buffer == NULL) {
+		cprintf(con, "Scratch buffer busy.\r\n");
+		return;
+	}
+
 	sump_init(con);
+	memset(&stats, 0, sizeof(stats));
 	proto->config.sump.state = SUMP_STATE_IDLE;
+	proto->config.sump.sample_rate = SUMP_MAX_SAMPLE_RATE;
+	/* Single parallel stage for hosts not sending the configuration */
+	memset(proto->config.sump.trigger_configs, 0,
+	       sizeof(proto->config.sump.trigger_configs));
+	proto->config.sump.trigger_configs[0] = SUMP_TRIG_CONF_START;
 
 	uint8_t sump_command;
 	uint8_t sump_parameters[4] = {0};
 	uint32_t index=0;
+	uint32_t divider;
 
 	while (!hydrabus_ubtn()) {
-		if(chnReadTimeout(con->sdu, &sump_command, 1, 1)) {
+		if(cread_timeout(con, &sump_command, 1, 1)) {
 			switch(sump_command) {
 			case SUMP_RESET:
 				break;
@@ -169,46 +615,27 @@ void sump(t_hydra_console *con)
 				cprintf(con, "1ALS");
 				break;
 			case SUMP_RUN:
-				INDEX=0;
-				proto->config.sump.state = SUMP_STATE_ARMED;
-				get_samples(con);
-
-				while(proto->config.sump.read_count > 0) {
-					if (INDEX == 0) {
-						INDEX = STATES_LEN-1;
-					} else {
-						INDEX--;
-					}
-					switch (proto->config.sump.channels) {
-					case 1:
-						cprintf(con, "%c\x00\x00\x00", *(buffer+INDEX) & 0xff);
-						break;
-					case 2:
-						cprintf(con, "%c\x00\x00\x00", (*(buffer+INDEX) & 0xff00)>>8);
-						break;
-					case 3:
-						cprintf(con, "%c%c\x00\x00", *(buffer+INDEX) & 0xff, (*(buffer+INDEX) & 0xff00)>>8);
-						break;
-					}
-					proto->config.sump.read_count--;
-				}
+				if (!get_samples(con))
+					break;
+				send_samples(con, proto->config.sump.read_count,
+					     proto->config.sump.channels & 0x03);
 				break;
 			case SUMP_DESC:
 				// device name string
 				cprintf(con, "%c", 0x01);
 				cprintf(con, "HydraBus");
 				cprintf(con, "%c", 0x00);
-				//sample memory (8192)
+				//sample memory (65536)
 				cprintf(con, "%c", 0x21);
 				cprintf(con, "%c", 0x00);
+				cprintf(con, "%c", 0x01);
 				cprintf(con, "%c", 0x00);
-				cprintf(con, "%c", 0x20);
 				cprintf(con, "%c", 0x00);
-				//sample rate (2MHz)
+				//sample rate (10MHz)
 				cprintf(con, "%c", 0x23);
 				cprintf(con, "%c", 0x00);
-				cprintf(con, "%c", 0x1E);
-				cprintf(con, "%c", 0x84);
+				cprintf(con, "%c", 0x98);
+				cprintf(con, "%c", 0x96);
 				cprintf(con, "%c", 0x80);
 				//b
 				//number of probes (16)
@@ -225,7 +652,7 @@ void sump(t_hydra_console *con)
 				break;
 			default:
 				// Other commands take 4 bytes as parameters
-				if(chnRead(con->sdu, sump_parameters, 4) == 4) {
+				if(cread(con, sump_parameters, 4) == 4) {
 					switch(sump_command) {
 					case SUMP_TRIG_1:
 					case SUMP_TRIG_2:
@@ -255,6 +682,20 @@ void sump(t_hydra_console *con)
 						proto->config.sump.trigger_values[index] <<= 8;
 						proto->config.sump.trigger_values[index] |= sump_parameters[0];
 						break;
+					case SUMP_TRIG_CONF_1:
+					case SUMP_TRIG_CONF_2:
+					case SUMP_TRIG_CONF_3:
+					case SUMP_TRIG_CONF_4:
+						// Get the trigger index
+						index = (sump_command & 0x0c) >> 2;
+						proto->config.sump.trigger_configs[index] = sump_parameters[3];
+						proto->config.sump.trigger_configs[index] <<= 8;
+						proto->config.sump.trigger_configs[index] |= sump_parameters[2];
+						proto->config.sump.trigger_configs[index] <<= 8;
+						proto->config.sump.trigger_configs[index] |= sump_parameters[1];
+						proto->config.sump.trigger_configs[index] <<= 8;
+						proto->config.sump.trigger_configs[index] |= sump_parameters[0];
+						break;
 					case SUMP_CNT:
 						proto->config.sump.delay_count = sump_parameters[3];
 						proto->config.sump.delay_count <<= 8;
@@ -267,18 +708,19 @@ void sump(t_hydra_console *con)
 						proto->config.sump.read_count <<= 2; /* values are multiples of 4 */
 						break;
 					case SUMP_DIV:
-						proto->config.sump.divider = sump_parameters[2];
-						proto->config.sump.divider <<= 8;
-						proto->config.sump.divider |= sump_parameters[1];
-						proto->config.sump.divider <<= 8;
-						proto->config.sump.divider |= sump_parameters[0];
-						proto->config.sump.divider /= 50; /* Assuming 100MHz base frequency */
-						proto->config.sump.divider++;
-						tim_set_prescaler(con);
+						divider = sump_parameters[2];
+						divider <<= 8;
+						divider |= sump_parameters[1];
+						divider <<= 8;
+						divider |= sump_parameters[0];
+						/* Assuming 100MHz base frequency */
+						proto->config.sump.sample_rate = 100000000 / (divider + 1);
+						if (proto->config.sump.sample_rate > SUMP_MAX_SAMPLE_RATE)
+							proto->config.sump.sample_rate = SUMP_MAX_SAMPLE_RATE;
 						break;
 					case SUMP_FLAGS:
 						proto->config.sump.channels = (~sump_parameters[0] >> 2) & 0x0f;
-						/* not implemented */
+						proto->config.sump.rle = sump_parameters[1] & 0x01;
 						break;
 					default:
 						break;
@@ -289,5 +731,16 @@ void sump(t_hydra_console *con)
 		}
 	}
 	sump_deinit();
-}
 
+	if (stats.clamped)
+		cprintf(con, "Sample rate clamped to %lu Hz (%lu cycles per sample) "
+			"for %lu captures.\r\n", stats.clamped_rate, stats.cost,
+			stats.clamped);
+	if (stats.refused)
+		cprintf(con, "%lu captures refused, %lu samples skipped, %lu lost, "
+			"lower the sample rate.\r\n", stats.refused,
+			stats.skipped, stats.lost);
+
+	sbuf_free(con, buffer);
+	buffer = NULL;
+}
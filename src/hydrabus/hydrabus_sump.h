@@ -33,6 +33,13 @@
 #define SUMP_TRIG_VALS_2  0xc5
 #define SUMP_TRIG_VALS_3  0xc9
 #define SUMP_TRIG_VALS_4  0xcd
+#define SUMP_TRIG_CONF_1  0xc2
+#define SUMP_TRIG_CONF_2  0xc6
+#define SUMP_TRIG_CONF_3  0xca
+#define SUMP_TRIG_CONF_4  0xce
+
+/* Timer triggered DMA from GPIOC->IDR */
+#define SUMP_MAX_SAMPLE_RATE	(10000000)
 
 #define SUMP_STATE_IDLE		0
 #define SUMP_STATE_ARMED	1
@@ -42,10 +49,12 @@
 typedef struct {
 	uint32_t trigger_masks[4];
 	uint32_t trigger_values[4];
+	uint32_t trigger_configs[4];
 	uint32_t read_count;
 	uint32_t delay_count;
-	uint32_t divider;
+	uint32_t sample_rate;
 	uint8_t state;
 	uint8_t channels;
+	uint8_t rle;
 } sump_config;
 void sump(t_hydra_console *con);
@@ -0,0 +1,247 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hydrabus_sump_stream.h"
+#include <string.h>
+
+/* Part of the ring kept free for the samples written while encoding */
+#define RING_MARGIN(len) ((len) - (len) / 4)
+
+/**
+ * @brief   Prepares a streaming capture
+ * @note    Samples are encoded from the ring to the blocks given by
+ *          sump_stream_set_block(). Raw samples are 16bits words. In RLE
+ *          mode a word with SUMP_STREAM_RLE_FLAG holds the number of
+ *          repeats of the previous value (0 pads the end of a block).
+ *
+ * @param[out] s		stream state
+ * @param[in] ring		ring filled by the sampler from index 0
+ * @param[in] len		ring size in samples, power of two
+ * @param[in] block_size	block size in bytes, multiple of 4
+ * @param[in] rle		run length encode the samples
+ * @param[in] mask		trigger mask, 0 for no trigger markers
+ * @param[in] value		trigger value
+ */
+void sump_stream_init(t_sump_stream *s, const uint16_t *ring, uint32_t len,
+		      uint32_t block_size, bool rle, uint16_t mask,
+		      uint16_t value)
+{
+	memset(s, 0, sizeof(*s));
+	s->ring = ring;
+	s->len = len;
+	s->block_size = block_size;
+	s->rle = rle;
+	/* Flag never matches a value, the first sample is written */
+	s->value = SUMP_STREAM_RLE_FLAG;
+	s->mask = mask;
+	s->match = value & mask;
+}
+
+/**
+ * @brief   Gives the next block to fill
+ * @note    The data file offset moves past the previous block.
+ *
+ * @param[in,out] s		stream state
+ * @param[in] block		block with block_size bytes of data, NULL
+ *				while none is free
+ */
+void sump_stream_set_block(t_sump_stream *s, t_sump_block *block)
+{
+	if (s->block != NULL)
+		s->offset += s->block->len;
+	s->block = block;
+	if (block == NULL)
+		return;
+	block->len = 0;
+	block->nb_markers = 0;
+}
+
+static inline void put(t_sump_stream *s, uint16_t word)
+{
+	t_sump_block *b = s->block;
+
+	b->data[b->len] = word & 0xFF;
+	b->data[b->len + 1] = word >> 8;
+	b->len += 2;
+}
+
+static void add_marker(t_sump_stream *s, uint32_t lost)
+{
+	t_sump_block *b = s->block;
+	t_sump_marker *m;
+
+	if (b->nb_markers == SUMP_STREAM_MARKERS) {
+		s->dropped++;
+		return;
+	}
+	m = &b->markers[b->nb_markers++];
+	m->sample = s->scan;
+	m->offset = s->offset + b->len;
+	m->lost = lost;
+}
+
+/* A block is full when a count and a value do not fit anymore */
+static inline bool block_full(t_sump_stream *s)
+{
+	t_sump_block *b = s->block;
+
+	if (s->rle && b->len == s->block_size - 2)
+		put(s, SUMP_STREAM_RLE_FLAG);
+	return b->len == s->block_size;
+}
+
+/* Encodes up to nb contiguous samples, returns the samples encoded */
+static uint32_t encode(t_sump_stream *s, const uint16_t *sample, uint32_t nb)
+	__attribute__((optimize("-O3")));
+static uint32_t encode(t_sump_stream *s, const uint16_t *sample, uint32_t nb)
+{
+	uint32_t i;
+	uint16_t value;
+	bool trigger, matched;
+
+	for (i = 0; i < nb; i++) {
+		value = sample[i];
+		trigger = false;
+		if (s->mask) {
+			matched = (value & s->mask) == s->match;
+			trigger = matched && !s->matched;
+			s->matched = matched;
+		}
+
+		if (s->rle) {
+			value &= SUMP_STREAM_RLE_MASK;
+			if (trigger || s->gap || value != s->value) {
+				/* Markers point to a value word */
+				if (s->count) {
+					put(s, SUMP_STREAM_RLE_FLAG | s->count);
+					s->count = 0;
+				}
+			} else {
+				if (++s->count == SUMP_STREAM_RLE_MASK) {
+					put(s, SUMP_STREAM_RLE_FLAG | s->count);
+					s->count = 0;
+					/* Next sample is written as a value */
+					s->value = SUMP_STREAM_RLE_FLAG;
+				}
+				s->scan++;
+				if (block_full(s))
+					return i + 1;
+				continue;
+			}
+			s->value = value;
+		}
+
+		if (s->gap) {
+			add_marker(s, s->gap > 0xFFFFFFFF ? 0xFFFFFFFF : s->gap);
+			s->gap = 0;
+		}
+		if (trigger) {
+			add_marker(s, 0);
+			s->nb_triggers++;
+		}
+		put(s, value);
+		s->scan++;
+		if (block_full(s))
+			return i + 1;
+	}
+	return nb;
+}
+
+/**
+ * @brief   Encodes the samples written since the last call
+ * @note    Shall be called at least once per ring period, also when no
+ *          block is free, so that the overflows are counted. Samples not
+ *          encoded before they are about to be overwritten are skipped,
+ *          a marker records the gap.
+ *
+ * @param[in,out] s		stream state
+ * @param[in] pos		ring index of the next sample written
+ *
+ * @return			TRUE when the block is full, a new one shall be
+ *				given before the next call.
+ */
+bool sump_stream_update(t_sump_stream *s, uint32_t pos)
+{
+	uint32_t idx, nb, margin;
+	uint64_t late;
+
+	s->written += (pos - s->last) & (s->len - 1);
+	s->last = pos;
+
+	margin = RING_MARGIN(s->len);
+	if (s->written - s->scan > margin) {
+		late = s->written - margin - s->scan;
+		s->scan += late;
+		s->lost += late;
+		if (s->gap == 0)
+			s->nb_overflows++;
+		s->gap += late;
+	}
+	if (s->block == NULL)
+		return false;
+
+	while (s->scan < s->written) {
+		idx = s->scan & (s->len - 1);
+		nb = s->len - idx;
+		if (nb > s->written - s->scan)
+			nb = s->written - s->scan;
+		encode(s, &s->ring[idx], nb);
+		if (s->block->len == s->block_size)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * @brief   Writes the pending repeats to the block
+ * @note    The block shall not be full.
+ *
+ * @param[in,out] s		stream state
+ */
+void sump_stream_finish(t_sump_stream *s)
+{
+	if (s->block == NULL || !s->rle || s->count == 0)
+		return;
+	put(s, SUMP_STREAM_RLE_FLAG | s->count);
+	s->count = 0;
+}
+
+/**
+ * @brief   Fills the index file header
+ *
+ * @param[in] s			stream state
+ * @param[out] h		header
+ * @param[in] sample_rate	sample rate in Hz
+ */
+void sump_stream_header(const t_sump_stream *s, t_sump_stream_header *h,
+			uint32_t sample_rate)
+{
+	memset(h, 0, sizeof(*h));
+	memcpy(h->magic, SUMP_STREAM_MAGIC, sizeof(h->magic));
+	h->version = SUMP_STREAM_VERSION;
+	h->sample_rate = sample_rate;
+	h->flags = s->rle ? SUMP_STREAM_FLAG_RLE : 0;
+	h->trigger_mask = s->mask;
+	h->trigger_value = s->match;
+	h->data_len = s->offset + (s->block != NULL ? s->block->len : 0);
+	h->samples = s->scan;
+	h->lost = s->lost;
+	h->nb_overflows = s->nb_overflows;
+	h->nb_triggers = s->nb_triggers;
+	h->dropped = s->dropped;
+}
@@ -0,0 +1,107 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRABUS_SUMP_STREAM_H_
+#define _HYDRABUS_SUMP_STREAM_H_
+
+/*
+ * Encoding of a continuous SUMP capture into file blocks, with trigger
+ * and overflow markers. No hardware or kernel access, so that it builds
+ * on a host.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Markers kept per block, the next ones are dropped */
+#define SUMP_STREAM_MARKERS	64
+
+/* RLE words: channel 15 is replaced by the count flag */
+#define SUMP_STREAM_RLE_FLAG	0x8000
+#define SUMP_STREAM_RLE_MASK	0x7FFF
+
+#define SUMP_STREAM_MAGIC	"HYDRASMP"
+#define SUMP_STREAM_VERSION	1
+#define SUMP_STREAM_FLAG_RLE	(1 << 0)
+
+/* Index file header, followed by the markers (little endian) */
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t sample_rate;
+	uint32_t flags;
+	uint32_t trigger_mask;
+	uint32_t trigger_value;
+	uint32_t data_len; /* Data file size in bytes */
+	uint64_t samples; /* Samples encoded */
+	uint64_t lost; /* Samples lost on overflows */
+	uint32_t nb_overflows;
+	uint32_t nb_triggers;
+	uint32_t dropped; /* Markers not recorded */
+	uint32_t reserved;
+} t_sump_stream_header;
+
+typedef struct {
+	uint64_t sample; /* Sample number since the start */
+	uint32_t offset; /* Data file offset of the word starting at sample */
+	uint32_t lost; /* 0 for a trigger, else samples lost just before */
+} t_sump_marker;
+
+typedef struct {
+	uint8_t *data;
+	uint32_t len; /* Bytes used */
+	t_sump_marker markers[SUMP_STREAM_MARKERS];
+	uint32_t nb_markers;
+} t_sump_block;
+
+typedef struct {
+	const uint16_t *ring;
+	uint32_t len; /* Ring size in samples, power of two */
+	uint32_t last; /* Ring index of the next sample written */
+	uint64_t written; /* Samples written by the sampler */
+	uint64_t scan; /* Next sample encoded */
+	/* Output */
+	t_sump_block *block; /* Block being filled, NULL if none free */
+	uint32_t block_size; /* Bytes, multiple of 4 */
+	uint32_t offset; /* Data file offset of the block */
+	/* RLE */
+	bool rle;
+	uint16_t value; /* Last value written */
+	uint16_t count; /* Pending repeats of value */
+	/* Trigger markers, on the samples starting a match */
+	uint16_t mask;
+	uint16_t match;
+	bool matched;
+	/* Overflows */
+	uint64_t gap; /* Samples lost before the next one encoded */
+	uint64_t lost;
+	uint32_t nb_overflows;
+	uint32_t nb_triggers;
+	uint32_t dropped;
+} t_sump_stream;
+
+void sump_stream_init(t_sump_stream *s, const uint16_t *ring, uint32_t len,
+		      uint32_t block_size, bool rle, uint16_t mask,
+		      uint16_t value);
+void sump_stream_set_block(t_sump_stream *s, t_sump_block *block);
+bool sump_stream_update(t_sump_stream *s, uint32_t pos);
+void sump_stream_finish(t_sump_stream *s);
+void sump_stream_header(const t_sump_stream *s, t_sump_stream_header *h,
+			uint32_t sample_rate);
+
+#endif /* _HYDRABUS_SUMP_STREAM_H_ */
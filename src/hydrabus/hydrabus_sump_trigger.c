@@ -0,0 +1,438 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hydrabus_sump_trigger.h"
+
+/* a - b as a signed distance, counters are modulo 2^32 */
+#define DIST(a, b) ((int32_t)((a) - (b)))
+
+/* Samples after the trigger keep this part of the ring free */
+#define RING_MAX_READ(len) ((len) - (len) / 4)
+
+static inline uint16_t ring_sample(const t_sump_capture *c, uint32_t idx)
+{
+	if (c->sample_size == 1)
+		return ((const uint8_t *)c->ring)[idx];
+	return ((const uint16_t *)c->ring)[idx];
+}
+
+static void set_counts(t_sump_capture *c, uint32_t max)
+{
+	c->read_count = (c->req_read_count > max) ? max : c->req_read_count;
+	c->delay_count = (c->req_delay_count > c->read_count) ?
+			 c->read_count : c->req_delay_count;
+}
+
+/* Stages evaluated at the current level, not done yet */
+static void update_active(t_sump_capture *c)
+{
+	t_sump_stage *s;
+	int i;
+
+	c->nb_active = 0;
+	for (i = 0; i < SUMP_NB_STAGES; i++) {
+		s = &c->stages[i];
+		if (!s->done && SUMP_TRIG_CONF_LEVEL(s->config) <= c->level)
+			c->active[c->nb_active++] = i;
+	}
+}
+
+static void init_stages(t_sump_capture *c, const uint32_t *masks,
+			const uint32_t *values, const uint32_t *configs)
+{
+	t_sump_stage *s, *start;
+	int i, nb_start;
+
+	c->level = 0;
+	c->serial = false;
+	start = NULL;
+	nb_start = 0;
+	for (i = 0; i < SUMP_NB_STAGES; i++) {
+		s = &c->stages[i];
+		s->mask = masks[i];
+		s->value = values[i] & masks[i];
+		s->config = configs[i];
+		s->shift = 0;
+		s->countdown = 0;
+		/* An unused stage (zero mask, no delay, no start) would
+		 * only raise the level on the first sample */
+		s->done = (s->mask == 0 && s->config == 0);
+		if (s->done)
+			continue;
+		if (s->config & SUMP_TRIG_CONF_SERIAL)
+			c->serial = true;
+		if (s->config & SUMP_TRIG_CONF_START) {
+			start = s;
+			nb_start++;
+		}
+	}
+	update_active(c);
+
+	/* Levels do not matter with a single start stage at level 0 */
+	c->simple = (nb_start == 1 && SUMP_TRIG_CONF_LEVEL(start->config) == 0 &&
+		     SUMP_TRIG_CONF_DELAY(start->config) == 0 &&
+		     !(start->config & SUMP_TRIG_CONF_SERIAL));
+	if (c->simple) {
+		c->mask = start->mask;
+		c->value = start->value;
+	}
+}
+
+/**
+ * @brief   Prepares a capture
+ * @note    The trigger is evaluated once the samples before it are in the
+ *          ring, so the data returned never contains stale samples.
+ *          The trigger sample is returned at read_count - delay_count
+ *          (oldest first). Up to 3/4 of the ring is returned, the rest
+ *          absorbs the samples written while the trigger is searched.
+ * @note    Stages follow the SUMP semantics: a stage is evaluated once the
+ *          trigger level reaches its level. On a match of its mask and
+ *          value (parallel: the sample, serial: the last 32 samples of its
+ *          channel, newest in bit 0), it waits for its delay then starts
+ *          the capture or raises the level. Each stage acts once.
+ *
+ * @param[out] c		capture state
+ * @param[in] ring		ring filled by the sampler from index 0
+ * @param[in] len		ring size in samples, power of two
+ * @param[in] sample_size	1 or 2 bytes per sample
+ * @param[in] read_count	samples to return, clamped to 3/4 of len
+ * @param[in] delay_count	samples to capture after the trigger
+ * @param[in] masks		SUMP_NB_STAGES trigger masks
+ * @param[in] values		SUMP_NB_STAGES trigger values
+ * @param[in] configs		SUMP_NB_STAGES trigger configurations
+ */
+void sump_capture_init(t_sump_capture *c, const void *ring, uint32_t len,
+		       uint8_t sample_size, uint32_t read_count,
+		       uint32_t delay_count, const uint32_t *masks,
+		       const uint32_t *values, const uint32_t *configs)
+{
+	c->ring = ring;
+	c->len = len;
+	c->sample_size = sample_size;
+	c->req_read_count = read_count;
+	c->req_delay_count = delay_count;
+	set_counts(c, RING_MAX_READ(len));
+	init_stages(c, masks, values, configs);
+	c->state = SUMP_CAPTURE_ARMED;
+	c->last = 0;
+	c->written = 0;
+	c->scan = c->read_count - c->delay_count;
+	c->end = 0;
+	c->skipped = 0;
+	c->lost = 0;
+	c->out = ring;
+	c->out_len = len;
+	c->rle_enabled = false;
+}
+
+/**
+ * @brief   Run length encodes the capture, as the OLS/SUMP RLE mode
+ * @note    The highest enabled channel is replaced by the count flag: a
+ *          word with the flag set holds the number of repeats of the
+ *          previous value. Read and delay counts are in words, so sparse
+ *          signals fill the buffer much slower.
+ *          The raw ring is only a staging buffer, encoded as it fills.
+ *
+ * @param[in,out] c		capture state, from sump_capture_init()
+ * @param[in] buf		encoded words buffer
+ * @param[in] len		buffer size in words, power of two
+ * @param[in] channels		enabled channel groups, bit 0: 0-7, bit 1: 8-15
+ */
+void sump_capture_set_rle(t_sump_capture *c, uint16_t *buf, uint32_t len,
+			  uint8_t channels)
+{
+	t_sump_rle *r = &c->rle;
+
+	/* Encoding stops at the last word, the whole buffer can be returned */
+	set_counts(c, len);
+
+	r->buf = buf;
+	r->len = len;
+	switch (channels & 0x03) {
+	case 1:
+		r->chan_mask = 0x007F;
+		r->flag = 0x0080;
+		r->shift = 0;
+		r->max_count = 0x7F;
+		break;
+	case 2:
+		r->chan_mask = 0x7F00;
+		r->flag = 0x8000;
+		r->shift = 8;
+		r->max_count = 0x7F;
+		break;
+	default:
+		r->chan_mask = 0x7FFF;
+		r->flag = 0x8000;
+		r->shift = 0;
+		r->max_count = 0x7FFF;
+		break;
+	}
+	/* Flag never matches a value, the first sample is written */
+	r->value = r->flag;
+	r->count = 0;
+	r->written = 0;
+	r->pre = c->read_count - c->delay_count;
+
+	c->out = buf;
+	c->out_len = len;
+	c->rle_enabled = true;
+	/* No data before the first sample */
+	c->scan = 0;
+}
+
+/* Runs the stages on a sample, returns TRUE when the capture starts */
+static bool stages_step(t_sump_capture *c, uint16_t sample)
+{
+	t_sump_stage *s;
+	uint32_t value;
+	int i;
+
+	if (c->serial) {
+		for (i = 0; i < SUMP_NB_STAGES; i++) {
+			s = &c->stages[i];
+			if (s->config & SUMP_TRIG_CONF_SERIAL)
+				s->shift = (s->shift << 1) |
+					   ((sample >> SUMP_TRIG_CONF_CHANNEL(s->config)) & 1);
+		}
+	}
+
+	for (i = 0; i < c->nb_active; i++) {
+		s = &c->stages[c->active[i]];
+		if (s->countdown) {
+			if (--s->countdown)
+				continue;
+		} else {
+			value = (s->config & SUMP_TRIG_CONF_SERIAL) ? s->shift : sample;
+			if ((value & s->mask) != s->value)
+				continue;
+			s->countdown = SUMP_TRIG_CONF_DELAY(s->config);
+			if (s->countdown)
+				continue;
+		}
+		if (s->config & SUMP_TRIG_CONF_START)
+			return true;
+		/* New stages are evaluated from the next sample */
+		s->done = true;
+		if (c->level < 3)
+			c->level++;
+		update_active(c);
+		break;
+	}
+	return false;
+}
+
+static inline bool trigger_step(t_sump_capture *c, uint16_t sample)
+{
+	if (c->simple)
+		return (sample & c->mask) == c->value;
+	return stages_step(c, sample);
+}
+
+/* Simple trigger, returns the number of samples before the match */
+static uint32_t match16(const uint16_t *ring, uint32_t nb, uint16_t mask,
+			uint16_t value)
+{
+	const uint16_t *sample = ring, *sample_end = ring + nb;
+
+	while (sample < sample_end && (*sample & mask) != value)
+		sample++;
+	return sample - ring;
+}
+
+static uint32_t match8(const uint8_t *ring, uint32_t nb, uint8_t mask,
+		       uint8_t value)
+{
+	const uint8_t *sample = ring, *sample_end = ring + nb;
+
+	while (sample < sample_end && (*sample & mask) != value)
+		sample++;
+	return sample - ring;
+}
+
+/* Searches the trigger up to the written samples, returns TRUE on match */
+static bool scan_trigger(t_sump_capture *c) __attribute__((optimize("-O3")));
+static bool scan_trigger(t_sump_capture *c)
+{
+	uint32_t idx, nb, i;
+
+	while (DIST(c->written, c->scan) > 0) {
+		/* Contiguous part of the ring */
+		idx = c->scan & (c->len - 1);
+		nb = c->written - c->scan;
+		if (nb > c->len - idx)
+			nb = c->len - idx;
+		if (c->simple && c->sample_size == 1) {
+			i = match8(&((const uint8_t *)c->ring)[idx], nb,
+				   c->mask, c->value);
+		} else if (c->simple) {
+			i = match16(&((const uint16_t *)c->ring)[idx], nb,
+				    c->mask, c->value);
+		} else {
+			for (i = 0; i < nb; i++)
+				if (stages_step(c, ring_sample(c, idx + i)))
+					break;
+		}
+		if (i < nb) {
+			c->scan += i;
+			return true;
+		}
+		c->scan += nb;
+	}
+	return false;
+}
+
+/* Appends a word, returns FALSE once the words after the trigger are done */
+static inline bool rle_put(t_sump_capture *c, uint16_t word)
+{
+	t_sump_rle *r = &c->rle;
+
+	if (c->state == SUMP_CAPTURE_TRIGGED && DIST(r->written, c->end) >= 0) {
+		c->state = SUMP_CAPTURE_DONE;
+		return false;
+	}
+	r->buf[r->written & (r->len - 1)] = word;
+	r->written++;
+	return true;
+}
+
+/* Pending repeats, then a new value */
+static inline bool rle_put_value(t_sump_capture *c, uint16_t value)
+{
+	t_sump_rle *r = &c->rle;
+
+	if (r->count) {
+		if (!rle_put(c, r->flag | (r->count << r->shift)))
+			return false;
+		r->count = 0;
+	}
+	r->value = value;
+	return rle_put(c, value);
+}
+
+/* Encodes the written samples and evaluates the trigger on them */
+static bool scan_rle(t_sump_capture *c) __attribute__((optimize("-O3")));
+static bool scan_rle(t_sump_capture *c)
+{
+	t_sump_rle *r = &c->rle;
+	uint32_t idx, nb, i;
+	uint16_t sample, value;
+
+	while (DIST(c->written, c->scan) > 0) {
+		idx = c->scan & (c->len - 1);
+		nb = c->written - c->scan;
+		if (nb > c->len - idx)
+			nb = c->len - idx;
+		for (i = 0; i < nb; i++) {
+			sample = ring_sample(c, idx + i);
+			value = sample & r->chan_mask;
+			if (c->state == SUMP_CAPTURE_ARMED &&
+			    DIST(r->written, r->pre) >= 0 &&
+			    trigger_step(c, sample)) {
+				/* The trigger sample starts a word */
+				if (!rle_put_value(c, value))
+					break;
+				c->end = r->written - 1 + c->delay_count;
+				c->state = SUMP_CAPTURE_TRIGGED;
+				if (DIST(r->written, c->end) >= 0) {
+					c->state = SUMP_CAPTURE_DONE;
+					break;
+				}
+			} else if (value != r->value) {
+				if (!rle_put_value(c, value))
+					break;
+			} else if (++r->count == r->max_count) {
+				if (!rle_put(c, r->flag | (r->count << r->shift)))
+					break;
+				r->count = 0;
+				/* Next sample is written as a value, counts never
+				 * follow each other */
+				r->value = r->flag;
+			}
+		}
+		c->scan += i;
+		if (c->state == SUMP_CAPTURE_DONE)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * @brief   Processes the samples written since the last call
+ * @note    Shall be called at least once per ring period, the number of
+ *          samples written is derived from the ring index.
+ *          If the evaluation falls behind by more than the free part of
+ *          the ring, the overwritten samples are skipped.
+ *
+ * @param[in,out] c		capture state
+ * @param[in] pos		ring index of the next sample written
+ *
+ * @return			TRUE once the samples after the trigger are
+ *				captured, the sampler can be stopped.
+ */
+bool sump_capture_update(t_sump_capture *c, uint32_t pos)
+{
+	uint32_t margin, overshoot;
+
+	c->written += (pos - c->last) & (c->len - 1);
+	c->last = pos;
+
+	if (c->rle_enabled) {
+		/* Samples overwritten before encoding are lost */
+		if (DIST(c->written, c->scan) > (int32_t)c->len) {
+			c->skipped += c->written - c->len - c->scan;
+			c->scan = c->written - c->len;
+		}
+		return scan_rle(c);
+	}
+
+	if (c->state == SUMP_CAPTURE_ARMED) {
+		/* Keep the pre-trigger samples of the next match intact */
+		margin = c->len - (c->read_count - c->delay_count);
+		if (DIST(c->written, c->scan) > (int32_t)margin) {
+			c->skipped += c->written - margin - c->scan;
+			c->scan = c->written - margin;
+		}
+		if (!scan_trigger(c))
+			return false;
+		c->end = c->scan + c->delay_count;
+		c->state = SUMP_CAPTURE_TRIGGED;
+	}
+	if (c->state == SUMP_CAPTURE_TRIGGED && DIST(c->written, c->end) >= 0) {
+		overshoot = c->written - c->end;
+		if (overshoot > c->len - c->read_count)
+			c->lost = overshoot - (c->len - c->read_count);
+		c->state = SUMP_CAPTURE_DONE;
+	}
+
+	return (c->state == SUMP_CAPTURE_DONE);
+}
+
+/**
+ * @brief   Index after the last sample returned
+ * @note    Samples are read backwards from this index in c->out,
+ *          read_count samples (or RLE words).
+ *
+ * @param[in] c			capture state, SUMP_CAPTURE_DONE
+ *
+ * @return			ring index.
+ */
+uint32_t sump_capture_end(const t_sump_capture *c)
+{
+	return c->end & (c->out_len - 1);
+}
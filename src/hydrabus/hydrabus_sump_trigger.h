@@ -0,0 +1,106 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2020 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRABUS_SUMP_TRIGGER_H_
+#define _HYDRABUS_SUMP_TRIGGER_H_
+
+/*
+ * Trigger evaluation and ring buffer indexes of the SUMP capture.
+ * No hardware or kernel access, so that it builds on a host.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SUMP_NB_STAGES		4
+
+/* Trigger stage configuration (SUMP set trigger configuration) */
+#define SUMP_TRIG_CONF_DELAY(conf)	((conf) & 0xFFFF)
+#define SUMP_TRIG_CONF_LEVEL(conf)	(((conf) >> 16) & 0x03)
+#define SUMP_TRIG_CONF_CHANNEL(conf)	(((conf) >> 20) & 0x1F)
+#define SUMP_TRIG_CONF_SERIAL		(1 << 26)
+#define SUMP_TRIG_CONF_START		(1 << 27)
+
+#define SUMP_CAPTURE_ARMED	0
+#define SUMP_CAPTURE_TRIGGED	1
+#define SUMP_CAPTURE_DONE	2
+
+typedef struct {
+	uint16_t *buf; /* Encoded words */
+	uint32_t len; /* Size in words, power of two */
+	uint16_t chan_mask; /* Channels recorded, flag excluded */
+	uint16_t flag; /* Highest enabled channel flags a count */
+	uint8_t shift; /* Count position in the word */
+	uint16_t max_count;
+	uint16_t value; /* Last value written */
+	uint16_t count; /* Pending repeats of value */
+	uint32_t written; /* Words written, modulo 2^32 */
+	uint32_t pre; /* Words before the trigger can be evaluated */
+} t_sump_rle;
+
+typedef struct {
+	uint32_t mask;
+	uint32_t value;
+	uint32_t config;
+	uint32_t shift; /* Serial mode, last 32 samples of the channel */
+	uint32_t countdown; /* Samples left before the action, 0 if none */
+	bool done; /* A stage acts once per capture */
+} t_sump_stage;
+
+typedef struct {
+	const void *ring;
+	uint32_t len; /* Ring size in samples, power of two */
+	uint8_t sample_size; /* 1 (8 channels packed) or 2 bytes */
+	uint32_t req_read_count; /* Requested counts */
+	uint32_t req_delay_count;
+	uint32_t read_count; /* Samples returned, up to 3/4 of len */
+	uint32_t delay_count; /* Samples after the trigger */
+	t_sump_stage stages[SUMP_NB_STAGES];
+	uint8_t level; /* Trigger level, 0 to 3 */
+	uint8_t active[SUMP_NB_STAGES]; /* Stages evaluated at this level */
+	uint8_t nb_active;
+	bool serial; /* At least one serial stage */
+	/* Single parallel start stage without delay, matched inline */
+	bool simple;
+	uint32_t mask;
+	uint32_t value;
+	uint8_t state;
+	uint32_t last; /* Ring index of the next sample written */
+	/* Sample counters since the start, modulo 2^32 */
+	uint32_t written;
+	uint32_t scan; /* Next sample to evaluate */
+	uint32_t end; /* First sample not returned, once trigged */
+	uint32_t skipped; /* Samples overwritten before evaluation */
+	uint32_t lost; /* Returned samples overwritten, update called late */
+	/* Data returned: the ring, or the RLE words (16bits) */
+	const void *out;
+	uint32_t out_len;
+	bool rle_enabled;
+	t_sump_rle rle;
+} t_sump_capture;
+
+void sump_capture_init(t_sump_capture *c, const void *ring, uint32_t len,
+		       uint8_t sample_size, uint32_t read_count, uint32_t delay_count,
+		       const uint32_t *masks, const uint32_t *values,
+		       const uint32_t *configs);
+void sump_capture_set_rle(t_sump_capture *c, uint16_t *buf, uint32_t len,
+			  uint8_t channels);
+bool sump_capture_update(t_sump_capture *c, uint32_t pos);
+uint32_t sump_capture_end(const t_sump_capture *c);
+
+#endif /* _HYDRABUS_SUMP_TRIGGER_H_ */
@@ -97,8 +97,17 @@ void _Error_Handler(char *, int);
 
 //#define platformProtectST25RComm()         do{ globalCommProtectCnt++; __DSB();NVIC_DisableIRQ(EXTI0_IRQn);__DSB();__ISB();}while(0) /*!< Protect unique access to ST25R communication channel - IRQ disable on single thread environment (MCU) ; Mutex lock on a multi thread environment      */
 //#define platformUnprotectST25RComm()       do{ if (--globalCommProtectCnt==0) {NVIC_EnableIRQ(EXTI0_IRQn);} }while(0)                /*!< Unprotect unique access to ST25R communication channel - IRQ enable on a single thread environment (MCU) ; Mutex unlock on a multi thread environment */
+#ifdef HYDRAFW_HOST
+/* Host build: the ST25R3916 interrupt is called from a thread, see host/st25r3916.c */
+void host_st25r3916_protect(void);
+void host_st25r3916_unprotect(void);
+void host_st25r3916_card(const uint8_t *atqa);
+#define platformProtectST25RComm()         host_st25r3916_protect()
+#define platformUnprotectST25RComm()       host_st25r3916_unprotect()
+#else
 #define platformProtectST25RComm()         do{ globalCommProtectCnt++; __DSB();NVIC_DisableIRQ(EXTI15_10_IRQn);__DSB();__ISB();}while(0) /*!< Protect unique access to ST25R391x communication channel - IRQ disable on single thread environment (MCU) ; Mutex lock on a multi thread environment      */
 #define platformUnprotectST25RComm()       do{ if (--globalCommProtectCnt==0) {NVIC_EnableIRQ(EXTI15_10_IRQn);} }while(0)                /*!< Unprotect unique access to ST25R391x communication channel - IRQ enable on a single thread environment (MCU) ; Mutex unlock on a multi thread environment */
+#endif
 
 #define platformProtectST25RIrqStatus()    platformProtectST25RComm()                       /*!< Protect unique access to IRQ status var - IRQ disable on single thread environment (MCU) ; Mutex lock on a multi thread environment */
 #define platformUnprotectST25RIrqStatus()  platformUnprotectST25RComm()                     /*!< Unprotect the IRQ status var - IRQ enable on a single thread environment (MCU) ; Mutex unlock on a multi thread environment         */
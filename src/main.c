@@ -32,6 +32,7 @@
 #include "usb2cfg.h"
 
 #include "microsd.h"
+#include "logger.h"
 #include "hydrabus.h"
 #ifdef HYDRANFC
 #include "hydranfc.h"
@@ -70,44 +71,96 @@ t_hydra_console consoles[] = {
 	{ .thread_name="console USB2", .sdu=&SDU2, .tl=&tl_con2, .mode = &mode_con2 }
 };
 
-THD_FUNCTION(console, arg)
+static THD_WORKING_AREA(wa_console_tx, CONSOLE_TX_WA_SIZE);
+
+/* Flush console output left idle in the TX buffers */
+THD_FUNCTION(console_tx, arg)
 {
-	t_hydra_console *con;
-	char input;
-	int i=0;
+	int i;
 
-	con = arg;
-	chRegSetThreadName(con->thread_name);
-	tl_init(con->tl, tl_tokens, tl_dict, print, con);
-	con->tl->prompt = PROMPT;
-	tl_set_callback(con->tl, execute);
+	(void)arg;
+	chRegSetThreadName("console TX");
 
-	if(is_file_present(INIT_SCRIPT_NAME)) {
-		execute_script(con,INIT_SCRIPT_NAME);
+	while (TRUE) {
+		chThdSleepMilliseconds(CONSOLE_TX_IDLE_MS);
+		for (i = 0; i < (int)ARRAY_SIZE(consoles); i++)
+			cflush_idle(&consoles[i]);
 	}
+}
 
-	while (1) {
-		input = get_char(con);
-		switch(input) {
+/* Console input is read in chunks of up to one USB buffer */
+#define CONSOLE_RX_CHUNK_SIZE SERIAL_USB_BUFFERS_SIZE
+
+/* BBIO is entered after 20 consecutive \x00 */
+#define BBIO_ENTRY_NUL_COUNT 20
+/* SUMP identification is 5*\x00 \x02 */
+#define SUMP_ENTRY_NUL_COUNT 5
+
+/*
+ * Feed a chunk of console input to tokenline while looking for the
+ * BBIO/SUMP entry sequences, nul_count is kept across chunks.
+ * Once a binary mode has been entered, the end of the chunk is dropped as
+ * the host waits for the mode banner before sending anything else.
+ */
+static void console_input(t_hydra_console *con, const uint8_t *data,
+			  uint32_t size, int *nul_count)
+{
+	uint32_t i;
+
+	for (i = 0; i < size; i++) {
+		switch (data[i]) {
 		case 0:
-			if (++i == 20) {
+			if (++(*nul_count) == BBIO_ENTRY_NUL_COUNT) {
 				cmd_bbio(con);
-				i=0;
+				*nul_count = 0;
+				return;
 			}
 			break;
-		/* SUMP identification is 5*\x00 \x02 */
 		/* Allows to enter SUMP mode autmomatically */
 		case 2:
-			if(i == 5) {
+			if (*nul_count == SUMP_ENTRY_NUL_COUNT) {
 				cprintf(con, "1ALS");
 				sump(con);
+				*nul_count = 0;
+				return;
 			}
 			break;
 		default:
-			i=0;
-			tl_input(con->tl, input);
+			*nul_count = 0;
+			tl_input(con->tl, data[i]);
+		}
+	}
+}
+
+THD_FUNCTION(console, arg)
+{
+	t_hydra_console *con;
+	uint8_t input[CONSOLE_RX_CHUNK_SIZE];
+	uint32_t len;
+	int nul_count = 0;
+
+	con = arg;
+	chRegSetThreadName(con->thread_name);
+	tl_init(con->tl, tl_tokens, tl_dict, print, con);
+	con->tl->prompt = PROMPT;
+	tl_set_callback(con->tl, execute);
+
+	if(is_file_present(INIT_SCRIPT_NAME)) {
+		execute_script(con,INIT_SCRIPT_NAME);
+	}
+
+	while (1) {
+		/* Wait for input, then take everything already received */
+		len = cread(con, input, 1);
+		if (len == 0) {
+			/* USB not ready */
+			chThdSleepMilliseconds(1);
+			continue;
 		}
-		chThdSleepMilliseconds(1);
+		len += cread_timeout(con, &input[1], sizeof(input) - 1,
+				     TIME_IMMEDIATE);
+
+		console_input(con, input, len, &nul_count);
 	}
 }
 
@@ -158,6 +211,12 @@ int main(void)
 	sduObjectInit(&SDU2);
 	sduStart(&SDU2, &serusb2cfg);
 
+	for (i = 0; i < (int)ARRAY_SIZE(consoles); i++)
+		console_tx_init(&consoles[i]);
+	chThdCreateStatic(wa_console_tx, sizeof(wa_console_tx), NORMALPRIO + 1,
+			  console_tx, NULL);
+	logger_init();
+
 	/*
 	 * Activates the USB1 & 2 driver and then the USB bus pull-up on D+.
 	 * Note, a delay is inserted in order to not have to disconnect the cable